@@ -0,0 +1,293 @@
+#include <benchmarks.h>
+#include <chatmodel.h>
+#include <chattexttokenizer.h>
+#include <llmrecorder.h>
+#include <mockllmserver.h>
+#include <syntaxcolormodel.h>
+#include <toolservice.h>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QMap>
+#include <QTest>
+
+// Languages with a tokenizer of their own
+static const QStringList s_languages = {
+    "cpp", "java", "javascript", "sql", "typescript", "python", "bash", "pascal", //
+    "sapabap", "fortran", "cobol", "objective-c", "swift", "php", "csh",          //
+};
+
+// Corpus text per language
+static constexpr qsizetype CorpusSize = 256 * 1024;
+
+// Code shaped text any tokenizer gets through: keywords, literals, comments, brackets
+static const char *s_syntheticCode = //
+    "#include <vector>\n"
+    "// line comment with some words\n"
+    "/* block comment */\n"
+    "function compute(int value, const char *name) {\n"
+    "    if (value > 42 && name != null) {\n"
+    "        return value * 3.14 + 0x1F; # shell style comment\n"
+    "    }\n"
+    "    let text = \"string with \\\"escapes\\\"\" + 'single';\n"
+    "    SELECT id, name FROM items WHERE id = 7; -- sql comment\n"
+    "\tfor (i = 0; i < 10; i++) { total += values[i]; }\n"
+    "}\n";
+
+void Benchmarks::initTestCase()
+{
+    // the hot paths log, keep it out of the timings
+    QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+    QVERIFY2(m_dir.isValid(), qPrintable(m_dir.errorString()));
+}
+
+// ---------------- Tokenizers ----------------------------
+
+void Benchmarks::corpusData()
+{
+    QTest::addColumn<QString>("code");
+    QTest::addColumn<QString>("language");
+
+    QString synthetic;
+    while (synthetic.size() < CorpusSize) {
+        synthetic.append(QString::fromLatin1(s_syntheticCode));
+    }
+    foreach (const QString &language, s_languages) {
+        QTest::addRow("synthetic:%s", qPrintable(language)) << synthetic << language;
+    }
+
+    // source files of the corpus by language, up to the corpus size each
+    const QString corpus = qEnvironmentVariable("EOFAICHAT_BENCHMARK_CORPUS");
+    if (corpus.isEmpty()) {
+        return;
+    }
+    QMap<QString, QString> corpora;
+    QDirIterator it(corpus, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QFileInfo info(it.next());
+        QString language = ChatTextTokenizer::fileExtToLanguage(info.suffix());
+        if (language == QStringLiteral("shell")) {
+            language = QStringLiteral("bash");
+        }
+        if (!s_languages.contains(language) || corpora.value(language).size() >= CorpusSize) {
+            continue;
+        }
+        QFile file(info.filePath());
+        if (file.open(QIODevice::ReadOnly)) {
+            corpora[language].append(QString::fromUtf8(file.read(CorpusSize - corpora.value(language).size())));
+        }
+    }
+    for (auto text = corpora.constBegin(); text != corpora.constEnd(); ++text) {
+        QTest::addRow("corpus:%s", qPrintable(text.key())) << text.value() << text.key();
+    }
+}
+
+void Benchmarks::tokenize_data()
+{
+    corpusData();
+}
+
+void Benchmarks::tokenize()
+{
+    QFETCH(QString, code);
+    QFETCH(QString, language);
+
+    QBENCHMARK {
+        ChatTextTokenizer::tokenizeCode(code, language);
+    }
+}
+
+void Benchmarks::tokensToHtml_data()
+{
+    corpusData();
+}
+
+void Benchmarks::tokensToHtml()
+{
+    QFETCH(QString, code);
+    QFETCH(QString, language);
+
+    SyntaxColorModel colors;
+    colors.loadSyntaxModel();
+    const QVector<Token> tokens = ChatTextTokenizer::tokenizeCode(code, language);
+
+    QBENCHMARK {
+        TokenizerBase::tokensToHtml(tokens, language, &colors);
+    }
+}
+
+// ---------------- Stream parser ----------------------------
+
+void Benchmarks::onParseDataStream_data()
+{
+    QTest::addColumn<QList<QByteArray>>("chunks");
+
+    // mock answers in one token events and in events of 16 tokens
+    MockLLMServer::Options options;
+    options.tokens = 4000;
+    QTest::newRow("mock-1") << MockLLMServer::answerEvents(options);
+    options.chunkTokens = 16;
+    QTest::newRow("mock-16") << MockLLMServer::answerEvents(options);
+
+    // recorded streams in the chunks they arrived in
+    const QString recording = qEnvironmentVariable("EOFAICHAT_BENCHMARK_SSE");
+    if (recording.isEmpty()) {
+        return;
+    }
+    int index = 0;
+    foreach (const LLMRecorder::Exchange &exchange, LLMRecorder::load(recording)) {
+        if (exchange.contentType.contains(QStringLiteral("event-stream")) && !exchange.chunks.isEmpty()) {
+            QTest::addRow("recorded-%d", index++) << exchange.chunks;
+        }
+    }
+}
+
+void Benchmarks::onParseDataStream()
+{
+    QFETCH(QList<QByteArray>, chunks);
+
+    QBENCHMARK {
+        // complete lines only, as LLMChatClient hands them over
+        ChatModel model;
+        QByteArray buffer;
+        foreach (const QByteArray &chunk, chunks) {
+            buffer.append(chunk);
+            const qsizetype end = buffer.lastIndexOf('\n');
+            if (end >= 0) {
+                model.onParseDataStream(buffer.left(end + 1));
+                buffer.remove(0, end + 1);
+            }
+        }
+        if (!buffer.isEmpty()) {
+            model.onParseDataStream(buffer);
+        }
+    }
+}
+
+// ---------------- Chat storage ----------------------------
+
+void Benchmarks::chatSizeData()
+{
+    QTest::addColumn<int>("count");
+
+    foreach (int count, QList<int>({10, 1000, 10000})) {
+        QTest::addRow("%d", count) << count;
+    }
+}
+
+static inline void fillChat(ChatModel &model, int count)
+{
+    const QString content = QString::fromLatin1(s_syntheticCode).repeated(4);
+    for (int i = 0; i < count; i++) {
+        ChatMessage *message = new ChatMessage(&model);
+        message->setId(QStringLiteral("msg-%1").arg(i));
+        message->setRole(i % 2 ? ChatMessage::AssistantRole : ChatMessage::UserRole);
+        message->setModel(QStringLiteral("mock-model"));
+        message->setCreated(QDateTime::currentSecsSinceEpoch());
+        message->setContent(content);
+        model.appendMessage(message);
+    }
+}
+
+QString Benchmarks::chatFile(int count)
+{
+    const QString fileName = m_dir.filePath(QStringLiteral("chat-%1.json").arg(count));
+    if (!QFile::exists(fileName)) {
+        ChatModel model;
+        fillChat(model, count);
+        model.saveToFile(fileName);
+    }
+    return fileName;
+}
+
+void Benchmarks::saveToFile_data()
+{
+    chatSizeData();
+}
+
+void Benchmarks::saveToFile()
+{
+    QFETCH(int, count);
+
+    ChatModel model;
+    fillChat(model, count);
+    const QString fileName = m_dir.filePath(QStringLiteral("save-%1.json").arg(count));
+
+    QBENCHMARK {
+        model.saveToFile(fileName);
+    }
+}
+
+void Benchmarks::loadFromFile_data()
+{
+    chatSizeData();
+}
+
+void Benchmarks::loadFromFile()
+{
+    QFETCH(int, count);
+
+    const QString fileName = chatFile(count);
+    ChatModel model;
+
+    // replaces the messages of the former iteration, as reopening a chat does
+    QBENCHMARK {
+        model.loadFromFile(fileName);
+    }
+    QCOMPARE(model.rowCount(), count);
+}
+
+// ---------------- Source scan ----------------------------
+
+// directories of fanout subdirectories to the depth, each with source, object and text files
+static inline bool generateTree(const QString &root, int depth, int fanout)
+{
+    static const QStringList suffixes = {"cpp", "h", "py", "o", "txt", "java", "md", "js"};
+    QStringList level = {root};
+    for (int d = 0; d <= depth; d++) {
+        QStringList next;
+        foreach (const QString &path, level) {
+            QDir().mkpath(path);
+            for (int f = 0; f < suffixes.size() * 2; f++) {
+                QFile file(QStringLiteral("%1/file%2.%3").arg(path).arg(f).arg(suffixes[f % suffixes.size()]));
+                if (!file.open(QIODevice::WriteOnly)) {
+                    return false;
+                }
+            }
+            for (int s = 0; d < depth && s < fanout; s++) {
+                next.append(QStringLiteral("%1/dir%2").arg(path).arg(s));
+            }
+        }
+        level = next;
+    }
+    return true;
+}
+
+void Benchmarks::findSourceFiles_data()
+{
+    QTest::addColumn<QString>("root");
+
+    foreach (int fanout, QList<int>({4, 8})) {
+        const QString variant = QStringLiteral("depth3-fanout%1").arg(fanout);
+        const QString root = m_dir.filePath(variant);
+        if (!QFileInfo::exists(root)) {
+            QVERIFY2(generateTree(root, 3, fanout), qPrintable(root));
+        }
+        QTest::newRow(qPrintable(variant)) << root;
+    }
+}
+
+void Benchmarks::findSourceFiles()
+{
+    QFETCH(QString, root);
+
+    ToolService service;
+    QBENCHMARK {
+        service.findSourceFiles(root, QStringList(), true);
+    }
+}
+
+QTEST_MAIN(Benchmarks)
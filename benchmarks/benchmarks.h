@@ -0,0 +1,46 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QTemporaryDir>
+
+/**
+ * @brief QTest benchmarks of the text, stream and storage hot paths.
+ *
+ * Times the syntax tokenizers and their HTML rendering on synthetic code
+ * and on source files of a corpus directory, ChatModel::onParseDataStream
+ * on mock and recorded SSE, ChatModel::saveToFile and loadFromFile at 10,
+ * 1k and 10k messages and ToolService::findSourceFiles on generated trees.
+ *
+ * The corpus directory and the LLMRecorder file are taken from the
+ * environment variables EOFAICHAT_BENCHMARK_CORPUS and
+ * EOFAICHAT_BENCHMARK_SSE. Results are machine readable through the QTest
+ * output formats, e.g. "benchmarks -o results.xml,xml" or "-csv".
+ */
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void tokenize_data();
+    void tokenize();
+    void tokensToHtml_data();
+    void tokensToHtml();
+    void onParseDataStream_data();
+    void onParseDataStream();
+    void saveToFile_data();
+    void saveToFile();
+    void loadFromFile_data();
+    void loadFromFile();
+    void findSourceFiles_data();
+    void findSourceFiles();
+
+private:
+    QTemporaryDir m_dir;
+
+private:
+    void corpusData();
+    void chatSizeData();
+    QString chatFile(int count);
+};
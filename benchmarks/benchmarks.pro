@@ -0,0 +1,32 @@
+QT  += core
+QT  += gui
+QT  += widgets
+QT  += concurrent
+QT  += core5compat
+QT  += network
+QT  += testlib
+
+TARGET = benchmarks
+CONFIG += c++17
+CONFIG += console
+CONFIG += testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+# application sources, without main.cpp
+include(../core/core.pri)
+include(../models/models.pri)
+include(../tokenizers/tokenizers.pri)
+include(../ui/ui.pri)
+
+INCLUDEPATH += $$PWD/
+
+HEADERS += \
+    $$PWD/benchmarks.h
+
+SOURCES += \
+    $$PWD/benchmarks.cpp
+
+RESOURCES += \
+    ../eofaichat.qrc
@@ -0,0 +1,544 @@
+#include <attachmentcache.h>
+#include <jsonrequestdevice.h>
+#include <tokencounter.h>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+
+#if defined(Q_OS_UNIX)
+#include <sys/stat.h>
+#endif
+
+static AttachmentCache *s_instance = nullptr;
+
+// Bytes hashed at once for files above AttachmentCache::MaxTextSize
+static constexpr qint64 s_chunkSize = 1024 * 1024;
+
+static constexpr quint64 s_prime1 = 0x9E3779B185EBCA87ull;
+static constexpr quint64 s_prime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr quint64 s_prime3 = 0x165667B19E3779F9ull;
+static constexpr quint64 s_prime4 = 0x85EBCA77C2B2AE63ull;
+static constexpr quint64 s_prime5 = 0x27D4EB2F165667C5ull;
+
+static inline quint64 rotl(quint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline quint64 round64(quint64 acc, quint64 input)
+{
+    acc += input * s_prime2;
+    return rotl(acc, 31) * s_prime1;
+}
+
+static inline quint64 mergeRound(quint64 acc, quint64 value)
+{
+    acc ^= round64(0, value);
+    return acc * s_prime1 + s_prime4;
+}
+
+// Incremental XXH64, same result as hashing all bytes at once
+class Xxh64
+{
+public:
+    explicit Xxh64(quint64 seed)
+        : m_seed(seed)
+        , m_v{seed + s_prime1 + s_prime2, seed + s_prime2, seed, seed - s_prime1}
+        , m_buffer()
+        , m_buffered(0)
+        , m_total(0)
+    {}
+
+    void update(const char *data, qsizetype length)
+    {
+        const uchar *p = reinterpret_cast<const uchar *>(data);
+        m_total += length;
+
+        if (m_buffered + length < 32) {
+            memcpy(m_buffer + m_buffered, p, length);
+            m_buffered += length;
+            return;
+        }
+        if (m_buffered > 0) {
+            const qsizetype fill = 32 - m_buffered;
+            memcpy(m_buffer + m_buffered, p, fill);
+            stripe(m_buffer);
+            p += fill;
+            length -= fill;
+            m_buffered = 0;
+        }
+        for (; length >= 32; p += 32, length -= 32) {
+            stripe(p);
+        }
+        memcpy(m_buffer, p, length);
+        m_buffered = length;
+    }
+
+    quint64 digest() const
+    {
+        quint64 h;
+        if (m_total >= 32) {
+            h = rotl(m_v[0], 1) + rotl(m_v[1], 7) + rotl(m_v[2], 12) + rotl(m_v[3], 18);
+            for (int i = 0; i < 4; i++) {
+                h = mergeRound(h, m_v[i]);
+            }
+        } else {
+            h = m_seed + s_prime5;
+        }
+        h += m_total;
+
+        const uchar *p = m_buffer;
+        const uchar *end = m_buffer + m_buffered;
+        for (; p + 8 <= end; p += 8) {
+            h ^= round64(0, qFromLittleEndian<quint64>(p));
+            h = rotl(h, 27) * s_prime1 + s_prime4;
+        }
+        if (p + 4 <= end) {
+            h ^= quint64(qFromLittleEndian<quint32>(p)) * s_prime1;
+            h = rotl(h, 23) * s_prime2 + s_prime3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= *p * s_prime5;
+            h = rotl(h, 11) * s_prime1;
+        }
+
+        // avalanche
+        h ^= h >> 33;
+        h *= s_prime2;
+        h ^= h >> 29;
+        h *= s_prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    quint64 m_seed;
+    quint64 m_v[4];
+    uchar m_buffer[32];
+    qsizetype m_buffered;
+    quint64 m_total;
+
+private:
+    inline void stripe(const uchar *p)
+    {
+        for (int i = 0; i < 4; i++) {
+            m_v[i] = round64(m_v[i], qFromLittleEndian<quint64>(p + i * 8));
+        }
+    }
+};
+
+static inline QString detectLanguage(const QFileInfo &info, const QByteArray &head)
+{
+    static const QHash<QString, QString> languages = {
+        {"c", "c"},
+        {"h", "cpp"},
+        {"cc", "cpp"},
+        {"cpp", "cpp"},
+        {"cxx", "cpp"},
+        {"hh", "cpp"},
+        {"hpp", "cpp"},
+        {"hxx", "cpp"},
+        {"cs", "csharp"},
+        {"css", "css"},
+        {"go", "go"},
+        {"html", "html"},
+        {"htm", "html"},
+        {"java", "java"},
+        {"js", "javascript"},
+        {"json", "json"},
+        {"kt", "kotlin"},
+        {"md", "markdown"},
+        {"php", "php"},
+        {"pl", "perl"},
+        {"pri", "qmake"},
+        {"pro", "qmake"},
+        {"py", "python"},
+        {"qml", "qml"},
+        {"rb", "ruby"},
+        {"rs", "rust"},
+        {"sh", "bash"},
+        {"sql", "sql"},
+        {"swift", "swift"},
+        {"ts", "typescript"},
+        {"xml", "xml"},
+        {"yaml", "yaml"},
+        {"yml", "yaml"},
+    };
+
+    const QString language = languages.value(info.suffix().toLower());
+    if (!language.isEmpty()) {
+        return language;
+    }
+    if (info.fileName() == QLatin1String("CMakeLists.txt")) {
+        return QStringLiteral("cmake");
+    }
+
+    // scripts without suffix
+    if (head.startsWith("#!")) {
+        const QByteArray line = head.left(head.indexOf('\n'));
+        if (line.contains("python")) {
+            return QStringLiteral("python");
+        }
+        if (line.contains("node")) {
+            return QStringLiteral("javascript");
+        }
+        if (line.contains("perl")) {
+            return QStringLiteral("perl");
+        }
+        if (line.contains("sh")) {
+            return QStringLiteral("bash");
+        }
+    }
+    return QStringLiteral("text");
+}
+
+// Fills fileName, size, modified and inode, fileName stays empty on error
+static inline AttachmentCache::Entry statFile(const QString &fileName)
+{
+    AttachmentCache::Entry result{};
+    const QFileInfo info(fileName);
+    const QString canonical = info.canonicalFilePath();
+    if (canonical.isEmpty() || !info.isFile()) {
+        return result;
+    }
+
+    result.fileName = canonical;
+    result.size = info.size();
+    result.modified = info.lastModified().toMSecsSinceEpoch();
+#if defined(Q_OS_UNIX)
+    // a file replaced by rename keeps size and mtime more often than one thinks
+    struct stat st;
+    if (::stat(QFile::encodeName(canonical).constData(), &st) == 0) {
+        result.inode = st.st_ino;
+    }
+#endif
+    result.tokens = -1;
+    result.escapedSize = -1;
+    return result;
+}
+
+// Length of the bytes escaped as JSON string content, as JsonRequestDevice uploads them
+static inline qint64 escapedSize(const char *data, qsizetype length)
+{
+    qint64 size = 0;
+    QByteArray escaped;
+    QByteArray carry;
+    for (qsizetype offset = 0; offset < length; offset += JsonRequestDevice::ChunkSize) {
+        escaped.clear();
+        JsonRequestDevice::escape(data + offset, qMin<qsizetype>(JsonRequestDevice::ChunkSize, length - offset), escaped, carry, false);
+        size += escaped.size();
+    }
+    escaped.clear();
+    JsonRequestDevice::escape(nullptr, 0, escaped, carry, true);
+    return size + escaped.size();
+}
+
+static inline bool isSameFile(const AttachmentCache::Entry &a, const AttachmentCache::Entry &b)
+{
+    return a.size == b.size && a.modified == b.modified && a.inode == b.inode;
+}
+
+// Reads the metadata of a stat'ed file, text receives the decoded content
+// of files up to AttachmentCache::MaxTextSize, fileName is cleared on error
+static inline AttachmentCache::Entry readFile(const AttachmentCache::Entry &stat, QString *text)
+{
+    AttachmentCache::Entry entry = stat;
+
+    QFile file(stat.fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning().noquote() << "[AttachmentCache] Unable to read:" << stat.fileName << file.errorString();
+        entry.fileName.clear();
+        return entry;
+    }
+
+    const QFileInfo info(stat.fileName);
+    const TokenCounter *counter = TokenCounter::instance();
+
+    if (stat.size <= AttachmentCache::MaxTextSize) {
+        const QByteArray data = file.readAll();
+        if (text) {
+            *text = QString::fromUtf8(data);
+        }
+        entry.hash = AttachmentCache::hash(data.constData(), data.size());
+        entry.escapedSize = escapedSize(data.constData(), data.size());
+        entry.tokens = counter->count(data);
+        entry.language = detectLanguage(info, data.left(256));
+    } else {
+        Xxh64 hasher(0);
+        QByteArray head;
+        QByteArray escaped;
+        QByteArray carry;
+        entry.escapedSize = 0;
+        while (!file.atEnd()) {
+            const QByteArray chunk = file.read(s_chunkSize);
+            if (chunk.isEmpty()) {
+                break;
+            }
+            if (head.isEmpty()) {
+                head = chunk.left(256);
+            }
+            hasher.update(chunk.constData(), chunk.size());
+            escaped.clear();
+            JsonRequestDevice::escape(chunk.constData(), chunk.size(), escaped, carry, false);
+            entry.escapedSize += escaped.size();
+        }
+        escaped.clear();
+        JsonRequestDevice::escape(nullptr, 0, escaped, carry, true);
+        entry.escapedSize += escaped.size();
+        entry.hash = hasher.digest();
+        entry.tokens = counter->countFile(stat.fileName);
+        entry.language = detectLanguage(info, head);
+    }
+
+    return entry;
+}
+
+// ---------------------------------------------------------
+
+AttachmentCache *AttachmentCache::instance()
+{
+    if (!s_instance) {
+        s_instance = new AttachmentCache(qApp);
+    }
+    return s_instance;
+}
+
+AttachmentCache::AttachmentCache(QObject *parent)
+    : QObject{parent}
+    , m_entries()
+    , m_used()
+    , m_clock(0)
+    , m_texts(DefaultBudget)
+    , m_persistent(false)
+    , m_fileName(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/attachment_cache.json")
+{}
+
+quint64 AttachmentCache::hash(const char *data, qsizetype length, quint64 seed)
+{
+    Xxh64 hasher(seed);
+    hasher.update(data, length);
+    return hasher.digest();
+}
+
+inline AttachmentCache::Entry AttachmentCache::read(const Entry &stat, QString *text)
+{
+    QString decoded;
+    const Entry entry = readFile(stat, &decoded);
+    if (entry.fileName.isEmpty()) {
+        return entry;
+    }
+
+    insert(entry);
+    if (stat.size <= MaxTextSize) {
+        if (text) {
+            *text = decoded;
+        }
+        // the text is dropped right away if it exceeds the budget
+        m_texts.insert(stat.fileName, new QString(decoded), decoded.size() * sizeof(QChar));
+    }
+    return entry;
+}
+
+AttachmentCache::Entry AttachmentCache::scan(const QString &fileName)
+{
+    const Entry stat = statFile(fileName);
+    if (stat.fileName.isEmpty()) {
+        return stat;
+    }
+    return readFile(stat, nullptr);
+}
+
+void AttachmentCache::insert(const Entry &entry)
+{
+    if (entry.fileName.isEmpty()) {
+        return;
+    }
+    // the text of a former version is stale
+    m_texts.remove(entry.fileName);
+    if (!m_entries.contains(entry.fileName) && m_entries.size() >= MaxEntries) {
+        // least recently used, one pass over the stamps when full
+        auto oldest = m_used.constBegin();
+        for (auto it = m_used.constBegin(); it != m_used.constEnd(); ++it) {
+            if (it.value() < oldest.value()) {
+                oldest = it;
+            }
+        }
+        if (oldest != m_used.constEnd()) {
+            const QString evicted = oldest.key();
+            m_entries.remove(evicted);
+            m_used.remove(evicted);
+            m_texts.remove(evicted);
+        }
+    }
+    m_entries.insert(entry.fileName, entry);
+    touch(entry.fileName);
+}
+
+inline void AttachmentCache::touch(const QString &fileName) const
+{
+    m_used.insert(fileName, ++m_clock);
+}
+
+AttachmentCache::Entry AttachmentCache::cached(const QString &fileName) const
+{
+    const Entry stat = statFile(fileName);
+    if (stat.fileName.isEmpty()) {
+        return stat;
+    }
+
+    const auto it = m_entries.constFind(stat.fileName);
+    if (it != m_entries.constEnd() && isSameFile(*it, stat)) {
+        touch(stat.fileName);
+        return *it;
+    }
+    return stat;
+}
+
+AttachmentCache::Entry AttachmentCache::entry(const QString &fileName)
+{
+    const Entry stat = statFile(fileName);
+    if (stat.fileName.isEmpty()) {
+        return stat;
+    }
+
+    const auto it = m_entries.constFind(stat.fileName);
+    if (it != m_entries.constEnd() && isSameFile(*it, stat)) {
+        touch(stat.fileName);
+        return *it;
+    }
+    return read(stat);
+}
+
+QString AttachmentCache::text(const QString &fileName)
+{
+    const Entry entry = this->entry(fileName);
+    if (entry.fileName.isEmpty() || entry.size > MaxTextSize) {
+        return QString();
+    }
+    if (const QString *text = m_texts.object(entry.fileName)) {
+        return *text;
+    }
+
+    // evicted, or above the budget
+    QString text;
+    if (read(entry, &text).fileName.isEmpty()) {
+        return QString();
+    }
+    return text;
+}
+
+void AttachmentCache::setBudget(qint64 bytes)
+{
+    m_texts.setMaxCost(bytes);
+}
+
+void AttachmentCache::clear()
+{
+    m_entries.clear();
+    m_used.clear();
+    m_texts.clear();
+}
+
+void AttachmentCache::setPersistent(bool persistent)
+{
+    if (persistent && !m_persistent) {
+        load();
+    } else if (!persistent && m_persistent) {
+        QFile::remove(m_fileName);
+    }
+    m_persistent = persistent;
+}
+
+inline void AttachmentCache::load()
+{
+    QFile file(m_fileName);
+    if (!file.exists()) {
+        return;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning().noquote() << "[AttachmentCache] Unable to open:" << m_fileName << file.errorString();
+        return;
+    }
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    // token counts of another vocabulary are of no use
+    const bool countsValid = (root.value("encoding").toString() == TokenCounter::instance()->encoding());
+
+    int loaded = 0;
+    foreach (const QJsonValue &value, root.value("entries").toArray()) {
+        const QJsonObject o = value.toObject();
+        Entry entry{
+            .fileName = o.value("path").toString(),
+            .size = o.value("size").toInteger(),
+            .modified = o.value("modified").toInteger(),
+            .inode = o.value("inode").toString().toULongLong(nullptr, 16),
+            .language = o.value("language").toString(),
+            .tokens = o.value("tokens").toInt(-1),
+            .hash = o.value("hash").toString().toULongLong(nullptr, 16),
+            .escapedSize = o.value("escapedSize").toInteger(-1),
+        };
+        if (entry.fileName.isEmpty() || !countsValid || m_entries.contains(entry.fileName)) {
+            continue;
+        }
+        // changed files are read again on first use, saved in order of use
+        m_entries.insert(entry.fileName, entry);
+        touch(entry.fileName);
+        if (++loaded >= MaxEntries) {
+            break;
+        }
+    }
+
+    qDebug().noquote() << "[AttachmentCache] Loaded" << loaded << "entries";
+}
+
+bool AttachmentCache::save() const
+{
+    if (!m_persistent) {
+        return false;
+    }
+
+    // least recently used first, load() keeps the order
+    QStringList order = m_entries.keys();
+    std::sort(order.begin(), order.end(), [this](const QString &a, const QString &b) { //
+        return m_used.value(a) < m_used.value(b);
+    });
+
+    QJsonArray entries;
+    foreach (const QString &fileName, order) {
+        const Entry &entry = *m_entries.constFind(fileName);
+        entries.append(QJsonObject{
+            {"path", entry.fileName},
+            {"size", entry.size},
+            {"modified", entry.modified},
+            {"inode", QString::number(entry.inode, 16)},
+            {"language", entry.language},
+            {"tokens", entry.tokens},
+            {"hash", QString::number(entry.hash, 16)},
+            {"escapedSize", entry.escapedSize},
+        });
+    }
+    const QJsonObject root{
+        {"encoding", TokenCounter::instance()->encoding()},
+        {"entries", entries},
+    };
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning().noquote() << "[AttachmentCache] Unable to write:" << m_fileName << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <QCache>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+/**
+ * @brief Caches attachments between sends.
+ *
+ * Files are keyed by their canonical path, an entry stays valid while the
+ * size, modification time and inode of the file are unchanged, so
+ * attaching the same file again costs one stat. The metadata (language,
+ * token count, content hash, escaped size) of every file seen is kept
+ * and can be persisted across restarts, up to MaxEntries least recently
+ * used first out. Decoded text is kept within a memory budget, also least
+ * recently used first out; files above MaxTextSize are streamed from disk
+ * and only their metadata is cached.
+ *
+ * Used from the GUI thread only, scan() reads a file on a worker thread
+ * and insert() stores its result.
+ */
+class AttachmentCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        QString fileName; // canonical path, empty if the file cannot be read
+        qint64 size;
+        qint64 modified; // msecs since epoch
+        quint64 inode;
+        QString language;
+        int tokens;
+        quint64 hash; // XXH64 of the file bytes
+        qint64 escapedSize; // bytes of the content escaped as a JSON string, -1 if unknown
+    };
+
+    // Memory budget of the cached text in bytes
+    static constexpr qint64 DefaultBudget = 64 * 1024 * 1024;
+    // Text of larger files is not cached
+    static constexpr qint64 MaxTextSize = 8 * 1024 * 1024;
+    // Metadata entries kept at most
+    static constexpr int MaxEntries = 4096;
+
+    static AttachmentCache *instance();
+
+    /**
+     * @brief entry Returns the metadata of a file, the file is read and
+     * counted if it is not cached or has changed.
+     * @param fileName File path
+     * @return Entry, fileName is empty if the file cannot be read
+     */
+    Entry entry(const QString &fileName);
+
+    /**
+     * @brief cached Returns the metadata of an unchanged file without
+     * reading it
+     * @param fileName File path
+     * @return Entry, tokens is -1 if the file is not cached or has changed
+     */
+    Entry cached(const QString &fileName) const;
+
+    /**
+     * @brief scan Reads and counts a file without using the cache, safe on
+     * any thread
+     * @param fileName File path
+     * @return Entry to insert(), fileName is empty if the file cannot be read
+     */
+    static Entry scan(const QString &fileName);
+
+    // Stores the metadata of a scanned file
+    void insert(const Entry &entry);
+
+    /**
+     * @brief text Returns the decoded UTF-8 text of a file
+     * @param fileName File path
+     * @return Text, a null string if the file is larger than MaxTextSize
+     * or cannot be read
+     */
+    QString text(const QString &fileName);
+
+    void setBudget(qint64 bytes);
+    inline qint64 budget() const { return m_texts.maxCost(); }
+
+    /**
+     * @brief setPersistent Keeps the metadata across restarts, loads the
+     * saved entries when enabled.
+     * @param persistent True to persist
+     */
+    void setPersistent(bool persistent);
+    inline bool isPersistent() const { return m_persistent; }
+
+    // Writes the metadata if persistent
+    bool save() const;
+
+    void clear();
+
+    /**
+     * @brief hash XXH64 of a byte range
+     * @param data Bytes
+     * @param length Number of bytes
+     * @param seed Hash seed
+     * @return Hash value
+     */
+    static quint64 hash(const char *data, qsizetype length, quint64 seed = 0);
+
+private:
+    QHash<QString, Entry> m_entries;
+    // access stamp per entry, the oldest is evicted at MaxEntries
+    mutable QHash<QString, quint64> m_used;
+    mutable quint64 m_clock;
+    QCache<QString, QString> m_texts;
+    bool m_persistent;
+    QString m_fileName;
+
+private:
+    explicit AttachmentCache(QObject *parent = nullptr);
+    inline Entry read(const Entry &stat, QString *text = nullptr);
+    inline void touch(const QString &fileName) const;
+    inline void load();
+};
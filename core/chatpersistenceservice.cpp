@@ -0,0 +1,189 @@
+#include <chatpersistenceservice.h>
+#include <chatsearchindex.h>
+#include <QDebug>
+#include <QFileInfo>
+
+// streamed assistant messages are indexed once they are finished
+static inline bool isSearchable(const ChatMessage &message)
+{
+    return message.role() != ChatMessage::AssistantRole || !message.finishReason().isEmpty();
+}
+
+ChatHistoryWriter::ChatHistoryWriter(QObject *parent)
+    : QObject{parent}
+    , m_stores()
+{}
+
+ChatHistoryWriter::~ChatHistoryWriter()
+{
+    closeAll();
+}
+
+void ChatHistoryWriter::write(const QString &fileName, const QList<ChatHistoryStore::Change> &changes)
+{
+    ChatHistoryStore *store = m_stores.value(fileName);
+    if (!store) {
+        store = new ChatHistoryStore(fileName);
+        m_stores.insert(fileName, store);
+    }
+
+    if (!store->apply(changes)) {
+        qWarning().noquote() << "[ChatHistoryWriter] Unable to save chat history:" << fileName;
+        return;
+    }
+
+    updateSearchIndex(store, changes);
+}
+
+void ChatHistoryWriter::updateSearchIndex(ChatHistoryStore *store, const QList<ChatHistoryStore::Change> &changes)
+{
+    ChatSearchIndex *index = ChatSearchIndex::instance();
+    const QString fileName = store->fileName();
+    int shiftedFrom = -1;
+
+    foreach (const ChatHistoryStore::Change &change, changes) {
+        switch (change.op) {
+            case ChatHistoryStore::Put: {
+                if (change.snapshot && isSearchable(*change.snapshot)) {
+                    index->indexMessage(fileName, change.index, change.snapshot->id(), change.snapshot->content());
+                }
+                break;
+            }
+            case ChatHistoryStore::Remove: {
+                // later messages moved down by one
+                shiftedFrom = (shiftedFrom < 0 ? change.index : qMin(shiftedFrom, change.index));
+                index->removeFrom(fileName, change.index);
+                break;
+            }
+            case ChatHistoryStore::Truncate: {
+                index->removeFrom(fileName, change.index);
+                break;
+            }
+        }
+    }
+
+    if (shiftedFrom >= 0 && shiftedFrom < store->messageCount()) {
+        QList<QJsonObject> messages;
+        const int count = static_cast<int>(store->messageCount()) - shiftedFrom;
+        if (store->readMessages(shiftedFrom, count, messages)) {
+            index->removeFrom(fileName, shiftedFrom);
+            for (int i = 0; i < messages.size(); i++) {
+                ChatMessage message(nullptr);
+                message.fromJson(messages[i]);
+                if (isSearchable(message)) {
+                    index->indexMessage(fileName, shiftedFrom + i, message.id(), message.content());
+                }
+            }
+        }
+    }
+
+    // kept in memory, written on quit; a log indexed only in part is
+    // indexed again on start as its size differs
+    index->setIndexedSize(fileName, QFileInfo(fileName).size());
+}
+
+void ChatHistoryWriter::closeAll()
+{
+    // writes the offset index of each log
+    qDeleteAll(m_stores);
+    m_stores.clear();
+    // and the search index changes of this session
+    ChatSearchIndex::instance()->save();
+}
+
+// ---------------------------------------------------------
+
+ChatPersistenceService::ChatPersistenceService(QObject *parent)
+    : QObject{parent}
+    , m_thread()
+    , m_writer(new ChatHistoryWriter())
+    , m_timer()
+    , m_dirty()
+{
+    m_thread.setObjectName(QStringLiteral("ChatPersistence"));
+    m_writer->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_writer, &QObject::deleteLater);
+    m_thread.start(QThread::LowPriority);
+
+    // not restarted by later changes, so streaming writes once per interval
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(DebounceInterval);
+    connect(&m_timer, &QTimer::timeout, this, &ChatPersistenceService::flush);
+}
+
+ChatPersistenceService::~ChatPersistenceService()
+{
+    shutdown();
+}
+
+void ChatPersistenceService::watch(ChatModel *model)
+{
+    connect(model, &ChatModel::messageAdded, this, &ChatPersistenceService::onModelChanged);
+    connect(model, &ChatModel::messageChanged, this, &ChatPersistenceService::onModelChanged);
+    connect(model, &ChatModel::messageRemoved, this, &ChatPersistenceService::onModelChanged);
+    connect(model, &ChatModel::modelReset, this, &ChatPersistenceService::onModelChanged);
+}
+
+void ChatPersistenceService::onModelChanged()
+{
+    if (ChatModel *model = qobject_cast<ChatModel *>(sender())) {
+        markDirty(model);
+    }
+}
+
+void ChatPersistenceService::markDirty(ChatModel *model)
+{
+    if (!m_dirty.contains(model)) {
+        m_dirty.append(model);
+    }
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void ChatPersistenceService::flush()
+{
+    m_timer.stop();
+
+    foreach (const QPointer<ChatModel> &model, m_dirty) {
+        // chat was closed meanwhile or has no log yet
+        if (!model || model->historyFile().isEmpty() || !model->hasChanges()) {
+            continue;
+        }
+
+        // snapshots only, serialization happens on the writer thread
+        const QString fileName = model->historyFile();
+        const QList<ChatHistoryStore::Change> changes = model->takeChanges();
+
+        ChatHistoryWriter *writer = m_writer;
+        QMetaObject::invokeMethod(
+            writer,
+            [writer, fileName, changes]() { //
+                writer->write(fileName, changes);
+            },
+            Qt::QueuedConnection);
+    }
+
+    m_dirty.clear();
+}
+
+void ChatPersistenceService::shutdown()
+{
+    if (!m_thread.isRunning()) {
+        return;
+    }
+
+    flush();
+
+    // pending writes are processed before the stores are closed
+    ChatHistoryWriter *writer = m_writer;
+    QMetaObject::invokeMethod(
+        writer,
+        [writer]() { //
+            writer->closeAll();
+        },
+        Qt::BlockingQueuedConnection);
+
+    m_thread.quit();
+    m_thread.wait();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <chathistorystore.h>
+#include <chatmodel.h>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QThread>
+#include <QTimer>
+
+/**
+ * @brief Writes chat history logs on the I/O thread. Owns one open
+ * ChatHistoryStore per log file.
+ */
+class ChatHistoryWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChatHistoryWriter(QObject *parent = nullptr);
+    ~ChatHistoryWriter();
+
+public slots:
+    void write(const QString &fileName, const QList<ChatHistoryStore::Change> &changes);
+    void closeAll();
+
+private:
+    QHash<QString, ChatHistoryStore *> m_stores;
+
+private:
+    void updateSearchIndex(ChatHistoryStore *store, const QList<ChatHistoryStore::Change> &changes);
+};
+
+/**
+ * @brief Debounced chat persistence. Changed chats are collected on the
+ * GUI thread, their pending changes are taken as cheap message snapshots
+ * once per interval and serialized and written by ChatHistoryWriter on a
+ * dedicated thread.
+ */
+class ChatPersistenceService : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Bursts of changes within this interval end up in one write
+    static constexpr int DebounceInterval = 750;
+
+    explicit ChatPersistenceService(QObject *parent = nullptr);
+    ~ChatPersistenceService();
+
+    /**
+     * @brief watch Persists the chat whenever its messages change
+     * @param model Chat model with a history file assigned
+     */
+    void watch(ChatModel *model);
+
+public slots:
+    void markDirty(ChatModel *model);
+    // Hand pending changes to the writer now
+    void flush();
+    // Write everything and stop the writer thread, used on quit
+    void shutdown();
+
+private slots:
+    void onModelChanged();
+
+private:
+    QThread m_thread;
+    ChatHistoryWriter *m_writer;
+    QTimer m_timer;
+    QList<QPointer<ChatModel>> m_dirty;
+};
@@ -0,0 +1,753 @@
+#include <chathistorystore.h>
+#include <chatmessage.h>
+#include <chatsearchindex.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+
+static constexpr char s_segmentMagic[8] = {'E', 'O', 'F', 'S', 'E', 'G', '0', '1'};
+static constexpr qsizetype s_maxTermLength = 64;
+// BM25 parameters
+static constexpr double s_k1 = 1.2;
+static constexpr double s_b = 0.75;
+
+static ChatSearchIndex *s_instance = nullptr;
+
+// ---------------- Varint encoding --------------------------------
+
+static inline void writeVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+static inline void writeString(QByteArray &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    writeVarint(out, static_cast<quint64>(utf8.size()));
+    out.append(utf8);
+}
+
+class SegmentReader
+{
+public:
+    explicit SegmentReader(const QByteArray &data)
+        : m_data(data)
+        , m_pos(0)
+        , m_ok(true)
+    {}
+
+    inline bool ok() const { return m_ok; }
+
+    inline quint64 varint()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_pos >= m_data.size()) {
+                break;
+            }
+            const quint8 byte = static_cast<quint8>(m_data[m_pos++]);
+            value |= static_cast<quint64>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        m_ok = false;
+        return 0;
+    }
+
+    inline QString string()
+    {
+        const quint64 length = varint();
+        if (!m_ok || length > static_cast<quint64>(m_data.size() - m_pos)) {
+            m_ok = false;
+            return QString();
+        }
+        const QString value = QString::fromUtf8(m_data.constData() + m_pos, static_cast<qsizetype>(length));
+        m_pos += static_cast<qsizetype>(length);
+        return value;
+    }
+
+private:
+    const QByteArray &m_data;
+    qsizetype m_pos;
+    bool m_ok;
+};
+
+// ---------------- Tokenizer --------------------------------------
+
+static inline bool isTermChar(QChar c)
+{
+    return c.isLetterOrNumber() || c == u'_';
+}
+
+// Words and code identifiers; parts of camelCase/snake_case identifiers
+// share the position of the identifier.
+template<typename Callback>
+static inline void tokenize(QStringView text, bool withParts, Callback &&callback)
+{
+    quint32 position = 0;
+    const qsizetype length = text.size();
+    qsizetype i = 0;
+
+    while (i < length) {
+        while (i < length && !isTermChar(text[i])) {
+            i++;
+        }
+        const qsizetype start = i;
+        while (i < length && isTermChar(text[i])) {
+            i++;
+        }
+        if (i == start) {
+            continue;
+        }
+
+        const QStringView word = text.mid(start, qMin(i - start, s_maxTermLength));
+        callback(word.toString().toLower(), position);
+
+        if (withParts) {
+            QList<QStringView> parts;
+            qsizetype partStart = 0;
+            for (qsizetype k = 1; k <= word.size(); k++) {
+                const bool atEnd = (k == word.size());
+                const bool boundary = atEnd                                          //
+                                      || word[k] == u'_'                             //
+                                      || (word[k].isUpper() && word[k - 1].isLower());
+                if (boundary) {
+                    QStringView part = word.mid(partStart, k - partStart);
+                    while (part.startsWith(u'_')) {
+                        part = part.mid(1);
+                    }
+                    if (part.size() >= 2) {
+                        parts.append(part);
+                    }
+                    partStart = k;
+                }
+            }
+            if (parts.size() > 1) {
+                foreach (const QStringView &part, parts) {
+                    callback(part.toString().toLower(), position);
+                }
+            }
+        }
+
+        position++;
+    }
+}
+
+// ---------------------------------------------------------
+
+ChatSearchIndex *ChatSearchIndex::instance()
+{
+    // first call must come from the GUI thread
+    if (!s_instance) {
+        s_instance = new ChatSearchIndex(qApp);
+    }
+    return s_instance;
+}
+
+ChatSearchIndex::ChatSearchIndex(QObject *parent)
+    : QObject{parent}
+    , m_lock()
+    , m_directory(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/search_index")
+    , m_documents()
+    , m_documentsByFile()
+    , m_terms()
+    , m_indexedSizes()
+    , m_totalLength(0)
+    , m_nextDocument(1)
+    , m_segmentCount(0)
+    , m_nextSegment(1)
+    , m_pendingDocuments()
+    , m_pendingDeletes()
+    , m_pendingTerms()
+    , m_pendingSizes(false)
+{
+    QDir dir(m_directory);
+    if (!dir.exists() && !dir.mkpath(m_directory)) {
+        qWarning("[ChatSearchIndex] Unable to create directory: %s", qPrintable(m_directory));
+    }
+
+    load();
+}
+
+inline QString ChatSearchIndex::segmentFileName(int number) const
+{
+    return QDir(m_directory).absoluteFilePath(QStringLiteral("segment_%1.idx").arg(number, 6, 10, QChar('0')));
+}
+
+inline void ChatSearchIndex::addDocument(quint32 id, const Document &document)
+{
+    // a newer version replaces the old one
+    const auto file = m_documentsByFile.constFind(document.historyFile);
+    if (file != m_documentsByFile.constEnd() && file->contains(document.messageIndex)) {
+        removeDocument(file->value(document.messageIndex));
+    }
+    m_documents.insert(id, document);
+    m_documentsByFile[document.historyFile].insert(document.messageIndex, id);
+    m_totalLength += document.length;
+}
+
+inline void ChatSearchIndex::removeDocument(quint32 id)
+{
+    // postings of removed documents are filtered at query time and
+    // dropped when segments are merged
+    auto it = m_documents.find(id);
+    if (it == m_documents.end()) {
+        return;
+    }
+    auto file = m_documentsByFile.find(it->historyFile);
+    if (file != m_documentsByFile.end()) {
+        file->remove(it->messageIndex);
+        if (file->isEmpty()) {
+            m_documentsByFile.erase(file);
+        }
+    }
+    m_totalLength -= it->length;
+    m_documents.erase(it);
+}
+
+void ChatSearchIndex::indexMessage(const QString &historyFile, int messageIndex, const QString &messageId, const QString &content)
+{
+    // collect positions per term first
+    QHash<QString, QList<quint32>> positions;
+    quint32 length = 0;
+    tokenize(content, true, [&positions, &length](const QString &term, quint32 position) { //
+        QList<quint32> &list = positions[term];
+        if (list.isEmpty() || list.last() != position) {
+            list.append(position);
+        }
+        length = position + 1;
+    });
+
+    QWriteLocker locker(&m_lock);
+
+    const auto file = m_documentsByFile.constFind(historyFile);
+    if (file != m_documentsByFile.constEnd() && file->contains(messageIndex)) {
+        const quint32 old = file->value(messageIndex);
+        removeDocument(old);
+        m_pendingDeletes.append(old);
+    }
+
+    if (positions.isEmpty()) {
+        return;
+    }
+
+    const quint32 id = m_nextDocument++;
+    addDocument(id,
+                {
+                    .historyFile = historyFile,
+                    .messageIndex = messageIndex,
+                    .messageId = messageId,
+                    .preview = content.simplified().left(160),
+                    .length = length,
+                });
+    m_pendingDocuments.append(id);
+
+    for (auto it = positions.constBegin(); it != positions.constEnd(); ++it) {
+        const Posting posting = {id, it.value()};
+        m_terms[it.key()].append(posting);
+        m_pendingTerms[it.key()].append(posting);
+    }
+}
+
+void ChatSearchIndex::removeFrom(const QString &historyFile, int messageIndex)
+{
+    QWriteLocker locker(&m_lock);
+
+    // messages of the log from the index on, ordered by index
+    const auto file = m_documentsByFile.constFind(historyFile);
+    if (file == m_documentsByFile.constEnd()) {
+        return;
+    }
+    QList<quint32> ids;
+    for (auto it = file->lowerBound(messageIndex); it != file->constEnd(); ++it) {
+        ids.append(it.value());
+    }
+    foreach (quint32 id, ids) {
+        removeDocument(id);
+        m_pendingDeletes.append(id);
+    }
+}
+
+qint64 ChatSearchIndex::indexedSize(const QString &historyFile) const
+{
+    QReadLocker locker(&m_lock);
+    return m_indexedSizes.value(historyFile, 0);
+}
+
+void ChatSearchIndex::setIndexedSize(const QString &historyFile, qint64 size)
+{
+    QWriteLocker locker(&m_lock);
+    m_indexedSizes.insert(historyFile, size);
+    m_pendingSizes = true;
+}
+
+// ---------------- Query ------------------------------------------
+
+QList<ChatSearchIndex::Hit> ChatSearchIndex::search(const QString &query, int limit) const
+{
+    struct Clause
+    {
+        QStringList terms;
+        bool prefix;
+    };
+
+    // "phrase", prefix* or word
+    QList<Clause> clauses;
+    static const QRegularExpression re(R"re("([^"]*)"|(\S+))re");
+    QRegularExpressionMatchIterator it = re.globalMatch(query);
+    while (it.hasNext()) {
+        const QRegularExpressionMatch match = it.next();
+        const bool quoted = match.capturedLength(1) > 0;
+        QString text = quoted ? match.captured(1) : match.captured(2);
+
+        bool prefix = false;
+        if (!quoted && text.endsWith('*')) {
+            text.chop(1);
+            prefix = true;
+        }
+
+        Clause clause = {{}, false};
+        tokenize(text, false, [&clause](const QString &term, quint32) { //
+            clause.terms.append(term);
+        });
+        if (clause.terms.isEmpty()) {
+            continue;
+        }
+        // prefix applies to a single term only
+        clause.prefix = (prefix && clause.terms.size() == 1 && clause.terms.first().size() >= 2);
+        clauses.append(clause);
+    }
+
+    QList<Hit> hits;
+    if (clauses.isEmpty()) {
+        return hits;
+    }
+
+    QReadLocker locker(&m_lock);
+
+    const double documentCount = qMax<double>(1.0, m_documents.size());
+    const double averageLength = qMax<double>(1.0, static_cast<double>(m_totalLength) / documentCount);
+
+    auto bm25 = [this, documentCount, averageLength](double tf, double df, quint32 document) -> double {
+        const double length = m_documents.value(document).length;
+        const double idf = std::log(1.0 + (documentCount - df + 0.5) / (df + 0.5));
+        return idf * (tf * (s_k1 + 1.0)) / (tf + s_k1 * (1.0 - s_b + s_b * length / averageLength));
+    };
+
+    // live postings of a term
+    auto postingsOf = [this](const QString &term) -> QList<const Posting *> {
+        QList<const Posting *> result;
+        auto found = m_terms.constFind(term);
+        if (found != m_terms.constEnd()) {
+            for (const Posting &posting : found.value()) {
+                if (m_documents.contains(posting.document)) {
+                    result.append(&posting);
+                }
+            }
+        }
+        return result;
+    };
+
+    QHash<quint32, double> scores;
+    bool first = true;
+
+    foreach (const Clause &clause, clauses) {
+        QHash<quint32, double> clauseScores;
+
+        if (clause.prefix) {
+            const QString &prefix = clause.terms.first();
+            int expanded = 0;
+            for (auto term = m_terms.lowerBound(prefix); //
+                 term != m_terms.constEnd() && term.key().startsWith(prefix) && expanded < MaxPrefixTerms;
+                 ++term, ++expanded) {
+                const QList<const Posting *> postings = postingsOf(term.key());
+                foreach (const Posting *posting, postings) {
+                    clauseScores[posting->document] += bm25(posting->positions.size(), postings.size(), posting->document);
+                }
+            }
+        } else if (clause.terms.size() == 1) {
+            const QList<const Posting *> postings = postingsOf(clause.terms.first());
+            foreach (const Posting *posting, postings) {
+                clauseScores[posting->document] += bm25(posting->positions.size(), postings.size(), posting->document);
+            }
+        } else {
+            // phrase: consecutive positions in the same document
+            QList<QHash<quint32, const QList<quint32> *>> termPositions;
+            QList<int> frequencies;
+            foreach (const QString &term, clause.terms) {
+                QHash<quint32, const QList<quint32> *> byDocument;
+                const QList<const Posting *> postings = postingsOf(term);
+                foreach (const Posting *posting, postings) {
+                    byDocument.insert(posting->document, &posting->positions);
+                }
+                termPositions.append(byDocument);
+                frequencies.append(postings.size());
+            }
+
+            for (auto doc = termPositions.first().constBegin(); doc != termPositions.first().constEnd(); ++doc) {
+                int matches = 0;
+                foreach (quint32 position, *doc.value()) {
+                    bool found = true;
+                    for (int k = 1; k < termPositions.size() && found; k++) {
+                        const QList<quint32> *next = termPositions[k].value(doc.key(), nullptr);
+                        found = next && std::binary_search(next->cbegin(), next->cend(), position + k);
+                    }
+                    if (found) {
+                        matches++;
+                    }
+                }
+                if (matches > 0) {
+                    double score = 0;
+                    for (int k = 0; k < frequencies.size(); k++) {
+                        score += bm25(matches, frequencies[k], doc.key());
+                    }
+                    clauseScores.insert(doc.key(), score);
+                }
+            }
+        }
+
+        // all clauses must match
+        if (first) {
+            scores = clauseScores;
+            first = false;
+        } else {
+            QHash<quint32, double> merged;
+            for (auto score = scores.constBegin(); score != scores.constEnd(); ++score) {
+                auto other = clauseScores.constFind(score.key());
+                if (other != clauseScores.constEnd()) {
+                    merged.insert(score.key(), score.value() + other.value());
+                }
+            }
+            scores = merged;
+        }
+
+        if (scores.isEmpty()) {
+            return hits;
+        }
+    }
+
+    QList<QPair<double, quint32>> ranked;
+    ranked.reserve(scores.size());
+    for (auto score = scores.constBegin(); score != scores.constEnd(); ++score) {
+        ranked.append(qMakePair(score.value(), score.key()));
+    }
+    const int count = qMin<int>(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), [](const auto &a, const auto &b) { //
+        return a.first > b.first;
+    });
+
+    for (int i = 0; i < count; i++) {
+        const Document &document = m_documents[ranked[i].second];
+        hits.append({
+            .historyFile = document.historyFile,
+            .messageIndex = document.messageIndex,
+            .messageId = document.messageId,
+            .preview = document.preview,
+            .score = ranked[i].first,
+        });
+    }
+
+    return hits;
+}
+
+// ---------------- Segments ---------------------------------------
+
+inline bool ChatSearchIndex::writeSegment(const QString &fileName, bool full)
+{
+    QByteArray body;
+    writeVarint(body, m_nextDocument);
+
+    // documents
+    const QList<quint32> documents = full ? m_documents.keys() : m_pendingDocuments;
+    QList<quint32> written;
+    foreach (quint32 id, documents) {
+        if (m_documents.contains(id)) {
+            written.append(id);
+        }
+    }
+    writeVarint(body, written.size());
+    foreach (quint32 id, written) {
+        const Document &document = m_documents[id];
+        writeVarint(body, id);
+        writeString(body, document.historyFile);
+        writeVarint(body, static_cast<quint64>(document.messageIndex));
+        writeString(body, document.messageId);
+        writeString(body, document.preview);
+        writeVarint(body, document.length);
+    }
+
+    // tombstones of documents of earlier segments
+    const QList<quint32> deletes = full ? QList<quint32>() : m_pendingDeletes;
+    writeVarint(body, deletes.size());
+    foreach (quint32 id, deletes) {
+        writeVarint(body, id);
+    }
+
+    // indexed log sizes
+    writeVarint(body, m_indexedSizes.size());
+    for (auto it = m_indexedSizes.constBegin(); it != m_indexedSizes.constEnd(); ++it) {
+        writeString(body, it.key());
+        writeVarint(body, static_cast<quint64>(it.value()));
+    }
+
+    // postings, positions delta encoded
+    const QMap<QString, QList<Posting>> &terms = full ? m_terms : m_pendingTerms;
+    QByteArray postingData;
+    int termCount = 0;
+    for (auto it = terms.constBegin(); it != terms.constEnd(); ++it) {
+        QList<const Posting *> live;
+        for (const Posting &posting : it.value()) {
+            if (m_documents.contains(posting.document)) {
+                live.append(&posting);
+            }
+        }
+        if (live.isEmpty()) {
+            continue;
+        }
+        termCount++;
+        writeString(postingData, it.key());
+        writeVarint(postingData, live.size());
+        foreach (const Posting *posting, live) {
+            writeVarint(postingData, posting->document);
+            writeVarint(postingData, posting->positions.size());
+            quint32 previous = 0;
+            foreach (quint32 position, posting->positions) {
+                writeVarint(postingData, position - previous);
+                previous = position;
+            }
+        }
+    }
+    writeVarint(body, termCount);
+    body.append(postingData);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning().noquote() << "[ChatSearchIndex] Unable to write segment:" << fileName << file.errorString();
+        return false;
+    }
+
+    char header[sizeof(s_segmentMagic) + sizeof(quint32)];
+    memcpy(header, s_segmentMagic, sizeof(s_segmentMagic));
+    qToLittleEndian<quint32>(ChatHistoryStore::crc32(body.constData(), body.size()), header + sizeof(s_segmentMagic));
+    file.write(header, sizeof(header));
+    file.write(body);
+
+    return file.commit();
+}
+
+inline bool ChatSearchIndex::readSegment(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    const qsizetype headerSize = sizeof(s_segmentMagic) + sizeof(quint32);
+    if (data.size() < headerSize || memcmp(data.constData(), s_segmentMagic, sizeof(s_segmentMagic)) != 0) {
+        return false;
+    }
+
+    const QByteArray body = data.mid(headerSize);
+    if (qFromLittleEndian<quint32>(data.constData() + sizeof(s_segmentMagic)) != ChatHistoryStore::crc32(body.constData(), body.size())) {
+        return false;
+    }
+
+    SegmentReader reader(body);
+    m_nextDocument = qMax<quint32>(m_nextDocument, static_cast<quint32>(reader.varint()));
+
+    const quint64 documentCount = reader.varint();
+    for (quint64 i = 0; i < documentCount && reader.ok(); i++) {
+        const quint32 id = static_cast<quint32>(reader.varint());
+        Document document;
+        document.historyFile = reader.string();
+        document.messageIndex = static_cast<int>(reader.varint());
+        document.messageId = reader.string();
+        document.preview = reader.string();
+        document.length = static_cast<quint32>(reader.varint());
+        if (reader.ok()) {
+            addDocument(id, document);
+        }
+    }
+
+    const quint64 deleteCount = reader.varint();
+    for (quint64 i = 0; i < deleteCount && reader.ok(); i++) {
+        removeDocument(static_cast<quint32>(reader.varint()));
+    }
+
+    const quint64 sizeCount = reader.varint();
+    for (quint64 i = 0; i < sizeCount && reader.ok(); i++) {
+        const QString historyFile = reader.string();
+        m_indexedSizes.insert(historyFile, static_cast<qint64>(reader.varint()));
+    }
+
+    const quint64 termCount = reader.varint();
+    for (quint64 i = 0; i < termCount && reader.ok(); i++) {
+        QList<Posting> &postings = m_terms[reader.string()];
+        const quint64 postingCount = reader.varint();
+        for (quint64 p = 0; p < postingCount && reader.ok(); p++) {
+            Posting posting;
+            posting.document = static_cast<quint32>(reader.varint());
+            const quint64 positionCount = reader.varint();
+            quint32 position = 0;
+            for (quint64 k = 0; k < positionCount && reader.ok(); k++) {
+                position += static_cast<quint32>(reader.varint());
+                posting.positions.append(position);
+            }
+            postings.append(posting);
+        }
+    }
+
+    return reader.ok();
+}
+
+void ChatSearchIndex::load()
+{
+    QWriteLocker locker(&m_lock);
+    QElapsedTimer timer;
+    timer.start();
+
+    QDir dir(m_directory);
+    const QStringList segments = dir.entryList({QStringLiteral("segment_*.idx")}, QDir::Files, QDir::Name);
+    foreach (const QString &segment, segments) {
+        const int number = segment.mid(8, 6).toInt();
+        m_nextSegment = qMax(m_nextSegment, number + 1);
+        if (!readSegment(dir.absoluteFilePath(segment))) {
+            qWarning().noquote() << "[ChatSearchIndex] Skipping damaged segment:" << segment;
+            continue;
+        }
+        m_segmentCount++;
+    }
+
+    // drop postings of documents deleted by later segments
+    for (auto it = m_terms.begin(); it != m_terms.end();) {
+        it->removeIf([this](const Posting &posting) { return !m_documents.contains(posting.document); });
+        it = it->isEmpty() ? m_terms.erase(it) : std::next(it);
+    }
+
+    qDebug().noquote() << "[ChatSearchIndex] Loaded" << m_documents.size() << "messages," //
+                       << m_terms.size() << "terms from" << m_segmentCount << "segments in" << timer.elapsed() << "ms";
+}
+
+inline bool ChatSearchIndex::mergeSegments()
+{
+    // drop dead postings, then write everything into one segment
+    for (auto it = m_terms.begin(); it != m_terms.end();) {
+        it->removeIf([this](const Posting &posting) { return !m_documents.contains(posting.document); });
+        it = it->isEmpty() ? m_terms.erase(it) : std::next(it);
+    }
+
+    const int number = m_nextSegment++;
+    if (!writeSegment(segmentFileName(number), true)) {
+        return false;
+    }
+
+    QDir dir(m_directory);
+    const QStringList segments = dir.entryList({QStringLiteral("segment_*.idx")}, QDir::Files, QDir::Name);
+    foreach (const QString &segment, segments) {
+        if (segment.mid(8, 6).toInt() < number) {
+            dir.remove(segment);
+        }
+    }
+    m_segmentCount = 1;
+
+    return true;
+}
+
+bool ChatSearchIndex::save()
+{
+    QWriteLocker locker(&m_lock);
+
+    if (m_pendingDocuments.isEmpty() && m_pendingDeletes.isEmpty() && !m_pendingSizes) {
+        return true;
+    }
+
+    if (!writeSegment(segmentFileName(m_nextSegment++), false)) {
+        return false;
+    }
+    m_segmentCount++;
+
+    m_pendingDocuments.clear();
+    m_pendingDeletes.clear();
+    m_pendingTerms.clear();
+    m_pendingSizes = false;
+
+    if (m_segmentCount > MaxSegments) {
+        return mergeSegments();
+    }
+
+    return true;
+}
+
+// ---------------- Bulk indexer -----------------------------------
+
+void ChatSearchIndex::indexHistoryFile(const QString &fileName)
+{
+    QFileInfo fi(fileName);
+    const qint64 size = fi.size();
+    if (indexedSize(fileName) == size) {
+        return;
+    }
+
+    QList<QJsonObject> messages;
+    if (fi.suffix().toLower() == "json") {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return;
+        }
+        const QJsonArray array = QJsonDocument::fromJson(file.readAll()).object()["messages"].toArray();
+        for (const QJsonValue &value : array) {
+            messages.append(value.toObject());
+        }
+    } else if (!ChatHistoryStore::readAll(fileName, messages)) {
+        return;
+    }
+
+    removeFrom(fileName, 0);
+    for (int i = 0; i < messages.size(); i++) {
+        ChatMessage message(nullptr);
+        message.fromJson(messages[i]);
+        indexMessage(fileName, i, message.id(), message.content());
+    }
+    setIndexedSize(fileName, size);
+}
+
+void ChatSearchIndex::indexDirectory(const QString &directory)
+{
+    (void) QtConcurrent::run([this, directory]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        QDir dir(directory);
+        const QFileInfoList files = dir.entryInfoList({QStringLiteral("*.chatlog"), QStringLiteral("*.json")}, QDir::Files);
+        int count = 0;
+        foreach (const QFileInfo &fi, files) {
+            // legacy history already imported into a log
+            if (fi.suffix().toLower() == "json" && QFileInfo::exists(dir.absoluteFilePath(fi.completeBaseName() + ".chatlog"))) {
+                continue;
+            }
+            indexHistoryFile(fi.absoluteFilePath());
+            count++;
+        }
+        save();
+
+        qDebug().noquote() << "[ChatSearchIndex] Indexed" << count << "histories in" << timer.elapsed() << "ms";
+        emit indexingFinished(count);
+    });
+}
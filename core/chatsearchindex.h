@@ -0,0 +1,134 @@
+#pragma once
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QString>
+
+/**
+ * @brief Full-text index over all saved chat histories.
+ *
+ * Message text is split into words and code identifiers (camelCase and
+ * snake_case parts are indexed too) and kept as an inverted index with
+ * term positions. Changes are kept in memory and written as one on-disk
+ * segment (varint encoded, CRC checked) on quit; later segments override
+ * earlier ones and are merged once there are too many. Logs changed after
+ * the last segment are indexed again on start. A message is identified by
+ * its history log and its absolute message index.
+ *
+ * Queries AND all terms. "quoted words" must appear as a phrase and a
+ * trailing '*' matches a term prefix. Hits are ranked with BM25.
+ *
+ * All methods are thread safe, updates usually arrive from the chat
+ * history writer thread. Queries may wait for a merge, run them off the
+ * GUI thread.
+ */
+class ChatSearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Hit
+    {
+        QString historyFile;
+        int messageIndex;
+        QString messageId;
+        QString preview;
+        double score;
+    };
+
+    // Merge segments above this count
+    static constexpr int MaxSegments = 8;
+    // Terms a prefix query expands to at most
+    static constexpr int MaxPrefixTerms = 64;
+
+    static ChatSearchIndex *instance();
+
+    /**
+     * @brief indexMessage Adds or replaces the message at the given index
+     * @param historyFile History log of the chat
+     * @param messageIndex Absolute message index in that log
+     * @param messageId Message id
+     * @param content Message text
+     */
+    void indexMessage(const QString &historyFile, int messageIndex, const QString &messageId, const QString &content);
+
+    /**
+     * @brief removeFrom Drops all messages of a log starting at index
+     * @param historyFile History log of the chat
+     * @param messageIndex First absolute message index to drop
+     */
+    void removeFrom(const QString &historyFile, int messageIndex);
+
+    // Log size the indexed messages were read from, 0 if unknown
+    qint64 indexedSize(const QString &historyFile) const;
+    void setIndexedSize(const QString &historyFile, qint64 size);
+
+    /**
+     * @brief search Runs a query
+     * @param query Words, "phrases" and prefix* terms
+     * @param limit Maximum number of hits
+     * @return Hits ordered by descending score
+     */
+    QList<Hit> search(const QString &query, int limit = 20) const;
+
+    // Writes pending changes as a new segment, on quit
+    bool save();
+
+    /**
+     * @brief indexDirectory Indexes all chat histories of a directory in
+     * the background, unchanged logs are skipped.
+     * @param directory Chat history directory
+     */
+    void indexDirectory(const QString &directory);
+
+signals:
+    void indexingFinished(int files);
+
+private:
+    struct Document
+    {
+        QString historyFile;
+        int messageIndex;
+        QString messageId;
+        QString preview;
+        quint32 length;
+    };
+
+    struct Posting
+    {
+        quint32 document;
+        QList<quint32> positions;
+    };
+
+    mutable QReadWriteLock m_lock;
+    QString m_directory;
+    // live documents by id
+    QHash<quint32, Document> m_documents;
+    // history log -> message index -> document id
+    QHash<QString, QMap<int, quint32>> m_documentsByFile;
+    // term -> postings, sorted for prefix lookups
+    QMap<QString, QList<Posting>> m_terms;
+    QHash<QString, qint64> m_indexedSizes;
+    quint64 m_totalLength;
+    quint32 m_nextDocument;
+    int m_segmentCount;
+    int m_nextSegment;
+    // changes not yet written to a segment
+    QList<quint32> m_pendingDocuments;
+    QList<quint32> m_pendingDeletes;
+    QMap<QString, QList<Posting>> m_pendingTerms;
+    bool m_pendingSizes;
+
+private:
+    explicit ChatSearchIndex(QObject *parent = nullptr);
+    void load();
+    inline void addDocument(quint32 id, const Document &document);
+    inline void removeDocument(quint32 id);
+    inline bool writeSegment(const QString &fileName, bool full);
+    inline bool readSegment(const QString &fileName);
+    inline bool mergeSegments();
+    inline QString segmentFileName(int number) const;
+    void indexHistoryFile(const QString &fileName);
+};
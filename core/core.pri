@@ -2,13 +2,39 @@
 INCLUDEPATH += $$PWD/
 
 HEADERS += \
+    $$PWD/attachmentcache.h \
+    $$PWD/chatpersistenceservice.h \
+    $$PWD/chatsearchindex.h \
     $$PWD/settingsmanager.h \
     $$PWD/downloadmanager.h \
+    $$PWD/jsonrequestdevice.h \
     $$PWD/llmchatclient.h \
-    $$PWD/toolservice.h
+    $$PWD/llmmetrics.h \
+    $$PWD/llmrecorder.h \
+    $$PWD/llmtransport.h \
+    $$PWD/mockllmserver.h \
+    $$PWD/modelcatalog.h \
+    $$PWD/replayserver.h \
+    $$PWD/tokencounter.h \
+    $$PWD/toolservice.h \
+    $$PWD/toolspeculator.h \
+    $$PWD/tracebuffer.h
 
 SOURCES += \
+    $$PWD/attachmentcache.cpp \
+    $$PWD/chatpersistenceservice.cpp \
+    $$PWD/chatsearchindex.cpp \
     $$PWD/settingsmanager.cpp \
     $$PWD/downloadmanager.cpp \
+    $$PWD/jsonrequestdevice.cpp \
     $$PWD/llmchatclient.cpp \
-    $$PWD/toolservice.cpp
+    $$PWD/llmmetrics.cpp \
+    $$PWD/llmrecorder.cpp \
+    $$PWD/llmtransport.cpp \
+    $$PWD/mockllmserver.cpp \
+    $$PWD/modelcatalog.cpp \
+    $$PWD/replayserver.cpp \
+    $$PWD/tokencounter.cpp \
+    $$PWD/toolservice.cpp \
+    $$PWD/toolspeculator.cpp \
+    $$PWD/tracebuffer.cpp
@@ -0,0 +1,286 @@
+#include <jsonrequestdevice.h>
+#include <QDebug>
+
+static constexpr char s_hex[] = "0123456789abcdef";
+static constexpr char s_replacement[] = "\xEF\xBF\xBD"; // U+FFFD
+
+JsonRequestDevice::JsonRequestDevice(QObject *parent)
+    : QIODevice{parent}
+    , m_segments()
+    , m_size(0)
+    , m_position(0)
+    , m_segment(0)
+    , m_file()
+    , m_buffer()
+    , m_bufferOffset(0)
+    , m_carry()
+{}
+
+void JsonRequestDevice::append(const QByteArray &json)
+{
+    if (json.isEmpty()) {
+        return;
+    }
+    // merge with a previous literal segment
+    if (!m_segments.isEmpty() && m_segments.last().fileName.isEmpty()) {
+        m_segments.last().json.append(json);
+    } else {
+        m_segments.append({json, QString(), 0});
+    }
+}
+
+void JsonRequestDevice::appendString(const QString &text)
+{
+    QByteArray escaped;
+    QByteArray carry;
+    const QByteArray utf8 = text.toUtf8();
+    escape(utf8.constData(), utf8.size(), escaped, carry, true);
+    append(escaped);
+}
+
+void JsonRequestDevice::appendFile(const QString &fileName, qint64 escapedSize)
+{
+    m_segments.append({QByteArray(), fileName, escapedSize});
+}
+
+void JsonRequestDevice::escape(const char *data, qsizetype length, QByteArray &out, QByteArray &carry, bool final)
+{
+    // continue a sequence split by the previous chunk
+    QByteArray joined;
+    if (!carry.isEmpty()) {
+        joined = carry;
+        joined.append(data, length);
+        carry.clear();
+        data = joined.constData();
+        length = joined.size();
+    }
+
+    const quint8 *in = reinterpret_cast<const quint8 *>(data);
+    qsizetype i = 0;
+    qsizetype plain = 0; // start of bytes copied unchanged
+
+    auto flush = [&out, data, &plain](qsizetype end) {
+        if (end > plain) {
+            out.append(data + plain, end - plain);
+        }
+    };
+
+    while (i < length) {
+        const quint8 c = in[i];
+
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+            i++;
+            continue;
+        }
+
+        if (c < 0x80) {
+            flush(i);
+            switch (c) {
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                case '\r':
+                    out.append("\\r");
+                    break;
+                case '\t':
+                    out.append("\\t");
+                    break;
+                case '\b':
+                    out.append("\\b");
+                    break;
+                case '\f':
+                    out.append("\\f");
+                    break;
+                default: {
+                    const char escaped[] = {'\\', 'u', '0', '0', s_hex[c >> 4], s_hex[c & 0x0F]};
+                    out.append(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+            plain = ++i;
+            continue;
+        }
+
+        // multi-byte UTF-8 sequence
+        qsizetype needed = 0;
+        quint8 low = 0x80;
+        quint8 high = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            needed = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            needed = 2;
+            low = (c == 0xE0 ? 0xA0 : 0x80); // overlong
+            high = (c == 0xED ? 0x9F : 0xBF); // surrogates
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            needed = 3;
+            low = (c == 0xF0 ? 0x90 : 0x80);
+            high = (c == 0xF4 ? 0x8F : 0xBF);
+        }
+
+        qsizetype k = 1;
+        for (; needed > 0 && k <= needed && i + k < length; k++) {
+            const quint8 b = in[i + k];
+            if (k == 1 ? (b < low || b > high) : (b < 0x80 || b > 0xBF)) {
+                break;
+            }
+        }
+
+        const bool valid = (needed > 0 && k > needed);
+        if (!valid && needed > 0 && i + k == length && !final) {
+            // sequence continues in the next chunk
+            flush(i);
+            carry = QByteArray(data + i, length - i);
+            return;
+        }
+
+        if (valid) {
+            i += needed + 1;
+        } else {
+            flush(i);
+            out.append(s_replacement, sizeof(s_replacement) - 1);
+            plain = ++i;
+        }
+    }
+
+    flush(length);
+}
+
+bool JsonRequestDevice::open(OpenMode mode)
+{
+    if (mode != QIODevice::ReadOnly) {
+        return false;
+    }
+
+    // counting pass over files of unknown size, same escaping as the upload
+    qint64 size = 0;
+    QByteArray chunk;
+    QByteArray escaped;
+    foreach (const Segment &segment, m_segments) {
+        if (segment.fileName.isEmpty()) {
+            size += segment.json.size();
+            continue;
+        }
+        if (segment.escapedSize >= 0) {
+            size += segment.escapedSize;
+            continue;
+        }
+
+        QFile file(segment.fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            setErrorString(file.errorString());
+            qWarning().noquote() << "[JsonRequestDevice] Unable to read:" << segment.fileName << file.errorString();
+            return false;
+        }
+        QByteArray carry;
+        chunk.resize(ChunkSize);
+        for (;;) {
+            const qint64 read = file.read(chunk.data(), ChunkSize);
+            if (read < 0) {
+                setErrorString(file.errorString());
+                return false;
+            }
+            escaped.clear();
+            escape(chunk.constData(), read, escaped, carry, read == 0);
+            size += escaped.size();
+            if (read == 0) {
+                break;
+            }
+        }
+    }
+
+    m_size = size;
+    m_position = 0;
+    m_segment = 0;
+    m_buffer.clear();
+    m_bufferOffset = 0;
+    m_carry.clear();
+
+    return QIODevice::open(mode);
+}
+
+void JsonRequestDevice::close()
+{
+    m_file.close();
+    m_buffer.clear();
+    m_bufferOffset = 0;
+    m_carry.clear();
+    QIODevice::close();
+}
+
+qint64 JsonRequestDevice::bytesAvailable() const
+{
+    return (m_size - m_position) + QIODevice::bytesAvailable();
+}
+
+bool JsonRequestDevice::atEnd() const
+{
+    return m_position >= m_size && QIODevice::bytesAvailable() == 0;
+}
+
+inline bool JsonRequestDevice::fillBuffer()
+{
+    m_buffer.clear();
+    m_bufferOffset = 0;
+
+    while (m_buffer.isEmpty() && m_segment < m_segments.size()) {
+        const Segment &segment = m_segments[m_segment];
+
+        if (segment.fileName.isEmpty()) {
+            m_buffer = segment.json;
+            m_segment++;
+            continue;
+        }
+
+        if (!m_file.isOpen()) {
+            m_file.setFileName(segment.fileName);
+            if (!m_file.open(QIODevice::ReadOnly)) {
+                setErrorString(m_file.errorString());
+                return false;
+            }
+            m_carry.clear();
+        }
+
+        const QByteArray data = m_file.read(ChunkSize);
+        const bool final = data.isEmpty();
+        escape(data.constData(), data.size(), m_buffer, m_carry, final);
+        if (final) {
+            m_file.close();
+            m_segment++;
+        }
+    }
+
+    return !m_buffer.isEmpty();
+}
+
+qint64 JsonRequestDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 total = 0;
+    while (total < maxSize) {
+        if (m_bufferOffset >= m_buffer.size() && !fillBuffer()) {
+            break;
+        }
+        const qint64 count = qMin<qint64>(maxSize - total, m_buffer.size() - m_bufferOffset);
+        memcpy(data + total, m_buffer.constData() + m_bufferOffset, count);
+        m_bufferOffset += count;
+        total += count;
+    }
+
+    m_position += total;
+    if (total == 0 && m_position < m_size) {
+        // file changed between counting and upload
+        qWarning().noquote() << "[JsonRequestDevice] Body shorter than announced:" << m_position << "of" << m_size;
+        return -1;
+    }
+    return total;
+}
+
+qint64 JsonRequestDevice::writeData(const char *, qint64)
+{
+    return -1;
+}
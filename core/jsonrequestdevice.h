@@ -0,0 +1,83 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+
+/**
+ * @brief Sequential upload device for JSON request bodies with large
+ * attachments.
+ *
+ * The body is a list of segments: literal JSON bytes and files whose
+ * content is written as the inside of a JSON string. Files are read and
+ * escaped chunk by chunk while the request is uploaded, so memory use does
+ * not depend on the attachment size. Invalid UTF-8 is replaced by U+FFFD
+ * like QString::fromUtf8() does, sequences split between chunks are
+ * carried over.
+ *
+ * The caller sets size() as Content-Length after open(). Files appended
+ * with their escaped size are not read before the upload, open() runs a
+ * counting pass over the others.
+ */
+class JsonRequestDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    // Bytes read from an attachment at once
+    static constexpr qint64 ChunkSize = 64 * 1024;
+
+    explicit JsonRequestDevice(QObject *parent = nullptr);
+
+    // Literal JSON bytes
+    void append(const QByteArray &json);
+    // Text written as JSON string content, without quotes
+    void appendString(const QString &text);
+    // File content written as JSON string content, without quotes, the
+    // escaped size is counted by open() if not known
+    void appendFile(const QString &fileName, qint64 escapedSize = -1);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 size() const override { return m_size; }
+    qint64 bytesAvailable() const override;
+    bool atEnd() const override;
+
+    /**
+     * @brief escape Appends bytes escaped as JSON string content
+     * @param data UTF-8 input
+     * @param length Number of bytes
+     * @param out Receives the escaped bytes
+     * @param carry Incomplete UTF-8 sequence of the previous chunk, updated
+     * @param final True for the last chunk, a remaining carry is replaced
+     */
+    static void escape(const char *data, qsizetype length, QByteArray &out, QByteArray &carry, bool final);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    struct Segment
+    {
+        QByteArray json;
+        QString fileName; // streamed if not empty
+        qint64 escapedSize; // of the file, -1 if unknown
+    };
+
+    QList<Segment> m_segments;
+    qint64 m_size;
+    qint64 m_position;
+    // current segment and its open file
+    qsizetype m_segment;
+    QFile m_file;
+    // escaped bytes not yet read
+    QByteArray m_buffer;
+    qsizetype m_bufferOffset;
+    QByteArray m_carry;
+
+private:
+    inline bool fillBuffer();
+};
@@ -1,36 +1,150 @@
+#include <attachmentcache.h>
+#include <jsonrequestdevice.h>
 #include <llmchatclient.h>
+#include <llmmetrics.h>
+#include <llmtransport.h>
+#include <modelcatalog.h>
+#include <tokencounter.h>
+#include <tracebuffer.h>
+#include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QNetworkReply>
+#include <QRandomGenerator>
 #include <QRegularExpression>
 #include <QStandardPaths>
 #include <QUrlQuery>
 
+// replaced by the attachment contents when the request is uploaded
+static const QString s_attachmentMarker = QStringLiteral("\u0001attachments:%1\u0001");
+// attachments already sent earlier in the same request
+static const QString s_unchangedReference = QStringLiteral("\n#File name: %1 (unchanged, content above)");
+static const QString s_sameReference = QStringLiteral("\n#File name: %1 (same content as %2 above)");
+// attachments of earlier turns whose file has changed since
+static const QString s_changedReference = QStringLiteral("\n#File name: %1 (modified since, content not available)");
+
+static inline QByteArray encodeJson(const QJsonValue &value)
+{
+    // QJsonDocument writes object keys sorted, so nested values are canonical
+    if (value.isObject()) {
+        return QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact);
+    }
+    if (value.isArray()) {
+        return QJsonDocument(value.toArray()).toJson(QJsonDocument::Compact);
+    }
+    const QByteArray wrapped = QJsonDocument(QJsonArray{value}).toJson(QJsonDocument::Compact);
+    return wrapped.mid(1, wrapped.size() - 2);
+}
+
 LLMChatClient::LLMChatClient(ToolModel *toolModel, QObject *parent)
     : QObject(parent)
     , m_toolModel(toolModel)
     , m_llmModels(new ModelListModel(this))
-    , m_networkManager(new QNetworkAccessManager(this))
     , m_connection(nullptr)
     , m_timeout(60000) // 1m default
-    , m_isResponseStream(false)
+    , m_lastContextTokens(0)
+    , m_lastPromptTokens(0)
+    , m_toolsJson()
+    , m_toolTokens(-1)
+    , m_chatModel()
+    , m_requests()
+    , m_nextRequestId(1)
+    , m_lastRequestId(0)
+    , m_fanOuts()
+    , m_nextFanOutId(1)
+    , m_failoverConnections()
+    , m_maxRetries(DefaultMaxRetries)
+    , m_retryBaseDelay(RetryBaseDelay)
+    , m_maxRetryDelay(MaxRetryDelay)
 {
-    connect(m_networkManager, &QNetworkAccessManager::finished, this, &LLMChatClient::onLLMResponse);
-    connect(m_networkManager, &QNetworkAccessManager::sslErrors, this, &LLMChatClient::onSslErrors);
+    // serialized tools are reused until the configuration changes
+    if (m_toolModel) {
+        connect(m_toolModel, &ToolModel::toolAdded, this, &LLMChatClient::invalidateTools);
+        connect(m_toolModel, &ToolModel::toolRemoved, this, &LLMChatClient::invalidateTools);
+        connect(m_toolModel, &ToolModel::toolChanged, this, &LLMChatClient::invalidateTools);
+        connect(m_toolModel, &ToolModel::modelReset, this, &LLMChatClient::invalidateTools);
+    }
+
+    // model lists fetched by any client of the same server
+    connect(ModelCatalog::instance(), &ModelCatalog::modelsChanged, this, [this](const QString &key, const QJsonArray &models) {
+        if (m_connection && key == ModelCatalog::key(m_connection)) {
+            m_llmModels->loadFrom(models);
+        }
+    });
 }
 
 LLMChatClient::~LLMChatClient()
 {
-    if (m_networkManager) {
-        m_networkManager->deleteLater();
+    // replies belong to the shared transport, not to this client; abort
+    // them so the servers stop generating, without calling back into it
+    foreach (const RequestContext &context, m_requests) {
+        if (QNetworkReply *reply = context.reply) {
+            disconnect(reply, nullptr, this, nullptr);
+            reply->setProperty("cancelled", true);
+            reply->abort();
+            reply->deleteLater();
+        }
+        // onLLMResponse() does not run, release the list request claim
+        if (context.kind != CompletionRequest) {
+            ModelCatalog::instance()->endFetch(context.connection);
+        }
     }
+    m_requests.clear();
 }
 
 void LLMChatClient::setConnection(LLMConnection *connection)
 {
     m_connection = connection;
+
+    // warm up the shared connection while the user types
+    LLMTransport::instance()->preconnect(m_connection);
+}
+
+void LLMChatClient::setFailoverConnections(const QList<LLMConnection> &connections)
+{
+    // running requests keep their copies until they finish
+    m_failoverConnections.clear();
+
+    foreach (const LLMConnection &connection, connections) {
+        if (!connection.isEnabled() || !connection.isValid()) {
+            continue;
+        }
+        QSharedPointer<LLMConnection> copy(new LLMConnection(connection));
+        // the default connection is tried first
+        if (copy->isDefault()) {
+            m_failoverConnections.prepend(copy);
+        } else {
+            m_failoverConnections.append(copy);
+        }
+        // model list of a server from the catalog, asked again when stale
+        QJsonArray models;
+        if (ModelCatalog::instance()->models(copy.data(), models)) {
+            LLMTransport::instance()->setModels(copy.data(), ModelCatalog::modelIds(models));
+        }
+        if (ModelCatalog::instance()->beginFetch(copy.data())) {
+            RequestContext context = requestContext(copy.data(), nullptr, CatalogRequest, false);
+            context.sharedConnection = copy;
+            if (startRequest(context) == 0) {
+                ModelCatalog::instance()->endFetch(copy.data());
+            }
+        }
+    }
+}
+
+void LLMChatClient::setRetryPolicy(int maxRetries, int baseDelay, int maxDelay)
+{
+    m_maxRetries = qMax(0, maxRetries);
+    m_retryBaseDelay = qMax(1, baseDelay);
+    m_maxRetryDelay = qMax(m_retryBaseDelay, maxDelay);
+}
+
+void LLMChatClient::setChatModel(ChatModel *chatModel)
+{
+    m_chatModel = chatModel;
 }
 
 void LLMChatClient::setTimeout(int milliseconds)
@@ -70,8 +184,30 @@ Sample of conversation request with tooling openAI -like:
 
 void LLMChatClient::sendChat(const QList<SendParameters> &parameters, bool stream, int maxTokens, double temperature)
 {
-    // Create list with single message
+    QList<QStringList> attachments;
+    int promptTokens = 0;
+    const QList<QJsonObject> messages = buildMessages(parameters, attachments, promptTokens);
+
+    // response must fit the rest of the context window
+    m_lastPromptTokens = promptTokens;
+    if (m_llmModel.contextLength > 0) {
+        maxTokens = qBound(MinResponseTokens, m_llmModel.contextLength - promptTokens, maxTokens);
+    }
+    qDebug().noquote() << "[LLMChatClient] sendChat prompt tokens:" << promptTokens << "max_tokens:" << maxTokens;
+
+    // Call the main createChatCompletion method
+    sendChat(activeModel().id, messages, stream, maxTokens, temperature, attachments);
+}
+
+inline QList<QJsonObject> LLMChatClient::buildMessages(const QList<SendParameters> &parameters, QList<QStringList> &attachments, int &promptTokens)
+{
     QList<QJsonObject> messages;
+    // content hash -> first file sent with it, repeated content becomes a back-reference
+    QHash<quint64, QString> sentFiles;
+    QSet<quint64> sentHashes;
+    int references = 0;
+    promptTokens = 0;
+    AttachmentCache *cache = AttachmentCache::instance();
 
     foreach (auto &p, parameters) {
         // Create a single message object
@@ -110,6 +246,48 @@ void LLMChatClient::sendChat(const QList<SendParameters> &parameters, bool strea
         // Standard user text
         messageObj["content"] = p.content.isEmpty() ? p.toolResult : p.content;
 
+        // file contents are streamed from disk in place of the marker
+        if (!p.attachments.isEmpty()) {
+            QString content = messageObj["content"].toString();
+            QStringList streamed;
+            foreach (const QString &fileName, p.attachments) {
+                const QString absolute = QFileInfo(fileName).absoluteFilePath();
+                const AttachmentCache::Entry entry = cache->entry(fileName);
+                if (entry.fileName.isEmpty()) {
+                    content.append(s_changedReference.arg(absolute));
+                    continue;
+                }
+                const auto sent = sentFiles.constFind(entry.hash);
+                if (sent != sentFiles.constEnd()) {
+                    content.append(sent.value() == absolute ? s_unchangedReference.arg(absolute) : s_sameReference.arg(absolute, sent.value()));
+                    references++;
+                    continue;
+                }
+                sentFiles.insert(entry.hash, absolute);
+                streamed.append(fileName);
+            }
+            if (!streamed.isEmpty()) {
+                content.append(s_attachmentMarker.arg(attachments.size()));
+                attachments.append(streamed);
+            }
+            messageObj["content"] = content;
+        }
+
+        if (!p.toolCalls.isEmpty()) {
+            QJsonArray toolCalls;
+            foreach (const ToolCallEntry &call, p.toolCalls) {
+                toolCalls.append(QJsonObject{
+                    {"id", call.toolCallId()},
+                    {"type", call.toolTypeString().isEmpty() ? QStringLiteral("function") : call.toolTypeString()},
+                    {"function", QJsonObject{{"name", call.functionName()}, {"arguments", call.arguments()}}},
+                });
+            }
+            messageObj["tool_calls"] = toolCalls;
+        }
+        if (!p.toolCallId.isEmpty()) {
+            messageObj["tool_call_id"] = p.toolCallId;
+        }
+
         if (!p.toolName.isEmpty()) {
             messageObj["tool_name"] = p.toolName;
             messageObj["parameters"] = QJsonObject{
@@ -121,10 +299,13 @@ void LLMChatClient::sendChat(const QList<SendParameters> &parameters, bool strea
         }
 
         messages.append(messageObj);
+        promptTokens += messageTokens(p, &sentHashes);
     }
 
-    // Call the main createChatCompletion method
-    sendChat(activeModel().id, messages, stream, maxTokens, temperature);
+    promptTokens += toolTokens();
+    qDebug().noquote() << "[LLMChatClient] buildMessages attachments:" << sentFiles.size() << "back-references:" << references;
+
+    return messages;
 }
 
 void LLMChatClient::sendChat(const SendParameters &parameter, bool stream, int maxTokens, double temperature)
@@ -136,29 +317,309 @@ void LLMChatClient::sendChat(const SendParameters &parameter, bool stream, int m
     sendChat(parameters, stream, maxTokens, temperature);
 }
 
-void LLMChatClient::sendChat(const QString &model, const QList<QJsonObject> &messages, bool stream, int maxTokens, double temperature)
+void LLMChatClient::sendChat( //
+    const QString &model,
+    const QList<QJsonObject> &messages,
+    bool stream,
+    int maxTokens,
+    double temperature,
+    const QList<QStringList> &attachments)
 {
     QJsonObject parameters;
     parameters["max_tokens"] = maxTokens;
     parameters["temperature"] = temperature;
 
-    sendChat(model, messages, parameters, stream);
+    sendChat(model, messages, parameters, stream, attachments);
 }
 
-void LLMChatClient::sendChat(const QString &model, const QList<QJsonObject> &messages, const QJsonObject &parameters, bool stream)
+void LLMChatClient::sendChat( //
+    const QString &model,
+    const QList<QJsonObject> &messages,
+    const QJsonObject &parameters,
+    bool stream,
+    const QList<QStringList> &attachments)
 {
     if (m_connection && m_connection->isValid()) {
-        QJsonObject requestBody = buildChatCompletionRequest(model, messages, parameters, stream);
-        sendRequest(requestBody,
-                    m_connection->endpointUri( //
-                        LLMConnection::EndpointCompletion));
+        const QByteArray requestBody = buildChatCompletionRequest(model, messages, parameters, stream);
+        RequestContext context = requestContext(m_connection, m_chatModel, CompletionRequest, stream);
+        context.model = model;
+        context.body = requestBody;
+        context.attachments = attachments;
+        startRequest(context);
     }
 }
 
+inline LLMChatClient::RequestContext LLMChatClient::requestContext( //
+    LLMConnection *connection,
+    ChatModel *chatModel,
+    RequestKind kind,
+    bool stream) const
+{
+    const LLMConnection::Endpoints endpoint = (kind == CompletionRequest ? LLMConnection::EndpointCompletion : LLMConnection::EndpointModels);
+    return RequestContext{
+        .reply = nullptr,
+        .connection = connection,
+        .sharedConnection = {},
+        .chatModel = chatModel,
+        .kind = kind,
+        .stream = stream,
+        .endpoint = (connection ? connection->endpointUri(endpoint) : QString()),
+        .model = QString(),
+        .body = QByteArray(),
+        .attachments = {},
+        .attempts = 0,
+        .tried = {},
+        .buffer = QByteArray(),
+        .timer = QElapsedTimer(),
+        .firstByteMs = -1,
+        .firstTokenMs = -1,
+        .connectMs = -1,
+        .encryptedMs = -1,
+        .sentMs = -1,
+        .headersMs = -1,
+        .lastChunkNs = -1,
+        .chunkGaps = {},
+        .parseNs = 0,
+        .renderNs = 0,
+        .events = 0,
+        .fanOutId = 0,
+        .fanOutIndex = -1,
+        .capture = {},
+    };
+}
+
+quint64 LLMChatClient::sendFanOut( //
+    const QList<SendParameters> &parameters,
+    const QList<FanOutTarget> &targets,
+    bool stream,
+    int maxTokens,
+    double temperature)
+{
+    // one packed request, encoded per target for its model name
+    QList<QStringList> attachments;
+    int promptTokens = 0;
+    const QList<QJsonObject> messages = buildMessages(parameters, attachments, promptTokens);
+    QJsonObject options;
+    options["max_tokens"] = maxTokens;
+    options["temperature"] = temperature;
+
+    const quint64 fanOutId = m_nextFanOutId++;
+    FanOut &fanOut = m_fanOuts[fanOutId];
+    fanOut.pending = 0;
+
+    for (int index = 0; index < targets.size(); index++) {
+        const FanOutTarget &target = targets[index];
+        FanOutResult failed{
+            .index = index,
+            .ok = false,
+            .firstTokenMs = -1,
+            .totalMs = 0,
+            .tokens = 0,
+            .tokensPerSecond = 0,
+            .error = tr("Invalid connection"),
+        };
+        if (!target.connection || !target.connection->isValid()) {
+            fanOut.results.append(failed);
+            continue;
+        }
+
+        RequestContext context = requestContext(target.connection, target.chatModel, CompletionRequest, stream);
+        context.model = target.model;
+        context.body = buildChatCompletionRequest(target.model, messages, options, stream);
+        context.attachments = attachments;
+        context.fanOutId = fanOutId;
+        context.fanOutIndex = index;
+        if (startRequest(context) == 0) {
+            failed.error = tr("Request not sent");
+            fanOut.results.append(failed);
+            continue;
+        }
+        fanOut.pending++;
+    }
+
+    qDebug().noquote() << "[LLMChatClient] sendFanOut" << fanOutId << "targets:" << targets.size() //
+                       << "sent:" << fanOut.pending << "prompt tokens:" << promptTokens;
+
+    // report targets that failed right away once the caller is connected
+    const QList<FanOutResult> failed = fanOut.results;
+    QTimer::singleShot(0, this, [this, fanOutId, failed]() {
+        foreach (const FanOutResult &result, failed) {
+            emit fanOutResult(fanOutId, result);
+        }
+        if (m_fanOuts.value(fanOutId).pending == 0 && m_fanOuts.contains(fanOutId)) {
+            emit fanOutFinished(fanOutId, bestFanOutResult(m_fanOuts.take(fanOutId).results));
+        }
+    });
+
+    return fanOutId;
+}
+
+inline void LLMChatClient::finishFanOut(const RequestContext &context, const QString &error)
+{
+    const auto it = m_fanOuts.find(context.fanOutId);
+    if (it == m_fanOuts.end()) {
+        return;
+    }
+
+    FanOutResult result{
+        .index = context.fanOutIndex,
+        .ok = false,
+        .firstTokenMs = context.firstTokenMs,
+        .totalMs = context.timer.elapsed(),
+        .tokens = 0,
+        .tokensPerSecond = 0,
+        .error = QString(),
+    };
+
+    QString finishReason;
+    result.tokens = answerTokens(context, &finishReason);
+    const qint64 generationMs = result.totalMs - qMax<qint64>(0, result.firstTokenMs);
+    if (result.tokens > 0 && generationMs > 0) {
+        result.tokensPerSecond = result.tokens * 1000.0 / generationMs;
+    }
+
+    if (!error.isEmpty()) {
+        result.error = error;
+    } else if (result.tokens == 0) {
+        result.error = tr("Empty answer");
+    } else if (finishReason == QLatin1String("length")) {
+        result.error = tr("Answer cut off");
+    }
+    result.ok = result.error.isEmpty();
+
+    it->results.append(result);
+    emit fanOutResult(context.fanOutId, result);
+
+    if (--it->pending <= 0) {
+        const QList<FanOutResult> results = it->results;
+        m_fanOuts.erase(it);
+        emit fanOutFinished(context.fanOutId, bestFanOutResult(results));
+    }
+}
+
+inline int LLMChatClient::answerTokens(const RequestContext &context, QString *finishReason) const
+{
+    // the answer is the last message of the target transcript
+    if (!context.chatModel || context.chatModel->rowCount() == 0) {
+        return 0;
+    }
+    const ChatMessage *message = context.chatModel->messageAt(context.chatModel->rowCount() - 1);
+    if (!message || message->isUser()) {
+        return 0;
+    }
+    if (finishReason) {
+        *finishReason = message->finishReason();
+    }
+    return TokenCounter::instance()->count(message->content());
+}
+
+inline void LLMChatClient::recordMetrics(const RequestContext &context, QNetworkReply *reply) const
+{
+    const qint64 totalMs = context.timer.elapsed();
+    // one event per token if nobody keeps the answer
+    const int tokens = (context.chatModel ? answerTokens(context) : context.events);
+    const qint64 generationMs = totalMs - qMax<qint64>(0, context.firstTokenMs);
+
+    LLMMetrics::instance()->record({
+        .id = reply->property("requestId").toULongLong(),
+        .connection = (context.connection ? context.connection->name() : QString()),
+        .model = context.model,
+        .started = QDateTime::currentMSecsSinceEpoch() - totalMs,
+        .stream = context.stream,
+        .ok = (reply->error() == QNetworkReply::NoError),
+        .attempts = int(context.attempts + context.tried.size()),
+        .connectMs = context.connectMs,
+        .encryptedMs = context.encryptedMs,
+        .sentMs = context.sentMs,
+        .headersMs = context.headersMs,
+        .firstByteMs = context.firstByteMs,
+        .firstTokenMs = context.firstTokenMs,
+        .totalMs = totalMs,
+        .bytesSent = reply->property("transportSent").toLongLong(),
+        .bytesReceived = reply->property("transportReceived").toLongLong(),
+        .tokens = tokens,
+        .tokensPerSecond = (tokens > 0 && generationMs > 0 ? tokens * 1000.0 / generationMs : 0),
+        .gapP50Ms = LLMMetrics::percentile(context.chunkGaps, 50),
+        .gapP95Ms = LLMMetrics::percentile(context.chunkGaps, 95),
+        .parseMs = context.parseNs / 1e6,
+        .renderMs = context.renderNs / 1e6,
+    });
+}
+
+void LLMChatClient::cancelFanOut(quint64 fanOutId)
+{
+    QList<quint64> ids;
+    for (auto it = m_requests.constBegin(); it != m_requests.constEnd(); ++it) {
+        if (it->fanOutId == fanOutId) {
+            ids.append(it.key());
+        }
+    }
+    foreach (quint64 id, ids) {
+        cancelRequest(id);
+    }
+}
+
+int LLMChatClient::bestFanOutResult(const QList<FanOutResult> &results)
+{
+    // fastest complete answer
+    int best = -1;
+    qint64 bestMs = 0;
+    foreach (const FanOutResult &result, results) {
+        if (result.ok && (best < 0 || result.totalMs < bestMs)) {
+            best = result.index;
+            bestMs = result.totalMs;
+        }
+    }
+    return best;
+}
+
+bool LLMChatClient::cancelRequest(quint64 id)
+{
+    const auto it = m_requests.constFind(id);
+    if (it == m_requests.constEnd()) {
+        return false;
+    }
+    QNetworkReply *reply = it->reply;
+    if (!reply) {
+        // waiting to be sent again
+        qDebug().noquote() << "[LLMChatClient] cancel retry:" << id;
+        const RequestContext context = m_requests.take(id);
+        if (context.chatModel) {
+            context.chatModel->abortStream();
+        }
+        if (context.fanOutId != 0) {
+            finishFanOut(context, tr("Cancelled"));
+        }
+        emit requestCancelled(id);
+        return true;
+    }
+    if (!reply->isRunning()) {
+        m_requests.remove(id);
+        return false;
+    }
+
+    // closes the connection, so the server stops generating
+    qDebug().noquote() << "[LLMChatClient] cancel request:" << id << reply->url().path();
+    const QPointer<ChatModel> chatModel = m_requests.value(id).chatModel;
+    reply->setProperty("cancelled", true);
+    reply->abort();
+
+    // keep what arrived of the answer, drop its pending tool calls
+    if (chatModel) {
+        chatModel->abortStream();
+    }
+
+    emit requestCancelled(id);
+    return true;
+}
+
 void LLMChatClient::cancelRequest()
 {
-    m_networkManager->clearAccessCache();
-    m_networkManager->clearConnectionCache();
+    // abort() finishes the reply synchronously and unregisters it
+    const QList<quint64> ids = m_requests.keys();
+    foreach (quint64 id, ids) {
+        cancelRequest(id);
+    }
 }
 
 void LLMChatClient::setActiveModel(const ModelListModel::ModelEntry &model)
@@ -168,13 +629,306 @@ void LLMChatClient::setActiveModel(const ModelListModel::ModelEntry &model)
 
 void LLMChatClient::listModels()
 {
-    if (m_connection && m_connection->isValid()) {
-        QJsonObject requestBody;
-        sendRequest(requestBody,
-                    m_connection->endpointUri( //
-                        LLMConnection::EndpointModels),
-                    true);
+    if (!m_connection || !m_connection->isValid()) {
+        return;
+    }
+
+    // cached list at once, the server is asked if it is stale and nobody else does
+    ModelCatalog *catalog = ModelCatalog::instance();
+    QJsonArray models;
+    if (catalog->models(m_connection, models)) {
+        m_llmModels->loadFrom(models);
     }
+    if (catalog->beginFetch(m_connection) && startRequest(requestContext(m_connection, nullptr, ModelsRequest, false)) == 0) {
+        catalog->endFetch(m_connection);
+    }
+}
+
+// ---------------- Context packing --------------------------------
+
+int LLMChatClient::estimateTokens(QStringView text, int limit, qsizetype *end)
+{
+    // Approximates BPE vocabularies of current models: short ASCII words
+    // are one token, longer ones about five characters per token, digits
+    // are grouped by three, punctuation and other scripts (CJK, emoji)
+    // count about one token per character.
+    int tokens = 0;
+    qsizetype i = 0;
+    const qsizetype length = text.size();
+
+    while (i < length && tokens < limit) {
+        const char16_t c = text[i].unicode();
+        qsizetype run = i + 1;
+        if (c == ' ' || c == '\t' || c == '\r') {
+            // merges into the next word
+            while (run < length && (text[run] == u' ' || text[run] == u'\t' || text[run] == u'\r')) {
+                run++;
+            }
+            // indentation
+            if (run - i > 1) {
+                tokens++;
+            }
+        } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            while (run < length && text[run].unicode() < 0x80 && text[run].isLetter()) {
+                run++;
+            }
+            tokens += 1 + static_cast<int>((run - i - 1) / 5);
+        } else if (c >= '0' && c <= '9') {
+            while (run < length && text[run].isDigit()) {
+                run++;
+            }
+            tokens += 1 + static_cast<int>((run - i - 1) / 3);
+        } else if (QChar::isHighSurrogate(c)) {
+            run = qMin(length, run + 1);
+            tokens += 2;
+        } else {
+            tokens++;
+        }
+        i = run;
+    }
+
+    if (end) {
+        *end = i;
+    }
+    return tokens;
+}
+
+inline int LLMChatClient::messageTokens(const SendParameters &message, QSet<quint64> *sentHashes)
+{
+    const TokenCounter *counter = TokenCounter::instance();
+    int tokens = MessageOverheadTokens               //
+                 + counter->count(message.content)   //
+                 + counter->count(message.toolName)  //
+                 + counter->count(message.toolQuery) //
+                 + counter->count(message.toolResult)  //
+                 + counter->count(message.toolCallId);
+    foreach (const ToolCallEntry &call, message.toolCalls) {
+        tokens += MessageOverheadTokens + counter->count(call.toolCallId()) + counter->count(call.functionName()) + counter->count(call.arguments());
+    }
+    foreach (const QString &fileName, message.attachments) {
+        const AttachmentCache::Entry entry = AttachmentCache::instance()->entry(fileName);
+        if (sentHashes && !entry.fileName.isEmpty()) {
+            if (sentHashes->contains(entry.hash)) {
+                tokens += BackReferenceTokens;
+                continue;
+            }
+            sentHashes->insert(entry.hash);
+        }
+        // "#File name:" header and content
+        tokens += 8 + counter->count(fileName) + qMax(0, entry.tokens);
+    }
+    return tokens;
+}
+
+inline int LLMChatClient::toolTokens() const
+{
+    if (m_toolTokens < 0) {
+        m_toolTokens = TokenCounter::instance()->count(toolsJson());
+    }
+    return m_toolTokens;
+}
+
+inline QString LLMChatClient::truncateToTokens(const QString &text, int maxTokens)
+{
+    qsizetype end = 0;
+    estimateTokens(text, maxTokens, &end);
+    if (end >= text.length()) {
+        return text;
+    }
+
+    const int rest = estimateTokens(QStringView(text).mid(end));
+    return text.left(end) + QStringLiteral("\n[... %1 more tokens truncated]").arg(rest);
+}
+
+inline QString LLMChatClient::summarize(const QString &text)
+{
+    // extractive: leading sentences without code blocks
+    static const QRegularExpression codeBlock(QStringLiteral("```.*?(```|$)"), QRegularExpression::DotMatchesEverythingOption);
+    QString plain = text;
+    plain.replace(codeBlock, QStringLiteral(" [code] "));
+    plain = plain.simplified();
+
+    qsizetype end = 0;
+    estimateTokens(plain, SummaryTokens, &end);
+    if (end >= plain.length()) {
+        return plain;
+    }
+
+    // cut at the last sentence end if that keeps most of the text
+    qsizetype cut = end;
+    for (qsizetype i = end - 1; i > end / 2; i--) {
+        if (plain[i] == '.' || plain[i] == '!' || plain[i] == '?') {
+            cut = i + 1;
+            break;
+        }
+    }
+    return QStringLiteral("[summary] ") + plain.left(cut) + QStringLiteral(" ...");
+}
+
+int LLMChatClient::contextBudget(int maxTokens) const
+{
+    const int contextLength = (m_llmModel.contextLength > 0 ? m_llmModel.contextLength : DefaultContextLength);
+
+    // keep max_tokens for the response, and at least a quarter of the window for the prompt
+    const int reserved = qMin(maxTokens, contextLength - contextLength / 4);
+
+    return qMax(0, contextLength - reserved - toolTokens());
+}
+
+QList<LLMChatClient::SendParameters> LLMChatClient::packContext( //
+    const ChatModel *history,
+    const QList<SendParameters> &pending,
+    int historyCount,
+    int maxTokens)
+{
+    const int budget = contextBudget(maxTokens);
+
+    // messages of this request are never dropped
+    int used = 0;
+    QSet<quint64> sentHashes;
+    QSet<QString> pendingCalls;
+    foreach (const SendParameters &p, pending) {
+        used += messageTokens(p, &sentHashes);
+        if (!p.toolCallId.isEmpty()) {
+            pendingCalls.insert(p.toolCallId);
+        }
+    }
+
+    // Newest to oldest, a single pass. Verbatim until three quarters of
+    // the budget are used, older messages get summaries in the rest, tool
+    // results before the last user question are truncated.
+    QList<SendParameters> packed;
+    const int verbatimLimit = budget - budget / 4;
+    const int count = (!history ? 0 : (historyCount < 0 ? history->rowCount() : qMin(historyCount, history->rowCount())));
+    bool currentTurn = true;
+    int verbatim = 0;
+    int truncated = 0;
+    int summarized = 0;
+    int orphaned = 0;
+    int i = count - 1;
+
+    // Tool results share the id of the assistant message calling them and
+    // are met first. They wait at the end of packed until that message is
+    // packed too, otherwise they are dropped with it.
+    QString waitingCall;
+    int waitingCount = 0;
+    int waitingTokens = 0;
+    auto dropWaiting = [&]() {
+        packed.remove(packed.size() - waitingCount, waitingCount);
+        used -= waitingTokens;
+        orphaned += waitingCount;
+        waitingCall.clear();
+        waitingCount = 0;
+        waitingTokens = 0;
+    };
+
+    for (; i >= 0; i--) {
+        const ChatMessage *cm = history->messageAt(i);
+        if (!cm) {
+            continue;
+        }
+        if (waitingCount > 0 && cm->id() != waitingCall) {
+            dropWaiting();
+        }
+
+        SendParameters p = {.role = cm->role()};
+        if (cm->role() == ChatMessage::ToolingRole) {
+            if (!cm->toolCalls().isEmpty()) {
+                p.toolCallId = cm->toolCalls().first().toolCallId();
+            }
+            p.toolResult = QString::fromUtf8(cm->toolContent());
+            if (!currentTurn && !p.toolResult.isEmpty()) {
+                const QString cut = truncateToTokens(p.toolResult, MaxToolResultTokens);
+                if (cut.length() != p.toolResult.length()) {
+                    p.toolResult = cut;
+                    truncated++;
+                }
+            }
+            if (p.toolResult.isEmpty()) {
+                p.content = cm->content();
+            }
+        } else {
+            p.content = cm->content();
+            // replay attachments whose bytes are still those sent then
+            foreach (const QJsonValue &value, cm->attachments()) {
+                const QJsonObject attachment = value.toObject();
+                const QString fileName = attachment.value("file").toString();
+                const AttachmentCache::Entry entry = AttachmentCache::instance()->entry(fileName);
+                if (!entry.fileName.isEmpty() && QString::number(entry.hash, 16) == attachment.value("hash").toString()) {
+                    p.attachments.append(fileName);
+                } else {
+                    p.content.append(s_changedReference.arg(fileName));
+                }
+            }
+            // calls are sent only together with their results
+            bool answered = (waitingCount > 0);
+            foreach (const ToolCallEntry &call, cm->toolCalls()) {
+                answered = answered || pendingCalls.contains(call.toolCallId());
+            }
+            if (answered) {
+                p.toolCalls = cm->toolCalls();
+            }
+        }
+        if (p.content.isEmpty() && p.toolResult.isEmpty() && p.toolCalls.isEmpty()) {
+            // e.g. assistant message carrying tool calls whose results are gone
+            continue;
+        }
+
+        // content is sent once, the oldest copy carries it and newer ones refer back
+        QSet<quint64> withMessage = sentHashes;
+        int tokens = messageTokens(p, &withMessage);
+        if (used + tokens > verbatimLimit) {
+            // summary instead of the full message, calls are kept
+            const QString text = (p.toolResult.isEmpty() ? p.content : p.toolResult);
+            p.content = (text.isEmpty() ? text : summarize(text));
+            p.toolResult.clear();
+            p.attachments.clear();
+            tokens = messageTokens(p);
+            if (used + tokens > budget) {
+                if (waitingCount > 0) {
+                    dropWaiting();
+                }
+                break;
+            }
+            summarized++;
+        } else {
+            sentHashes = withMessage;
+            verbatim++;
+        }
+
+        used += tokens;
+        packed.append(p);
+
+        if (cm->role() == ChatMessage::ToolingRole) {
+            waitingCall = cm->id();
+            waitingCount++;
+            waitingTokens += tokens;
+        } else {
+            waitingCall.clear();
+            waitingCount = 0;
+            waitingTokens = 0;
+        }
+
+        if (cm->isUser()) {
+            currentTurn = false;
+        }
+    }
+    // results of calls before the considered history
+    if (waitingCount > 0) {
+        dropWaiting();
+    }
+
+    std::reverse(packed.begin(), packed.end());
+    packed.append(pending);
+
+    m_lastContextTokens = used;
+    qDebug().noquote() << "[LLMChatClient] packContext tokens:" << used << "/" << budget //
+                       << "verbatim:" << verbatim << "truncated:" << truncated         //
+                       << "summarized:" << summarized << "dropped:" << (i + 1) //
+                       << "orphaned tool results:" << orphaned;
+    emit contextPacked(used, budget);
+
+    return packed;
 }
 
 inline void LLMChatClient::reportError(const QString &message)
@@ -184,14 +938,14 @@ inline void LLMChatClient::reportError(const QString &message)
     emit errorOccurred("Server URL not set");
 }
 
-inline void LLMChatClient::sendRequest(const QJsonObject &requestBody, const QString &endpoint, bool isGetMethod)
+inline bool LLMChatClient::createRequest(const LLMConnection *connection, const QString &endpoint, QNetworkRequest &request)
 {
-    if (!m_connection || !m_connection->isValid()) {
+    if (!connection || !connection->isValid()) {
         reportError("Server URL not set");
-        return;
+        return false;
     }
 
-    QString apiUrl = m_connection->apiUrl();
+    QString apiUrl = connection->apiUrl();
     if (!apiUrl.endsWith('/') && !endpoint.startsWith("/")) {
         apiUrl + "/" + endpoint;
     } else if (apiUrl.endsWith("/") && endpoint.startsWith("/")) {
@@ -201,62 +955,390 @@ inline void LLMChatClient::sendRequest(const QJsonObject &requestBody, const QSt
     }
 
     QUrl url(apiUrl);
-    QNetworkRequest request(url);
+    request.setUrl(url);
 
     request.setTransferTimeout(m_timeout);
+    LLMTransport::instance()->prepare(request);
     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-    if (!m_connection->apiKey().isEmpty()) {
-        switch (m_connection->authType()) {
+    if (!connection->apiKey().isEmpty()) {
+        switch (connection->authType()) {
             case LLMConnection::AuthType::AuthToken: {
-                request.setRawHeader("Authorization", "Token " + m_connection->apiKey().toUtf8());
+                request.setRawHeader("Authorization", "Token " + connection->apiKey().toUtf8());
                 break;
             }
             case LLMConnection::AuthType::AuthBearer: {
-                request.setRawHeader("Authorization", "Bearer " + m_connection->apiKey().toUtf8());
+                request.setRawHeader("Authorization", "Bearer " + connection->apiKey().toUtf8());
                 break;
             }
         }
     }
 
-    // ensure to handle regular LLM messages
-    m_isResponseStream = false;
+    return true;
+}
 
-    QNetworkReply *reply;
-    if (isGetMethod) {
-        reply = m_networkManager->get(request);
-    } else {
-        QJsonDocument doc(requestBody);
-        QByteArray data = doc.toJson(QJsonDocument::Compact);
-        reply = m_networkManager->post(request, data);
+inline QNetworkReply *LLMChatClient::sendRequest( //
+    LLMConnection *connection,
+    const QByteArray &requestBody,
+    const QString &endpoint,
+    RequestKind kind)
+{
+    QNetworkRequest request;
+    if (!createRequest(connection, endpoint, request)) {
+        return nullptr;
     }
 
-    connect(reply, &QNetworkReply::finished, this, [this]() { //
-        this->onLLMResponse(qobject_cast<QNetworkReply *>(sender()));
+    if (kind != CompletionRequest) {
+        // 304 without a body if the cached model list is current
+        ModelCatalog::instance()->prepare(connection, request);
+        return LLMTransport::instance()->manager(connection)->get(request);
+    }
+    return LLMTransport::instance()->manager(connection)->post(request, requestBody);
+}
+
+inline QNetworkReply *LLMChatClient::sendRequest(LLMConnection *connection, JsonRequestDevice *requestBody, const QString &endpoint)
+{
+    QNetworkRequest request;
+    if (!createRequest(connection, endpoint, request)) {
+        delete requestBody;
+        return nullptr;
+    }
+
+    // sizes the body for Content-Length
+    if (!requestBody->open(QIODevice::ReadOnly)) {
+        reportError(tr("Unable to read attachment: %1").arg(requestBody->errorString()));
+        delete requestBody;
+        return nullptr;
+    }
+    request.setHeader(QNetworkRequest::ContentLengthHeader, requestBody->size());
+    request.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+
+    QNetworkReply *reply = LLMTransport::instance()->manager(connection)->post(request, requestBody);
+    requestBody->setParent(reply);
+    return reply;
+}
+
+inline JsonRequestDevice *LLMChatClient::requestDevice(const RequestContext &context)
+{
+    // splice the attachments into the encoded request at their markers
+    JsonRequestDevice *device = new JsonRequestDevice(this);
+    const QByteArray &requestBody = context.body;
+    qsizetype from = 0;
+    for (int k = 0; k < context.attachments.size(); k++) {
+        const QByteArray marker = QByteArrayLiteral("\\u0001attachments:") + QByteArray::number(k) + QByteArrayLiteral("\\u0001");
+        const qsizetype at = requestBody.indexOf(marker, from);
+        if (at < 0) {
+            continue;
+        }
+        device->append(requestBody.mid(from, at - from));
+        foreach (const QString &fileName, context.attachments[k]) {
+            device->appendString(QStringLiteral("\n#File name: %1\n").arg(QFileInfo(fileName).absoluteFilePath()));
+            // cached text saves reading the file twice, large files are streamed
+            // with the escaped size the cache counted when it read them
+            const QString text = AttachmentCache::instance()->text(fileName);
+            if (text.isNull()) {
+                device->appendFile(fileName, AttachmentCache::instance()->entry(fileName).escapedSize);
+            } else {
+                device->appendString(text);
+            }
+        }
+        from = at + marker.size();
+    }
+    device->append(requestBody.mid(from));
+    return device;
+}
+
+inline QByteArray LLMChatClient::uploadedBody(const RequestContext &context)
+{
+    if (context.kind != CompletionRequest || context.attachments.isEmpty()) {
+        return context.body;
+    }
+
+    // the bytes the server gets, a replay compares the request with them
+    QByteArray body;
+    JsonRequestDevice *device = requestDevice(context);
+    if (device->open(QIODevice::ReadOnly)) {
+        body = device->readAll();
+    }
+    delete device;
+    return body;
+}
+
+inline QNetworkReply *LLMChatClient::send(const RequestContext &context)
+{
+    if (context.kind != CompletionRequest || context.attachments.isEmpty()) {
+        return sendRequest(context.connection, context.body, context.endpoint, context.kind);
+    }
+    return sendRequest(context.connection, requestDevice(context), context.endpoint);
+}
+
+inline quint64 LLMChatClient::startRequest(RequestContext context)
+{
+    // skip a server known to be down if another one serves the model,
+    // otherwise try it anyway
+    if (!LLMTransport::instance()->isAvailable(context.connection)) {
+        failover(context);
+    }
+
+    QNetworkReply *reply = send(context);
+    if (!reply) {
+        return 0;
+    }
+
+    // in-flight registry, the context travels with the reply
+    const quint64 id = m_nextRequestId++;
+    context.reply = reply;
+    context.timer.start();
+    context.capture.started = QDateTime::currentMSecsSinceEpoch();
+    // attachments as uploaded, they may change on disk until the answer
+    if (LLMRecorder::instance()->isRecording()) {
+        context.capture.request = uploadedBody(context);
+    }
+    m_requests.insert(id, context);
+    m_lastRequestId = id;
+    attachReply(id, reply, context.connection);
+    emit requestStarted(id);
+
+    return id;
+}
+
+inline void LLMChatClient::attachReply(quint64 id, QNetworkReply *reply, const LLMConnection *connection)
+{
+    LLMTransport::instance()->track(connection, reply);
+    reply->setProperty("requestId", id);
+
+    connect(reply, &QNetworkReply::readyRead, this, [this, id]() { //
+        this->onReadyRead(id);
     });
 
-    connect(reply, &QNetworkReply::errorOccurred, this, [this](QNetworkReply::NetworkError error) { //
-        this->onError(error);
+    connect(reply, &QNetworkReply::finished, this, [this, id]() {
+        QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+        const bool cancelled = reply->property("cancelled").toBool();
+        this->onLLMResponse(reply);
+        // still registered while waiting to be sent again
+        if (!cancelled && !m_requests.contains(id)) {
+            emit requestFinished(id);
+        }
     });
 
     connect(reply, &QNetworkReply::sslErrors, this, [this](const QList<QSslError> &errors) { //
         this->onSslErrors(qobject_cast<QNetworkReply *>(sender()), errors);
     });
-#if 0
-    // Handle download progress if needed
-    connect(reply, &QNetworkReply::downloadProgress, this, [/*this*/](qint64 bytesReceived, qint64 bytesTotal) { //
-        qDebug() << "[LLMChatClient] downloadProgress:" << bytesReceived << "/" << bytesTotal;
-    });
 
-    // Handle download progress if needed
-    connect(reply, &QNetworkReply::uploadProgress, this, [/*this*/](qint64 bytesSent, qint64 bytesTotal) { //
-        qDebug() << "[LLMChatClient] uploadProgress:" << bytesSent << "/" << bytesTotal;
+    // phases of the request for the metrics
+    const auto mark = [this, id](qint64 RequestContext::*phase) {
+        const auto it = m_requests.find(id);
+        if (it != m_requests.end() && it.value().*phase < 0) {
+            it.value().*phase = it->timer.elapsed();
+        }
+    };
+    connect(reply, &QNetworkReply::socketStartedConnecting, this, [mark]() { //
+        mark(&RequestContext::connectMs);
+    });
+    connect(reply, &QNetworkReply::encrypted, this, [mark]() { //
+        mark(&RequestContext::encryptedMs);
+    });
+    connect(reply, &QNetworkReply::requestSent, this, [mark]() { //
+        mark(&RequestContext::sentMs);
+    });
+    connect(reply, &QNetworkReply::metaDataChanged, this, [mark]() { //
+        mark(&RequestContext::headersMs);
     });
+}
+
+// ---------------- Retry and failover ----------------------------
+
+// Worth sending again: the server is busy or down, not the request wrong
+static inline bool isRetryable(QNetworkReply::NetworkError error, int status)
+{
+    switch (status) {
+        case 0:
+            break;
+        case 408: // request timeout
+        case 425: // too early
+        case 429: // too many requests
+        case 500:
+        case 502:
+        case 503:
+        case 504:
+            return true;
+        default:
+            // a bad request or key fails the same way again
+            return false;
+    }
+
+    switch (error) {
+        case QNetworkReply::ConnectionRefusedError:
+        case QNetworkReply::RemoteHostClosedError:
+        case QNetworkReply::HostNotFoundError:
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::OperationCanceledError: // transfer timeout
+        case QNetworkReply::TemporaryNetworkFailureError:
+        case QNetworkReply::NetworkSessionFailedError:
+        case QNetworkReply::ProxyTimeoutError:
+        case QNetworkReply::UnknownNetworkError:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Wait asked for by the server in msecs, -1 if none
+static inline qint64 retryAfter(const QNetworkReply *reply)
+{
+    bool ok = false;
+    // OpenAI sends msecs in addition
+    const qint64 msecs = reply->rawHeader("retry-after-ms").trimmed().toLongLong(&ok);
+    if (ok) {
+        return qMax<qint64>(0, msecs);
+    }
+
+    const QByteArray value = reply->rawHeader("Retry-After").trimmed();
+    if (value.isEmpty()) {
+        return -1;
+    }
+    const qint64 seconds = value.toLongLong(&ok);
+    if (ok) {
+        return qMax<qint64>(0, seconds) * 1000;
+    }
+    // or an HTTP date
+    const QDateTime date = QDateTime::fromString(QString::fromLatin1(value), Qt::RFC2822Date);
+    return (date.isValid() ? qMax<qint64>(0, QDateTime::currentDateTimeUtc().msecsTo(date)) : -1);
+}
+
+// Model of the list with the same id, else the same name without the
+// publisher prefix, e.g. "qwen/qwen3-8b" and "Qwen3-8B"
+static inline QString equivalentModel(const QString &model, const QStringList &models)
+{
+    if (models.contains(model)) {
+        return model;
+    }
+    const QString name = model.section('/', -1);
+    foreach (const QString &id, models) {
+        if (id.section('/', -1).compare(name, Qt::CaseInsensitive) == 0) {
+            return id;
+        }
+    }
+    return QString();
+}
+
+inline int LLMChatClient::backoffDelay(int attempt) const
+{
+    // exponential with jitter, clients failing together do not retry together
+    const qint64 ceiling = qMin<qint64>(m_maxRetryDelay, qint64(m_retryBaseDelay) << qMin(attempt, 16));
+    return int(ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1));
+}
+
+inline bool LLMChatClient::failover(RequestContext &context)
+{
+    // fan-out compares servers, it does not replace them
+    if (context.kind != CompletionRequest || context.fanOutId != 0) {
+        return false;
+    }
+
+    context.tried.append(LLMTransport::poolKey(context.connection));
+    LLMTransport *transport = LLMTransport::instance();
+    foreach (const QSharedPointer<LLMConnection> &connection, m_failoverConnections) {
+        if (!connection->isEnabled() || !connection->isValid() || context.tried.contains(LLMTransport::poolKey(connection.data()))) {
+            continue;
+        }
+        const QString model = equivalentModel(context.model, transport->models(connection.data()));
+        if (model.isEmpty() || !transport->isAvailable(connection.data())) {
+            continue;
+        }
+
+        qDebug().noquote() << "[LLMChatClient] failover from" << context.tried.last() << "to" << connection->name() << "model:" << model;
+        // the model leads the request, see buildChatCompletionRequest()
+        const QByteArray prefix = QByteArrayLiteral("{\"model\":") + encodeJson(context.model);
+        if (model != context.model && context.body.startsWith(prefix)) {
+            context.body = QByteArrayLiteral("{\"model\":") + encodeJson(model) + context.body.mid(prefix.size());
+        }
+        context.connection = connection.data();
+        context.sharedConnection = connection;
+        context.endpoint = connection->endpointUri(LLMConnection::EndpointCompletion);
+        context.model = model;
+        context.attempts = 0;
+        return true;
+    }
+    return false;
+}
+
+inline bool LLMChatClient::retryRequest(quint64 id, RequestContext &context, QNetworkReply *reply)
+{
+    // a stream cannot be resumed, none of the supported servers offers
+    // it, and sending again would repeat what is already shown
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (context.events > 0 || !isRetryable(reply->error(), status)) {
+        return false;
+    }
+
+    // same server unless it asks for a long wait or its circuit opened
+    qint64 delay = retryAfter(reply);
+    if (context.connection && context.attempts < m_maxRetries && delay <= m_maxRetryDelay //
+        && LLMTransport::instance()->isAvailable(context.connection)) {
+        if (delay < 0) {
+            delay = backoffDelay(context.attempts);
+        }
+        context.attempts++;
+    } else if (failover(context)) {
+        delay = 0;
+    } else {
+        return false;
+    }
+
+    const QString name = context.connection->name();
+    qDebug().noquote() << "[LLMChatClient] retry request:" << id << "status:" << status << reply->error() //
+                       << "attempt:" << context.attempts << "in" << delay << "ms on" << name;
 
-    // Handle metadata changes if needed
-    connect(reply, &QNetworkReply::metaDataChanged, this, [/*this*/]() { //
-        qDebug() << "[LLMChatClient] metaDataChanged";
+    context.reply = nullptr;
+    context.buffer.clear();
+    context.capture.chunks.clear();
+    context.capture.times.clear();
+    context.firstByteMs = -1;
+    context.connectMs = -1;
+    context.encryptedMs = -1;
+    context.sentMs = -1;
+    context.headersMs = -1;
+    m_requests.insert(id, context);
+    emit requestRetrying(id, context.attempts, int(delay), name);
+
+    QTimer::singleShot(delay, this, [this, id]() { //
+        resendRequest(id);
     });
-#endif
+    return true;
+}
+
+inline void LLMChatClient::resendRequest(quint64 id)
+{
+    // cancelled while waiting
+    const auto found = m_requests.constFind(id);
+    if (found == m_requests.constEnd() || found->reply) {
+        return;
+    }
+    const RequestContext context = found.value();
+
+    QNetworkReply *reply = send(context);
+    if (!reply) {
+        m_requests.remove(id);
+        if (context.fanOutId != 0) {
+            finishFanOut(context, tr("Request not sent"));
+        }
+        emit requestFinished(id);
+        return;
+    }
+
+    const auto it = m_requests.find(id);
+    if (it == m_requests.end()) {
+        // cancelled by an error report of this send
+        reply->abort();
+        reply->deleteLater();
+        return;
+    }
+    it->reply = reply;
+    it->capture.started = QDateTime::currentMSecsSinceEpoch();
+    if (LLMRecorder::instance()->isRecording()) {
+        it->capture.request = uploadedBody(context);
+    }
+    attachReply(id, reply, context.connection);
 }
 
 inline QJsonArray LLMChatClient::loadToolsConfig() const
@@ -265,8 +1347,12 @@ inline QJsonArray LLMChatClient::loadToolsConfig() const
         return QJsonArray();
     }
 
+    // sorted by name, the file listing order of the tool configs varies
     QJsonArray result;
     QList<QJsonObject> toolList = m_toolModel->toolObjects();
+    std::stable_sort(toolList.begin(), toolList.end(), [](const QJsonObject &a, const QJsonObject &b) { //
+        return a.value("name").toString() < b.value("name").toString();
+    });
     foreach (auto tool, toolList) {
         QJsonObject fncItem;
         fncItem["type"] = "function";
@@ -277,11 +1363,26 @@ inline QJsonArray LLMChatClient::loadToolsConfig() const
     return result;
 }
 
-inline QJsonObject LLMChatClient::buildChatCompletionRequest( //
+inline const QByteArray &LLMChatClient::toolsJson() const
+{
+    if (m_toolsJson.isEmpty()) {
+        m_toolsJson = encodeJson(loadToolsConfig());
+    }
+    return m_toolsJson;
+}
+
+void LLMChatClient::invalidateTools()
+{
+    m_toolsJson.clear();
+    m_toolTokens = -1;
+}
+
+QByteArray LLMChatClient::buildChatCompletionRequest( //
     const QString &model,
     const QList<QJsonObject> &messages,
     const QJsonObject &parameters,
-    bool stream)
+    bool stream,
+    qsizetype *stablePrefix) const
 {
 #if 0
     qDebug().noquote() << "[LLMChatClient] buildChatCompletionRequest" //
@@ -290,27 +1391,15 @@ inline QJsonObject LLMChatClient::buildChatCompletionRequest( //
                        << "json:" << messages                          //
                        << "params:" << parameters;
 #endif
-    QJsonObject request;
-
-    // Required fields
-    request["model"] = model;
-
-    // Convert QList<QJsonObject> to QJsonArray
-    QJsonArray messagesArray;
-    for (const QJsonObject &message : messages) {
-        messagesArray.append(message);
-    }
-    request["messages"] = messagesArray;
-
-    // Optional parameters
-    if (!parameters.isEmpty()) {
-        for (const QString &key : parameters.keys()) {
-            request[key] = parameters.value(key);
-        }
-    }
+    // Fixed field order keeps the leading bytes of consecutive requests
+    // identical, so local servers (llama.cpp, LM Studio) reuse their
+    // prompt cache: model, tools and system messages first, history next,
+    // volatile sampling parameters last.
+    QByteArray request;
+    request.append("{\"model\":").append(encodeJson(model));
 
     // Tools -> hm, not work for normal text?
-    request["tools"] = loadToolsConfig();
+    request.append(",\"tools\":").append(toolsJson());
 
     // Resources?
     //request["resources"] = QJsonArray();
@@ -318,18 +1407,47 @@ inline QJsonObject LLMChatClient::buildChatCompletionRequest( //
     // Prompt Templates?
     //request["prompts"] = QJsonArray();
 
+    request.append(",\"messages\":[");
+    bool first = true;
+    // system preamble leads, whatever the history packing left in front
+    for (const QJsonObject &message : messages) {
+        if (message.value("role").toString() == "system") {
+            request.append(first ? "" : ",").append(encodeJson(message));
+            first = false;
+        }
+    }
+    if (stablePrefix) {
+        *stablePrefix = request.size();
+    }
+    for (const QJsonObject &message : messages) {
+        if (message.value("role").toString() != "system") {
+            request.append(first ? "" : ",").append(encodeJson(message));
+            first = false;
+        }
+    }
+    request.append(']');
+
+    // Optional parameters, sorted by key
+    for (const QString &key : parameters.keys()) {
+        if (key == "model" || key == "tools" || key == "messages" || key == "stream") {
+            continue;
+        }
+        request.append(',').append(encodeJson(key)).append(':').append(encodeJson(parameters.value(key)));
+    }
+
     // Streaming
-    request["stream"] = stream;
+    request.append(",\"stream\":").append(stream ? "true" : "false");
+    request.append('}');
 
     return request;
 }
 
 // =========================================================
 
-void LLMChatClient::onError(QNetworkReply::NetworkError error)
+void LLMChatClient::onError(QNetworkReply::NetworkError error, const QString &message)
 {
-    qCritical().noquote() << "[LLMChatClient] onError reply:" << error;
-    emit networkError(error, "Network error occurred");
+    qCritical().noquote() << "[LLMChatClient] onError reply:" << error << message;
+    emit networkError(error, "Network error occurred: " + message);
 }
 
 void LLMChatClient::onSslErrors(QNetworkReply *reply, const QList<QSslError> &errors)
@@ -342,29 +1460,178 @@ void LLMChatClient::onSslErrors(QNetworkReply *reply, const QList<QSslError> &er
     }
 }
 
-void LLMChatClient::onLLMResponse(QNetworkReply *reply)
+// A non-empty "content" (or "reasoning_content") delta, the first token
+static inline bool hasContentDelta(const QByteArray &data)
+{
+    static const QByteArray key = QByteArrayLiteral("content\":\"");
+    for (qsizetype i = data.indexOf(key); i >= 0; i = data.indexOf(key, i + 1)) {
+        const qsizetype next = i + key.size();
+        if (next < data.size() && data.at(next) != '"') {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void LLMChatClient::deliverStream(RequestContext &context, const QByteArray &data)
 {
-    qDebug().noquote() << "[LLMChatClient] onLLMResponse --------------------------";
+    const int events = int(data.count("data:"));
+    context.events += events;
+    TraceBuffer::instance()->counter("streamEvents", "stream", events);
+    if (hasContentDelta(data)) {
+        const qint64 now = context.timer.nsecsElapsed();
+        if (context.firstTokenMs < 0) {
+            context.firstTokenMs = now / 1000000;
+        } else {
+            context.chunkGaps.append((now - context.lastChunkNs) / 1e6);
+        }
+        context.lastChunkNs = now;
+    }
 
+    // the views render while the model parses, their share is counted apart
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 rendered = LLMMetrics::instance()->renderTime();
+    if (context.chatModel) {
+        context.chatModel->onParseDataStream(data);
+    } else {
+        emit parseDataStream(data);
+    }
+    const qint64 render = LLMMetrics::instance()->renderTime() - rendered;
+    context.renderNs += render;
+    context.parseNs += timer.nsecsElapsed() - render;
+}
+
+inline void LLMChatClient::capture(RequestContext &context, const QByteArray &data) const
+{
+    if (!data.isEmpty() && LLMRecorder::instance()->isRecording()) {
+        context.capture.chunks.append(data);
+        context.capture.times.append(QDateTime::currentMSecsSinceEpoch() - context.capture.started);
+    }
+}
+
+inline void LLMChatClient::deliverObject(RequestContext &context, const QJsonObject &response)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 rendered = LLMMetrics::instance()->renderTime();
+    if (context.chatModel) {
+        context.chatModel->onParseMessageObject(response);
+    } else {
+        emit parseDataObject(response);
+    }
+    const qint64 render = LLMMetrics::instance()->renderTime() - rendered;
+    context.renderNs += render;
+    context.parseNs += timer.nsecsElapsed() - render;
+}
+
+void LLMChatClient::onReadyRead(quint64 id)
+{
+    const auto it = m_requests.find(id);
+    if (it == m_requests.end() || !it->reply) {
+        return;
+    }
+    RequestContext &context = it.value();
+    QNetworkReply *reply = context.reply;
+
+    // error bodies are not answers, the reply is retried or reported when finished
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400) {
+        return;
+    }
+
+    if (context.firstByteMs < 0) {
+        context.firstByteMs = context.timer.elapsed();
+        // servers may stream even if not asked to, and the other way round
+        const QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+        context.stream = contentType.contains(QLatin1String("text/event-stream")) || reply->peek(5) == "data:" //
+                         || (context.stream && !contentType.contains(QLatin1String("json")));
+    }
+    if (!context.stream) {
+        // a JSON body is parsed once complete
+        return;
+    }
+
+    // hand over complete lines only, the rest waits for more data
+    const QByteArray data = reply->readAll();
+    capture(context, data);
+    context.buffer.append(data);
+    const qsizetype end = context.buffer.lastIndexOf('\n');
+    if (end < 0) {
+        return;
+    }
+    const QByteArray lines = context.buffer.left(end + 1);
+    context.buffer.remove(0, end + 1);
+    deliverStream(context, lines);
+}
+
+void LLMChatClient::onLLMResponse(QNetworkReply *reply)
+{
+    const quint64 id = reply->property("requestId").toULongLong();
+    RequestContext context = m_requests.take(id);
     QJsonParseError error;
     QJsonDocument doc;
     QJsonObject response;
     QByteArray data;
+    // what the stream did not read yet, or the whole body
+    const QByteArray rest = reply->readAll();
+    capture(context, rest);
+
+    qDebug().noquote() << "[LLMChatClient] onLLMResponse" << id                                         //
+                       << "in" << (context.timer.isValid() ? context.timer.elapsed() : -1) << "ms"    //
+                       << "first byte" << context.firstByteMs << "ms"                                  //
+                       << "events" << context.events;
+
+    // every attempt, for replay without a server
+    if (LLMRecorder::instance()->isRecording() && !reply->property("cancelled").toBool()) {
+        context.capture.method = (context.kind == CompletionRequest ? QStringLiteral("POST") : QStringLiteral("GET"));
+        context.capture.path = reply->url().path();
+        if (context.capture.request.isNull()) {
+            context.capture.request = context.body;
+        }
+        context.capture.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        context.capture.contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+        LLMRecorder::instance()->record(context.capture);
+    }
 
     if (reply->error() != QNetworkReply::NoError) {
+        if (reply->property("cancelled").toBool()) {
+            goto finish;
+        }
+        // sent again later, on this or another server
+        if (retryRequest(id, context, reply)) {
+            reply->deleteLater();
+            return;
+        }
+        // other servers are listed in the background, nobody waits for them
+        if (context.kind == CatalogRequest) {
+            qWarning().noquote() << "[LLMChatClient] model list of" << reply->url().host() << "failed:" << reply->errorString();
+        } else {
+            onError(reply->error(), reply->errorString());
+            if (context.kind == CompletionRequest) {
+                emit requestFailed(id, reply->error(), reply->errorString());
+            }
+        }
+        goto finish;
+    }
+
+    // cached model list still current
+    if (context.kind != CompletionRequest && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+        QJsonArray models;
+        if (context.connection && ModelCatalog::instance()->models(context.connection, models)) {
+            LLMTransport::instance()->setModels(context.connection, ModelCatalog::modelIds(models));
+        }
+        ModelCatalog::instance()->revalidated(context.connection);
         goto finish;
     }
 
-    data = reply->readAll();
+    data = context.buffer + rest;
     if (data.length() == 0) {
         goto finish;
     }
 
-    // Check if a streamed LLM message
-    if (data.startsWith("data:") || m_isResponseStream) {
-        qDebug().noquote() << "[LLMChatClient] onFinished -> stream message.";
-        parseDataStream(data);
-        m_isResponseStream = true;
+    // rest of a streamed LLM message, without a trailing line end
+    if (context.stream || data.startsWith("data:")) {
+        deliverStream(context, data);
         goto finish;
     }
 
@@ -379,15 +1646,37 @@ void LLMChatClient::onLLMResponse(QNetworkReply *reply)
     response = doc.object();
 
     // Handle available models response
-    if (reply->url().path().contains("/models")) {
-        modelList()->loadFrom(response["data"].toArray());
-        qDebug("[LLMChatClient] onLLMResponse: %d LLM models available.", modelList()->rowCount());
+    if (context.kind != CompletionRequest) {
+        // failover looks up the models a server offers, clients of the server get them from the catalog
+        const QJsonArray models = response["data"].toArray();
+        if (context.connection) {
+            LLMTransport::instance()->setModels(context.connection, ModelCatalog::modelIds(models));
+            ModelCatalog::instance()->store(context.connection,
+                                            models,
+                                            QString::fromLatin1(reply->rawHeader("ETag")),
+                                            QString::fromLatin1(reply->rawHeader("Last-Modified")));
+        }
+        // answered by a failover server, not listed under the connection of this client
+        if (context.kind == ModelsRequest && ModelCatalog::key(context.connection) != ModelCatalog::key(m_connection)) {
+            m_llmModels->loadFrom(models);
+        }
+        if (context.kind == ModelsRequest) {
+            qDebug("[LLMChatClient] onLLMResponse: %d LLM models available.", modelList()->rowCount());
+        }
     }
     // Handle regular LLM message
     else {
-        parseDataObject(response);
+        deliverObject(context, response);
     }
 
 finish:
+    if (context.kind == CompletionRequest) {
+        recordMetrics(context, reply);
+    } else {
+        ModelCatalog::instance()->endFetch(context.connection);
+    }
+    if (context.fanOutId != 0) {
+        finishFanOut(context, reply->error() != QNetworkReply::NoError ? reply->errorString() : QString());
+    }
     reply->deleteLater();
 }
@@ -3,9 +3,11 @@
 #include <chatmessage.h>
 #include <chatmodel.h>
 #include <llmconnectionmodel.h>
+#include <llmrecorder.h>
 #include <modellistmodel.h>
 #include <toolmodel.h>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -14,10 +16,16 @@
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QSharedPointer>
 #include <QString>
+#include <QStringList>
 #include <QTimer>
 #include <QUrl>
 
+class JsonRequestDevice;
+
 class LLMChatClient : public QObject
 {
     Q_OBJECT
@@ -30,8 +38,57 @@ public:
         QString toolName;
         QString toolQuery; // user question
         QString toolResult;
+        // files appended to the content, streamed from disk on upload
+        QStringList attachments;
+        // calls of an assistant message, sent as tool_calls
+        QList<ToolCallEntry> toolCalls;
+        // call a tool result answers, sent as tool_call_id
+        QString toolCallId;
+    };
+
+    // One (connection, model) pair of a fan-out comparison
+    struct FanOutTarget
+    {
+        LLMConnection *connection;
+        QString model;
+        // receives the answer of this target
+        ChatModel *chatModel;
+    };
+
+    // Timing of one fan-out answer
+    struct FanOutResult
+    {
+        int index; // in the target list
+        // answered without error, not empty and not cut off
+        bool ok;
+        qint64 firstTokenMs; // time to first token, -1 if none arrived
+        qint64 totalMs;
+        int tokens;
+        double tokensPerSecond; // after the first token
+        QString error;
     };
 
+    // Context window assumed if the server does not report one
+    static constexpr int DefaultContextLength = 8192;
+    // Role, separators and framing of each message
+    static constexpr int MessageOverheadTokens = 4;
+    // Tool results of earlier turns are cut to this size
+    static constexpr int MaxToolResultTokens = 512;
+    // Size of an extractive summary of an older message
+    static constexpr int SummaryTokens = 64;
+    // max_tokens is never clamped below this
+    static constexpr int MinResponseTokens = 256;
+    // Tokens packContext() keeps free for the response by default
+    static constexpr int DefaultResponseTokens = 4096;
+    // Tokens of a back-reference replacing a repeated attachment
+    static constexpr int BackReferenceTokens = 16;
+    // Retries of a failed request on the same server
+    static constexpr int DefaultMaxRetries = 3;
+    // First retry delay in msecs, doubled per retry
+    static constexpr int RetryBaseDelay = 500;
+    // Longer waits, Retry-After included, fail over instead
+    static constexpr int MaxRetryDelay = 30000;
+
     explicit LLMChatClient(ToolModel *toolModel, QObject *parent = nullptr);
 
     ~LLMChatClient();
@@ -39,6 +96,27 @@ public:
     // Configuration methods
     void setTimeout(int milliseconds);
     void setConnection(LLMConnection *connection);
+    // Responses are parsed into this model, signals are emitted if null
+    void setChatModel(ChatModel *chatModel);
+
+    /**
+     * @brief setRetryPolicy Failed requests are sent again on 429, 5xx and
+     * network errors, after a jittered exponential backoff or the wait
+     * asked for by Retry-After. A stream is only sent again if no part of
+     * the answer arrived yet.
+     * @param maxRetries Retries on the same server, 0 to disable
+     * @param baseDelay First delay in msecs
+     * @param maxDelay Longest delay in msecs
+     */
+    void setRetryPolicy(int maxRetries, int baseDelay = RetryBaseDelay, int maxDelay = MaxRetryDelay);
+
+    /**
+     * @brief setFailoverConnections Servers a chat request moves to when
+     * its server keeps failing or its circuit is open. A server qualifies
+     * if it is enabled, healthy and lists the same model.
+     * @param connections All configured connections, copied
+     */
+    void setFailoverConnections(const QList<LLMConnection> &connections);
 
     // Convenience method for single string message
 
@@ -48,35 +126,194 @@ public:
     // Model listing
     void listModels();
 
+    /**
+     * @brief packContext Prepends as much chat history to the pending
+     * messages as fits the context window of the active model. Newest
+     * messages are kept verbatim, tool results of earlier turns are
+     * truncated and older messages summarized, the rest is dropped. Tool
+     * calls and their results are kept or dropped together.
+     * Runs in linear time of the history size.
+     * @param history Chat history, messages already shown in the chat
+     * @param pending Messages of this request, always kept
+     * @param historyCount Number of history messages to consider, -1 for all
+     * @param maxTokens Tokens reserved for the response, at most three
+     * quarters of the window
+     * @return Packed messages in chronological order
+     */
+    QList<SendParameters> packContext(const ChatModel *history, const QList<SendParameters> &pending, int historyCount = -1, int maxTokens = DefaultResponseTokens);
+
+    /**
+     * @brief buildChatCompletionRequest Encodes a chat completion request
+     * canonically: model, tools and system messages first, the history in
+     * order next, sampling parameters sorted by key last. Consecutive
+     * requests of a chat share their leading bytes, so servers keep their
+     * prompt cache.
+     * @param model Model id
+     * @param messages Messages in chronological order
+     * @param parameters Sampling parameters, max_tokens, temperature, ...
+     * @param stream Stream the answer
+     * @param stablePrefix Receives the size of the part before the history
+     * @return JSON request body
+     */
+    QByteArray buildChatCompletionRequest(const QString &model,
+                                          const QList<QJsonObject> &messages,
+                                          const QJsonObject &parameters,
+                                          bool stream,
+                                          qsizetype *stablePrefix = nullptr) const;
+
+    // Fast local token estimate, stops counting at limit and reports the text position
+    static int estimateTokens(QStringView text, int limit = INT_MAX, qsizetype *end = nullptr);
+    // Token budget for the messages of a request
+    int contextBudget(int maxTokens) const;
+    inline int lastContextTokens() const { return m_lastContextTokens; }
+    // Counted prompt size of the last request including tool schemas
+    inline int lastPromptTokens() const { return m_lastPromptTokens; }
+
     inline ToolModel *toolModel() { return m_toolModel; }
     inline ModelListModel *modelList() const { return m_llmModels; }
     inline const ModelListModel::ModelEntry &activeModel() const { return m_llmModel; }
     inline bool hasLLModels() const { return m_llmModels && m_llmModels->rowCount() > 0; }
     inline bool modelCount() const { return (m_llmModels ? m_llmModels->rowCount() : 0); }
 
+    // Requests still running
+    inline int activeRequests() const { return m_requests.size(); }
+    inline QList<quint64> requestIds() const { return m_requests.keys(); }
+    // Id of the request sent last, 0 if none
+    inline quint64 lastRequestId() const { return m_lastRequestId; }
+
+    /**
+     * @brief cancelRequest Aborts a running request
+     * @param id Request id from requestStarted() or lastRequestId()
+     * @return true if the request was still running
+     */
+    bool cancelRequest(quint64 id);
+
+    /**
+     * @brief sendFanOut Sends the same request to several models at once
+     * @param parameters Messages, usually from packContext()
+     * @param targets Connection, model and transcript of every answer
+     * @param stream Stream the answers, needed for time to first token
+     * @param maxTokens Response limit of every target
+     * @param temperature Sampling temperature of every target
+     * @return Fan-out id reported by fanOutResult() and fanOutFinished()
+     */
+    quint64 sendFanOut(const QList<SendParameters> &parameters,
+                       const QList<FanOutTarget> &targets,
+                       bool stream = true,
+                       int maxTokens = 65536,
+                       double temperature = 0.7);
+
+    // Aborts the requests of a fan-out still running
+    void cancelFanOut(quint64 fanOutId);
+
+    // Index of the fastest acceptable answer, -1 if none
+    static int bestFanOutResult(const QList<FanOutResult> &results);
+
 public slots:
     void setActiveModel(const ModelListModel::ModelEntry &model);
+    // Aborts all running requests of this client
     void cancelRequest();
 
 signals:
     void errorOccurred(const QString &error);
     void networkError(QNetworkReply::NetworkError error, const QString &message);
+    // a completion request failed after its retries, model lists never report here
+    void requestFailed(quint64 id, QNetworkReply::NetworkError error, const QString &message);
     void parseDataStream(const QByteArray &data);
     void parseDataObject(const QJsonObject &response);
+    void contextPacked(int tokens, int budget);
+    void requestStarted(quint64 id);
+    void requestFinished(quint64 id);
+    // aborted by cancelRequest(), no finished signal follows
+    void requestCancelled(quint64 id);
+    // failed, sent again after delay msecs to the named connection
+    void requestRetrying(quint64 id, int attempt, int delay, const QString &connection);
+    // one target of a fan-out answered or failed
+    void fanOutResult(quint64 fanOutId, const LLMChatClient::FanOutResult &result);
+    // all targets are done, best is the fastest acceptable answer or -1
+    void fanOutFinished(quint64 fanOutId, int best);
 
 protected:
     // Chat completion methods
-    void sendChat(const QString &model, const QList<QJsonObject> &messages, bool stream = false, int maxTokens = 65536, double temperature = 0.7);
+    void sendChat(const QString &model,
+                  const QList<QJsonObject> &messages,
+                  bool stream = false,
+                  int maxTokens = 65536,
+                  double temperature = 0.7,
+                  const QList<QStringList> &attachments = {});
     // Chat completion with parameters
-    void sendChat(const QString &model, const QList<QJsonObject> &messages, const QJsonObject &parameters, bool stream = false);
+    void sendChat(const QString &model,
+                  const QList<QJsonObject> &messages,
+                  const QJsonObject &parameters,
+                  bool stream = false,
+                  const QList<QStringList> &attachments = {});
 
 private slots:
+    void onReadyRead(quint64 id);
     void onLLMResponse(QNetworkReply *reply);
-    void onError(QNetworkReply::NetworkError error);
+    void onError(QNetworkReply::NetworkError error, const QString &message);
     void onSslErrors(QNetworkReply *reply, const QList<QSslError> &errors);
+    void invalidateTools();
 
 private:
-    QNetworkAccessManager *m_networkManager;
+    enum RequestKind {
+        ModelsRequest = 0,
+        CompletionRequest,
+        // model list of a failover server, errors are not reported
+        CatalogRequest,
+    };
+
+    // State of one running request
+    struct RequestContext
+    {
+        // null while waiting to be sent again
+        QPointer<QNetworkReply> reply;
+        // server of the request, changes on failover
+        QPointer<LLMConnection> connection;
+        // holds a failover connection while the list is replaced
+        QSharedPointer<LLMConnection> sharedConnection;
+        // receives the response, signals are emitted if null
+        QPointer<ChatModel> chatModel;
+        RequestKind kind;
+        // server-sent events, parsed while they arrive
+        bool stream;
+        // kept to send the request again
+        QString endpoint;
+        QString model;
+        QByteArray body;
+        QList<QStringList> attachments;
+        int attempts;      // retries on the current server
+        QStringList tried; // servers failed over from
+        // incomplete line of the event stream
+        QByteArray buffer;
+        QElapsedTimer timer;
+        qint64 firstByteMs;  // -1 until the first data arrived
+        qint64 firstTokenMs; // -1 until the first content delta
+        // network phases since sent, -1 if not seen
+        qint64 connectMs;
+        qint64 encryptedMs;
+        qint64 sentMs;
+        qint64 headersMs;
+        // arrival of the last content chunk, gaps between chunks in msecs
+        qint64 lastChunkNs;
+        QList<double> chunkGaps;
+        qint64 parseNs;
+        qint64 renderNs;
+        int events;
+        // fan-out the request belongs to, 0 if none
+        quint64 fanOutId;
+        int fanOutIndex;
+        // request and response bytes, kept while recording
+        LLMRecorder::Exchange capture;
+    };
+
+    // Running fan-out comparison
+    struct FanOut
+    {
+        int pending;
+        QList<FanOutResult> results;
+    };
+
     // tool support
     ToolModel *m_toolModel;
     // all available LL models
@@ -87,14 +324,57 @@ private:
     LLMConnection *m_connection;
     // configured time out
     int m_timeout;
-    // True if server response is a stream
-    bool m_isResponseStream;
+    // target of responses to requests sent from now on
+    QPointer<ChatModel> m_chatModel;
+    // estimated prompt size of the last packed request
+    int m_lastContextTokens;
+    // counted prompt size of the last request
+    int m_lastPromptTokens;
+    // serialized "tools" array and its token count, -1 if not counted
+    mutable QByteArray m_toolsJson;
+    mutable int m_toolTokens;
+    // running requests by id
+    QHash<quint64, RequestContext> m_requests;
+    quint64 m_nextRequestId;
+    quint64 m_lastRequestId;
+    // running fan-outs by id
+    QHash<quint64, FanOut> m_fanOuts;
+    quint64 m_nextFanOutId;
+    // copies of the configured connections, for failover, shared with
+    // the requests using them
+    QList<QSharedPointer<LLMConnection>> m_failoverConnections;
+    int m_maxRetries;
+    int m_retryBaseDelay;
+    int m_maxRetryDelay;
 
 private:
     inline void reportError(const QString &message);
-    inline void sendRequest(const QJsonObject &requestBody, const QString &endpoint, bool isGetMethod = false);
+    inline bool createRequest(const LLMConnection *connection, const QString &endpoint, QNetworkRequest &request);
+    inline QNetworkReply *sendRequest(LLMConnection *connection, const QByteArray &requestBody, const QString &endpoint, RequestKind kind);
+    inline QNetworkReply *sendRequest(LLMConnection *connection, JsonRequestDevice *requestBody, const QString &endpoint);
+    inline JsonRequestDevice *requestDevice(const RequestContext &context);
+    inline QByteArray uploadedBody(const RequestContext &context);
+    inline QNetworkReply *send(const RequestContext &context);
+    inline RequestContext requestContext(LLMConnection *connection, ChatModel *chatModel, RequestKind kind, bool stream) const;
+    inline quint64 startRequest(RequestContext context);
+    inline void attachReply(quint64 id, QNetworkReply *reply, const LLMConnection *connection);
+    inline bool retryRequest(quint64 id, RequestContext &context, QNetworkReply *reply);
+    inline void resendRequest(quint64 id);
+    inline bool failover(RequestContext &context);
+    inline int backoffDelay(int attempt) const;
+    inline QList<QJsonObject> buildMessages(const QList<SendParameters> &parameters, QList<QStringList> &attachments, int &promptTokens);
+    inline void finishFanOut(const RequestContext &context, const QString &error);
+    inline int answerTokens(const RequestContext &context, QString *finishReason = nullptr) const;
+    inline void recordMetrics(const RequestContext &context, QNetworkReply *reply) const;
+    inline void deliverStream(RequestContext &context, const QByteArray &data);
+    inline void capture(RequestContext &context, const QByteArray &data) const;
+    inline void deliverObject(RequestContext &context, const QJsonObject &response);
     inline QJsonArray loadToolsConfig() const;
-    inline QJsonObject buildChatCompletionRequest(const QString &model, const QList<QJsonObject> &messages, const QJsonObject &parameters, bool stream);
+    inline const QByteArray &toolsJson() const;
+    static inline int messageTokens(const SendParameters &message, QSet<quint64> *sentHashes = nullptr);
+    inline int toolTokens() const;
+    static inline QString truncateToTokens(const QString &text, int maxTokens);
+    static inline QString summarize(const QString &text);
 };
 
 #endif // LLMCHAT_CLIENT_H
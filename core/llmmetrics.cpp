@@ -0,0 +1,137 @@
+#include <llmmetrics.h>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QStringList>
+#include <algorithm>
+
+static LLMMetrics *s_instance = nullptr;
+
+LLMMetrics *LLMMetrics::instance()
+{
+    if (!s_instance) {
+        s_instance = new LLMMetrics(qApp);
+    }
+    return s_instance;
+}
+
+LLMMetrics::LLMMetrics(QObject *parent)
+    : QObject{parent}
+    , m_samples()
+    , m_traceFile()
+    , m_renderNs(0)
+{}
+
+void LLMMetrics::record(const Sample &sample)
+{
+    m_samples.append(sample);
+    if (m_samples.size() > MaxSamples) {
+        m_samples.removeFirst();
+    }
+
+    if (m_traceFile.isOpen()) {
+        m_traceFile.write(QJsonDocument(toJson(sample)).toJson(QJsonDocument::Compact) + '\n');
+        m_traceFile.flush();
+    }
+
+    emit sampleRecorded(sample);
+}
+
+bool LLMMetrics::setTraceFile(const QString &fileName)
+{
+    if (m_traceFile.isOpen()) {
+        m_traceFile.close();
+    }
+    if (fileName.isEmpty()) {
+        return true;
+    }
+
+    m_traceFile.setFileName(fileName);
+    if (!m_traceFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning().noquote() << "[LLMMetrics] Unable to open trace file:" << fileName << m_traceFile.errorString();
+        return false;
+    }
+    qDebug().noquote() << "[LLMMetrics] Tracing to" << fileName;
+    return true;
+}
+
+QJsonObject LLMMetrics::toJson(const Sample &sample)
+{
+    return QJsonObject{
+        {"id", QString::number(sample.id)},
+        {"connection", sample.connection},
+        {"model", sample.model},
+        {"started", QDateTime::fromMSecsSinceEpoch(sample.started).toString(Qt::ISODateWithMs)},
+        {"stream", sample.stream},
+        {"ok", sample.ok},
+        {"attempts", sample.attempts},
+        {"connectMs", sample.connectMs},
+        {"encryptedMs", sample.encryptedMs},
+        {"sentMs", sample.sentMs},
+        {"headersMs", sample.headersMs},
+        {"firstByteMs", sample.firstByteMs},
+        {"firstTokenMs", sample.firstTokenMs},
+        {"totalMs", sample.totalMs},
+        {"bytesSent", sample.bytesSent},
+        {"bytesReceived", sample.bytesReceived},
+        {"tokens", sample.tokens},
+        {"tokensPerSecond", sample.tokensPerSecond},
+        {"gapP50Ms", sample.gapP50Ms},
+        {"gapP95Ms", sample.gapP95Ms},
+        {"parseMs", sample.parseMs},
+        {"renderMs", sample.renderMs},
+    };
+}
+
+double LLMMetrics::percentile(QList<double> values, double p)
+{
+    if (values.isEmpty()) {
+        return -1;
+    }
+    const qsizetype rank = qBound<qsizetype>(0, qsizetype(p / 100.0 * values.size() + 0.5) - 1, values.size() - 1);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values.at(rank);
+}
+
+QString LLMMetrics::report() const
+{
+    QList<double> firstByte, firstToken, total, throughput, gaps, parse, render;
+    foreach (const Sample &s, m_samples) {
+        if (s.firstByteMs >= 0) {
+            firstByte.append(s.firstByteMs);
+        }
+        if (s.firstTokenMs >= 0) {
+            firstToken.append(s.firstTokenMs);
+        }
+        total.append(s.totalMs);
+        if (s.tokensPerSecond > 0) {
+            throughput.append(s.tokensPerSecond);
+        }
+        if (s.gapP95Ms >= 0) {
+            gaps.append(s.gapP95Ms);
+        }
+        parse.append(s.parseMs);
+        render.append(s.renderMs);
+    }
+
+    QStringList lines;
+    lines.append(QStringLiteral("%1 completions").arg(m_samples.size()));
+    const auto line = [&lines](const QString &name, const QList<double> &values, const QString &unit) {
+        if (!values.isEmpty()) {
+            lines.append(QStringLiteral("%1: p50 %2 %4, p95 %3 %4") //
+                             .arg(name)
+                             .arg(percentile(values, 50), 0, 'f', 1)
+                             .arg(percentile(values, 95), 0, 'f', 1)
+                             .arg(unit));
+        }
+    };
+    line(QStringLiteral("first byte"), firstByte, QStringLiteral("ms"));
+    line(QStringLiteral("first token"), firstToken, QStringLiteral("ms"));
+    line(QStringLiteral("total"), total, QStringLiteral("ms"));
+    line(QStringLiteral("throughput"), throughput, QStringLiteral("tok/s"));
+    line(QStringLiteral("token gap p95"), gaps, QStringLiteral("ms"));
+    line(QStringLiteral("parse"), parse, QStringLiteral("ms"));
+    line(QStringLiteral("render"), render, QStringLiteral("ms"));
+    return lines.join('\n');
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+/**
+ * @brief Timings of the completions sent by all chat clients.
+ *
+ * Every finished completion leaves one sample: the network phases taken
+ * from the reply signals, time to first byte and first token, the gaps
+ * between streamed content chunks, throughput, and the time spent parsing
+ * the response and rendering it in the chat. The last MaxSamples are kept
+ * in memory; with a trace file set, each sample is also appended to it as
+ * one JSON line for offline analysis.
+ *
+ * Used from the GUI thread only.
+ */
+class LLMMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Sample
+    {
+        quint64 id;
+        QString connection;
+        QString model;
+        qint64 started; // msecs since epoch
+        bool stream;
+        bool ok;
+        int attempts; // retries before this answer
+        // msecs since the request was sent, -1 if not seen, e.g. the
+        // connect phases on a reused connection
+        qint64 connectMs; // socket connecting, after queueing and DNS lookup
+        qint64 encryptedMs; // TLS handshake done
+        qint64 sentMs;      // request uploaded
+        qint64 headersMs;   // response headers
+        qint64 firstByteMs;
+        qint64 firstTokenMs;
+        qint64 totalMs;
+        qint64 bytesSent;
+        qint64 bytesReceived;
+        int tokens;
+        double tokensPerSecond; // after the first token
+        // gaps between content chunks of a stream
+        double gapP50Ms;
+        double gapP95Ms;
+        double parseMs;
+        double renderMs;
+    };
+
+    // Samples kept in memory
+    static constexpr int MaxSamples = 256;
+
+    static LLMMetrics *instance();
+
+    void record(const Sample &sample);
+    inline const QList<Sample> &samples() const { return m_samples; }
+    // Percentiles of the kept samples, e.g. for the debug log
+    QString report() const;
+
+    /**
+     * @brief setTraceFile Appends every sample as a JSON line to a file
+     * @param fileName Trace file, empty to stop tracing
+     * @return true if the file is open or tracing was stopped
+     */
+    bool setTraceFile(const QString &fileName);
+    inline QString traceFile() const { return m_traceFile.fileName(); }
+
+    // Time the chat views spend rendering, added by the views
+    inline void addRenderTime(qint64 nsecs) { m_renderNs += nsecs; }
+    inline qint64 renderTime() const { return m_renderNs; }
+
+    static QJsonObject toJson(const Sample &sample);
+    // Nearest rank percentile, p in 0..100, -1 for no values
+    static double percentile(QList<double> values, double p);
+
+signals:
+    void sampleRecorded(const LLMMetrics::Sample &sample);
+
+private:
+    QList<Sample> m_samples;
+    QFile m_traceFile;
+    qint64 m_renderNs;
+
+private:
+    explicit LLMMetrics(QObject *parent = nullptr);
+};
@@ -0,0 +1,154 @@
+#include <llmrecorder.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+static LLMRecorder *s_instance = nullptr;
+
+LLMRecorder *LLMRecorder::instance()
+{
+    if (!s_instance) {
+        s_instance = new LLMRecorder(qApp);
+    }
+    return s_instance;
+}
+
+LLMRecorder::LLMRecorder(QObject *parent)
+    : QObject{parent}
+    , m_file()
+    , m_count(0)
+{}
+
+bool LLMRecorder::setFile(const QString &fileName)
+{
+    if (m_file.isOpen()) {
+        qDebug().noquote() << "[LLMRecorder] Recorded" << m_count << "exchanges to" << m_file.fileName();
+        m_file.close();
+    }
+    m_count = 0;
+    if (fileName.isEmpty()) {
+        return true;
+    }
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning().noquote() << "[LLMRecorder] Unable to open record file:" << fileName << m_file.errorString();
+        return false;
+    }
+    qDebug().noquote() << "[LLMRecorder] Recording to" << fileName;
+    return true;
+}
+
+void LLMRecorder::record(const Exchange &exchange)
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    m_file.write(QJsonDocument(toJson(exchange)).toJson(QJsonDocument::Compact) + '\n');
+    m_file.flush();
+    m_count++;
+}
+
+// Text if the bytes are valid UTF-8, base64 otherwise
+static inline void writeBytes(QJsonObject &json, const QByteArray &bytes)
+{
+    const QString text = QString::fromUtf8(bytes);
+    if (text.toUtf8() == bytes) {
+        json["data"] = text;
+    } else {
+        json["base64"] = QString::fromLatin1(bytes.toBase64());
+    }
+}
+
+static inline QByteArray readBytes(const QJsonObject &json)
+{
+    if (json.contains("base64")) {
+        return QByteArray::fromBase64(json["base64"].toString().toLatin1());
+    }
+    return json["data"].toString().toUtf8();
+}
+
+QJsonObject LLMRecorder::toJson(const Exchange &exchange)
+{
+    QJsonObject request{
+        {"method", exchange.method},
+        {"path", exchange.path},
+    };
+    writeBytes(request, exchange.request);
+
+    QJsonArray chunks;
+    for (int i = 0; i < exchange.chunks.size(); i++) {
+        QJsonObject chunk{{"t", exchange.times.value(i)}};
+        writeBytes(chunk, exchange.chunks[i]);
+        chunks.append(chunk);
+    }
+
+    return QJsonObject{
+        {"started", exchange.started},
+        {"request", request},
+        {"response",
+         QJsonObject{
+             {"status", exchange.status},
+             {"contentType", exchange.contentType},
+             {"chunks", chunks},
+         }},
+    };
+}
+
+LLMRecorder::Exchange LLMRecorder::fromJson(const QJsonObject &json)
+{
+    const QJsonObject request = json["request"].toObject();
+    const QJsonObject response = json["response"].toObject();
+
+    Exchange exchange{
+        .method = request["method"].toString(),
+        .path = request["path"].toString(),
+        .request = readBytes(request),
+        .started = json["started"].toInteger(),
+        .status = response["status"].toInt(),
+        .contentType = response["contentType"].toString(),
+        .chunks = {},
+        .times = {},
+    };
+    foreach (const QJsonValue &value, response["chunks"].toArray()) {
+        const QJsonObject chunk = value.toObject();
+        exchange.chunks.append(readBytes(chunk));
+        exchange.times.append(chunk["t"].toInteger());
+    }
+    return exchange;
+}
+
+QList<LLMRecorder::Exchange> LLMRecorder::load(const QString &fileName, bool *ok)
+{
+    QList<Exchange> exchanges;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning().noquote() << "[LLMRecorder] Unable to read" << fileName << file.errorString();
+        if (ok) {
+            *ok = false;
+        }
+        return exchanges;
+    }
+
+    int line = 0;
+    while (!file.atEnd()) {
+        const QByteArray data = file.readLine().trimmed();
+        line++;
+        if (data.isEmpty()) {
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+        if (doc.isNull() || error.error != QJsonParseError::NoError) {
+            qWarning().noquote() << "[LLMRecorder]" << fileName << "line" << line << error.errorString();
+            continue;
+        }
+        exchanges.append(fromJson(doc.object()));
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+    return exchanges;
+}
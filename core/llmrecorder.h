@@ -0,0 +1,69 @@
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+/**
+ * @brief Records LLM traffic for offline replay.
+ *
+ * While a record file is set, every request sent by a chat client is
+ * written with its response as one JSON line: method, path and raw
+ * request body, then status, content type and the response bytes in the
+ * chunks and at the times they arrived. The request body is recorded as
+ * uploaded, with the attachments streamed from disk spliced in, so the
+ * replay matches it. ReplayServer serves such a file from localhost.
+ *
+ * Used from the GUI thread only.
+ */
+class LLMRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // One request and its response as received
+    struct Exchange
+    {
+        QString method;
+        QString path;
+        QByteArray request;
+        qint64 started; // msecs since epoch
+        int status;
+        QString contentType;
+        // response bytes and their arrival in msecs since sent
+        QList<QByteArray> chunks;
+        QList<qint64> times;
+    };
+
+    static LLMRecorder *instance();
+
+    /**
+     * @brief setFile Appends the exchanges to a file
+     * @param fileName Record file, empty to stop recording
+     * @return true if the file is open or recording was stopped
+     */
+    bool setFile(const QString &fileName);
+    inline bool isRecording() const { return m_file.isOpen(); }
+    inline QString fileName() const { return m_file.fileName(); }
+
+    void record(const Exchange &exchange);
+
+    static QJsonObject toJson(const Exchange &exchange);
+    static Exchange fromJson(const QJsonObject &json);
+    /**
+     * @brief load Reads a record file
+     * @param fileName Record file
+     * @param ok Set to false if the file cannot be read
+     * @return Exchanges in recorded order, invalid lines are skipped
+     */
+    static QList<Exchange> load(const QString &fileName, bool *ok = nullptr);
+
+private:
+    QFile m_file;
+    int m_count;
+
+private:
+    explicit LLMRecorder(QObject *parent = nullptr);
+};
@@ -0,0 +1,202 @@
+#include <llmconnectionmodel.h>
+#include <llmtransport.h>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QSslConfiguration>
+#include <QStringList>
+#include <QUrl>
+
+static LLMTransport *s_instance = nullptr;
+
+LLMTransport *LLMTransport::instance()
+{
+    if (!s_instance) {
+        s_instance = new LLMTransport(qApp);
+    }
+    return s_instance;
+}
+
+LLMTransport::LLMTransport(QObject *parent)
+    : QObject{parent}
+    , m_pools()
+    , m_failureThreshold(FailureThreshold)
+    , m_openInterval(OpenInterval)
+{}
+
+void LLMTransport::setCircuitPolicy(int failureThreshold, qint64 openInterval)
+{
+    m_failureThreshold = qMax(1, failureThreshold);
+    m_openInterval = qMax<qint64>(0, openInterval);
+}
+
+QString LLMTransport::poolKey(const LLMConnection *connection)
+{
+    if (!connection) {
+        return QString();
+    }
+    // one pool per connection and server origin
+    const QUrl origin = QUrl(connection->apiUrl()).adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment);
+    return connection->name() + QChar('|') + origin.toString();
+}
+
+inline LLMTransport::Pool &LLMTransport::pool(const LLMConnection *connection)
+{
+    const QString key = poolKey(connection);
+    auto it = m_pools.find(key);
+    if (it == m_pools.end()) {
+        QNetworkAccessManager *manager = new QNetworkAccessManager(this);
+        it = m_pools.insert(key, {manager, Stats{0, 0, 0, 0, 0, 0, 0}, 0, 0, 0, false, QStringList()});
+        qDebug().noquote() << "[LLMTransport] New pool:" << key;
+    }
+    return it.value();
+}
+
+QNetworkAccessManager *LLMTransport::manager(const LLMConnection *connection)
+{
+    return pool(connection).manager;
+}
+
+void LLMTransport::preconnect(const LLMConnection *connection)
+{
+    if (!connection || !connection->isValid()) {
+        return;
+    }
+
+    Pool &p = pool(connection);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - p.lastPreconnect < PreconnectInterval) {
+        return;
+    }
+    p.lastPreconnect = now;
+
+    const QUrl url(connection->apiUrl());
+    if (url.scheme() == QLatin1String("https")) {
+        // offer HTTP/2 in the handshake, the connection is reused by the first request
+        QSslConfiguration ssl = QSslConfiguration::defaultConfiguration();
+        ssl.setAllowedNextProtocols({QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1});
+        p.manager->connectToHostEncrypted(url.host(), url.port(443), ssl);
+    } else if (url.scheme() == QLatin1String("http")) {
+        p.manager->connectToHost(url.host(), url.port(80));
+    } else {
+        return;
+    }
+    p.stats.preconnects++;
+}
+
+void LLMTransport::prepare(QNetworkRequest &request) const
+{
+    // negotiated by ALPN, servers without HTTP/2 fall back to HTTP/1.1
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+}
+
+void LLMTransport::track(const LLMConnection *connection, QNetworkReply *reply)
+{
+    const QString key = poolKey(connection);
+    Pool &tracked = pool(connection);
+    tracked.stats.requests++;
+    tracked.stats.active++;
+
+    // half open, this reply closes or opens the circuit again
+    if (tracked.openUntil != 0 && !tracked.probing && QDateTime::currentMSecsSinceEpoch() >= tracked.openUntil) {
+        tracked.probing = true;
+        reply->setProperty("transportProbe", true);
+    }
+
+    connect(reply, &QNetworkReply::uploadProgress, this, [this, key, reply](qint64 sent, qint64) { //
+        const qint64 last = reply->property("transportSent").toLongLong();
+        m_pools[key].stats.bytesSent += sent - last;
+        reply->setProperty("transportSent", sent);
+    });
+    connect(reply, &QNetworkReply::downloadProgress, this, [this, key, reply](qint64 received, qint64) { //
+        const qint64 last = reply->property("transportReceived").toLongLong();
+        m_pools[key].stats.bytesReceived += received - last;
+        reply->setProperty("transportReceived", received);
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, key, reply]() {
+        Pool &p = m_pools[key];
+        p.stats.active--;
+        if (reply->error() != QNetworkReply::NoError) {
+            p.stats.failed++;
+        }
+        if (reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool()) {
+            p.stats.http2++;
+        }
+
+        // a probe ends with any result, a cancelled one lets the next request probe
+        if (reply->property("transportProbe").toBool()) {
+            p.probing = false;
+        }
+
+        // the server is in trouble, not the request; cancels do not count
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (!reply->property("cancelled").toBool()) {
+            const bool failed = (status == 0 && reply->error() != QNetworkReply::NoError) || status == 429 || status >= 500;
+            if (!failed) {
+                p.failures = 0;
+                p.openUntil = 0;
+            } else if (++p.failures >= m_failureThreshold) {
+                p.openUntil = QDateTime::currentMSecsSinceEpoch() + m_openInterval;
+                qWarning().noquote() << "[LLMTransport] Circuit open:" << key << "after" << p.failures << "failures";
+            }
+        }
+        emit statsChanged(key);
+    });
+}
+
+void LLMTransport::reset(const LLMConnection *connection)
+{
+    QNetworkAccessManager *manager = pool(connection).manager;
+    manager->clearAccessCache();
+    manager->clearConnectionCache();
+}
+
+bool LLMTransport::isAvailable(const LLMConnection *connection) const
+{
+    if (!connection) {
+        return false;
+    }
+
+    // the probe is claimed by the reply tracked next, a request that is
+    // never sent leaves the circuit as it is
+    const auto it = m_pools.constFind(poolKey(connection));
+    if (it == m_pools.constEnd() || it->openUntil == 0) {
+        return true;
+    }
+    return QDateTime::currentMSecsSinceEpoch() >= it->openUntil && !it->probing;
+}
+
+void LLMTransport::setModels(const LLMConnection *connection, const QStringList &models)
+{
+    pool(connection).models = models;
+}
+
+QStringList LLMTransport::models(const LLMConnection *connection) const
+{
+    return m_pools.value(poolKey(connection)).models;
+}
+
+LLMTransport::Stats LLMTransport::stats(const LLMConnection *connection) const
+{
+    const auto it = m_pools.constFind(poolKey(connection));
+    return (it == m_pools.constEnd() ? Stats{0, 0, 0, 0, 0, 0, 0} : it->stats);
+}
+
+QString LLMTransport::report() const
+{
+    QStringList lines;
+    for (auto it = m_pools.constBegin(); it != m_pools.constEnd(); ++it) {
+        const Stats &s = it->stats;
+        lines.append(QStringLiteral("%1: requests %2 (active %3, failed %4, http2 %5), preconnects %6, sent %7 bytes, received %8 bytes%9")
+                         .arg(it.key())
+                         .arg(s.requests)
+                         .arg(s.active)
+                         .arg(s.failed)
+                         .arg(s.http2)
+                         .arg(s.preconnects)
+                         .arg(s.bytesSent)
+                         .arg(s.bytesReceived)
+                         .arg(it->openUntil > 0 ? QStringLiteral(", circuit open") : QString()));
+    }
+    return lines.join('\n');
+}
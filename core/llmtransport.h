@@ -0,0 +1,115 @@
+#pragma once
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class LLMConnection;
+
+/**
+ * @brief Network access shared by all chat clients.
+ *
+ * One QNetworkAccessManager per LLM connection, so every chat panel talking
+ * to the same server reuses the same connection cache, DNS lookups and TLS
+ * sessions. Requests allow HTTP/2, which multiplexes concurrent chats over
+ * one connection when the server negotiates it over TLS. Opening a chat
+ * pre-connects to the server so the first request skips the handshake.
+ * Each server has a circuit breaker: after failureThreshold() failures in
+ * a row it counts as down for openInterval(), then one probe request
+ * decides.
+ *
+ * Used from the GUI thread only.
+ */
+class LLMTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats
+    {
+        int requests;
+        int active;
+        int failed;
+        int http2; // replies served over HTTP/2
+        int preconnects;
+        qint64 bytesSent;
+        qint64 bytesReceived;
+    };
+
+    // Skip pre-connects to the same server within this interval
+    static constexpr qint64 PreconnectInterval = 30000;
+    // Failures in a row that open the circuit of a server by default
+    static constexpr int FailureThreshold = 5;
+    // Time an open circuit rejects requests before a probe by default
+    static constexpr qint64 OpenInterval = 30000;
+
+    static LLMTransport *instance();
+
+    /**
+     * @brief setCircuitPolicy Configures the circuit breaker of all
+     * servers, circuits opened before keep their interval
+     * @param failureThreshold Failures in a row that open a circuit
+     * @param openInterval Msecs an open circuit rejects requests
+     */
+    void setCircuitPolicy(int failureThreshold, qint64 openInterval);
+    inline int failureThreshold() const { return m_failureThreshold; }
+    inline qint64 openInterval() const { return m_openInterval; }
+
+    // Manager of the connection, created on first use
+    QNetworkAccessManager *manager(const LLMConnection *connection);
+
+    // Opens a connection to the server ahead of the first request
+    void preconnect(const LLMConnection *connection);
+
+    // Sets the transport attributes of a request
+    void prepare(QNetworkRequest &request) const;
+
+    // Counts the reply in the statistics of its connection, the first
+    // reply after openInterval() is the probe of an open circuit
+    void track(const LLMConnection *connection, QNetworkReply *reply);
+
+    // Drops cached connections and credentials of one connection
+    void reset(const LLMConnection *connection);
+
+    // False while the circuit of the server is open or its probe runs,
+    // true once openInterval() has passed
+    bool isAvailable(const LLMConnection *connection) const;
+
+    // Model ids the server listed last
+    void setModels(const LLMConnection *connection, const QStringList &models);
+    QStringList models(const LLMConnection *connection) const;
+
+    // Connections with the same key share a pool and a circuit
+    static QString poolKey(const LLMConnection *connection);
+
+    Stats stats(const LLMConnection *connection) const;
+    // Statistics of all pools, e.g. for the debug log
+    QString report() const;
+
+signals:
+    void statsChanged(const QString &key);
+
+private:
+    struct Pool
+    {
+        QNetworkAccessManager *manager;
+        Stats stats;
+        qint64 lastPreconnect;
+        // circuit breaker
+        int failures; // in a row
+        qint64 openUntil;
+        bool probing;
+        QStringList models;
+    };
+
+    QHash<QString, Pool> m_pools;
+    int m_failureThreshold;
+    qint64 m_openInterval;
+
+private:
+    explicit LLMTransport(QObject *parent = nullptr);
+    inline Pool &pool(const LLMConnection *connection);
+};
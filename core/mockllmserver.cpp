@@ -0,0 +1,401 @@
+#include <mockllmserver.h>
+#include <QDateTime>
+#include <QDebug>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPointer>
+
+// Markdown mix of prose, lists and code, one token per entry
+static const QStringList s_words = {
+    "The", " stream", " carries", " a", " mixed", " answer", " with", " **bold**", " words", ",", " `inline", " code`", //
+    " and", " plain", " prose", ".", "\n\n", "-", " first", " item", "\n", "-", " second", " item", "\n\n",          //
+    "Numbers", " like", " 3.14", " and", " links", " to", " [docs](https://example.com)", " follow", ".", "\n",    //
+};
+
+static const QStringList s_code = {
+    "\n```cpp\n", "int", " main", "()", "\n{", "\n    ", "return", " 0", ";", "\n}", "\n```\n\n",
+};
+
+MockLLMServer::Options MockLLMServer::parse(const QString &spec, bool *ok)
+{
+    Options options;
+    bool valid = true;
+    foreach (const QString &pair, spec.split(',', Qt::SkipEmptyParts)) {
+        const QString key = pair.section('=', 0, 0).trimmed().toLower();
+        const QString value = pair.section('=', 1).trimmed();
+        bool number = true;
+        if (key == QStringLiteral("rate")) {
+            options.tokensPerSecond = qMax(1, value.toInt(&number));
+        } else if (key == QStringLiteral("tokens")) {
+            options.tokens = qMax(0, value.toInt(&number));
+        } else if (key == QStringLiteral("chunk")) {
+            options.chunkTokens = qMax(1, value.toInt(&number));
+        } else if (key == QStringLiteral("batch")) {
+            options.eventsPerWrite = qMax(1, value.toInt(&number));
+        } else if (key == QStringLiteral("tools")) {
+            options.toolCalls = (value.toInt(&number) != 0);
+        } else if (key == QStringLiteral("malformed")) {
+            options.malformedRate = qBound(0.0, value.toDouble(&number), 1.0);
+        } else if (key == QStringLiteral("stall")) {
+            options.stallMs = qMax(0, value.toInt(&number));
+        } else if (key == QStringLiteral("stallevery")) {
+            options.stallEvery = qMax(1, value.toInt(&number));
+        } else if (key == QStringLiteral("trickle")) {
+            options.trickle = (value.toInt(&number) != 0);
+        } else if (key == QStringLiteral("seed")) {
+            options.seed = value.toUInt(&number);
+        } else if (key == QStringLiteral("models")) {
+            options.models = value.split(':', Qt::SkipEmptyParts);
+        } else {
+            number = false;
+        }
+        if (!number) {
+            qWarning().noquote() << "[MockLLMServer] Invalid option:" << pair;
+            valid = false;
+        }
+    }
+    if (options.models.isEmpty()) {
+        options.models = Options().models;
+    }
+    if (ok) {
+        *ok = valid;
+    }
+    return options;
+}
+
+QList<QByteArray> MockLLMServer::answerEvents(const Options &options)
+{
+    const Stream stream{
+        .id = QStringLiteral("chatcmpl-mock-0"),
+        .model = options.models.value(0),
+        .tool = QString(),
+        .timer = QElapsedTimer(),
+        .sent = 0,
+        .events = 0,
+        .stalledUntil = 0,
+        .stalledMs = 0,
+    };
+
+    QList<QByteArray> events;
+    events.append(event(stream, QJsonObject{{"role", "assistant"}, {"content", ""}}, QJsonValue::Null));
+    for (int sent = 0; sent < options.tokens; sent += options.chunkTokens) {
+        QString content;
+        for (int i = sent; i < qMin(sent + options.chunkTokens, options.tokens); i++) {
+            content.append(token(i));
+        }
+        events.append(event(stream, QJsonObject{{"content", content}}, QJsonValue::Null));
+    }
+    events.append(event(stream, QJsonObject(), "stop"));
+    events.append(QByteArrayLiteral("data: [DONE]\n\n"));
+    return events;
+}
+
+MockLLMServer::MockLLMServer(QObject *parent)
+    : QObject{parent}
+    , m_server(new QTcpServer(this))
+    , m_ticker(new QTimer(this))
+    , m_options()
+    , m_random()
+    , m_buffers()
+    , m_streams()
+    , m_nextId(0)
+    , m_tokensSent(0)
+    , m_eventsSent(0)
+    , m_malformedSent(0)
+{
+    // pace all streams at a few milliseconds, events due in between are sent together
+    m_ticker->setInterval(5);
+    m_ticker->setTimerType(Qt::PreciseTimer);
+    connect(m_ticker, &QTimer::timeout, this, &MockLLMServer::onTick);
+    connect(m_server, &QTcpServer::newConnection, this, &MockLLMServer::onNewConnection);
+}
+
+bool MockLLMServer::listen(quint16 port)
+{
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning().noquote() << "[MockLLMServer] Unable to listen on port" << port << m_server->errorString();
+        return false;
+    }
+    m_random.seed(m_options.seed);
+    qDebug().noquote() << "[MockLLMServer] Listening on" << QStringLiteral("http://localhost:%1/").arg(m_server->serverPort()) //
+                       << "rate" << m_options.tokensPerSecond << "tok/s chunk" << m_options.chunkTokens                        //
+                       << "tools" << m_options.toolCalls << "malformed" << m_options.malformedRate << "stall" << m_options.stallMs;
+    return true;
+}
+
+void MockLLMServer::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        // no Nagle delay, tokens leave as they are written
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &MockLLMServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+        // not on disconnect, a write in onTick may report it
+        connect(socket, &QObject::destroyed, this, [this, socket]() { m_streams.remove(socket); });
+    }
+}
+
+void MockLLMServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket || !m_buffers.contains(socket)) {
+        return;
+    }
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+
+    // wait for the headers and the whole body
+    const qsizetype headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        return;
+    }
+    const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    qsizetype contentLength = 0;
+    for (int i = 1; i < lines.size(); i++) {
+        const QByteArray line = lines[i].trimmed();
+        if (line.toLower().startsWith("content-length:")) {
+            contentLength = line.mid(15).trimmed().toLongLong();
+        }
+    }
+    if (buffer.size() < headerEnd + 4 + contentLength) {
+        return;
+    }
+
+    const QByteArray method = requestLine.value(0);
+    const QByteArray path = requestLine.value(1).split('?').value(0);
+    const QJsonObject request = QJsonDocument::fromJson(buffer.mid(headerEnd + 4, contentLength)).object();
+    // one request per connection, the response ends with the connection
+    disconnect(socket, &QTcpSocket::readyRead, this, &MockLLMServer::onReadyRead);
+    m_buffers[socket].clear();
+
+    if (method == "GET" && path.endsWith("/models")) {
+        QJsonArray models;
+        foreach (const QString &model, m_options.models) {
+            models.append(QJsonObject{
+                {"id", model},
+                {"object", "model"},
+                {"owned_by", "mock"},
+            });
+        }
+        respond(socket, 200, "application/json", QJsonDocument(QJsonObject{{"object", "list"}, {"data", models}}).toJson(QJsonDocument::Compact));
+        return;
+    }
+    if (method != "POST" || !path.endsWith("/chat/completions")) {
+        respond(socket, 404, "application/json", QByteArrayLiteral("{\"error\":{\"message\":\"Unknown endpoint\"}}"));
+        return;
+    }
+
+    Stream stream{
+        .id = QStringLiteral("chatcmpl-mock-%1").arg(++m_nextId),
+        .model = request["model"].toString(m_options.models.first()),
+        .tool = QString(),
+        .timer = QElapsedTimer(),
+        .sent = 0,
+        .events = 0,
+        .stalledUntil = m_options.stallMs,
+        .stalledMs = m_options.stallMs,
+    };
+    // only tools the client offered can be called
+    if (m_options.toolCalls) {
+        stream.tool = request["tools"].toArray().at(0).toObject()["function"].toObject()["name"].toString();
+    }
+    stream.timer.start();
+
+    if (!request["stream"].toBool()) {
+        // whole answer after the time it would take to stream
+        QString content;
+        for (int i = 0; i < m_options.tokens; i++) {
+            content.append(token(i));
+        }
+        QJsonObject message{{"role", "assistant"}, {"content", content}};
+        if (!stream.tool.isEmpty()) {
+            message["tool_calls"] = QJsonArray{QJsonObject{
+                {"id", QStringLiteral("call_%1").arg(m_nextId)},
+                {"type", "function"},
+                {"function", QJsonObject{{"name", stream.tool}, {"arguments", "{\"query\":\"mock\"}"}}},
+            }};
+        }
+        const QByteArray body = QJsonDocument(QJsonObject{
+                                                  {"id", stream.id},
+                                                  {"object", "chat.completion"},
+                                                  {"created", QDateTime::currentSecsSinceEpoch()},
+                                                  {"model", stream.model},
+                                                  {"choices",
+                                                   QJsonArray{QJsonObject{
+                                                       {"index", 0},
+                                                       {"message", message},
+                                                       {"finish_reason", stream.tool.isEmpty() ? "stop" : "tool_calls"},
+                                                   }}},
+                                                  {"usage", QJsonObject{{"completion_tokens", m_options.tokens}}},
+                                              })
+                                    .toJson(QJsonDocument::Compact);
+        m_tokensSent += m_options.tokens;
+        QPointer<QTcpSocket> target(socket);
+        QTimer::singleShot(m_options.stallMs + qint64(m_options.tokens) * 1000 / m_options.tokensPerSecond, this, [this, target, body]() {
+            if (target) {
+                respond(target, 200, "application/json", body);
+            }
+        });
+        return;
+    }
+
+    write(socket, QByteArrayLiteral("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n"));
+    write(socket, event(stream, QJsonObject{{"role", "assistant"}, {"content", ""}}, QJsonValue::Null));
+    m_streams.insert(socket, stream);
+    if (!m_ticker->isActive()) {
+        m_ticker->start();
+    }
+}
+
+void MockLLMServer::onTick()
+{
+    QList<QTcpSocket *> finished;
+    for (auto it = m_streams.begin(); it != m_streams.end(); ++it) {
+        Stream &stream = it.value();
+        if (it.key()->state() != QAbstractSocket::ConnectedState) {
+            finished.append(it.key());
+            continue;
+        }
+        const qint64 elapsed = stream.timer.elapsed();
+        if (elapsed < stream.stalledUntil) {
+            continue;
+        }
+
+        const int due = int(qMin<qint64>(m_options.tokens, (elapsed - stream.stalledMs) * m_options.tokensPerSecond / 1000));
+        QByteArray batch;
+        int batched = 0;
+        while (stream.sent < m_options.tokens && (stream.sent + m_options.chunkTokens <= due || due == m_options.tokens)) {
+            const int count = qMin(m_options.chunkTokens, m_options.tokens - stream.sent);
+            QString content;
+            for (int i = 0; i < count; i++) {
+                content.append(token(stream.sent + i));
+            }
+            stream.sent += count;
+            stream.events++;
+            m_tokensSent += count;
+
+            QByteArray data = event(stream, QJsonObject{{"content", content}}, QJsonValue::Null);
+            if (m_options.malformedRate > 0 && m_random.generateDouble() < m_options.malformedRate) {
+                data = data.left(data.size() / 2) + "\n\n";
+                m_malformedSent++;
+            }
+            batch.append(data);
+            if (++batched >= m_options.eventsPerWrite) {
+                write(it.key(), batch);
+                batch.clear();
+                batched = 0;
+            }
+
+            // slow loris, keep the connection open without sending
+            if (m_options.stallMs > 0 && stream.events % m_options.stallEvery == 0) {
+                stream.stalledUntil = elapsed + m_options.stallMs;
+                stream.stalledMs += m_options.stallMs;
+                break;
+            }
+        }
+        if (!batch.isEmpty()) {
+            write(it.key(), batch);
+        }
+
+        if (stream.sent >= m_options.tokens) {
+            finish(it.key(), stream);
+            finished.append(it.key());
+        }
+    }
+
+    foreach (QTcpSocket *socket, finished) {
+        m_streams.remove(socket);
+        socket->disconnectFromHost();
+    }
+    if (m_streams.isEmpty()) {
+        m_ticker->stop();
+    }
+}
+
+inline void MockLLMServer::finish(QTcpSocket *socket, Stream &stream)
+{
+    if (!stream.tool.isEmpty()) {
+        const QString callId = QStringLiteral("call_%1").arg(stream.id.section('-', -1));
+        // name first, arguments in fragments as the OpenAI API sends them
+        write(socket,
+              event(stream,
+                    QJsonObject{{"tool_calls",
+                                 QJsonArray{QJsonObject{
+                                     {"index", 0},
+                                     {"id", callId},
+                                     {"type", "function"},
+                                     {"function", QJsonObject{{"name", stream.tool}, {"arguments", ""}}},
+                                 }}}},
+                    QJsonValue::Null));
+        foreach (const QString &fragment, QStringList({"{\"query\":", "\"mock\"}"})) {
+            write(socket,
+                  event(stream,
+                        QJsonObject{{"tool_calls",
+                                     QJsonArray{QJsonObject{
+                                         {"index", 0},
+                                         {"function", QJsonObject{{"arguments", fragment}}},
+                                     }}}},
+                        QJsonValue::Null));
+        }
+    }
+    write(socket, event(stream, QJsonObject(), stream.tool.isEmpty() ? "stop" : "tool_calls"));
+    write(socket, QByteArrayLiteral("data: [DONE]\n\n"));
+}
+
+inline QByteArray MockLLMServer::event(const Stream &stream, const QJsonObject &delta, const QJsonValue &finishReason)
+{
+    const QJsonObject chunk{
+        {"id", stream.id},
+        {"object", "chat.completion.chunk"},
+        {"created", QDateTime::currentSecsSinceEpoch()},
+        {"model", stream.model},
+        {"choices",
+         QJsonArray{QJsonObject{
+             {"index", 0},
+             {"delta", delta},
+             {"finish_reason", finishReason},
+         }}},
+    };
+    return "data: " + QJsonDocument(chunk).toJson(QJsonDocument::Compact) + "\n\n";
+}
+
+inline QString MockLLMServer::token(int index)
+{
+    // a code block every 200 tokens
+    const int position = index % 200;
+    if (position >= 100 && position < 100 + s_code.size()) {
+        return s_code[position - 100];
+    }
+    return s_words[index % s_words.size()];
+}
+
+inline void MockLLMServer::write(QTcpSocket *socket, const QByteArray &data)
+{
+    m_eventsSent += data.count("\n\n");
+    if (!m_options.trickle) {
+        socket->write(data);
+        return;
+    }
+    // every byte in its own segment, lines arrive split anywhere
+    for (qsizetype i = 0; i < data.size(); i++) {
+        socket->write(data.constData() + i, 1);
+        socket->flush();
+    }
+}
+
+inline void MockLLMServer::respond(QTcpSocket *socket, int status, const QByteArray &contentType, const QByteArray &body)
+{
+    write(socket, QStringLiteral("HTTP/1.1 %1 Mock\r\nContent-Type: %2\r\nContent-Length: %3\r\nConnection: close\r\n\r\n") //
+                      .arg(status)
+                      .arg(QString::fromLatin1(contentType))
+                      .arg(body.size())
+                      .toLatin1());
+    write(socket, body);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+/**
+ * @brief OpenAI compatible stub server for load and stress tests.
+ *
+ * Answers GET /v1/models with the configured model names and POST
+ * /v1/chat/completions with synthetic markdown, streamed as SSE at the
+ * configured token rate when the request asks for a stream. Tool calls,
+ * malformed events and slow-loris stalls can be mixed in to exercise the
+ * error paths of the client. Streams of all connections are paced by one
+ * timer, so hundreds of parallel requests cost a single wakeup per tick.
+ */
+class MockLLMServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr quint16 DefaultPort = 8090;
+
+    struct Options
+    {
+        int tokensPerSecond = 1000;
+        int tokens = 2000; // per answer
+        int chunkTokens = 1; // tokens per SSE event
+        int eventsPerWrite = 1; // SSE events per socket write
+        bool toolCalls = false; // end answers with a call of the first tool offered
+        double malformedRate = 0; // fraction of events cut in the middle of the JSON
+        int stallMs = 0; // slow-loris pause before the first and every stallEvery events
+        int stallEvery = 100;
+        bool trickle = false; // write responses byte by byte
+        quint32 seed = 1;
+        QStringList models = {QStringLiteral("mock-model")};
+    };
+
+    /**
+     * @brief parse Reads options from a "key=value,key=value" list
+     * @param spec rate, tokens, chunk, batch, tools, malformed, stall, stallevery, trickle, seed, models (separated by ':')
+     * @param ok Set to false on unknown keys or values
+     */
+    static Options parse(const QString &spec, bool *ok = nullptr);
+
+    // SSE events of one streamed text answer as the server sends them, without faults
+    static QList<QByteArray> answerEvents(const Options &options);
+
+    explicit MockLLMServer(QObject *parent = nullptr);
+
+    // 0 for any free port
+    bool listen(quint16 port = DefaultPort);
+    inline quint16 port() const { return m_server->serverPort(); }
+
+    inline void setOptions(const Options &options) { m_options = options; }
+    inline const Options &options() const { return m_options; }
+
+    // tokens and events sent, for the benchmark report
+    inline qint64 tokensSent() const { return m_tokensSent; }
+    inline qint64 eventsSent() const { return m_eventsSent; }
+    inline qint64 malformedSent() const { return m_malformedSent; }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onTick();
+
+private:
+    // answer being streamed on a connection
+    struct Stream
+    {
+        QString id;
+        QString model;
+        QString tool;
+        QElapsedTimer timer;
+        int sent; // tokens
+        int events;
+        qint64 stalledUntil; // msecs of timer
+        qint64 stalledMs; // not counted for the token rate
+    };
+
+    QTcpServer *m_server;
+    QTimer *m_ticker;
+    Options m_options;
+    QRandomGenerator m_random;
+    // incomplete requests per connection
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QHash<QTcpSocket *, Stream> m_streams;
+    quint64 m_nextId;
+    qint64 m_tokensSent;
+    qint64 m_eventsSent;
+    qint64 m_malformedSent;
+
+private:
+    inline void respond(QTcpSocket *socket, int status, const QByteArray &contentType, const QByteArray &body);
+    inline void write(QTcpSocket *socket, const QByteArray &data);
+    inline void finish(QTcpSocket *socket, Stream &stream);
+    static inline QByteArray event(const Stream &stream, const QJsonObject &delta, const QJsonValue &finishReason);
+    static inline QString token(int index);
+};
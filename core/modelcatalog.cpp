@@ -0,0 +1,197 @@
+#include <llmtransport.h>
+#include <modelcatalog.h>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+static ModelCatalog *s_instance = nullptr;
+
+ModelCatalog *ModelCatalog::instance()
+{
+    if (!s_instance) {
+        s_instance = new ModelCatalog(qApp);
+    }
+    return s_instance;
+}
+
+ModelCatalog::ModelCatalog(QObject *parent)
+    : QObject{parent}
+    , m_entries()
+    , m_fetching()
+    , m_ttl(DefaultTtl)
+    , m_persistent(false)
+    , m_fileName(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/model_catalog.json")
+{}
+
+QString ModelCatalog::key(const LLMConnection *connection)
+{
+    if (!connection) {
+        return QString();
+    }
+    // other keys may see other models, the key itself is not written to disk
+    const QByteArray apiKey = QCryptographicHash::hash(connection->apiKey().toUtf8(), QCryptographicHash::Sha256).toHex().left(16);
+    return LLMTransport::poolKey(connection) + QChar('|') + connection->endpointUri(LLMConnection::EndpointModels) + QChar('|') + QString::fromLatin1(apiKey);
+}
+
+bool ModelCatalog::models(const LLMConnection *connection, QJsonArray &models) const
+{
+    const auto it = m_entries.constFind(key(connection));
+    if (it == m_entries.constEnd()) {
+        return false;
+    }
+    models = it->models;
+    return true;
+}
+
+bool ModelCatalog::isFresh(const LLMConnection *connection) const
+{
+    const auto it = m_entries.constFind(key(connection));
+    return it != m_entries.constEnd() && QDateTime::currentMSecsSinceEpoch() - it->fetched < m_ttl;
+}
+
+bool ModelCatalog::beginFetch(const LLMConnection *connection)
+{
+    if (!connection || isFresh(connection)) {
+        return false;
+    }
+    const QString k = key(connection);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - m_fetching.value(k, 0) < FetchTimeout) {
+        return false;
+    }
+    m_fetching.insert(k, now);
+    return true;
+}
+
+void ModelCatalog::endFetch(const LLMConnection *connection)
+{
+    m_fetching.remove(key(connection));
+}
+
+void ModelCatalog::prepare(const LLMConnection *connection, QNetworkRequest &request) const
+{
+    const auto it = m_entries.constFind(key(connection));
+    if (it == m_entries.constEnd()) {
+        return;
+    }
+    if (!it->etag.isEmpty()) {
+        request.setRawHeader("If-None-Match", it->etag.toLatin1());
+    }
+    if (!it->lastModified.isEmpty()) {
+        request.setRawHeader("If-Modified-Since", it->lastModified.toLatin1());
+    }
+}
+
+void ModelCatalog::store(const LLMConnection *connection, const QJsonArray &models, const QString &etag, const QString &lastModified)
+{
+    const QString k = key(connection);
+    m_fetching.remove(k);
+    m_entries.insert(k,
+                     Entry{
+                         .models = models,
+                         .etag = etag,
+                         .lastModified = lastModified,
+                         .fetched = QDateTime::currentMSecsSinceEpoch(),
+                     });
+    qDebug().noquote() << "[ModelCatalog]" << k.section('|', 0, 1) << models.size() << "models" << (etag.isEmpty() ? QString() : etag);
+    emit modelsChanged(k, models);
+}
+
+void ModelCatalog::revalidated(const LLMConnection *connection)
+{
+    const QString k = key(connection);
+    m_fetching.remove(k);
+    auto it = m_entries.find(k);
+    if (it == m_entries.end()) {
+        return;
+    }
+    it->fetched = QDateTime::currentMSecsSinceEpoch();
+    qDebug().noquote() << "[ModelCatalog]" << k.section('|', 0, 1) << "not modified";
+    // clients waiting for the fetch still show the list once
+    emit modelsChanged(k, it->models);
+}
+
+QStringList ModelCatalog::modelIds(const QJsonArray &models)
+{
+    QStringList ids;
+    foreach (const QJsonValue &model, models) {
+        ids.append(model.toObject()["id"].toString());
+    }
+    return ids;
+}
+
+void ModelCatalog::setPersistent(bool persistent)
+{
+    if (persistent && !m_persistent) {
+        load();
+    } else if (!persistent && m_persistent) {
+        QFile::remove(m_fileName);
+    }
+    m_persistent = persistent;
+}
+
+inline void ModelCatalog::load()
+{
+    QFile file(m_fileName);
+    if (!file.exists()) {
+        return;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning().noquote() << "[ModelCatalog] Unable to open:" << m_fileName << file.errorString();
+        return;
+    }
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    foreach (const QJsonValue &value, root.value("entries").toArray()) {
+        const QJsonObject o = value.toObject();
+        const QString k = o.value("key").toString();
+        if (k.isEmpty() || m_entries.contains(k)) {
+            continue;
+        }
+        // the age is kept, an old list is shown and revalidated
+        m_entries.insert(k,
+                         Entry{
+                             .models = o.value("models").toArray(),
+                             .etag = o.value("etag").toString(),
+                             .lastModified = o.value("lastModified").toString(),
+                             .fetched = o.value("fetched").toInteger(),
+                         });
+    }
+
+    qDebug().noquote() << "[ModelCatalog] Loaded" << m_entries.size() << "model lists";
+}
+
+bool ModelCatalog::save() const
+{
+    if (!m_persistent) {
+        return false;
+    }
+
+    QJsonArray entries;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        entries.append(QJsonObject{
+            {"key", it.key()},
+            {"models", it->models},
+            {"etag", it->etag},
+            {"lastModified", it->lastModified},
+            {"fetched", it->fetched},
+        });
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning().noquote() << "[ModelCatalog] Unable to write:" << m_fileName << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{{"entries", entries}}).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <llmconnectionmodel.h>
+#include <QHash>
+#include <QJsonArray>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief Process-wide cache of the model lists of the LLM servers.
+ *
+ * Lists are keyed by connection: server origin, models endpoint and API
+ * key, so chats on the same server share one list and one request. A list
+ * younger than the TTL is used as is. An older one is still shown at once
+ * and revalidated in the background with If-None-Match or
+ * If-Modified-Since, so an unchanged list costs a 304 without a body. One
+ * request per key is in flight at a time, every client receives the
+ * result through modelsChanged. The lists can be persisted, a new chat
+ * then shows its models before the server answers.
+ *
+ * Used from the GUI thread only.
+ */
+class ModelCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry
+    {
+        QJsonArray models; // "data" of the /models response
+        QString etag;
+        QString lastModified;
+        qint64 fetched; // msecs since epoch of the last answer
+    };
+
+    static constexpr qint64 DefaultTtl = 5 * 60 * 1000;
+    // a fetch not ended by then is taken as lost
+    static constexpr qint64 FetchTimeout = 2 * 60 * 1000;
+
+    static ModelCatalog *instance();
+    static QString key(const LLMConnection *connection);
+
+    /**
+     * @brief models Returns the cached list of a connection
+     * @param connection Connection
+     * @param models Set to the list if one is cached
+     * @return true if a list is cached, fresh or not
+     */
+    bool models(const LLMConnection *connection, QJsonArray &models) const;
+    bool isFresh(const LLMConnection *connection) const;
+
+    /**
+     * @brief beginFetch Claims the request for the list of a connection
+     * @return false if a list is fresh or another client fetches it
+     */
+    bool beginFetch(const LLMConnection *connection);
+    void endFetch(const LLMConnection *connection);
+    // adds the validators of the cached list
+    void prepare(const LLMConnection *connection, QNetworkRequest &request) const;
+
+    // new list from the server
+    void store(const LLMConnection *connection, const QJsonArray &models, const QString &etag, const QString &lastModified);
+    // server answered 304, the cached list is fresh again
+    void revalidated(const LLMConnection *connection);
+
+    inline void setTtl(qint64 milliseconds) { m_ttl = qMax<qint64>(0, milliseconds); }
+    inline qint64 ttl() const { return m_ttl; }
+
+    /**
+     * @brief setPersistent Keeps the lists across restarts, loads the
+     * saved lists when enabled.
+     * @param persistent True to persist
+     */
+    void setPersistent(bool persistent);
+    inline bool isPersistent() const { return m_persistent; }
+
+    // Writes the lists if persistent
+    bool save() const;
+
+    // ids of a list, for failover lookups
+    static QStringList modelIds(const QJsonArray &models);
+
+signals:
+    void modelsChanged(const QString &key, const QJsonArray &models);
+
+private:
+    QHash<QString, Entry> m_entries;
+    // key -> msecs since epoch the fetch started
+    QHash<QString, qint64> m_fetching;
+    qint64 m_ttl;
+    bool m_persistent;
+    QString m_fileName;
+
+private:
+    explicit ModelCatalog(QObject *parent = nullptr);
+    inline void load();
+};
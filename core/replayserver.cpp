@@ -0,0 +1,170 @@
+#include <replayserver.h>
+#include <QDebug>
+#include <QHostAddress>
+#include <QPointer>
+#include <QTimer>
+
+ReplayServer::ReplayServer(QObject *parent)
+    : QObject{parent}
+    , m_server(new QTcpServer(this))
+    , m_exchanges()
+    , m_next()
+    , m_used()
+    , m_buffers()
+    , m_speed(1.0)
+{
+    connect(m_server, &QTcpServer::newConnection, this, &ReplayServer::onNewConnection);
+}
+
+bool ReplayServer::load(const QString &fileName)
+{
+    bool ok = false;
+    m_exchanges = LLMRecorder::load(fileName, &ok);
+    m_next.clear();
+    m_used.clear();
+    qDebug().noquote() << "[ReplayServer] Loaded" << m_exchanges.size() << "exchanges from" << fileName;
+    return ok && !m_exchanges.isEmpty();
+}
+
+bool ReplayServer::listen(quint16 port)
+{
+    // recorded traffic may hold keys or private code, never leave the host
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning().noquote() << "[ReplayServer] Unable to listen on port" << port << m_server->errorString();
+        return false;
+    }
+    qDebug().noquote() << "[ReplayServer] Listening on" << QStringLiteral("http://localhost:%1/").arg(m_server->serverPort()) //
+                       << "speed" << m_speed;
+    return true;
+}
+
+void ReplayServer::onNewConnection()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        m_buffers.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &ReplayServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void ReplayServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket || !m_buffers.contains(socket)) {
+        return;
+    }
+    QByteArray &buffer = m_buffers[socket];
+    buffer.append(socket->readAll());
+
+    // wait for the headers and the whole body
+    const qsizetype headerEnd = buffer.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        return;
+    }
+    const QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    qsizetype contentLength = 0;
+    for (int i = 1; i < lines.size(); i++) {
+        const QByteArray line = lines[i].trimmed();
+        if (line.toLower().startsWith("content-length:")) {
+            contentLength = line.mid(15).trimmed().toLongLong();
+        }
+    }
+    if (buffer.size() < headerEnd + 4 + contentLength) {
+        return;
+    }
+
+    const QString method = QString::fromLatin1(requestLine.value(0));
+    const QString path = QString::fromLatin1(requestLine.value(1));
+    const QByteArray body = buffer.mid(headerEnd + 4, contentLength);
+    // one request per connection, the response ends with the connection
+    disconnect(socket, &QTcpSocket::readyRead, this, &ReplayServer::onReadyRead);
+    m_buffers[socket].clear();
+
+    const int index = match(method, path, body);
+    qDebug().noquote() << "[ReplayServer]" << method << path << "->" << (index < 0 ? QStringLiteral("not recorded") : QString::number(index));
+    if (index < 0) {
+        respond(socket, 404, QByteArrayLiteral("{\"error\":{\"message\":\"No recorded exchange for this request\"}}"));
+        return;
+    }
+    respond(socket, m_exchanges[index]);
+}
+
+inline int ReplayServer::match(const QString &method, const QString &path, const QByteArray &body)
+{
+    // same request recorded, in recording order: a retry sends the body
+    // of the failed attempt again and gets the answer recorded after it
+    int last = -1;
+    for (int i = 0; i < m_exchanges.size(); i++) {
+        const LLMRecorder::Exchange &exchange = m_exchanges[i];
+        if (exchange.method == method && exchange.path == path && exchange.request == body) {
+            if (!m_used.contains(i)) {
+                m_used.insert(i);
+                return i;
+            }
+            last = i;
+        }
+    }
+    // all replayed, the final answer stands
+    if (last >= 0) {
+        return last;
+    }
+
+    // else the recorded answers of the path in turn
+    const QString key = method + QChar(' ') + path;
+    const int from = m_next.value(key);
+    for (int k = 0; k < m_exchanges.size(); k++) {
+        const int i = (from + k) % m_exchanges.size();
+        if (m_exchanges[i].method == method && m_exchanges[i].path == path) {
+            m_next[key] = i + 1;
+            m_used.insert(i);
+            return i;
+        }
+    }
+    return -1;
+}
+
+inline void ReplayServer::respond(QTcpSocket *socket, const LLMRecorder::Exchange &exchange)
+{
+    const QString contentType = (exchange.contentType.isEmpty() ? QStringLiteral("application/json") : exchange.contentType);
+    socket->write(QStringLiteral("HTTP/1.1 %1 Replay\r\nContent-Type: %2\r\nConnection: close\r\n\r\n") //
+                      .arg(exchange.status > 0 ? exchange.status : 200)
+                      .arg(contentType)
+                      .toLatin1());
+
+    // chunks at their recorded times, the response ends with the connection
+    QPointer<QTcpSocket> target(socket);
+    for (int i = 0; i < exchange.chunks.size(); i++) {
+        const QByteArray chunk = exchange.chunks[i];
+        const qint64 delay = (m_speed > 0 ? qint64(exchange.times.value(i) / m_speed) : 0);
+        if (delay <= 0) {
+            socket->write(chunk);
+            continue;
+        }
+        QTimer::singleShot(delay, socket, [target, chunk]() {
+            if (target) {
+                target->write(chunk);
+            }
+        });
+    }
+
+    const qint64 end = (m_speed > 0 && !exchange.times.isEmpty() ? qint64(exchange.times.last() / m_speed) : 0);
+    QTimer::singleShot(end, socket, [target]() {
+        if (target) {
+            target->disconnectFromHost();
+        }
+    });
+}
+
+inline void ReplayServer::respond(QTcpSocket *socket, int status, const QByteArray &body)
+{
+    socket->write(QStringLiteral("HTTP/1.1 %1 Replay\r\nContent-Type: application/json\r\nContent-Length: %2\r\nConnection: close\r\n\r\n") //
+                      .arg(status)
+                      .arg(body.size())
+                      .toLatin1());
+    socket->write(body);
+    socket->disconnectFromHost();
+}
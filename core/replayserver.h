@@ -0,0 +1,57 @@
+#pragma once
+#include <llmrecorder.h>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+/**
+ * @brief Serves recorded LLM traffic from localhost.
+ *
+ * Loads a file written by LLMRecorder and answers HTTP requests with the
+ * recorded responses, chunk by chunk at the recorded times divided by the
+ * speed factor. A request is answered by the next unused exchange with
+ * the same method, path and body, so a failed attempt and its retry are
+ * replayed in turn, else by the next exchange recorded for the path,
+ * so a client pointed at the server runs its parse, render and tool paths
+ * without a live model.
+ */
+class ReplayServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr quint16 DefaultPort = 8089;
+
+    explicit ReplayServer(QObject *parent = nullptr);
+
+    bool load(const QString &fileName);
+    bool listen(quint16 port = DefaultPort);
+    inline quint16 port() const { return m_server->serverPort(); }
+    inline int exchangeCount() const { return m_exchanges.size(); }
+
+    // 1 at recorded speed, 2 twice as fast, 0 without delays
+    inline void setSpeed(double speed) { m_speed = qMax(0.0, speed); }
+    inline double speed() const { return m_speed; }
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    QTcpServer *m_server;
+    QList<LLMRecorder::Exchange> m_exchanges;
+    // next exchange to replay per method and path
+    QHash<QString, int> m_next;
+    // exchanges replayed already, by index
+    QSet<int> m_used;
+    // incomplete requests per connection
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    double m_speed;
+
+private:
+    inline int match(const QString &method, const QString &path, const QByteArray &body);
+    inline void respond(QTcpSocket *socket, const LLMRecorder::Exchange &exchange);
+    inline void respond(QTcpSocket *socket, int status, const QByteArray &body);
+};
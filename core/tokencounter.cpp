@@ -0,0 +1,407 @@
+#include <llmchatclient.h>
+#include <tokencounter.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QVarLengthArray>
+#include <array>
+
+static constexpr quint32 s_noRank = 0xFFFFFFFFu;
+
+// Byte classes of the pre-tokenizer
+enum : quint8 {
+    ClassOther = 0,   // punctuation, stray continuation bytes
+    ClassLetter = 1,  // ASCII letters and UTF-8 lead bytes
+    ClassDigit = 2,   // 0-9
+    ClassSpace = 3,   // blank, tab, vertical tab, form feed
+    ClassNewline = 4, // CR, LF
+};
+
+static const std::array<quint8, 256> s_classes = []() {
+    std::array<quint8, 256> t{};
+    for (int c = 0; c < 256; c++) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0xC0) {
+            // non-ASCII text is mostly letters, close enough for counting
+            t[c] = ClassLetter;
+        } else if (c >= '0' && c <= '9') {
+            t[c] = ClassDigit;
+        } else if (c == ' ' || c == '\t' || c == '\v' || c == '\f') {
+            t[c] = ClassSpace;
+        } else if (c == '\r' || c == '\n') {
+            t[c] = ClassNewline;
+        } else {
+            t[c] = ClassOther;
+        }
+    }
+    return t;
+}();
+
+static inline quint32 hashBytes(const char *bytes, qsizetype length)
+{
+    // FNV-1a
+    quint32 hash = 2166136261u;
+    for (qsizetype i = 0; i < length; i++) {
+        hash = (hash ^ static_cast<quint8>(bytes[i])) * 16777619u;
+    }
+    return hash;
+}
+
+// 8 ASCII letters in a row, tested without branching per byte
+static inline bool isLetterWord(quint64 word)
+{
+    if (word & 0x8080808080808080ull) {
+        return false;
+    }
+    const quint64 folded = word | 0x2020202020202020ull;
+    // high bit set if byte >= 'a', respectively byte > 'z'
+    const quint64 atLeastA = folded + 0x1F1F1F1F1F1F1F1Full;
+    const quint64 aboveZ = folded + 0x0505050505050505ull;
+    return ((atLeastA & ~aboveZ) & 0x8080808080808080ull) == 0x8080808080808080ull;
+}
+
+static inline qsizetype nextChar(const quint8 *bytes, qsizetype length, qsizetype i)
+{
+    for (i++; i < length && (bytes[i] & 0xC0) == 0x80; i++) {
+    }
+    return i;
+}
+
+static inline qsizetype scanLetters(const quint8 *bytes, qsizetype length, qsizetype i)
+{
+    quint64 word;
+    while (i + 8 <= length) {
+        memcpy(&word, bytes + i, sizeof(word));
+        if (!isLetterWord(word)) {
+            break;
+        }
+        i += 8;
+    }
+    while (i < length && s_classes[bytes[i]] == ClassLetter) {
+        i = nextChar(bytes, length, i);
+    }
+    return i;
+}
+
+// Splits text like the cl100k pattern:
+// 's|'t|'re|'ve|'m|'ll|'d, [^\r\n\p{L}\p{N}]?\p{L}+, \p{N}{1,3},
+//  ?[^\s\p{L}\p{N}]+[\r\n]*, \s*[\r\n], \s+(?!\S), \s+
+template<typename Callback>
+static inline void pretokenize(const quint8 *bytes, qsizetype length, Callback &&callback)
+{
+    qsizetype i = 0;
+    while (i < length) {
+        const quint8 c = s_classes[bytes[i]];
+        qsizetype j = i;
+
+        // contractions
+        if (bytes[i] == '\'' && i + 1 < length) {
+            const quint8 c1 = bytes[i + 1] | 0x20;
+            const quint8 c2 = (i + 2 < length ? bytes[i + 2] | 0x20 : 0);
+            if (c1 == 's' || c1 == 'd' || c1 == 'm' || c1 == 't') {
+                j = i + 2;
+            } else if ((c1 == 'l' && c2 == 'l') || (c1 == 'v' && c2 == 'e') || (c1 == 'r' && c2 == 'e')) {
+                j = i + 3;
+            }
+            if (j > i) {
+                callback(i, j);
+                i = j;
+                continue;
+            }
+        }
+
+        if (c == ClassLetter) {
+            j = scanLetters(bytes, length, i);
+        } else if ((c == ClassOther || c == ClassSpace) && i + 1 < length && s_classes[bytes[i + 1]] == ClassLetter) {
+            // leading blank or punctuation belongs to the word
+            j = scanLetters(bytes, length, i + 1);
+        } else if (c == ClassDigit) {
+            for (int k = 0; j < length && k < 3 && s_classes[bytes[j]] == ClassDigit; j++, k++) {
+            }
+        } else if (c == ClassOther || (bytes[i] == ' ' && i + 1 < length && s_classes[bytes[i + 1]] == ClassOther)) {
+            j = (c == ClassOther ? i : i + 1);
+            while (j < length && s_classes[bytes[j]] == ClassOther) {
+                j++;
+            }
+            while (j < length && s_classes[bytes[j]] == ClassNewline) {
+                j++;
+            }
+        } else {
+            qsizetype newline = -1;
+            while (j < length && (s_classes[bytes[j]] == ClassSpace || s_classes[bytes[j]] == ClassNewline)) {
+                if (s_classes[bytes[j]] == ClassNewline) {
+                    newline = j;
+                }
+                j++;
+            }
+            if (newline >= 0) {
+                j = newline + 1;
+            } else if (j < length && j - i > 1) {
+                // last blank goes with the next word
+                j--;
+            }
+        }
+
+        callback(i, j);
+        i = j;
+    }
+}
+
+// ---------------------------------------------------------
+
+TokenCounter *TokenCounter::instance()
+{
+    static TokenCounter counter;
+    return &counter;
+}
+
+TokenCounter::TokenCounter()
+    : m_pool()
+    , m_table()
+    , m_mask(0)
+    , m_encoding()
+{
+    // cl100k matches the pre-tokenizer, o200k counts are close
+    const QStringList encodings = {
+        QStringLiteral("cl100k_base"),
+        QStringLiteral("o200k_base"),
+    };
+    foreach (const QString &encoding, encodings) {
+        const QString fileName = locate(encoding);
+        if (!fileName.isEmpty() && load(fileName)) {
+            return;
+        }
+    }
+
+    qDebug().noquote() << "[TokenCounter] No vocabulary found, estimating token counts.";
+}
+
+TokenCounter::TokenCounter(const QString &fileName)
+    : m_pool()
+    , m_table()
+    , m_mask(0)
+    , m_encoding()
+{
+    load(fileName);
+}
+
+QString TokenCounter::locate(const QString &encoding)
+{
+    const QString name = QStringLiteral("tokenizers/%1.tiktoken").arg(encoding);
+    const QString fileName = QStandardPaths::locate(QStandardPaths::AppDataLocation, name);
+    if (!fileName.isEmpty()) {
+        return fileName;
+    }
+    // shipped with the application
+    const QFileInfo shipped(QDir(QCoreApplication::applicationDirPath()).filePath(name));
+    return (shipped.isFile() ? shipped.absoluteFilePath() : QString());
+}
+
+QList<QByteArray> TokenCounter::pieces(const QByteArray &utf8)
+{
+    QList<QByteArray> pieces;
+    pretokenize(reinterpret_cast<const quint8 *>(utf8.constData()), utf8.size(), [&utf8, &pieces](qsizetype start, qsizetype end) { //
+        pieces.append(utf8.mid(start, end - start));
+    });
+    return pieces;
+}
+
+bool TokenCounter::load(const QString &fileName)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning().noquote() << "[TokenCounter] Unable to open:" << fileName << file.errorString();
+        return false;
+    }
+
+    const QByteArray data = file.readAll();
+    QByteArray pool;
+    QList<Entry> entries;
+    pool.reserve(data.size() / 2);
+    entries.reserve(data.count('\n') + 1);
+
+    qsizetype start = 0;
+    while (start < data.size()) {
+        qsizetype end = data.indexOf('\n', start);
+        if (end < 0) {
+            end = data.size();
+        }
+        const QByteArrayView line(data.constData() + start, end - start);
+        start = end + 1;
+
+        const qsizetype space = line.indexOf(' ');
+        if (space <= 0) {
+            continue;
+        }
+        bool ok = false;
+        const quint32 rank = line.mid(space + 1).trimmed().toUInt(&ok);
+        const QByteArray token = QByteArray::fromBase64(line.left(space).toByteArray());
+        if (!ok || token.isEmpty()) {
+            qWarning().noquote() << "[TokenCounter] Invalid vocabulary:" << fileName;
+            return false;
+        }
+
+        entries.append({
+            .offset = static_cast<quint32>(pool.size()),
+            .length = static_cast<quint32>(token.size()),
+            .rank = rank,
+            .hash = hashBytes(token.constData(), token.size()),
+        });
+        pool.append(token);
+    }
+
+    if (entries.isEmpty()) {
+        return false;
+    }
+
+    // load factor <= 0.5
+    quint32 size = 1;
+    while (size < entries.size() * 2) {
+        size <<= 1;
+    }
+    QList<Entry> table(size, Entry{0, 0, 0, 0});
+    const quint32 mask = size - 1;
+    foreach (const Entry &entry, entries) {
+        quint32 slot = entry.hash & mask;
+        while (table[slot].length != 0) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = entry;
+    }
+
+    m_pool = pool;
+    m_table = table;
+    m_mask = mask;
+    m_encoding = QFileInfo(fileName).completeBaseName();
+
+    qDebug().noquote() << "[TokenCounter] Loaded" << m_encoding << "with" << entries.size() //
+                       << "tokens in" << timer.elapsed() << "ms";
+    return true;
+}
+
+inline quint32 TokenCounter::rank(const char *bytes, qsizetype length) const
+{
+    const quint32 hash = hashBytes(bytes, length);
+    const Entry *table = m_table.constData();
+    const char *pool = m_pool.constData();
+
+    for (quint32 slot = hash & m_mask;; slot = (slot + 1) & m_mask) {
+        const Entry &entry = table[slot];
+        if (entry.length == 0) {
+            return s_noRank;
+        }
+        if (entry.hash == hash && entry.length == length && memcmp(pool + entry.offset, bytes, length) == 0) {
+            return entry.rank;
+        }
+    }
+}
+
+inline int TokenCounter::countPiece(const char *bytes, qsizetype length) const
+{
+    if (length == 1 || rank(bytes, length) != s_noRank) {
+        return 1;
+    }
+    if (length > MaxPieceLength) {
+        int tokens = 0;
+        for (qsizetype i = 0; i < length; i += MaxPieceLength) {
+            tokens += countPiece(bytes + i, qMin<qsizetype>(MaxPieceLength, length - i));
+        }
+        return tokens;
+    }
+
+    // byte pair merge: parts[i] starts a token, rank of merging it with the next one
+    struct Part
+    {
+        qsizetype start;
+        quint32 rank;
+    };
+    QVarLengthArray<Part, MaxPieceLength + 1> parts;
+    for (qsizetype i = 0; i <= length; i++) {
+        parts.append({i, s_noRank});
+    }
+
+    auto pairRank = [this, bytes, &parts](qsizetype i) -> quint32 {
+        if (i + 2 >= parts.size()) {
+            return s_noRank;
+        }
+        return rank(bytes + parts[i].start, parts[i + 2].start - parts[i].start);
+    };
+
+    for (qsizetype i = 0; i + 1 < parts.size(); i++) {
+        parts[i].rank = pairRank(i);
+    }
+
+    while (parts.size() > 2) {
+        qsizetype best = -1;
+        quint32 bestRank = s_noRank;
+        for (qsizetype i = 0; i + 1 < parts.size(); i++) {
+            if (parts[i].rank < bestRank) {
+                bestRank = parts[i].rank;
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        parts.remove(best + 1);
+        parts[best].rank = pairRank(best);
+        if (best > 0) {
+            parts[best - 1].rank = pairRank(best - 1);
+        }
+    }
+
+    return static_cast<int>(parts.size() - 1);
+}
+
+int TokenCounter::count(const char *utf8, qsizetype length) const
+{
+    if (!isLoaded()) {
+        return LLMChatClient::estimateTokens(QString::fromUtf8(utf8, length));
+    }
+
+    int tokens = 0;
+    pretokenize(reinterpret_cast<const quint8 *>(utf8), length, [this, utf8, &tokens](qsizetype start, qsizetype end) { //
+        tokens += countPiece(utf8 + start, end - start);
+    });
+    return tokens;
+}
+
+int TokenCounter::count(QStringView text) const
+{
+    if (!isLoaded()) {
+        return LLMChatClient::estimateTokens(text);
+    }
+    return count(text.toUtf8());
+}
+
+int TokenCounter::countFile(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    int tokens = 0;
+    QByteArray pending;
+    while (!file.atEnd()) {
+        pending.append(file.read(FileChunkSize));
+        // keep the last line for the next chunk, pieces never span lines
+        const qsizetype end = pending.lastIndexOf('\n');
+        if (end < 0 && pending.size() < FileChunkSize * 4) {
+            continue;
+        }
+        const qsizetype split = (end < 0 ? pending.size() : end + 1);
+        tokens += count(pending.constData(), split);
+        pending.remove(0, split);
+    }
+    tokens += count(pending);
+
+    return tokens;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+/**
+ * @brief Counts tokens like the BPE tokenizers of OpenAI compatible models.
+ *
+ * Loads a tiktoken vocabulary (lines of "<base64 token> <rank>", e.g.
+ * cl100k_base.tiktoken) into one byte pool with an open addressing hash
+ * table, so counting does not allocate per token. Text is split into
+ * pieces by a table driven pre-tokenizer following the cl100k pattern,
+ * ASCII words are scanned 8 bytes at a time. A piece found in the
+ * vocabulary is one token, others are merged pair by pair by rank.
+ *
+ * The shared counter loads the file set as "tokenizer/vocabulary" in the
+ * settings, else the first of cl100k_base and o200k_base found in the
+ * "tokenizers" directory of the application data or next to the
+ * executable. Without a vocabulary it falls back to
+ * LLMChatClient::estimateTokens().
+ */
+class TokenCounter
+{
+public:
+    // Longer pieces are counted in chunks, bounds the quadratic merge
+    static constexpr int MaxPieceLength = 256;
+    // Files are counted in chunks of this size
+    static constexpr qint64 FileChunkSize = 1024 * 1024;
+
+    static TokenCounter *instance();
+    // Counter of its own vocabulary, e.g. to compare encodings
+    explicit TokenCounter(const QString &fileName);
+
+    /**
+     * @brief locate Finds a vocabulary in the tokenizers directories
+     * @param encoding Vocabulary name, e.g. "cl100k_base"
+     * @return File name, empty if not found
+     */
+    static QString locate(const QString &encoding);
+    // Pieces of the pre-tokenizer, each is merged on its own
+    static QList<QByteArray> pieces(const QByteArray &utf8);
+
+    /**
+     * @brief load Loads a tiktoken vocabulary file
+     * @param fileName Vocabulary file
+     * @return true on success, the previous vocabulary is kept otherwise
+     */
+    bool load(const QString &fileName);
+
+    inline bool isLoaded() const { return !m_table.isEmpty(); }
+    // Vocabulary name, e.g. "cl100k_base", empty if estimating
+    inline const QString &encoding() const { return m_encoding; }
+
+    int count(const char *utf8, qsizetype length) const;
+    inline int count(const QByteArray &utf8) const { return count(utf8.constData(), utf8.size()); }
+    int count(QStringView text) const;
+    // Counts a file in chunks split at line ends, -1 if it cannot be read
+    int countFile(const QString &fileName) const;
+
+private:
+    struct Entry
+    {
+        quint32 offset;
+        quint32 length; // 0 marks an empty slot
+        quint32 rank;
+        quint32 hash;
+    };
+
+    QByteArray m_pool;
+    QList<Entry> m_table;
+    quint32 m_mask;
+    QString m_encoding;
+
+private:
+    TokenCounter();
+    inline quint32 rank(const char *bytes, qsizetype length) const;
+    inline int countPiece(const char *bytes, qsizetype length) const;
+};
@@ -1,4 +1,5 @@
 #include <toolservice.h>
+#include <tracebuffer.h>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
@@ -19,6 +20,8 @@ QJsonObject ToolService::execute(const ToolModel::ToolModelEntry &tool, const QS
                        << "method:" << tool.execMethod               //
                        << "name:" << tool.name                       //
                        << "args:" << arguments;
+    // runs on worker threads too when speculated
+    TraceScope scope(TraceBuffer::instance()->isEnabled() ? TraceBuffer::intern(tool.name) : "", "tool");
 
     QJsonObject args;
     if (!arguments.isEmpty()) {
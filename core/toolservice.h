@@ -9,6 +9,9 @@ class ToolService : public QObject
 public:
     explicit ToolService(QObject *parent = nullptr);
 
+    // Source files below a path, build output directories are skipped
+    QList<QFileInfo> findSourceFiles(const QString &strPath, const QStringList &strExtensions, bool bRecursive) const;
+
 public slots:
     /**
      * @brief Displays all source code files in the project
@@ -101,5 +104,4 @@ private:
     QJsonObject listDirectory(const ToolModel::ToolModelEntry &tool, const QJsonObject &args) const;
     QString createBackupPath(const QString &strOriginalPath) const;
     bool isValidPath(const QString &strPath) const;
-    QList<QFileInfo> findSourceFiles(const QString &strPath, const QStringList &strExtensions, bool bRecursive) const;
 };
@@ -0,0 +1,114 @@
+#include <toolservice.h>
+#include <toolspeculator.h>
+#include <QDebug>
+#include <QtConcurrent/QtConcurrent>
+
+static inline QString speculationKey(const QString &messageId, const QString &toolCallId)
+{
+    return messageId + QChar('/') + toolCallId;
+}
+
+ToolSpeculator::ToolSpeculator(ToolModel *toolModel, QObject *parent)
+    : QObject{parent}
+    , m_toolModel(toolModel)
+    , m_speculations()
+{}
+
+inline bool ToolSpeculator::canSpeculate(const ToolModel::ToolModelEntry &tool, const ToolCallEntry &toolCall) const
+{
+    // unknown, write or prompt/resource tools run only on request
+    if (tool.name.isEmpty() || !tool.readOnly) {
+        return false;
+    }
+    if (tool.type != ToolModel::ToolFunction || toolCall.toolType() != ToolCallEntry::Function) {
+        return false;
+    }
+    // user confirmation or disabled tool, never run ahead of time
+    return tool.option == ToolModel::ToolEnabled;
+}
+
+void ToolSpeculator::onToolCallCompleted(ChatMessage *message, const ToolCallEntry &toolCall)
+{
+    const QString messageId = message->id();
+    const QString key = speculationKey(messageId, toolCall.toolCallId());
+
+    if (m_speculations.contains(key)) {
+        return;
+    }
+
+    // results of older responses will never be confirmed
+    auto it = m_speculations.begin();
+    while (it != m_speculations.end()) {
+        if (it->messageId != messageId) {
+            it = m_speculations.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    const ToolModel::ToolModelEntry tool = m_toolModel->toolByName(toolCall.functionName());
+    if (!canSpeculate(tool, toolCall)) {
+        return;
+    }
+
+    qDebug().noquote() << "[ToolSpeculator] start msgId:" << messageId //
+                       << "id:" << toolCall.toolCallId()               //
+                       << "function:" << tool.name;
+
+    const QString arguments = toolCall.arguments();
+    Speculation speculation = {
+        .messageId = messageId,
+        .functionName = toolCall.functionName(),
+        .arguments = arguments,
+        .result = QtConcurrent::run([tool, arguments]() -> QJsonObject {
+            ToolService toolService;
+            return toolService.execute(tool, arguments);
+        }),
+    };
+    m_speculations.insert(key, speculation);
+}
+
+bool ToolSpeculator::take(const QString &messageId, const ToolCallEntry &toolCall, QJsonObject &result)
+{
+    const QString key = speculationKey(messageId, toolCall.toolCallId());
+
+    auto it = m_speculations.find(key);
+    if (it == m_speculations.end()) {
+        return false;
+    }
+
+    Speculation speculation = it.value();
+    m_speculations.erase(it);
+
+    // final call differs from what was speculated on
+    if (speculation.functionName != toolCall.functionName() || speculation.arguments != toolCall.arguments()) {
+        qDebug().noquote() << "[ToolSpeculator] discard msgId:" << messageId //
+                           << "id:" << toolCall.toolCallId();
+        return false;
+    }
+
+    // usually finished, otherwise wait for the remaining part
+    result = speculation.result.result();
+
+    qDebug().noquote() << "[ToolSpeculator] reuse msgId:" << messageId //
+                       << "id:" << toolCall.toolCallId();
+    return true;
+}
+
+void ToolSpeculator::discard(const QString &messageId)
+{
+    auto it = m_speculations.begin();
+    while (it != m_speculations.end()) {
+        if (it->messageId == messageId) {
+            it = m_speculations.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ToolSpeculator::clear()
+{
+    // running read-only tools finish in the pool, results are dropped
+    m_speculations.clear();
+}
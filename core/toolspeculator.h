@@ -0,0 +1,51 @@
+#pragma once
+#include <chatmessage.h>
+#include <toolmodel.h>
+#include <QFuture>
+#include <QHash>
+#include <QJsonObject>
+#include <QObject>
+
+/**
+ * @brief Runs read-only tools as soon as their streamed arguments are
+ * complete, while the LLM response is still arriving. The result is kept
+ * until the final 'tool_calls' asks for the very same call and discarded
+ * otherwise. Tools without readOnlyHint are never run speculatively.
+ */
+class ToolSpeculator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ToolSpeculator(ToolModel *toolModel, QObject *parent = nullptr);
+
+    /**
+     * @brief take Hands over the speculative result of a confirmed call
+     * @param messageId Id of the message holding the tool call
+     * @param toolCall Final tool call
+     * @param result Receives the tool result
+     * @return true if a matching speculative result was available
+     */
+    bool take(const QString &messageId, const ToolCallEntry &toolCall, QJsonObject &result);
+
+public slots:
+    void onToolCallCompleted(ChatMessage *message, const ToolCallEntry &toolCall);
+    void discard(const QString &messageId);
+    void clear();
+
+private:
+    struct Speculation
+    {
+        QString messageId;
+        QString functionName;
+        QString arguments;
+        QFuture<QJsonObject> result;
+    };
+
+    ToolModel *m_toolModel;
+    // message id + tool call id -> running or finished tool
+    QHash<QString, Speculation> m_speculations;
+
+private:
+    inline bool canSpeculate(const ToolModel::ToolModelEntry &tool, const ToolCallEntry &toolCall) const;
+};
@@ -0,0 +1,154 @@
+#include <tracebuffer.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+#include <chrono>
+
+TraceBuffer *TraceBuffer::instance()
+{
+    // never destroyed, worker threads may record until the process ends
+    static TraceBuffer *buffer = new TraceBuffer();
+    return buffer;
+}
+
+TraceBuffer::TraceBuffer()
+    : m_slots(new Slot[Capacity])
+    , m_next(0)
+    , m_enabled(false)
+{
+    for (quint64 i = 0; i < Capacity; i++) {
+        m_slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+qint64 TraceBuffer::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *TraceBuffer::intern(const QString &text)
+{
+    static QMutex mutex;
+    static QHash<QString, QByteArray> names;
+
+    QMutexLocker locker(&mutex);
+    auto it = names.constFind(text);
+    if (it == names.constEnd()) {
+        it = names.insert(text, text.toUtf8());
+    }
+    // the bytes stay put when the hash grows, only the QByteArray moves
+    return it->constData();
+}
+
+inline void TraceBuffer::append(char phase, const char *name, const char *category, qint64 timestampNs, qint64 durationNs, double value)
+{
+    const quint64 index = m_next.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = m_slots[index & (Capacity - 1)];
+
+    // seqlock: readers see 0 or a changed sequence while the fields change
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.timestampNs.store(timestampNs, std::memory_order_relaxed);
+    slot.durationNs.store(durationNs, std::memory_order_relaxed);
+    slot.value.store(value, std::memory_order_relaxed);
+    slot.thread.store(quint64(quintptr(QThread::currentThreadId())), std::memory_order_relaxed);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void TraceBuffer::complete(const char *name, const char *category, qint64 startNs, qint64 durationNs)
+{
+    if (isEnabled()) {
+        append('X', name, category, startNs, durationNs, 0);
+    }
+}
+
+void TraceBuffer::instant(const char *name, const char *category)
+{
+    if (isEnabled()) {
+        append('i', name, category, now(), 0, 0);
+    }
+}
+
+void TraceBuffer::counter(const char *name, const char *category, double value)
+{
+    if (isEnabled()) {
+        append('C', name, category, now(), 0, value);
+    }
+}
+
+QList<TraceBuffer::Event> TraceBuffer::events(qint64 sinceNs) const
+{
+    QList<Event> result;
+    const quint64 end = m_next.load(std::memory_order_acquire);
+    const quint64 begin = (end > Capacity ? end - Capacity : 0);
+    result.reserve(int(end - begin));
+
+    for (quint64 index = begin; index < end; index++) {
+        const Slot &slot = m_slots[index & (Capacity - 1)];
+        const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != index + 1) {
+            // being written, or already overwritten by a newer event
+            continue;
+        }
+        const Event event{
+            .name = slot.name.load(std::memory_order_relaxed),
+            .category = slot.category.load(std::memory_order_relaxed),
+            .timestampNs = slot.timestampNs.load(std::memory_order_relaxed),
+            .durationNs = slot.durationNs.load(std::memory_order_relaxed),
+            .value = slot.value.load(std::memory_order_relaxed),
+            .thread = slot.thread.load(std::memory_order_relaxed),
+            .phase = slot.phase.load(std::memory_order_relaxed),
+        };
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        if (event.timestampNs >= sinceNs) {
+            result.append(event);
+        }
+    }
+    return result;
+}
+
+bool TraceBuffer::writeChromeTrace(const QString &fileName) const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray traceEvents;
+    foreach (const Event &event, events()) {
+        // trace-event times are microseconds
+        QJsonObject json{
+            {"name", QString::fromUtf8(event.name)},
+            {"cat", QString::fromUtf8(event.category)},
+            {"ph", QString(QChar(event.phase))},
+            {"ts", event.timestampNs / 1000.0},
+            {"pid", pid},
+            {"tid", qint64(event.thread)},
+        };
+        if (event.phase == 'X') {
+            json["dur"] = event.durationNs / 1000.0;
+        } else if (event.phase == 'i') {
+            json["s"] = "t";
+        } else if (event.phase == 'C') {
+            json["args"] = QJsonObject{{"value", event.value}};
+        }
+        traceEvents.append(json);
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning().noquote() << "[TraceBuffer] Unable to write" << fileName << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(QJsonObject{{"traceEvents", traceEvents}, {"displayTimeUnit", "ms"}}).toJson(QJsonDocument::Compact));
+    qDebug().noquote() << "[TraceBuffer] Wrote" << traceEvents.size() << "events to" << fileName;
+    return true;
+}
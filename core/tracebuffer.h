@@ -0,0 +1,98 @@
+#pragma once
+#include <QList>
+#include <QString>
+#include <atomic>
+
+/**
+ * @brief Process-wide ring buffer of trace events.
+ *
+ * Keeps the last Capacity events: durations, instants and counter values
+ * with their thread. Writers claim a slot with one atomic increment and
+ * publish it with a sequence number, readers skip slots written while
+ * they copy, so any thread records without a lock and a full buffer
+ * overwrites its oldest events. Recording is off until enabled and then
+ * costs a few atomic stores per event. Names and categories must outlive
+ * the buffer: string literals, or intern() for runtime names.
+ *
+ * The events can be written in Chrome trace-event format for
+ * chrome://tracing or Perfetto.
+ */
+class TraceBuffer
+{
+public:
+    static constexpr quint64 Capacity = 1 << 15; // power of two
+
+    struct Event
+    {
+        const char *name;
+        const char *category;
+        qint64 timestampNs;
+        qint64 durationNs;
+        double value;
+        quint64 thread;
+        char phase; // 'X' complete, 'i' instant, 'C' counter
+    };
+
+    static TraceBuffer *instance();
+    // monotonic nanoseconds, the time base of all events
+    static qint64 now();
+    // stable copy of a runtime name, takes a lock on first use of the name
+    static const char *intern(const QString &text);
+
+    inline void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    inline bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    void complete(const char *name, const char *category, qint64 startNs, qint64 durationNs);
+    void instant(const char *name, const char *category);
+    void counter(const char *name, const char *category, double value);
+
+    // events recorded at or after the given time, oldest first
+    QList<Event> events(qint64 sinceNs = 0) const;
+    bool writeChromeTrace(const QString &fileName) const;
+
+private:
+    struct Slot
+    {
+        // index + 1 once published, 0 while being written
+        std::atomic<quint64> sequence;
+        std::atomic<const char *> name;
+        std::atomic<const char *> category;
+        std::atomic<qint64> timestampNs;
+        std::atomic<qint64> durationNs;
+        std::atomic<double> value;
+        std::atomic<quint64> thread;
+        std::atomic<char> phase;
+    };
+
+    Slot *m_slots;
+    std::atomic<quint64> m_next;
+    std::atomic<bool> m_enabled;
+
+private:
+    TraceBuffer();
+    inline void append(char phase, const char *name, const char *category, qint64 timestampNs, qint64 durationNs, double value);
+};
+
+/**
+ * @brief Records the lifetime of a scope as a complete event.
+ */
+class TraceScope
+{
+public:
+    inline TraceScope(const char *name, const char *category)
+        : m_name(name)
+        , m_category(category)
+        , m_start(TraceBuffer::instance()->isEnabled() ? TraceBuffer::now() : -1)
+    {}
+    inline ~TraceScope()
+    {
+        if (m_start >= 0) {
+            TraceBuffer::instance()->complete(m_name, m_category, m_start, TraceBuffer::now() - m_start);
+        }
+    }
+
+private:
+    const char *m_name;
+    const char *m_category;
+    qint64 m_start;
+};
@@ -0,0 +1,11 @@
+# Application, benchmarks and tests, eofaichat.pro alone builds the application
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    app \
+    benchmarks \
+    tests
+
+app.file = eofaichat.pro
+benchmarks.file = benchmarks/benchmarks.pro
+tests.file = tests/tests.pro
@@ -1,10 +1,17 @@
 #include <appbundle.h>
+#include <core/llmrecorder.h>
+#include <core/mockllmserver.h>
+#include <core/replayserver.h>
 #include <ui/mainwindow.h>
+#include <ui/streambenchmark.h>
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QFile>
+#include <QJsonDocument>
 #include <QLocale>
 #include <QProxyStyle>
 #include <QStyleFactory>
+#include <QTextStream>
 #include <QTranslator>
 
 class ApplicationStyle : public QProxyStyle
@@ -105,6 +112,60 @@ int main(int argc, char *argv[])
         }
     }
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QApplication::applicationDisplayName());
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption recordOption("record", "Record the LLM traffic to <file>.", "file");
+    const QCommandLineOption replayOption("replay-server", "Serve the LLM traffic recorded in <file> from localhost, no window.", "file");
+    const QCommandLineOption portOption("replay-port", "Port of the replay server.", "port", QString::number(ReplayServer::DefaultPort));
+    const QCommandLineOption speedOption("replay-speed", "Replay speed factor, 0 for no delays.", "factor", "1");
+    const QCommandLineOption mockOption("mock-server", "Serve mock OpenAI compatible answers from localhost, no window.");
+    const QCommandLineOption mockPortOption("mock-port", "Port of the mock server.", "port", QString::number(MockLLMServer::DefaultPort));
+    const QCommandLineOption mockOptionsOption("mock-options",
+                                               "Mock answers as key=value list: rate, tokens, chunk, batch, tools, malformed, stall, stallevery, trickle, seed, models.",
+                                               "options");
+    const QCommandLineOption benchmarkOption("stream-benchmark", "Stream <answers> mock answers through the chat view, print the results as JSON.", "answers");
+    parser.addOptions({recordOption, replayOption, portOption, speedOption, mockOption, mockPortOption, mockOptionsOption, benchmarkOption});
+    parser.process(a);
+
+    // offline benchmarks: one instance serves, another records or runs
+    if (parser.isSet(replayOption)) {
+        ReplayServer server;
+        server.setSpeed(parser.value(speedOption).toDouble());
+        if (!server.load(parser.value(replayOption)) || !server.listen(parser.value(portOption).toUShort())) {
+            return -1;
+        }
+        return a.exec();
+    }
+    bool mockOk = true;
+    const MockLLMServer::Options mockOptions = MockLLMServer::parse(parser.value(mockOptionsOption), &mockOk);
+    if (!mockOk) {
+        return -1;
+    }
+    if (parser.isSet(mockOption)) {
+        MockLLMServer server;
+        server.setOptions(mockOptions);
+        if (!server.listen(parser.value(mockPortOption).toUShort())) {
+            return -1;
+        }
+        return a.exec();
+    }
+    if (parser.isSet(benchmarkOption)) {
+        StreamBenchmark benchmark(mockOptions, parser.value(benchmarkOption).toInt());
+        QObject::connect(&benchmark, &StreamBenchmark::finished, &a, [](const QJsonObject &result) {
+            QTextStream(stdout) << QJsonDocument(result).toJson(QJsonDocument::Indented);
+            QApplication::exit(result["errors"].toInt() == 0 ? 0 : 1);
+        });
+        if (!benchmark.start()) {
+            return -1;
+        }
+        return a.exec();
+    }
+    if (parser.isSet(recordOption) && !LLMRecorder::instance()->setFile(parser.value(recordOption))) {
+        return -1;
+    }
+
     MainWindow window;
     window.show();
 
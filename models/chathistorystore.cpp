@@ -0,0 +1,614 @@
+#include <chathistorystore.h>
+#include <chatmessage.h>
+#include <QCborMap>
+#include <QCborValue>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtEndian>
+#include <array>
+
+static constexpr char s_magic[8] = {'E', 'O', 'F', 'C', 'H', 'L', 'O', 'G'};
+static constexpr char s_indexMagic[8] = {'E', 'O', 'F', 'C', 'H', 'I', 'D', 'X'};
+static constexpr qint64 s_headerSize = sizeof(s_magic) + sizeof(quint32);
+static constexpr qint64 s_recordHeaderSize = 2 * sizeof(quint32);
+// magic, version, covered log size, record count, message count
+static constexpr qint64 s_indexHeaderSize = sizeof(s_indexMagic) + sizeof(quint32) + 2 * sizeof(quint64) + sizeof(quint32);
+
+ChatHistoryStore::ChatHistoryStore(const QString &fileName, bool readOnly)
+    : m_file(fileName)
+    , m_recordCount(0)
+    , m_offsets()
+    , m_indexDirty(false)
+    , m_unindexedRecords(0)
+    , m_readOnly(readOnly)
+{}
+
+ChatHistoryStore::~ChatHistoryStore()
+{
+    close();
+}
+
+quint32 ChatHistoryStore::crc32(const char *data, qsizetype length, quint32 crc)
+{
+    // CRC-32 (IEEE 802.3), reflected polynomial
+    static const std::array<quint32, 256> table = []() {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (qsizetype i = 0; i < length; i++) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool ChatHistoryStore::open(QList<QJsonObject> *messages)
+{
+    if (m_file.isOpen()) {
+        return messages ? scan(messages) : true;
+    }
+
+    if (!m_file.open(m_readOnly ? QIODevice::ReadOnly : QIODevice::ReadWrite)) {
+        qWarning().noquote() << "[ChatHistoryStore] Unable to open:" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+
+    // header not written yet
+    if (m_file.size() == 0 && m_readOnly) {
+        m_recordCount = 0;
+        m_offsets.clear();
+        if (messages) {
+            messages->clear();
+        }
+        return true;
+    }
+
+    // new log
+    if (m_file.size() == 0) {
+        m_recordCount = 0;
+        m_offsets.clear();
+        m_indexDirty = true;
+        if (!writeHeader(&m_file) || !m_file.flush()) {
+            m_file.close();
+            return false;
+        }
+        if (messages) {
+            messages->clear();
+        }
+        return true;
+    }
+
+    // complete replay requested, rebuilds the offsets too
+    if (messages) {
+        if (!scan(messages)) {
+            m_file.close();
+            return false;
+        }
+        return true;
+    }
+
+    // offsets from index file, only records appended later are scanned
+    if (readIndex()) {
+        const qint64 covered = m_file.pos();
+        if (scan(nullptr, covered)) {
+            return true;
+        }
+        qWarning().noquote() << "[ChatHistoryStore] Stale index, rebuilding:" << indexFileName();
+    }
+
+    if (!scan(nullptr)) {
+        m_file.close();
+        return false;
+    }
+
+    return true;
+}
+
+void ChatHistoryStore::close()
+{
+    if (m_file.isOpen()) {
+        m_file.flush();
+        if (m_indexDirty && !m_readOnly && m_file.isWritable()) {
+            writeIndex();
+        }
+        m_file.close();
+    }
+}
+
+QString ChatHistoryStore::indexFileName() const
+{
+    QFileInfo fi(m_file.fileName());
+    return fi.absoluteDir().absoluteFilePath(fi.completeBaseName() + ".chatidx");
+}
+
+inline bool ChatHistoryStore::writeHeader(QIODevice *device) const
+{
+    char header[s_headerSize];
+    memcpy(header, s_magic, sizeof(s_magic));
+    qToLittleEndian<quint32>(Version, header + sizeof(s_magic));
+    return device->write(header, s_headerSize) == s_headerSize;
+}
+
+inline bool ChatHistoryStore::writeRecord(QIODevice *device, const Change &change) const
+{
+    QCborMap record;
+    record.insert(QStringLiteral("op"), static_cast<int>(change.op));
+    record.insert(QStringLiteral("index"), change.index);
+    if (change.op == Put) {
+        const QJsonObject message = (change.snapshot ? change.snapshot->toJson() : change.message);
+        record.insert(QStringLiteral("message"), QCborValue::fromJsonValue(message));
+    }
+
+    const QByteArray payload = QCborValue(record).toCbor();
+
+    char header[s_recordHeaderSize];
+    qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), header);
+    qToLittleEndian<quint32>(crc32(payload.constData(), payload.size()), header + sizeof(quint32));
+
+    // one write per record keeps a torn record at the very end only
+    QByteArray buffer;
+    buffer.reserve(s_recordHeaderSize + payload.size());
+    buffer.append(header, s_recordHeaderSize);
+    buffer.append(payload);
+
+    return device->write(buffer) == buffer.size();
+}
+
+inline bool ChatHistoryStore::decodeRecord(const QByteArray &payload, Change &change)
+{
+    QCborParserError error;
+    const QCborValue value = QCborValue::fromCbor(payload, &error);
+    if (error.error != QCborError::NoError || !value.isMap()) {
+        return false;
+    }
+
+    const QCborMap record = value.toMap();
+    change.op = static_cast<Operation>(record.value(QStringLiteral("op")).toInteger(-1));
+    change.index = static_cast<int>(record.value(QStringLiteral("index")).toInteger(-1));
+    if (change.index < 0) {
+        return false;
+    }
+
+    switch (change.op) {
+        case Put: {
+            change.message = record.value(QStringLiteral("message")).toJsonValue().toObject();
+            return true;
+        }
+        case Remove:
+        case Truncate: {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
+
+template<typename T>
+inline void ChatHistoryStore::replay(QList<T> &list, const Change &change, const T &value)
+{
+    switch (change.op) {
+        case Put: {
+            if (change.index < list.size()) {
+                list[change.index] = value;
+            } else {
+                // gaps are not expected, keep order anyway
+                list.append(value);
+            }
+            break;
+        }
+        case Remove: {
+            if (change.index < list.size()) {
+                list.removeAt(change.index);
+            }
+            break;
+        }
+        case Truncate: {
+            if (change.index < list.size()) {
+                list.resize(change.index);
+            }
+            break;
+        }
+    }
+}
+
+inline bool ChatHistoryStore::readRecord(qint64 position, Change &change)
+{
+    if (!m_file.seek(position)) {
+        return false;
+    }
+
+    char recordHeader[s_recordHeaderSize];
+    if (m_file.read(recordHeader, s_recordHeaderSize) != s_recordHeaderSize) {
+        return false;
+    }
+
+    const quint32 length = qFromLittleEndian<quint32>(recordHeader);
+    const quint32 checksum = qFromLittleEndian<quint32>(recordHeader + sizeof(quint32));
+    if (length == 0 || length > MaxRecordSize || position + s_recordHeaderSize + length > m_file.size()) {
+        return false;
+    }
+
+    const QByteArray payload = m_file.read(length);
+    if (payload.size() != static_cast<qsizetype>(length) || crc32(payload.constData(), payload.size()) != checksum) {
+        return false;
+    }
+
+    return decodeRecord(payload, change);
+}
+
+inline bool ChatHistoryStore::isPartialRecord(qint64 position)
+{
+    if (!m_file.seek(position)) {
+        return false;
+    }
+
+    char recordHeader[s_recordHeaderSize];
+    const qint64 read = m_file.read(recordHeader, s_recordHeaderSize);
+    if (read >= 0 && read < s_recordHeaderSize) {
+        return true;
+    }
+    const quint32 length = qFromLittleEndian<quint32>(recordHeader);
+    return read == s_recordHeaderSize && length > 0 && length <= MaxRecordSize && position + s_recordHeaderSize + length > m_file.size();
+}
+
+inline bool ChatHistoryStore::scan(QList<QJsonObject> *messages, qint64 from)
+{
+    QList<QJsonObject> replayed;
+
+    if (!m_file.seek(0)) {
+        return false;
+    }
+
+    const QByteArray header = m_file.read(s_headerSize);
+    if (header.size() != s_headerSize || memcmp(header.constData(), s_magic, sizeof(s_magic)) != 0) {
+        qWarning().noquote() << "[ChatHistoryStore] Not a chat history log:" << m_file.fileName();
+        return false;
+    }
+    if (qFromLittleEndian<quint32>(header.constData() + sizeof(s_magic)) > Version) {
+        qWarning().noquote() << "[ChatHistoryStore] Unsupported log version:" << m_file.fileName();
+        return false;
+    }
+
+    // continue behind the part covered by the index
+    const bool incremental = (from > s_headerSize && !messages);
+    if (!incremental) {
+        m_offsets.clear();
+        m_recordCount = 0;
+    }
+
+    const qint64 fileSize = m_file.size();
+    qint64 position = incremental ? from : s_headerSize;
+    qint64 records = 0;
+
+    while (position < fileSize) {
+        Change change;
+        if (!readRecord(position, change)) {
+            break;
+        }
+
+        if (messages) {
+            replay(replayed, change, change.message);
+        }
+        replay(m_offsets, change, position);
+        position = m_file.pos();
+        records++;
+    }
+
+    // index does not end on a record boundary of this log, unless a
+    // reader meets a record the writer is appending
+    if (incremental && records == 0 && position < fileSize && !(m_readOnly && isPartialRecord(position))) {
+        return false;
+    }
+
+    // cut off a torn or corrupt tail, everything before is consistent;
+    // read-only readers just stop there, the tail may still be written
+    if (position < fileSize && m_file.isWritable()) {
+        qWarning().noquote() << "[ChatHistoryStore] Truncating damaged tail of" << m_file.fileName() //
+                             << "at offset" << position << "of" << fileSize;
+        if (!m_file.resize(position)) {
+            qWarning().noquote() << "[ChatHistoryStore] Unable to truncate:" << m_file.errorString();
+            return false;
+        }
+    }
+
+    m_recordCount += records;
+    m_unindexedRecords = (incremental ? m_unindexedRecords + records : records);
+    if (!m_readOnly && (records > 0 || !incremental)) {
+        m_indexDirty = true;
+    }
+
+    if (messages) {
+        *messages = replayed;
+    }
+
+    return m_file.seek(position);
+}
+
+inline bool ChatHistoryStore::readIndex()
+{
+    QFile file(indexFileName());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray header = file.read(s_indexHeaderSize);
+    if (header.size() != s_indexHeaderSize || memcmp(header.constData(), s_indexMagic, sizeof(s_indexMagic)) != 0) {
+        return false;
+    }
+
+    const char *ptr = header.constData() + sizeof(s_indexMagic);
+    if (qFromLittleEndian<quint32>(ptr) != Version) {
+        return false;
+    }
+    ptr += sizeof(quint32);
+    const qint64 covered = static_cast<qint64>(qFromLittleEndian<quint64>(ptr));
+    ptr += sizeof(quint64);
+    const qint64 records = static_cast<qint64>(qFromLittleEndian<quint64>(ptr));
+    ptr += sizeof(quint64);
+    const quint32 count = qFromLittleEndian<quint32>(ptr);
+
+    // log was truncated or replaced behind our back
+    if (covered < s_headerSize || covered > m_file.size()) {
+        return false;
+    }
+
+    const QByteArray data = file.read(static_cast<qint64>(count) * sizeof(quint64));
+    if (data.size() != static_cast<qsizetype>(count * sizeof(quint64))) {
+        return false;
+    }
+
+    QList<qint64> offsets;
+    offsets.reserve(count);
+    for (quint32 i = 0; i < count; i++) {
+        const qint64 offset = static_cast<qint64>(qFromLittleEndian<quint64>(data.constData() + i * sizeof(quint64)));
+        if (offset < s_headerSize || offset >= covered) {
+            return false;
+        }
+        offsets.append(offset);
+    }
+
+    m_offsets = offsets;
+    m_recordCount = records;
+    m_indexDirty = false;
+    m_unindexedRecords = 0;
+
+    // scan() continues from here
+    return m_file.seek(covered);
+}
+
+inline bool ChatHistoryStore::writeIndex()
+{
+    QSaveFile file(indexFileName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning().noquote() << "[ChatHistoryStore] Unable to write index:" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QByteArray data(s_indexHeaderSize + m_offsets.size() * sizeof(quint64), Qt::Uninitialized);
+    char *ptr = data.data();
+    memcpy(ptr, s_indexMagic, sizeof(s_indexMagic));
+    ptr += sizeof(s_indexMagic);
+    qToLittleEndian<quint32>(Version, ptr);
+    ptr += sizeof(quint32);
+    qToLittleEndian<quint64>(static_cast<quint64>(m_file.size()), ptr);
+    ptr += sizeof(quint64);
+    qToLittleEndian<quint64>(static_cast<quint64>(m_recordCount), ptr);
+    ptr += sizeof(quint64);
+    qToLittleEndian<quint32>(static_cast<quint32>(m_offsets.size()), ptr);
+    ptr += sizeof(quint32);
+    foreach (qint64 offset, m_offsets) {
+        qToLittleEndian<quint64>(static_cast<quint64>(offset), ptr);
+        ptr += sizeof(quint64);
+    }
+
+    if (file.write(data) != data.size() || !file.commit()) {
+        return false;
+    }
+
+    m_indexDirty = false;
+    m_unindexedRecords = 0;
+    return true;
+}
+
+bool ChatHistoryStore::readMessages(int first, int count, QList<QJsonObject> &messages)
+{
+    if (!m_file.isOpen() && !open()) {
+        return false;
+    }
+    if (first < 0 || count < 0 || first + count > m_offsets.size()) {
+        return false;
+    }
+
+    messages.reserve(messages.size() + count);
+    for (int i = first; i < first + count; i++) {
+        Change change;
+        if (!readRecord(m_offsets[i], change) || change.op != Put) {
+            qWarning().noquote() << "[ChatHistoryStore] Invalid record for message" << i << "in" << m_file.fileName();
+            return false;
+        }
+        messages.append(change.message);
+    }
+
+    return true;
+}
+
+bool ChatHistoryStore::load(QList<QJsonObject> &messages)
+{
+    if (!m_file.isOpen()) {
+        return open(&messages);
+    }
+    return scan(&messages);
+}
+
+bool ChatHistoryStore::readAll(const QString &fileName, QList<QJsonObject> &messages)
+{
+    ChatHistoryStore store(fileName);
+    if (!store.m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return store.scan(&messages);
+}
+
+bool ChatHistoryStore::apply(const QList<Change> &changes)
+{
+    if (m_readOnly || (!m_file.isOpen() && !open())) {
+        return false;
+    }
+    if (changes.isEmpty()) {
+        return true;
+    }
+
+    // a failed write is cut off again, later records must not follow garbage
+    const qint64 size = m_file.size();
+    const QList<qint64> offsets = m_offsets;
+    const qint64 records = m_recordCount;
+    const qint64 unindexed = m_unindexedRecords;
+    auto rollback = [this, size, &offsets, records, unindexed]() {
+        qWarning().noquote() << "[ChatHistoryStore] Write failed:" << m_file.fileName() << m_file.errorString();
+        m_file.resize(size);
+        m_file.seek(size);
+        m_offsets = offsets;
+        m_recordCount = records;
+        m_unindexedRecords = unindexed;
+        return false;
+    };
+
+    if (!m_file.seek(size)) {
+        return false;
+    }
+
+    foreach (const Change &change, changes) {
+        const qint64 position = m_file.pos();
+        if (!writeRecord(&m_file, change)) {
+            return rollback();
+        }
+        replay(m_offsets, change, position);
+        m_recordCount++;
+        m_unindexedRecords++;
+    }
+
+    if (!m_file.flush()) {
+        return rollback();
+    }
+    m_indexDirty = true;
+
+    if (needsCompaction()) {
+        return compact();
+    }
+
+    // reopening scans the records behind the index only
+    if (m_unindexedRecords >= IndexInterval) {
+        writeIndex();
+    }
+
+    return true;
+}
+
+bool ChatHistoryStore::needsCompaction() const
+{
+    return m_recordCount > CompactionRatio * qMax<qint64>(m_offsets.size(), 16);
+}
+
+bool ChatHistoryStore::compact()
+{
+    if (m_readOnly) {
+        return false;
+    }
+
+    QList<QJsonObject> messages;
+    if (!load(messages)) {
+        return false;
+    }
+
+    QSaveFile file(m_file.fileName());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning().noquote() << "[ChatHistoryStore] Unable to compact:" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    bool success = writeHeader(&file);
+    for (int i = 0; success && i < messages.size(); i++) {
+        success = writeRecord(&file, {Put, i, messages[i]});
+    }
+    if (!success) {
+        file.cancelWriting();
+        return false;
+    }
+
+    // release our handle before the new file replaces it,
+    // offsets of the old log must not survive
+    m_indexDirty = false;
+    close();
+    QFile::remove(indexFileName());
+    if (!file.commit()) {
+        qWarning().noquote() << "[ChatHistoryStore] Compaction failed:" << file.fileName() << file.errorString();
+        return open();
+    }
+
+    qDebug().noquote() << "[ChatHistoryStore] Compacted" << m_recordCount << "records to" << messages.size();
+
+    if (!open()) {
+        return false;
+    }
+    // offsets of the new log for the next reopen
+    writeIndex();
+    return true;
+}
+
+bool ChatHistoryStore::importJson(const QString &jsonFile, const QString &logFile)
+{
+    QFile file(jsonFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "[ChatHistoryStore] Failed to open file for reading:" << jsonFile;
+        return false;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    file.close();
+    if (doc.isNull() || !doc.isObject()) {
+        qWarning() << "[ChatHistoryStore] Invalid JSON in file:" << jsonFile << error.errorString();
+        return false;
+    }
+
+    const QJsonArray messages = doc.object()["messages"].toArray();
+
+    ChatHistoryStore store(logFile);
+    QSaveFile target(logFile);
+    if (!target.open(QIODevice::WriteOnly)) {
+        qWarning() << "[ChatHistoryStore] Failed to open file for writing:" << logFile;
+        return false;
+    }
+
+    bool success = store.writeHeader(&target);
+    int index = 0;
+    for (const QJsonValue &value : messages) {
+        if (!success) {
+            break;
+        }
+        if (value.isObject()) {
+            success = store.writeRecord(&target, {Put, index++, value.toObject()});
+        }
+    }
+
+    if (!success) {
+        target.cancelWriting();
+        return false;
+    }
+
+    QFile::remove(store.indexFileName());
+    return target.commit();
+}
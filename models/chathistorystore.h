@@ -0,0 +1,161 @@
+#ifndef CHATHISTORYSTORE_H
+#define CHATHISTORYSTORE_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+class ChatMessage;
+
+/**
+ * @brief Append-only chat history log.
+ *
+ * File layout: 8 byte magic and a 32 bit version, followed by records of
+ * [u32 payload length][u32 CRC-32 of payload][CBOR payload], all little
+ * endian. A payload is a CBOR map with the operation, the absolute message
+ * index and (for Put) the message in ChatMessage::toJson() layout.
+ *
+ * Saving a conversation only appends the changed messages. A torn record
+ * at the end of the file (crash while writing) is cut off on open, and the
+ * log is compacted into one Put per message once it holds mostly
+ * superseded records.
+ *
+ * An offset index (.chatidx) next to the log maps each message to its
+ * latest Put record, so single pages of a long history can be read without
+ * replaying the log. The index stores the log size it covers; records
+ * appended after that are scanned on open, a shorter log forces a rebuild.
+ * A writing store rewrites the index every IndexInterval records and after
+ * compaction, so reopening a long log scans a short tail only. Read-only
+ * stores never mark the index dirty and accept a record the writer has not
+ * finished as the end of the log.
+ */
+class ChatHistoryStore
+{
+public:
+    enum Operation {
+        Put = 0,      // insert or replace message at index
+        Remove = 1,   // remove message at index
+        Truncate = 2, // keep the first 'index' messages
+    };
+
+    struct Change
+    {
+        Operation op;
+        int index;
+        QJsonObject message;
+        // copy-on-write message copy, serialized when the record is written
+        QSharedPointer<const ChatMessage> snapshot;
+    };
+
+    static constexpr quint32 Version = 1;
+    // Records larger than this are treated as corruption
+    static constexpr quint32 MaxRecordSize = 64 * 1024 * 1024;
+    // Compact if the log holds that many records per live message
+    static constexpr int CompactionRatio = 4;
+    // The index is written after that many appended records
+    static constexpr int IndexInterval = 256;
+
+    /**
+     * @brief ChatHistoryStore
+     * @param fileName Log file
+     * @param readOnly Never writes the log or its index, for readers of a
+     * log another store appends to
+     */
+    explicit ChatHistoryStore(const QString &fileName, bool readOnly = false);
+    ~ChatHistoryStore();
+
+    /**
+     * @brief open Opens or creates the log, validates all records and
+     * truncates a torn tail.
+     * @param messages Receives the replayed messages if not null
+     * @return true on success
+     */
+    bool open(QList<QJsonObject> *messages = nullptr);
+    void close();
+    inline bool isOpen() const { return m_file.isOpen(); }
+    inline bool isReadOnly() const { return m_readOnly; }
+    inline QString fileName() const { return m_file.fileName(); }
+    QString indexFileName() const;
+
+    /**
+     * @brief readMessages Reads a range of messages through the offset
+     * index, other messages are not touched.
+     * @param first Absolute index of the first message
+     * @param count Number of messages
+     * @param messages Receives the messages in order
+     * @return true if all messages could be read
+     */
+    bool readMessages(int first, int count, QList<QJsonObject> &messages);
+
+    /**
+     * @brief apply Appends the changes as records and flushes once
+     * @param changes Ordered list of changes
+     * @return true if all records were written
+     */
+    bool apply(const QList<Change> &changes);
+
+    /**
+     * @brief load Replays the log
+     * @param messages Receives the messages in order
+     * @return true if the log could be read
+     */
+    bool load(QList<QJsonObject> &messages);
+
+    /**
+     * @brief compact Rewrites the log with one record per live message.
+     * The new file replaces the old one atomically.
+     * @return true on success
+     */
+    bool compact();
+    bool needsCompaction() const;
+
+    inline qint64 recordCount() const { return m_recordCount; }
+    inline qint64 messageCount() const { return m_offsets.size(); }
+
+    /**
+     * @brief importJson Converts a history saved by ChatModel::saveToFile
+     * @param jsonFile Legacy JSON history
+     * @param logFile Log file to create, an existing one is replaced
+     * @return true on success
+     */
+    static bool importJson(const QString &jsonFile, const QString &logFile);
+
+    /**
+     * @brief readAll Replays a log read-only. Nothing is truncated or
+     * written, so it is safe while another store appends to the file.
+     * @param fileName Log file
+     * @param messages Receives the messages in order
+     * @return true if the log could be read
+     */
+    static bool readAll(const QString &fileName, QList<QJsonObject> &messages);
+
+    static quint32 crc32(const char *data, qsizetype length, quint32 crc = 0);
+
+private:
+    QFile m_file;
+    // Number of valid records in the log
+    qint64 m_recordCount;
+    // File offset of the latest Put record of each message
+    QList<qint64> m_offsets;
+    // Offsets changed since the index file was written
+    bool m_indexDirty;
+    // Records not covered by the index file
+    qint64 m_unindexedRecords;
+    bool m_readOnly;
+
+private:
+    inline bool writeHeader(QIODevice *device) const;
+    inline bool writeRecord(QIODevice *device, const Change &change) const;
+    inline bool readRecord(qint64 position, Change &change);
+    inline bool isPartialRecord(qint64 position);
+    inline bool scan(QList<QJsonObject> *messages, qint64 from = 0);
+    inline bool readIndex();
+    inline bool writeIndex();
+    template<typename T>
+    static inline void replay(QList<T> &list, const Change &change, const T &value);
+    static inline bool decodeRecord(const QByteArray &payload, Change &change);
+};
+
+#endif // CHATHISTORYSTORE_H
@@ -19,12 +19,13 @@ ChatMessage::ChatMessage(QObject *parent)
     , m_usage()
     , m_toolCalls()
     , m_toolContent()
+    , m_attachments()
 {}
 
 // Copy constructor
 ChatMessage::ChatMessage(const ChatMessage &other)
     : QObject(other.parent())
-    , m_content(other.content())
+    , m_content(other.m_content)
     , m_role(other.role())
     , m_created(other.created())
     , m_id(other.id())
@@ -35,67 +36,28 @@ ChatMessage::ChatMessage(const ChatMessage &other)
     , m_choiceIndex(other.choiceIndex())
     , m_stats(other.stats())
     , m_usage(other.usage())
-    , m_toolCalls(other.toolCalls())
+    , m_toolCalls(other.m_toolCalls)
     , m_toolContent(other.toolContent())
+    , m_attachments(other.attachments())
 {}
 
-void ChatMessage::mergeToolsFrom(ToolCallEntry &tool)
+bool ChatMessage::appendToolCallDelta(const ToolCallEntry &tool, qsizetype *position)
 {
-    auto updateTool = [](const ToolCallEntry &original, const ToolCallEntry &tool) -> ToolCallEntry {
-        ToolCallEntry org = original;
-        if (!tool.toolTypeString().isEmpty()) {
-            org.setToolType(tool.toolTypeString());
-        }
-        if (!tool.toolCallId().isEmpty()) {
-            org.setToolCallId(tool.toolCallId());
-        }
-        if (!tool.arguments().isEmpty()) {
-            org.setArguments(tool.arguments());
-        }
-        if (!tool.functionName().isEmpty()) {
-            org.setFunctionName(tool.functionName());
-        }
-        return org;
-    };
-
-    // if from stream and tools are empty, add
-    if (m_toolCalls.count() == 0) {
-        m_toolCalls.append(tool);
-        return;
-    }
-
-    // if from stream and id is empty, updtate first tool
-    if (tool.toolCallId().isEmpty()) {
-        if (tool.toolIndex() > 0 && tool.toolIndex() < m_toolCalls.count()) {
-            m_toolCalls[tool.toolIndex()] = updateTool(m_toolCalls[tool.toolIndex()], tool);
-        } else {
-            m_toolCalls[0] = updateTool(m_toolCalls[0], tool);
-        }
-        return;
-    }
-
-    // if from stream find tool and updtate
-    for (int i = 0; i < m_toolCalls.count(); i++) {
-        if (m_toolCalls[i].toolCallId() == tool.toolCallId()) {
-            m_toolCalls[i] = updateTool(m_toolCalls[i], tool);
-            return;
-        }
-    }
+    return m_toolCalls.merge(tool, position);
 }
 
 void ChatMessage::setToolCalls(const QList<ToolCallEntry> &tools)
 {
+    // complete calls, they replace the current ones
     if (!tools.isEmpty()) {
-        foreach (auto tool, tools) {
-            mergeToolsFrom(tool);
-        }
+        m_toolCalls.setCalls(tools);
     }
 }
 
 void ChatMessage::setContent(const QString &content)
 {
-    if (!content.isEmpty() && m_content != content) {
-        m_content = content;
+    if (!content.isEmpty() && m_content.toString() != content) {
+        m_content.setText(content);
     }
 }
 
@@ -106,9 +68,16 @@ void ChatMessage::setToolContent(const QByteArray &content)
     }
 }
 
+void ChatMessage::setAttachments(const QJsonArray &attachments)
+{
+    if (m_attachments != attachments) {
+        m_attachments = attachments;
+    }
+}
+
 void ChatMessage::appendContent(const QString &content)
 {
-    if (!content.isEmpty() && !content.isEmpty()) {
+    if (!content.isEmpty()) {
         m_content.append(content);
     }
 }
@@ -185,7 +154,9 @@ void ChatMessage::setUsage(const QJsonObject &usage)
 
 void ChatMessage::addTools(const QList<ToolCallEntry> &tools)
 {
-    m_toolCalls.append(tools);
+    foreach (const ToolCallEntry &tool, tools) {
+        m_toolCalls.append(tool);
+    }
 }
 
 QJsonObject ChatMessage::toJson() const
@@ -228,20 +199,26 @@ QJsonObject ChatMessage::toJson() const
         }
     }
 
-    messageObj["content"] = m_content;
+    messageObj["content"] = m_content.toString();
 
     QJsonArray toolsCalls;
-    for (auto &toolCall : m_toolCalls) {
+    for (const ToolCallEntry &toolCall : m_toolCalls.calls()) {
         QJsonObject tc;
-        tc["type"] = toolCall.toolType();
+        tc["type"] = toolCall.toolTypeString();
         tc["id"] = toolCall.toolCallId();
         tc["index"] = toolCall.toolIndex();
-        tc["function"] = toolCall.functionName();
-        tc["arguments"] = toolCall.arguments();
+        tc["function"] = QJsonObject{
+            {"name", toolCall.functionName()},
+            {"arguments", toolCall.arguments()},
+        };
+        toolsCalls.append(tc);
     }
 
     messageObj["tool_calls"] = toolsCalls;
     messageObj["tool_content"] = QString(m_toolContent);
+    if (!m_attachments.isEmpty()) {
+        messageObj["attachments"] = m_attachments;
+    }
 
     choiceObj["finish_reason"] = m_finishReason;
     choiceObj["index"] = m_choiceIndex;
@@ -267,6 +244,24 @@ QJsonObject ChatMessage::toJson() const
 
 void ChatMessage::fromJson(const QJsonObject &json)
 {
+    // written by toJson() in LLM response layout, flatten first choice
+    if (json.contains("choices") && json["choices"].isArray() && !json.contains("content")) {
+        QJsonObject flat = json;
+        QJsonArray choices = json["choices"].toArray();
+        if (!choices.isEmpty() && choices[0].isObject()) {
+            QJsonObject choice = choices[0].toObject();
+            flat["finish_reason"] = choice["finish_reason"].toString();
+            flat["index"] = choice["index"].toInt();
+            QJsonObject message = choice["message"].toObject();
+            for (auto it = message.constBegin(); it != message.constEnd(); ++it) {
+                flat.insert(it.key(), it.value());
+            }
+        }
+        flat.remove("choices");
+        fromJson(flat);
+        return;
+    }
+
     // Set basic properties
     if (json.contains("content")) {
         setContent(json["content"].toString());
@@ -370,6 +365,10 @@ void ChatMessage::fromJson(const QJsonObject &json)
     if (json.contains("tool_content")) {
         setToolContent(json["tool_content"].toString().toUtf8());
     }
+
+    if (json.contains("attachments") && json["attachments"].isArray()) {
+        setAttachments(json["attachments"].toArray());
+    }
 }
 
 // Comparison operators
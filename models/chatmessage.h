@@ -1,124 +1,15 @@
 #ifndef CHATMESSAGE_H
 #define CHATMESSAGE_H
 
+#include <contentbuffer.h>
+#include <toolcallaccumulator.h>
+#include <toolcallentry.h>
 #include <QDataStream>
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QObject>
 
-class ToolCallEntry
-{
-public:
-    enum ToolType {
-        TypeNone = 0,
-        Function = 1,
-        Resuource = 2, // Fixed typo: was "Resuource"
-        Prompt = 3,
-    };
-
-    explicit ToolCallEntry()
-        : m_toolIndex(0)
-    {}
-
-    ToolCallEntry(const ToolCallEntry &other)
-        : m_toolIndex(other.m_toolIndex)
-        , m_toolType(other.m_toolType)
-        , m_toolCallId(other.m_toolCallId)
-        , m_functionName(other.m_functionName)
-        , m_arguments(other.m_arguments)
-    {}
-
-    // Assignment operator
-    ToolCallEntry &operator=(const ToolCallEntry &other)
-    {
-        if (this != &other) { // Self-assignment check
-            m_toolIndex = other.m_toolIndex;
-            m_toolType = other.m_toolType;
-            m_toolCallId = other.m_toolCallId;
-            m_functionName = other.m_functionName;
-            m_arguments = other.m_arguments;
-        }
-        return *this;
-    }
-
-    // Comparison operator
-    bool operator==(const ToolCallEntry &other) const
-    {
-        return (m_toolIndex == other.m_toolIndex          //
-                && m_toolType == other.m_toolType         //
-                && m_toolCallId == other.m_toolCallId     //
-                && m_functionName == other.m_functionName //
-                && m_arguments == other.m_arguments);
-    }
-
-    inline ToolType toolType() const
-    {
-        if (m_toolType.toLower() == "resource") {
-            return Resuource;
-        } else if (m_toolType.toLower() == "prompt") {
-            return Prompt;
-        } else if (m_toolType.toLower() == "function") {
-            return Function;
-        }
-        return TypeNone;
-    }
-
-    inline void setToolIndex(int value)
-    {
-        if (value != 0)
-            m_toolIndex = value;
-    }
-
-    inline int toolIndex() const { return m_toolIndex; }
-
-    inline void setToolType(const QString &value)
-    {
-        if (!value.trimmed().isEmpty())
-            m_toolType = value.trimmed();
-    }
-
-    inline const QString &toolTypeString() const { return m_toolType; }
-
-    inline const QString &toolCallId() const { return m_toolCallId; }
-
-    inline void setToolCallId(const QString &value)
-    {
-        if (!value.trimmed().isEmpty())
-            m_toolCallId = value.trimmed();
-    }
-
-    inline const QString &functionName() const { return m_functionName; }
-
-    inline void setFunctionName(const QString &value)
-    {
-        if (!value.trimmed().isEmpty())
-            m_functionName = value.trimmed();
-    }
-
-    inline const QString &arguments() const { return m_arguments; }
-
-    inline void setArguments(const QString &value)
-    {
-        if (!value.trimmed().isEmpty())
-            m_arguments = value.trimmed();
-    }
-
-    inline bool isValid() const
-    {
-        return !m_toolType.isEmpty()      //
-               && !m_toolCallId.isEmpty() //
-               && !m_functionName.isEmpty();
-    }
-
-private:
-    int m_toolIndex;
-    QString m_toolType;
-    QString m_toolCallId;
-    QString m_functionName;
-    QString m_arguments;
-};
-Q_DECLARE_METATYPE(ToolCallEntry::ToolType)
-
 class LLMChatClient;
 class ChatMessage : public QObject
 {
@@ -152,12 +43,19 @@ public:
     void fromJson(const QJsonObject &json);
 
     /**
-     * @brief mergeToolsFrom
-     * @param tool
+     * @brief appendToolCallDelta Merges a streamed tool call fragment,
+     * its arguments are appended to those of the call it continues
+     * @param tool Tool call delta
+     * @param position Receives the position of the call in toolCalls()
+     * @return true if the arguments of this call just became complete
      */
-    void mergeToolsFrom(ToolCallEntry &tool);
+    bool appendToolCallDelta(const ToolCallEntry &tool, qsizetype *position = nullptr);
 
-    inline const QString &content() const { return m_content; }
+    inline const QString &content() const { return m_content.toString(); }
+    inline qsizetype contentLength() const { return m_content.length(); }
+    inline bool hasContent() const { return !m_content.isEmpty(); }
+    // Content appended after the given offset, without flattening
+    inline QString contentSince(qsizetype offset) const { return m_content.suffix(offset); }
     inline Role role() const { return m_role; }
     inline bool isUser() const { return m_role == ChatRole || m_role == UserRole; }
     inline qint64 created() const { return m_created; }
@@ -169,8 +67,10 @@ public:
     inline int choiceIndex() const { return m_choiceIndex; }
     inline const QJsonObject &stats() const { return m_stats; }
     inline const QJsonObject &usage() const { return m_usage; }
-    inline const QList<ToolCallEntry> &toolCalls() const { return m_toolCalls; }
+    inline const QList<ToolCallEntry> &toolCalls() const { return m_toolCalls.calls(); }
     inline const QByteArray &toolContent() const { return m_toolContent; }
+    // Attached files as {"file", "hash"} objects, hash is the hex XXH64 of the bytes sent
+    inline const QJsonArray &attachments() const { return m_attachments; }
 
 public slots:
     void appendContent(const QString &content);
@@ -188,9 +88,10 @@ public slots:
     void addTools(const QList<ToolCallEntry> &tools);
     void setToolCalls(const QList<ToolCallEntry> &tools);
     void setToolContent(const QByteArray &content);
+    void setAttachments(const QJsonArray &attachments);
 
 private:
-    QString m_content;
+    ContentBuffer m_content;
     Role m_role;
     qint64 m_created;
     QString m_id;
@@ -201,8 +102,9 @@ private:
     int m_choiceIndex;
     QJsonObject m_stats;
     QJsonObject m_usage;
-    QList<ToolCallEntry> m_toolCalls;
+    ToolCallAccumulator m_toolCalls;
     QByteArray m_toolContent;
+    QJsonArray m_attachments;
 };
 
 // Comparison operators
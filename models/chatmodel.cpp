@@ -1,14 +1,28 @@
 #include "chatmodel.h"
 #include <QDebug>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <algorithm>
+#include <utility>
 
 ChatModel::ChatModel(QObject *parent)
     : QAbstractListModel(parent)
+    , m_historyStore(nullptr)
+    , m_baseIndex(0)
+    , m_pageSize(HistoryPageSize)
 {}
 
+ChatModel::~ChatModel()
+{
+    if (m_historyStore) {
+        delete m_historyStore;
+    }
+}
+
 int ChatModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent);
@@ -73,6 +87,8 @@ bool ChatModel::setData(const QModelIndex &index, const QVariant &value, int rol
             return false;
     }
 
+    markDirty(index.row());
+
     emit dataChanged(index, index, {role});
     emit messageChanged(message, index.row());
     return true;
@@ -99,6 +115,50 @@ QHash<int, QByteArray> ChatModel::roleNames() const
     return roles;
 }
 
+bool ChatModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return false;
+    }
+    return m_historyStore && m_baseIndex > 0;
+}
+
+// Load the next older history page in front of the loaded rows
+void ChatModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+
+    const int count = qMin(m_pageSize, m_baseIndex);
+    const int first = m_baseIndex - count;
+
+    // reopened, so the offsets include what the writer appended or compacted
+    QList<QJsonObject> objects;
+    const bool read = m_historyStore->readMessages(first, count, objects);
+    m_historyStore->close();
+    if (!read) {
+        qWarning().noquote() << "[ChatModel] Unable to read history page" << first << count << "from" << m_historyFile;
+        return;
+    }
+
+    QList<ChatMessage *> messages;
+    messages.reserve(objects.size());
+    foreach (const QJsonObject &messageObj, objects) {
+        ChatMessage *message = new ChatMessage(this);
+        message->fromJson(messageObj);
+        messages.append(message);
+    }
+
+    // row indices shift, absolute indices of pending changes do not
+    beginInsertRows(QModelIndex(), 0, messages.size() - 1);
+    m_messages = messages + m_messages;
+    m_baseIndex = first;
+    endInsertRows();
+
+    emit messagesPrepended(messages);
+}
+
 void ChatModel::clear()
 {
     if (m_messages.isEmpty())
@@ -108,16 +168,26 @@ void ChatModel::clear()
     qDeleteAll(m_messages);
     m_messages.clear();
     endResetModel();
+
+    // pending message updates are obsolete, cold pages too
+    m_dirty.clear();
+    m_changes.clear();
+    m_changes.append({ChatHistoryStore::Truncate, 0, {}});
+    m_baseIndex = 0;
 }
 
 ChatMessage *ChatModel::appendMessage(const ChatMessage &message)
 {
     ChatMessage *cm = new ChatMessage(message);
+    // the copy takes the parent of the source, which may be another model
+    cm->setParent(this);
 
     beginInsertRows(QModelIndex(), m_messages.size(), m_messages.size());
     m_messages.append(cm);
     endInsertRows();
 
+    markDirty(m_messages.size() - 1);
+
     emit messageAdded(cm);
     return cm;
 }
@@ -128,6 +198,8 @@ ChatMessage *ChatModel::appendMessage(ChatMessage *message)
     m_messages.append(message);
     endInsertRows();
 
+    markDirty(m_messages.size() - 1);
+
     emit messageAdded(message);
     return message;
 }
@@ -154,6 +226,10 @@ void ChatModel::removeMessage(int index)
     if (index < 0 || index >= m_messages.size())
         return;
 
+    // indices of pending updates shift with the removal
+    snapshotDirty();
+    m_changes.append({ChatHistoryStore::Remove, m_baseIndex + index, {}});
+
     beginRemoveRows(QModelIndex(), index, index);
     delete m_messages.takeAt(index);
     endRemoveRows();
@@ -226,13 +302,132 @@ bool ChatModel::loadFromFile(const QString &fileName)
             message->fromJson(messageObj);
 
             // Add to model
-            messageAdded(message);
+            appendMessage(message);
         }
     }
 
     return true;
 }
 
+inline void ChatModel::markDirty(int index)
+{
+    // absolute history index, stable while older pages are fetched
+    m_dirty.insert(m_baseIndex + index);
+}
+
+inline void ChatModel::snapshotDirty()
+{
+    if (m_dirty.isEmpty()) {
+        return;
+    }
+
+    QList<int> indices = m_dirty.values();
+    std::sort(indices.begin(), indices.end());
+    foreach (int index, indices) {
+        if (ChatMessage *message = messageAt(index - m_baseIndex)) {
+            // implicitly shared copy, JSON is built by the writer
+            ChatMessage *snapshot = new ChatMessage(*message);
+            snapshot->setParent(nullptr);
+            m_changes.append({ChatHistoryStore::Put, index, {}, QSharedPointer<const ChatMessage>(snapshot)});
+        }
+    }
+    m_dirty.clear();
+}
+
+QList<ChatHistoryStore::Change> ChatModel::takeChanges()
+{
+    snapshotDirty();
+    return std::exchange(m_changes, {});
+}
+
+void ChatModel::setHistoryFile(const QString &fileName)
+{
+    if (m_historyFile == fileName) {
+        return;
+    }
+
+    if (m_historyStore) {
+        delete m_historyStore;
+        m_historyStore = nullptr;
+    }
+    m_historyFile = fileName;
+
+    // new log receives the loaded conversation, cold pages stay behind
+    m_baseIndex = 0;
+    m_changes.clear();
+    if (!m_messages.isEmpty()) {
+        m_changes.append({ChatHistoryStore::Truncate, 0, {}});
+        for (int i = 0; i < m_messages.size(); i++) {
+            markDirty(i);
+        }
+    }
+}
+
+// Open a history log and load its most recent page, legacy JSON files are imported
+QString ChatModel::historyLogFile(const QString &fileName)
+{
+    QFileInfo fi(fileName);
+    if (fi.suffix().toLower() == "json") {
+        return fi.absoluteDir().absoluteFilePath(fi.completeBaseName() + ".chatlog");
+    }
+    return fi.absoluteFilePath();
+}
+
+bool ChatModel::openHistory(const QString &fileName, int pageSize)
+{
+    const QString logFile = historyLogFile(fileName);
+    if (logFile != QFileInfo(fileName).absoluteFilePath() && !QFileInfo::exists(logFile) && !ChatHistoryStore::importJson(fileName, logFile)) {
+        return false;
+    }
+
+    // offsets only, message records stay on disk; the writer thread owns
+    // the log, this store reads pages and never writes the log or its index
+    ChatHistoryStore *store = new ChatHistoryStore(logFile, true);
+    if (!store->open()) {
+        delete store;
+        return false;
+    }
+
+    const int total = static_cast<int>(store->messageCount());
+    const int count = (pageSize > 0 ? qMin(pageSize, total) : total);
+
+    QList<QJsonObject> messages;
+    if (!store->readMessages(total - count, count, messages)) {
+        delete store;
+        return false;
+    }
+    // appends and compactions of the writer leave the offsets stale, and
+    // an open handle keeps compaction from replacing the file on Windows
+    store->close();
+
+    clear();
+
+    if (m_historyStore) {
+        delete m_historyStore;
+    }
+    m_historyStore = store;
+    m_historyFile = logFile;
+    m_pageSize = (pageSize > 0 ? pageSize : HistoryPageSize);
+    m_baseIndex = total - count;
+
+    // the log already holds all of this, nothing becomes dirty
+    m_dirty.clear();
+    m_changes.clear();
+
+    foreach (const QJsonObject &messageObj, messages) {
+        ChatMessage *message = new ChatMessage(this);
+        message->fromJson(messageObj);
+
+        beginInsertRows(QModelIndex(), m_messages.size(), m_messages.size());
+        m_messages.append(message);
+        endInsertRows();
+
+        emit messageAdded(message);
+    }
+
+    return true;
+}
+
 inline void ChatModel::reportError(const QString &message)
 {
     qCritical("[LLMChatClient] ERROR: %s", qPrintable(message));
@@ -240,6 +435,25 @@ inline void ChatModel::reportError(const QString &message)
     emit errorOccurred("Server URL not set");
 }
 
+void ChatModel::abortStream()
+{
+    m_completedTools.clear();
+
+    // partial answers since the last user message
+    for (int i = m_messages.size() - 1; i >= 0; i--) {
+        ChatMessage *message = m_messages[i];
+        if (message->isUser()) {
+            break;
+        }
+        if (message->role() != ChatMessage::AssistantRole || !message->finishReason().isEmpty()) {
+            continue;
+        }
+        message->setFinishReason(QStringLiteral("cancelled"));
+        markDirty(i);
+        emit messageChanged(message, i);
+    }
+}
+
 void ChatModel::onParseDataStream(const QByteArray &data)
 {
     // Split by newlines and process each line
@@ -338,11 +552,19 @@ void ChatModel::onParseMessageObject(const QJsonObject &response)
     }
 
     if (!isNew) {
-        emit messageChanged(message, m_messages.indexOf(message));
+        const int index = m_messages.indexOf(message);
+        markDirty(index);
+        emit messageChanged(message, index);
     } else {
         appendMessage(message);
     }
 
+    // tool calls with complete arguments, before the stream ends
+    foreach (const ToolCallEntry &tool, m_completedTools) {
+        emit toolCallCompleted(message, tool);
+    }
+    m_completedTools.clear();
+
     // run tooling (tool_calls)
     if (message->finishReason().toLower().trimmed() == "tool_calls") {
         checkAndRunTooling(message);
@@ -357,7 +579,8 @@ void ChatModel::onParseMessageObject(const QJsonObject &response)
     return;
 
 error_exit:
-    if (message) {
+    m_completedTools.clear();
+    if (message && isNew) {
         message->deleteLater();
     }
 }
@@ -444,7 +667,7 @@ inline bool ChatModel::parseToolCall(const QJsonObject toolObject, ToolCallEntry
         // Extract arguments - may empty basedd on streamed message
         value = object["arguments"];
         if (!value.isNull() && value.isString()) {
-            tool.setArguments(value.toString());
+            tool.appendArguments(value.toString());
         }
     }
 
@@ -466,7 +689,10 @@ inline bool ChatModel::parseToolCalls(ChatMessage *message, const QJsonArray &to
         QJsonObject toolObject = toolCalls[i].toObject();
         //qDebug().noquote() << "[LLMChatClient] parseToolCalls msgId:" << message->id() << "toolObject:" << toolObject;
         parseToolCall(toolObject, tool);
-        message->mergeToolsFrom(tool);
+        qsizetype position = -1;
+        if (message->appendToolCallDelta(tool, &position)) {
+            m_completedTools.append(message->toolCalls().at(position));
+        }
     }
     return true;
 }
@@ -1,9 +1,11 @@
 #ifndef CHATMODEL_H
 #define CHATMODEL_H
 
+#include <chathistorystore.h>
 #include <chatmessage.h>
 #include <QAbstractListModel>
 #include <QList>
+#include <QSet>
 
 class ChatModel : public QAbstractListModel
 {
@@ -20,7 +22,11 @@ public:
         SystemFingerprintRole,
     };
 
+    // Messages loaded per history page
+    static constexpr int HistoryPageSize = 50;
+
     explicit ChatModel(QObject *parent = nullptr);
+    ~ChatModel();
 
     // Model interface
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -28,6 +34,8 @@ public:
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
     QHash<int, QByteArray> roleNames() const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
     // Custom methods
     void clear();
@@ -42,6 +50,24 @@ public:
     bool saveToFile(const QString &fileName) const;
     bool loadFromFile(const QString &fileName);
 
+    // Append-only history log
+    inline const QString &historyFile() const { return m_historyFile; }
+    void setHistoryFile(const QString &fileName);
+    bool openHistory(const QString &fileName, int pageSize = HistoryPageSize);
+    // Absolute log openHistory() reads a file from, the imported log of a legacy .json history
+    static QString historyLogFile(const QString &fileName);
+    // Absolute history index of row 0, older messages are still on disk
+    inline int baseIndex() const { return m_baseIndex; }
+    inline bool hasChanges() const { return !m_changes.isEmpty() || !m_dirty.isEmpty(); }
+    QList<ChatHistoryStore::Change> takeChanges();
+
+    /**
+     * @brief abortStream Ends a response cut off by a cancelled request,
+     * the partial answer is kept with finish reason "cancelled" and pending
+     * tool calls are dropped.
+     */
+    void abortStream();
+
 public slots:
     void onParseMessageObject(const QJsonObject &response);
     void onParseDataStream(const QByteArray &data);
@@ -50,12 +76,29 @@ signals:
     void streamCompleted();
     void errorOccurred(const QString &error);
     void toolRequest(ChatMessage *message, const ToolCallEntry &tool);
+    // arguments of a streamed tool call are complete, stream may still run
+    void toolCallCompleted(ChatMessage *message, const ToolCallEntry &tool);
     void messageAdded(ChatMessage *message);
+    // older history page inserted at row 0, in chronological order
+    void messagesPrepended(const QList<ChatMessage *> &messages);
     void messageChanged(ChatMessage *message, int index = -1);
     void messageRemoved(int index);
 
 private:
     QList<ChatMessage *> m_messages;
+    // tool calls completed while parsing the current response
+    QList<ToolCallEntry> m_completedTools;
+    // history log of this chat
+    QString m_historyFile;
+    // read-only, open while a page is read
+    ChatHistoryStore *m_historyStore;
+    // number of older messages not loaded yet
+    int m_baseIndex;
+    int m_pageSize;
+    // messages changed since last save, copied on demand
+    QSet<int> m_dirty;
+    // structural changes and message snapshots since last save
+    QList<ChatHistoryStore::Change> m_changes;
 
 private:
     inline void reportError(const QString &message);
@@ -66,6 +109,8 @@ private:
     inline bool parseToolCalls(ChatMessage *message, const QJsonArray &toolCalls);
     inline bool parseToolCall(const QJsonObject toolObject, ToolCallEntry &tool) const;
     inline void checkAndRunTooling(ChatMessage *messge);
+    inline void markDirty(int index);
+    inline void snapshotDirty();
 };
 
 #endif // CHATMODEL_H
@@ -0,0 +1,122 @@
+#include <contentbuffer.h>
+#include <algorithm>
+
+ContentBuffer::ContentBuffer()
+    : m_chunks()
+    , m_offsets()
+    , m_length(0)
+    , m_flat()
+    , m_flatLength(0)
+{}
+
+ContentBuffer::ContentBuffer(const QString &text)
+    : ContentBuffer()
+{
+    setText(text);
+}
+
+void ContentBuffer::append(const QString &text)
+{
+    if (text.isEmpty()) {
+        return;
+    }
+
+    // fill the current chunk while its reserved capacity suffices
+    if (!m_chunks.isEmpty()) {
+        QString &last = m_chunks.last();
+        if (last.size() + text.size() <= last.capacity()) {
+            last.append(text);
+            m_length += text.size();
+            return;
+        }
+    }
+
+    // start a new chunk, older chunks stay untouched
+    QString chunk;
+    chunk.reserve(qMax(ChunkSize, text.size()));
+    chunk.append(text);
+
+    m_offsets.append(m_length);
+    m_chunks.append(chunk);
+    m_length += text.size();
+}
+
+void ContentBuffer::setText(const QString &text)
+{
+    clear();
+    append(text);
+}
+
+void ContentBuffer::clear()
+{
+    m_chunks.clear();
+    m_offsets.clear();
+    m_length = 0;
+    m_flat.clear();
+    m_flatLength = 0;
+}
+
+inline qsizetype ContentBuffer::chunkAt(qsizetype offset) const
+{
+    // last chunk starting at or before offset
+    auto it = std::upper_bound(m_offsets.cbegin(), m_offsets.cend(), offset);
+    return qMax<qsizetype>(0, (it - m_offsets.cbegin()) - 1);
+}
+
+QString ContentBuffer::suffix(qsizetype offset) const
+{
+    if (offset <= 0) {
+        return toString();
+    }
+    if (offset >= m_length) {
+        return QString();
+    }
+
+    // served from the flat copy if it is already up to date
+    if (m_flatLength == m_length) {
+        return m_flat.mid(offset);
+    }
+
+    QString result;
+    result.reserve(m_length - offset);
+
+    qsizetype index = chunkAt(offset);
+    result.append(QStringView(m_chunks[index]).mid(offset - m_offsets[index]));
+    for (++index; index < m_chunks.count(); ++index) {
+        result.append(m_chunks[index]);
+    }
+
+    return result;
+}
+
+const QString &ContentBuffer::toString() const
+{
+    if (m_flatLength == m_length) {
+        return m_flat;
+    }
+
+    // the flat copy owns its data: sharing a chunk would make the next
+    // append to it detach, and growing by the appended part only would
+    // reallocate on every call, both copy everything while streaming
+    if (m_flat.capacity() < m_length) {
+        m_flat.reserve(qMax(m_length, 2 * m_flat.capacity()));
+    }
+
+    // copy only what was appended since the last flatten
+    qsizetype index = chunkAt(m_flatLength);
+    m_flat.append(QStringView(m_chunks[index]).mid(m_flatLength - m_offsets[index]));
+    for (++index; index < m_chunks.count(); ++index) {
+        m_flat.append(m_chunks[index]);
+    }
+    m_flatLength = m_length;
+
+    return m_flat;
+}
+
+bool ContentBuffer::operator==(const ContentBuffer &other) const
+{
+    if (m_length != other.m_length) {
+        return false;
+    }
+    return toString() == other.toString();
+}
@@ -0,0 +1,76 @@
+#ifndef CONTENTBUFFER_H
+#define CONTENTBUFFER_H
+
+#include <QList>
+#include <QString>
+
+/**
+ * @brief Chunked (rope-like) text buffer used to accumulate streamed
+ * message content. Appending never reallocates or copies text that was
+ * already stored, readers can fetch the text appended since a known
+ * offset without touching older chunks, and the flat QString is only
+ * built on demand.
+ */
+class ContentBuffer
+{
+public:
+    // Capacity reserved for each new chunk
+    static constexpr qsizetype ChunkSize = 4096;
+
+    ContentBuffer();
+    ContentBuffer(const QString &text);
+
+    /**
+     * @brief append Appends text in amortized O(1)
+     * @param text
+     */
+    void append(const QString &text);
+
+    /**
+     * @brief setText Replaces the whole buffer content
+     * @param text
+     */
+    void setText(const QString &text);
+
+    void clear();
+
+    inline qsizetype length() const { return m_length; }
+    inline bool isEmpty() const { return m_length == 0; }
+    inline qsizetype chunkCount() const { return m_chunks.count(); }
+
+    /**
+     * @brief suffix Returns the text appended after the given offset.
+     * Only the chunks covering [offset, length()) are visited.
+     * @param offset Character offset, usually a length seen before
+     * @return Text since offset
+     */
+    QString suffix(qsizetype offset) const;
+
+    /**
+     * @brief toString Flattens the buffer lazily. Consecutive calls while
+     * streaming only copy the part appended since the previous call, the
+     * flat copy grows geometrically. A caller keeping a copy of the
+     * result makes the next call after an append copy it once more.
+     * @return Complete text
+     */
+    const QString &toString() const;
+
+    bool operator==(const ContentBuffer &other) const;
+    inline bool operator!=(const ContentBuffer &other) const { return !(*this == other); }
+
+private:
+    // Text chunks, each one reserved with ChunkSize capacity
+    QList<QString> m_chunks;
+    // Start offset of every chunk, for binary search in suffix()
+    QList<qsizetype> m_offsets;
+    // Total number of characters
+    qsizetype m_length;
+    // Lazily flattened text and the length it covers
+    mutable QString m_flat;
+    mutable qsizetype m_flatLength;
+
+private:
+    inline qsizetype chunkAt(qsizetype offset) const;
+};
+
+#endif // CONTENTBUFFER_H
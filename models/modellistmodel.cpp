@@ -3,6 +3,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
+#include <QSet>
 
 ModelListModel::ModelListModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -27,6 +28,7 @@ QVariant ModelListModel::data(const QModelIndex &index, int role) const
     const ModelEntry &entry = m_entries.at(index.row());
 
     switch (role) {
+        case Qt::DisplayRole:
         case IdRole:
             return entry.id;
         case ObjectRole:
@@ -129,14 +131,19 @@ void ModelListModel::removeEntry(int row)
     emit entryRemoved(row, removed);
 }
 
+static inline bool isSameEntry(const ModelListModel::ModelEntry &a, const ModelListModel::ModelEntry &b)
+{
+    return a.id == b.id && a.object == b.object && a.ownedBy == b.ownedBy && a.contextLength == b.contextLength;
+}
+
 void ModelListModel::loadFrom(const QJsonArray &models)
 {
     if (models.isEmpty()) {
         return;
     }
 
-    beginResetModel();
-    m_entries.clear();
+    QList<ModelEntry> entries;
+    QSet<QString> ids;
     for (const auto &value : models) {
         if (!value.isObject()) {
             continue;
@@ -146,9 +153,64 @@ void ModelListModel::loadFrom(const QJsonArray &models)
         entry.id = obj.value("id").toString();
         entry.object = obj.value("object").toString();
         entry.ownedBy = obj.value("owned_by").toString();
-        m_entries.append(entry);
+        // OpenRouter, LM Studio, vLLM, llama.cpp server
+        if (obj.contains("context_length")) {
+            entry.contextLength = obj.value("context_length").toInt();
+        } else if (obj.contains("max_context_length")) {
+            entry.contextLength = obj.value("max_context_length").toInt();
+        } else if (obj.contains("max_model_len")) {
+            entry.contextLength = obj.value("max_model_len").toInt();
+        } else if (obj.value("meta").isObject()) {
+            entry.contextLength = obj.value("meta").toObject().value("n_ctx_train").toInt();
+        }
+        entries.append(entry);
+        ids.insert(entry.id);
+    }
+
+    // update in place, views keep their selection and scroll position:
+    // rows of models gone first, from the end so the rows stay valid
+    for (int row = m_entries.size() - 1; row >= 0; row--) {
+        if (!ids.contains(m_entries.at(row).id)) {
+            beginRemoveRows(QModelIndex(), row, row);
+            m_entries.removeAt(row);
+            endRemoveRows();
+        }
+    }
+
+    // then row by row in the new order, an unchanged list costs no signal
+    for (int row = 0; row < entries.size(); row++) {
+        const ModelEntry &entry = entries.at(row);
+        int from = -1;
+        for (int i = row; i < m_entries.size(); i++) {
+            if (m_entries.at(i).id == entry.id) {
+                from = i;
+                break;
+            }
+        }
+        if (from < 0) {
+            beginInsertRows(QModelIndex(), row, row);
+            m_entries.insert(row, entry);
+            endInsertRows();
+            continue;
+        }
+        if (from != row) {
+            beginMoveRows(QModelIndex(), from, from, QModelIndex(), row);
+            m_entries.move(from, row);
+            endMoveRows();
+        }
+        if (!isSameEntry(m_entries.at(row), entry)) {
+            m_entries[row] = entry;
+            const QModelIndex idx = index(row);
+            emit dataChanged(idx, idx);
+        }
+    }
+
+    // repeated ids left over
+    if (m_entries.size() > entries.size()) {
+        beginRemoveRows(QModelIndex(), entries.size(), m_entries.size() - 1);
+        m_entries.resize(entries.size());
+        endRemoveRows();
     }
-    endResetModel();
 
     emit modelsLoaded();
 }
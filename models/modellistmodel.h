@@ -22,6 +22,8 @@ public:
         QString id;
         QString object;
         QString ownedBy;
+        // context window in tokens, 0 if the server does not report it
+        int contextLength = 0;
     };
 
     explicit ModelListModel(QObject *parent = nullptr);
@@ -47,7 +49,7 @@ signals:
     void modelsLoaded();
 
 public:
-    // Load entries from JSON array
+    // Update entries to a JSON array, rows are kept, moved, inserted or removed
     void loadFrom(const QJsonArray &models);
     // Load entries from JSON string
     bool loadFrom(const QString &jsonString);
@@ -2,21 +2,28 @@
 INCLUDEPATH += $$PWD/
 
 HEADERS += \
+    $$PWD/chathistorystore.h \
     $$PWD/chatlistmodel.h \
     $$PWD/chatmessage.h \
     $$PWD/chatmodel.h \
+    $$PWD/contentbuffer.h \
     $$PWD/filelistmodel.h \
     $$PWD/llmconnectionmodel.h \
     $$PWD/modellistmodel.h \
     $$PWD/syntaxcolormodel.h \
+    $$PWD/toolcallaccumulator.h \
+    $$PWD/toolcallentry.h \
     $$PWD/toolmodel.h
 
 SOURCES += \
+    $$PWD/chathistorystore.cpp \
     $$PWD/chatlistmodel.cpp \
     $$PWD/chatmessage.cpp \
     $$PWD/chatmodel.cpp \
+    $$PWD/contentbuffer.cpp \
     $$PWD/filelistmodel.cpp \
     $$PWD/llmconnectionmodel.cpp \
     $$PWD/modellistmodel.cpp \
     $$PWD/syntaxcolormodel.cpp \
+    $$PWD/toolcallaccumulator.cpp \
     $$PWD/toolmodel.cpp
\ No newline at end of file
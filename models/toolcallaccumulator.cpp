@@ -0,0 +1,320 @@
+#include <toolcallaccumulator.h>
+#include <toolcallentry.h>
+
+JsonStreamValidator::JsonStreamValidator()
+    : m_stack()
+    , m_expect(ExpectValue)
+    , m_inString(false)
+    , m_inKey(false)
+    , m_escape(false)
+    , m_hexDigits(0)
+    , m_inNumber(false)
+    , m_literal(nullptr)
+    , m_state(Empty)
+{}
+
+void JsonStreamValidator::reset()
+{
+    m_stack.clear();
+    m_expect = ExpectValue;
+    m_inString = false;
+    m_inKey = false;
+    m_escape = false;
+    m_hexDigits = 0;
+    m_inNumber = false;
+    m_literal = nullptr;
+    m_state = Empty;
+}
+
+inline void JsonStreamValidator::feedString(QChar c)
+{
+    if (m_hexDigits > 0) {
+        const char16_t u = c.unicode();
+        if (!((u >= u'0' && u <= u'9') || (u >= u'a' && u <= u'f') || (u >= u'A' && u <= u'F'))) {
+            m_state = Invalid;
+        }
+        m_hexDigits--;
+    } else if (m_escape) {
+        m_escape = false;
+        switch (c.unicode()) {
+            case u'"':
+            case u'\\':
+            case u'/':
+            case u'b':
+            case u'f':
+            case u'n':
+            case u'r':
+            case u't': {
+                break;
+            }
+            case u'u': {
+                m_hexDigits = 4;
+                break;
+            }
+            default: {
+                m_state = Invalid;
+                break;
+            }
+        }
+    } else if (c == u'\\') {
+        m_escape = true;
+    } else if (c == u'"') {
+        m_inString = false;
+        if (m_inKey) {
+            m_inKey = false;
+            m_expect = ExpectColon;
+        } else {
+            endValue();
+        }
+    } else if (c.unicode() < 0x20) {
+        // control characters must be escaped
+        m_state = Invalid;
+    }
+}
+
+inline void JsonStreamValidator::endValue()
+{
+    if (m_stack.isEmpty()) {
+        m_state = Complete;
+    } else {
+        m_expect = ExpectCommaOrEnd;
+    }
+}
+
+JsonStreamValidator::State JsonStreamValidator::feed(QStringView text)
+{
+    for (const QChar c : text) {
+        if (m_state == Invalid) {
+            break;
+        }
+
+        if (m_inString) {
+            feedString(c);
+            continue;
+        }
+
+        if (m_literal) {
+            if (c != QLatin1Char(*m_literal)) {
+                m_state = Invalid;
+                break;
+            }
+            if (*++m_literal == '\0') {
+                m_literal = nullptr;
+                endValue();
+            }
+            continue;
+        }
+
+        // a number ends with the first character that is not part of it
+        if (m_inNumber) {
+            if ((c >= u'0' && c <= u'9') || c == u'.' || c == u'e' || c == u'E' || c == u'+' || c == u'-') {
+                continue;
+            }
+            m_inNumber = false;
+            endValue();
+        }
+
+        if (c == u' ' || c == u'\t' || c == u'\n' || c == u'\r') {
+            continue;
+        }
+
+        // anything after a complete top level value is garbage
+        if (m_state == Complete) {
+            m_state = Invalid;
+            break;
+        }
+
+        // tool arguments are a JSON object (or array)
+        if (m_state == Empty && c != u'{' && c != u'[') {
+            m_state = Invalid;
+            break;
+        }
+
+        const bool value = (m_expect == ExpectValue || m_expect == ExpectValueOrEnd);
+        switch (c.unicode()) {
+            case u'{':
+            case u'[': {
+                if (!value) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_stack.append(static_cast<char>(c.unicode()));
+                m_expect = (c == u'{' ? ExpectKeyOrEnd : ExpectValueOrEnd);
+                m_state = Partial;
+                break;
+            }
+            case u'}':
+            case u']': {
+                // empty container or after a value, never after a comma
+                const char open = (c == u'}' ? '{' : '[');
+                const Expect empty = (c == u'}' ? ExpectKeyOrEnd : ExpectValueOrEnd);
+                if (m_stack.isEmpty() || m_stack.last() != open || (m_expect != empty && m_expect != ExpectCommaOrEnd)) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_stack.removeLast();
+                endValue();
+                break;
+            }
+            case u'"': {
+                if (!value && m_expect != ExpectKey && m_expect != ExpectKeyOrEnd) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_inString = true;
+                m_inKey = !value;
+                break;
+            }
+            case u':': {
+                if (m_expect != ExpectColon) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_expect = ExpectValue;
+                break;
+            }
+            case u',': {
+                if (m_expect != ExpectCommaOrEnd) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_expect = (m_stack.last() == '{' ? ExpectKey : ExpectValue);
+                break;
+            }
+            case u't':
+            case u'f':
+            case u'n': {
+                if (!value) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_literal = (c == u't' ? "rue" : c == u'f' ? "alse" : "ull");
+                break;
+            }
+            default: {
+                if (!value || (c != u'-' && (c < u'0' || c > u'9'))) {
+                    m_state = Invalid;
+                    break;
+                }
+                m_inNumber = true;
+                break;
+            }
+        }
+    }
+
+    return m_state;
+}
+
+// ---------------------------------------------------------
+
+ToolCallAccumulator::ToolCallAccumulator()
+    : m_calls()
+    , m_validators()
+    , m_reported()
+    , m_byIndex()
+    , m_byId()
+{}
+
+void ToolCallAccumulator::clear()
+{
+    m_calls.clear();
+    m_validators.clear();
+    m_reported.clear();
+    m_byIndex.clear();
+    m_byId.clear();
+}
+
+bool ToolCallAccumulator::isComplete(qsizetype position) const
+{
+    if (position < 0 || position >= m_validators.count()) {
+        return false;
+    }
+    return m_validators[position].state() == JsonStreamValidator::Complete;
+}
+
+inline qsizetype ToolCallAccumulator::slotFor(const ToolCallEntry &delta)
+{
+    const QString &id = delta.toolCallId();
+
+    if (!id.isEmpty()) {
+        // known call id
+        auto it = m_byId.constFind(id);
+        if (it != m_byId.constEnd()) {
+            return it.value();
+        }
+        // first chunk of a call whose id arrives late
+        auto ix = m_byIndex.constFind(delta.toolIndex());
+        if (ix != m_byIndex.constEnd() && m_calls[ix.value()].toolCallId().isEmpty()) {
+            m_byId.insert(id, ix.value());
+            return ix.value();
+        }
+    } else {
+        // streamed continuation, addressed by index only
+        auto ix = m_byIndex.constFind(delta.toolIndex());
+        if (ix != m_byIndex.constEnd()) {
+            return ix.value();
+        }
+    }
+
+    // new call
+    const qsizetype position = m_calls.count();
+    m_calls.append(ToolCallEntry());
+    m_validators.append(JsonStreamValidator());
+    m_reported.append(false);
+    m_byIndex.insert(delta.toolIndex(), position);
+    if (!id.isEmpty()) {
+        m_byId.insert(id, position);
+    }
+    return position;
+}
+
+void ToolCallAccumulator::append(const ToolCallEntry &call)
+{
+    const qsizetype position = m_calls.count();
+    m_calls.append(call);
+    m_validators.append(JsonStreamValidator());
+    m_validators.last().feed(call.arguments());
+    m_reported.append(true);
+    if (!m_byIndex.contains(call.toolIndex())) {
+        m_byIndex.insert(call.toolIndex(), position);
+    }
+    if (!call.toolCallId().isEmpty() && !m_byId.contains(call.toolCallId())) {
+        m_byId.insert(call.toolCallId(), position);
+    }
+}
+
+void ToolCallAccumulator::setCalls(const QList<ToolCallEntry> &calls)
+{
+    clear();
+    foreach (const ToolCallEntry &call, calls) {
+        append(call);
+    }
+}
+
+bool ToolCallAccumulator::merge(const ToolCallEntry &delta, qsizetype *position)
+{
+    const qsizetype slot = slotFor(delta);
+    if (position) {
+        *position = slot;
+    }
+
+    // update in place, no copy of the accumulated arguments
+    ToolCallEntry &call = m_calls[slot];
+    call.setToolIndex(delta.toolIndex());
+    call.setToolType(delta.toolTypeString());
+    call.setToolCallId(delta.toolCallId());
+    call.setFunctionName(delta.functionName());
+
+    if (!delta.arguments().isEmpty()) {
+        call.appendArguments(delta.arguments());
+        m_validators[slot].feed(delta.arguments());
+    }
+
+    // report completion exactly once
+    if (!m_reported[slot] && m_validators[slot].state() == JsonStreamValidator::Complete && call.isValid()) {
+        m_reported[slot] = true;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,106 @@
+#ifndef TOOLCALLACCUMULATOR_H
+#define TOOLCALLACCUMULATOR_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringView>
+#include <QVarLengthArray>
+
+class ToolCallEntry;
+
+/**
+ * @brief Incremental JSON check for streamed tool arguments.
+ * Follows the JSON grammar fragment by fragment: brackets, keys, colons
+ * and commas, strings with their escapes, numbers and literals, so a
+ * caller knows when the argument text forms one complete JSON object or
+ * array, and as early as possible when it cannot.
+ */
+class JsonStreamValidator
+{
+public:
+    enum State {
+        Empty = 0,
+        Partial,
+        Complete,
+        Invalid,
+    };
+
+    JsonStreamValidator();
+
+    void reset();
+    State feed(QStringView text);
+    inline State state() const { return m_state; }
+
+private:
+    // next token allowed in the open container
+    enum Expect {
+        ExpectValue = 0,
+        ExpectValueOrEnd,
+        ExpectKey,
+        ExpectKeyOrEnd,
+        ExpectColon,
+        ExpectCommaOrEnd,
+    };
+
+    // open brackets '{' or '['
+    QVarLengthArray<char, 32> m_stack;
+    Expect m_expect;
+    bool m_inString;
+    bool m_inKey;
+    bool m_escape;
+    // hex digits left of a \u escape
+    int m_hexDigits;
+    bool m_inNumber;
+    // rest of true, false or null
+    const char *m_literal;
+    State m_state;
+
+private:
+    inline void feedString(QChar c);
+    inline void endValue();
+};
+
+/**
+ * @brief Collects streamed tool call deltas. Calls are keyed by their
+ * stream index (or id), argument fragments are appended in place and
+ * each call reports once when its arguments became complete JSON.
+ */
+class ToolCallAccumulator
+{
+public:
+    ToolCallAccumulator();
+
+    /**
+     * @brief merge Merges a (partial) tool call into the accumulated list
+     * @param delta Streamed tool call fragment
+     * @param position Receives the list position of the merged call
+     * @return true if the call arguments became complete with this delta
+     */
+    bool merge(const ToolCallEntry &delta, qsizetype *position = nullptr);
+
+    // Appends a complete call, it is not reported by merge()
+    void append(const ToolCallEntry &call);
+    // Replaces all calls by complete ones
+    void setCalls(const QList<ToolCallEntry> &calls);
+
+    void clear();
+
+    inline const QList<ToolCallEntry> &calls() const { return m_calls; }
+    inline qsizetype count() const { return m_calls.count(); }
+    bool isComplete(qsizetype position) const;
+
+private:
+    QList<ToolCallEntry> m_calls;
+    QList<JsonStreamValidator> m_validators;
+    QList<bool> m_reported;
+    // stream index -> list position
+    QHash<int, qsizetype> m_byIndex;
+    // tool call id -> list position
+    QHash<QString, qsizetype> m_byId;
+
+private:
+    inline qsizetype slotFor(const ToolCallEntry &delta);
+};
+
+#endif // TOOLCALLACCUMULATOR_H
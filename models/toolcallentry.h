@@ -0,0 +1,123 @@
+#ifndef TOOLCALLENTRY_H
+#define TOOLCALLENTRY_H
+
+#include <QMetaType>
+#include <QString>
+
+class ToolCallEntry
+{
+public:
+    enum ToolType {
+        TypeNone = 0,
+        Function = 1,
+        Resuource = 2, // Fixed typo: was "Resuource"
+        Prompt = 3,
+    };
+
+    explicit ToolCallEntry()
+        : m_toolIndex(0)
+    {}
+
+    ToolCallEntry(const ToolCallEntry &other)
+        : m_toolIndex(other.m_toolIndex)
+        , m_toolType(other.m_toolType)
+        , m_toolCallId(other.m_toolCallId)
+        , m_functionName(other.m_functionName)
+        , m_arguments(other.m_arguments)
+    {}
+
+    // Assignment operator
+    ToolCallEntry &operator=(const ToolCallEntry &other)
+    {
+        if (this != &other) { // Self-assignment check
+            m_toolIndex = other.m_toolIndex;
+            m_toolType = other.m_toolType;
+            m_toolCallId = other.m_toolCallId;
+            m_functionName = other.m_functionName;
+            m_arguments = other.m_arguments;
+        }
+        return *this;
+    }
+
+    // Comparison operator
+    bool operator==(const ToolCallEntry &other) const
+    {
+        return (m_toolIndex == other.m_toolIndex          //
+                && m_toolType == other.m_toolType         //
+                && m_toolCallId == other.m_toolCallId     //
+                && m_functionName == other.m_functionName //
+                && m_arguments == other.m_arguments);
+    }
+
+    inline ToolType toolType() const
+    {
+        if (m_toolType.toLower() == "resource") {
+            return Resuource;
+        } else if (m_toolType.toLower() == "prompt") {
+            return Prompt;
+        } else if (m_toolType.toLower() == "function") {
+            return Function;
+        }
+        return TypeNone;
+    }
+
+    inline void setToolIndex(int value)
+    {
+        if (value != 0)
+            m_toolIndex = value;
+    }
+
+    inline int toolIndex() const { return m_toolIndex; }
+
+    inline void setToolType(const QString &value)
+    {
+        if (!value.trimmed().isEmpty())
+            m_toolType = value.trimmed();
+    }
+
+    inline const QString &toolTypeString() const { return m_toolType; }
+
+    inline const QString &toolCallId() const { return m_toolCallId; }
+
+    inline void setToolCallId(const QString &value)
+    {
+        if (!value.trimmed().isEmpty())
+            m_toolCallId = value.trimmed();
+    }
+
+    inline const QString &functionName() const { return m_functionName; }
+
+    inline void setFunctionName(const QString &value)
+    {
+        if (!value.trimmed().isEmpty())
+            m_functionName = value.trimmed();
+    }
+
+    inline const QString &arguments() const { return m_arguments; }
+
+    inline void setArguments(const QString &value)
+    {
+        if (!value.trimmed().isEmpty())
+            m_arguments = value.trimmed();
+    }
+
+    // Streamed argument fragments are appended untouched
+    inline void appendArguments(const QString &fragment) { m_arguments.append(fragment); }
+
+    inline bool isValid() const
+    {
+        return !m_toolType.isEmpty()      //
+               && !m_toolCallId.isEmpty() //
+               && !m_functionName.isEmpty();
+    }
+
+private:
+    int m_toolIndex;
+    QString m_toolType;
+    QString m_toolCallId;
+    QString m_functionName;
+    QString m_arguments;
+};
+Q_DECLARE_METATYPE(ToolCallEntry::ToolType)
+
+#endif // TOOLCALLENTRY_H
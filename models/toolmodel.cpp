@@ -27,22 +27,31 @@ bool ToolModel::setData(const QModelIndex &index, const QVariant &value, int rol
     switch (role) {
         case Qt::UserRole:
             entry = value.value<ToolModelEntry>();
+            break;
         case ToolRole:
             entry.tool = value.value<QJsonObject>();
+            break;
         case NameRole:
             entry.name = value.value<QString>();
+            break;
         case OptionRole:
             entry.option = value.value<ToolOption>();
+            break;
         case TypeRole:
             entry.type = value.value<ToolModelType>();
+            break;
         case DescriptionRole:
             entry.description = value.value<QString>();
+            break;
         case TitleRole:
             entry.title = value.value<QString>();
+            break;
         case ExecHandlerRole:
             entry.execHandler = value.value<QString>();
+            break;
         case ExecMethodRole:
             entry.execMethod = value.value<QString>();
+            break;
         default: {
             return false;
         }
@@ -51,6 +60,9 @@ bool ToolModel::setData(const QModelIndex &index, const QVariant &value, int rol
     beginResetModel();
     m_toolEntries[index.row()] = entry;
     endResetModel();
+
+    emit toolChanged(index.row(), entry);
+    return true;
 }
 
 QVariant ToolModel::data(const QModelIndex &index, int role) const
@@ -116,6 +128,7 @@ void ToolModel::loadFromDirectory(const QFileInfo &fileInfo, ToolModelType type)
             entry.execMethod = jsonObject["execMethod"].toString("");
             entry.option = ToolDisabled; // Default value
             entry.type = type;
+            entry.readOnly = jsonObject["annotations"].toObject()["readOnlyHint"].toBool(false);
             addToolEntry(entry);
         } else {
             qWarning().noquote() << "[ToolModel] loadFromDirectory:"                //
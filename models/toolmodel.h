@@ -48,6 +48,8 @@ public:
         QString execMethod;
         ToolOption option;
         ToolModelType type;
+        // annotations.readOnlyHint, tool has no side effects
+        bool readOnly = false;
     };
 
     explicit ToolModel(QObject *parent = nullptr);
@@ -72,6 +74,7 @@ public:
 signals:
     void toolAdded(const ToolModel::ToolModelEntry &entry);
     void toolRemoved(int index);
+    void toolChanged(int index, const ToolModel::ToolModelEntry &entry);
 
 public slots:
     void addToolEntry(const ToolModel::ToolModelEntry &entry);
@@ -0,0 +1,138 @@
+#include <attachmentcache.h>
+#include <attachmentcachetest.h>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QTest>
+
+// Entry of a file that is never stat'ed
+static inline AttachmentCache::Entry placeholder(const QString &fileName)
+{
+    return AttachmentCache::Entry{
+        .fileName = fileName,
+        .size = 0,
+        .modified = 0,
+        .inode = 0,
+        .language = "text",
+        .tokens = 1,
+        .hash = 0,
+        .escapedSize = 0,
+    };
+}
+
+void AttachmentCacheTest::initTestCase()
+{
+    QVERIFY2(m_dir.isValid(), qPrintable(m_dir.errorString()));
+}
+
+void AttachmentCacheTest::init()
+{
+    AttachmentCache::instance()->clear();
+}
+
+void AttachmentCacheTest::cleanupTestCase()
+{
+    AttachmentCache::instance()->clear();
+}
+
+QString AttachmentCacheTest::writeFile(const QString &name, const QByteArray &data) const
+{
+    const QString fileName = m_dir.filePath(name);
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size()) {
+        return QString();
+    }
+    return fileName;
+}
+
+void AttachmentCacheTest::unchangedFileIsCached()
+{
+    AttachmentCache *cache = AttachmentCache::instance();
+    const QByteArray data = "int main() { return 0; }\n";
+    const QString fileName = writeFile("main.cpp", data);
+    QVERIFY(!fileName.isEmpty());
+
+    // nothing read yet
+    QCOMPARE(cache->cached(fileName).tokens, -1);
+
+    const AttachmentCache::Entry entry = cache->entry(fileName);
+    QCOMPARE(entry.fileName, QFileInfo(fileName).canonicalFilePath());
+    QCOMPARE(entry.size, data.size());
+    QCOMPARE(entry.hash, AttachmentCache::hash(data.constData(), data.size()));
+    QCOMPARE(entry.language, QStringLiteral("cpp"));
+    QVERIFY(entry.tokens > 0);
+
+    const AttachmentCache::Entry cached = cache->cached(fileName);
+    QCOMPARE(cached.tokens, entry.tokens);
+    QCOMPARE(cached.hash, entry.hash);
+    QCOMPARE(cache->text(fileName), QString::fromUtf8(data));
+}
+
+void AttachmentCacheTest::changedFileIsReadAgain()
+{
+    AttachmentCache *cache = AttachmentCache::instance();
+    const QString fileName = writeFile("notes.txt", "first version\n");
+    QVERIFY(!fileName.isEmpty());
+    const AttachmentCache::Entry first = cache->entry(fileName);
+    QCOMPARE(cache->text(fileName), QStringLiteral("first version\n"));
+
+    const QByteArray data = "second and much longer version\n";
+    QCOMPARE(writeFile("notes.txt", data), fileName);
+
+    // stale without reading, the text of the first version is gone
+    const AttachmentCache::Entry stale = cache->cached(fileName);
+    QCOMPARE(stale.tokens, -1);
+    QCOMPARE(stale.size, data.size());
+
+    const AttachmentCache::Entry second = cache->entry(fileName);
+    QCOMPARE(second.size, data.size());
+    QVERIFY(second.hash != first.hash);
+    QCOMPARE(second.hash, AttachmentCache::hash(data.constData(), data.size()));
+    QVERIFY(second.tokens > first.tokens);
+    QCOMPARE(cache->text(fileName), QString::fromUtf8(data));
+    QCOMPARE(cache->cached(fileName).hash, second.hash);
+}
+
+void AttachmentCacheTest::sameSizeRewriteIsReadAgain()
+{
+    AttachmentCache *cache = AttachmentCache::instance();
+    const QString fileName = writeFile("same.txt", "aaaa bbbb\n");
+    QVERIFY(!fileName.isEmpty());
+    const AttachmentCache::Entry first = cache->entry(fileName);
+
+    // same size, only the modification time tells
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QCOMPARE(file.write("cccc dddd\n"), 10);
+    QVERIFY(file.flush());
+    QVERIFY(file.setFileTime(QDateTime::fromMSecsSinceEpoch(first.modified + 2000), QFileDevice::FileModificationTime));
+    file.close();
+
+    QCOMPARE(cache->cached(fileName).tokens, -1);
+    const AttachmentCache::Entry second = cache->entry(fileName);
+    QCOMPARE(second.size, first.size);
+    QVERIFY(second.hash != first.hash);
+    QCOMPARE(cache->text(fileName), QStringLiteral("cccc dddd\n"));
+}
+
+void AttachmentCacheTest::leastRecentlyUsedIsEvicted()
+{
+    AttachmentCache *cache = AttachmentCache::instance();
+    const QString used = writeFile("used.txt", "used\n");
+    const QString unused = writeFile("unused.txt", "unused\n");
+    QVERIFY(!used.isEmpty() && !unused.isEmpty());
+    cache->entry(used);
+    cache->entry(unused);
+
+    // fill the cache, the two files are the oldest entries
+    for (int i = 0; i < AttachmentCache::MaxEntries - 2; i++) {
+        cache->insert(placeholder(m_dir.filePath(QStringLiteral("missing-%1.txt").arg(i))));
+    }
+    // a lookup counts as use, unused is the oldest now
+    QVERIFY(cache->cached(used).tokens >= 0);
+
+    cache->insert(placeholder(m_dir.filePath("one-more.txt")));
+
+    QCOMPARE(cache->cached(unused).tokens, -1);
+    QVERIFY(cache->cached(used).tokens >= 0);
+}
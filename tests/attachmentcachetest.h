@@ -0,0 +1,27 @@
+#pragma once
+#include <QObject>
+#include <QTemporaryDir>
+
+/**
+ * @brief Unit tests of the invalidation and eviction of AttachmentCache.
+ */
+class AttachmentCacheTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanupTestCase();
+
+    void unchangedFileIsCached();
+    void changedFileIsReadAgain();
+    void sameSizeRewriteIsReadAgain();
+    void leastRecentlyUsedIsEvicted();
+
+private:
+    QTemporaryDir m_dir;
+
+private:
+    QString writeFile(const QString &name, const QByteArray &data) const;
+};
@@ -0,0 +1,234 @@
+#include <chathistorystore.h>
+#include <chathistorystoretest.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTest>
+
+static inline QJsonObject message(int n)
+{
+    return QJsonObject{
+        {"id", QStringLiteral("msg-%1").arg(n)},
+        {"role", n % 2 ? "assistant" : "user"},
+        {"content", QStringLiteral("Message %1").arg(n)},
+    };
+}
+
+static inline QList<ChatHistoryStore::Change> puts(int first, int count)
+{
+    QList<ChatHistoryStore::Change> changes;
+    for (int i = first; i < first + count; i++) {
+        changes.append({ChatHistoryStore::Put, i, message(i)});
+    }
+    return changes;
+}
+
+static inline QList<QJsonObject> messages(int count)
+{
+    QList<QJsonObject> result;
+    for (int i = 0; i < count; i++) {
+        result.append(message(i));
+    }
+    return result;
+}
+
+void ChatHistoryStoreTest::initTestCase()
+{
+    QVERIFY2(m_dir.isValid(), qPrintable(m_dir.errorString()));
+}
+
+QString ChatHistoryStoreTest::logFile(const QString &name) const
+{
+    return m_dir.filePath(name + QStringLiteral(".chatlog"));
+}
+
+void ChatHistoryStoreTest::roundTrip()
+{
+    const QString fileName = logFile("roundtrip");
+    {
+        ChatHistoryStore store(fileName);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(0, 4)));
+        // replace the first, remove the third
+        QVERIFY(store.apply({{ChatHistoryStore::Put, 0, message(10)}, {ChatHistoryStore::Remove, 2, QJsonObject()}}));
+    }
+
+    QList<QJsonObject> expected = {message(10), message(1), message(3)};
+    ChatHistoryStore store(fileName);
+    QList<QJsonObject> loaded;
+    QVERIFY(store.open(&loaded));
+    QCOMPARE(loaded, expected);
+
+    // pages through the offsets
+    QList<QJsonObject> page;
+    QVERIFY(store.readMessages(1, 2, page));
+    QCOMPARE(page, expected.mid(1));
+    QVERIFY(!store.readMessages(2, 2, page));
+}
+
+void ChatHistoryStoreTest::tornTailIsCut()
+{
+    const QString fileName = logFile("torn");
+    qint64 size = 0;
+    {
+        ChatHistoryStore store(fileName);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(0, 2)));
+        size = QFileInfo(fileName).size();
+    }
+
+    // record header and half of a payload, as a crash while writing leaves it
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::Append));
+    file.write(QByteArray("\x40\x00\x00\x00\x12\x34\x56\x78\xA3\x62op", 12));
+    file.close();
+
+    {
+        ChatHistoryStore store(fileName);
+        QList<QJsonObject> loaded;
+        QVERIFY(store.open(&loaded));
+        QCOMPARE(loaded, messages(2));
+        QCOMPARE(QFileInfo(fileName).size(), size);
+        // appended behind the last valid record
+        QVERIFY(store.apply(puts(2, 1)));
+    }
+
+    ChatHistoryStore store(fileName);
+    QList<QJsonObject> loaded;
+    QVERIFY(store.open(&loaded));
+    QCOMPARE(loaded, messages(3));
+}
+
+void ChatHistoryStoreTest::compaction()
+{
+    const QString fileName = logFile("compaction");
+    const int rewrites = ChatHistoryStore::CompactionRatio * 16 + 1;
+    {
+        ChatHistoryStore store(fileName);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(0, 2)));
+        // the same message over and over, as a streamed answer is saved
+        for (int i = 0; i < rewrites; i++) {
+            QVERIFY(store.apply({{ChatHistoryStore::Put, 1, message(100 + i)}}));
+        }
+        QVERIFY(!store.needsCompaction());
+        QVERIFY(store.recordCount() < rewrites);
+        QCOMPARE(store.messageCount(), 2);
+    }
+
+    ChatHistoryStore store(fileName);
+    QList<QJsonObject> loaded;
+    QVERIFY(store.open(&loaded));
+    QCOMPARE(loaded, QList<QJsonObject>({message(0), message(100 + rewrites - 1)}));
+    QVERIFY(store.recordCount() < rewrites);
+}
+
+void ChatHistoryStoreTest::staleIndexIsRebuilt()
+{
+    const QString fileName = logFile("stale");
+    const QString shorter = logFile("stale-short");
+    {
+        ChatHistoryStore store(fileName);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(0, 5)));
+    }
+    {
+        ChatHistoryStore store(shorter);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(0, 1)));
+    }
+    QVERIFY(QFile::exists(ChatHistoryStore(fileName).indexFileName()));
+
+    // log replaced behind the index, which covers more than the file
+    QVERIFY(QFile::remove(fileName));
+    QVERIFY(QFile::copy(shorter, fileName));
+
+    ChatHistoryStore store(fileName);
+    QVERIFY(store.open());
+    QCOMPARE(store.messageCount(), 1);
+    QList<QJsonObject> page;
+    QVERIFY(store.readMessages(0, 1, page));
+    QCOMPARE(page, messages(1));
+}
+
+void ChatHistoryStoreTest::recordsAfterIndexAreScanned()
+{
+    const QString fileName = logFile("incremental");
+    const QString indexFile = ChatHistoryStore(fileName).indexFileName();
+    {
+        ChatHistoryStore store(fileName);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(0, 3)));
+    }
+    QFile index(indexFile);
+    QVERIFY(index.open(QIODevice::ReadOnly));
+    const QByteArray covered = index.readAll();
+    index.close();
+
+    {
+        ChatHistoryStore store(fileName);
+        QVERIFY(store.open());
+        QVERIFY(store.apply(puts(3, 2)));
+    }
+    // index of the first three messages only
+    QVERIFY(index.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    index.write(covered);
+    index.close();
+
+    ChatHistoryStore store(fileName);
+    QVERIFY(store.open());
+    QCOMPARE(store.messageCount(), 5);
+    QList<QJsonObject> page;
+    QVERIFY(store.readMessages(2, 3, page));
+    QCOMPARE(page, messages(5).mid(2));
+}
+
+void ChatHistoryStoreTest::indexIsWrittenWhileAppending()
+{
+    const QString fileName = logFile("periodic");
+    const int count = ChatHistoryStore::IndexInterval;
+
+    ChatHistoryStore writer(fileName);
+    QVERIFY(writer.open());
+    for (int i = 0; i < count; i++) {
+        QVERIFY(writer.apply(puts(i, 1)));
+    }
+    QVERIFY(QFile::exists(writer.indexFileName()));
+
+    // the writer is in the middle of the next record
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::Append));
+    file.write(QByteArray("\x40\x00\x00\x00", 4));
+    file.close();
+
+    ChatHistoryStore reader(fileName, true);
+    QVERIFY(reader.open());
+    QCOMPARE(reader.messageCount(), count);
+    QList<QJsonObject> page;
+    QVERIFY(reader.readMessages(count - 1, 1, page));
+    QCOMPARE(page, QList<QJsonObject>({message(count - 1)}));
+}
+
+void ChatHistoryStoreTest::importJson()
+{
+    const QString jsonFile = m_dir.filePath("legacy.json");
+    const QString fileName = logFile("legacy");
+
+    QJsonArray array;
+    foreach (const QJsonObject &m, messages(3)) {
+        array.append(m);
+    }
+    QFile file(jsonFile);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QJsonDocument(QJsonObject{{"messages", array}}).toJson());
+    file.close();
+
+    QVERIFY(ChatHistoryStore::importJson(jsonFile, fileName));
+
+    ChatHistoryStore store(fileName);
+    QList<QJsonObject> loaded;
+    QVERIFY(store.open(&loaded));
+    QCOMPARE(loaded, messages(3));
+    QCOMPARE(store.recordCount(), 3);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <QObject>
+#include <QTemporaryDir>
+
+/**
+ * @brief Unit tests of the append-only chat history log and its index.
+ */
+class ChatHistoryStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void roundTrip();
+    void tornTailIsCut();
+    void compaction();
+    void staleIndexIsRebuilt();
+    void recordsAfterIndexAreScanned();
+    void indexIsWrittenWhileAppending();
+    void importJson();
+
+private:
+    QTemporaryDir m_dir;
+
+private:
+    QString logFile(const QString &name) const;
+};
@@ -0,0 +1,96 @@
+#include <chatmodel.h>
+#include <chatsearchindextest.h>
+#include <QDir>
+#include <QTest>
+
+void ChatSearchIndexTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+// hits of the logs of this run only
+inline QList<ChatSearchIndex::Hit> ChatSearchIndexTest::search(const QString &query) const
+{
+    QList<ChatSearchIndex::Hit> hits;
+    foreach (const ChatSearchIndex::Hit &hit, ChatSearchIndex::instance()->search(query)) {
+        if (hit.historyFile.startsWith(m_dir.path())) {
+            hits.append(hit);
+        }
+    }
+    return hits;
+}
+
+void ChatSearchIndexTest::hitsCarryMessageIndex()
+{
+    const QString file = m_dir.filePath("hits.chatlog");
+    ChatSearchIndex *index = ChatSearchIndex::instance();
+    index->indexMessage(file, 0, "m0", "Nothing to find here");
+    index->indexMessage(file, 1, "m1", "the zebrafinch sings");
+    index->indexMessage(file, 2, "m2", "zebrafinch zebrafinch again");
+
+    const QList<ChatSearchIndex::Hit> hits = search("zebrafinch");
+    QCOMPARE(hits.size(), 2);
+    // more occurrences rank first
+    QCOMPARE(hits[0].messageIndex, 2);
+    QCOMPARE(hits[0].messageId, QStringLiteral("m2"));
+    QCOMPARE(hits[0].historyFile, file);
+    QCOMPARE(hits[1].messageIndex, 1);
+    QVERIFY(hits[0].score >= hits[1].score);
+}
+
+void ChatSearchIndexTest::phrasesAndPrefixes()
+{
+    const QString file = m_dir.filePath("phrases.chatlog");
+    ChatSearchIndex *index = ChatSearchIndex::instance();
+    index->indexMessage(file, 0, "p0", "quokka marsupial island");
+    index->indexMessage(file, 1, "p1", "marsupial quokka");
+
+    QList<ChatSearchIndex::Hit> hits = search("\"quokka marsupial\"");
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].messageIndex, 0);
+
+    QCOMPARE(search("quokk*").size(), 2);
+
+    // all terms must match
+    hits = search("quokka island");
+    QCOMPARE(hits.size(), 1);
+    QCOMPARE(hits[0].messageIndex, 0);
+}
+
+void ChatSearchIndexTest::identifierParts()
+{
+    const QString file = m_dir.filePath("code.chatlog");
+    ChatSearchIndex::instance()->indexMessage(file, 0, "c0", "call parseNumbatCalls() or read_numbat_file()");
+
+    QCOMPARE(search("parsenumbatcalls").size(), 1);
+    QCOMPARE(search("numbat").size(), 1);
+    QCOMPARE(search("calls").size(), 1);
+    QCOMPARE(search("read_numbat_file").size(), 1);
+}
+
+void ChatSearchIndexTest::replaceAndRemove()
+{
+    const QString file = m_dir.filePath("replace.chatlog");
+    ChatSearchIndex *index = ChatSearchIndex::instance();
+    index->indexMessage(file, 0, "r0", "wombat burrow");
+    index->indexMessage(file, 1, "r1", "wombat again");
+    // edited message
+    index->indexMessage(file, 0, "r0", "platypus burrow");
+
+    QCOMPARE(search("wombat").size(), 1);
+    QCOMPARE(search("platypus").size(), 1);
+
+    // history cut after the first message
+    index->removeFrom(file, 1);
+    QVERIFY(search("wombat").isEmpty());
+    QCOMPARE(search("burrow").size(), 1);
+}
+
+void ChatSearchIndexTest::legacyHitOpensItsLog()
+{
+    const QDir dir(m_dir.path());
+    // a .json hit is the chat whose log it was imported into
+    QCOMPARE(ChatModel::historyLogFile(dir.filePath("legacy.json")), dir.absoluteFilePath("legacy.chatlog"));
+    QCOMPARE(ChatModel::historyLogFile(dir.filePath("legacy.JSON")), dir.absoluteFilePath("legacy.chatlog"));
+    QCOMPARE(ChatModel::historyLogFile(dir.filePath("current.chatlog")), dir.absoluteFilePath("current.chatlog"));
+}
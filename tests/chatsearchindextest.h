@@ -0,0 +1,26 @@
+#pragma once
+#include <chatsearchindex.h>
+#include <QObject>
+#include <QTemporaryDir>
+
+/**
+ * @brief Unit tests of the chat search index and of opening its hits.
+ */
+class ChatSearchIndexTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void hitsCarryMessageIndex();
+    void phrasesAndPrefixes();
+    void identifierParts();
+    void replaceAndRemove();
+    void legacyHitOpensItsLog();
+
+private:
+    QTemporaryDir m_dir;
+
+private:
+    inline QList<ChatSearchIndex::Hit> search(const QString &query) const;
+};
@@ -0,0 +1,108 @@
+#include <contentbuffer.h>
+#include <contentbuffertest.h>
+#include <QTest>
+
+// streamed text: short deltas, one larger than a chunk
+static inline QStringList deltas()
+{
+    QStringList deltas;
+    for (int i = 0; i < 2000; i++) {
+        deltas.append(QStringLiteral("token %1 ").arg(i));
+    }
+    deltas.insert(1000, QString(ContentBuffer::ChunkSize * 2, QChar('x')));
+    return deltas;
+}
+
+void ContentBufferTest::appendAcrossChunks()
+{
+    ContentBuffer buffer;
+    QString expected;
+    foreach (const QString &delta, deltas()) {
+        buffer.append(delta);
+        expected.append(delta);
+    }
+    buffer.append(QString());
+
+    QCOMPARE(buffer.length(), expected.size());
+    QVERIFY(buffer.chunkCount() > 1);
+    QCOMPARE(buffer.toString(), expected);
+}
+
+void ContentBufferTest::suffixFromOffset()
+{
+    ContentBuffer buffer;
+    QString expected;
+    foreach (const QString &delta, deltas()) {
+        buffer.append(delta);
+        expected.append(delta);
+    }
+
+    // chunk starts, chunk inner positions and the ends
+    const QList<qsizetype> offsets = {-1, 0, 1, ContentBuffer::ChunkSize - 1, ContentBuffer::ChunkSize, 10000, expected.size() - 1, expected.size(), expected.size() + 1};
+    foreach (qsizetype offset, offsets) {
+        QCOMPARE(buffer.suffix(offset), expected.mid(qMax<qsizetype>(0, offset)));
+    }
+    // from the flat copy as well
+    buffer.toString();
+    QCOMPARE(buffer.suffix(12345), expected.mid(12345));
+}
+
+void ContentBufferTest::flattenWhileStreaming()
+{
+    ContentBuffer buffer;
+    QString expected;
+    const QChar *data = nullptr;
+    int reallocations = 0;
+    foreach (const QString &delta, deltas()) {
+        buffer.append(delta);
+        expected.append(delta);
+        // the view polls the whole text after every delta
+        const QString &flat = buffer.toString();
+        QCOMPARE(flat.size(), expected.size());
+        if (flat.constData() != data) {
+            data = flat.constData();
+            reallocations++;
+        }
+    }
+    QCOMPARE(buffer.toString(), expected);
+    // grows geometrically instead of once per delta
+    QVERIFY2(reallocations < 40, qPrintable(QString::number(reallocations)));
+
+    // a copy kept by the caller does not change with the buffer
+    const QString copy = buffer.toString();
+    buffer.append(QStringLiteral("more"));
+    QCOMPARE(copy, expected);
+    QCOMPARE(buffer.toString(), expected + QStringLiteral("more"));
+}
+
+void ContentBufferTest::setTextAndClear()
+{
+    ContentBuffer buffer(QStringLiteral("first"));
+    buffer.append(QStringLiteral(" second"));
+    QCOMPARE(buffer.toString(), QStringLiteral("first second"));
+
+    buffer.setText(QStringLiteral("other"));
+    QCOMPARE(buffer.length(), qsizetype(5));
+    QCOMPARE(buffer.toString(), QStringLiteral("other"));
+    QCOMPARE(buffer.suffix(2), QStringLiteral("her"));
+
+    buffer.clear();
+    QVERIFY(buffer.isEmpty());
+    QCOMPARE(buffer.chunkCount(), qsizetype(0));
+    QVERIFY(buffer.toString().isEmpty());
+    QVERIFY(buffer.suffix(0).isEmpty());
+}
+
+void ContentBufferTest::equality()
+{
+    // same text in other chunks
+    ContentBuffer streamed;
+    streamed.append(QStringLiteral("Hello"));
+    streamed.append(QString(ContentBuffer::ChunkSize, QChar(' ')));
+    streamed.append(QStringLiteral("world"));
+    const ContentBuffer whole(QStringLiteral("Hello") + QString(ContentBuffer::ChunkSize, QChar(' ')) + QStringLiteral("world"));
+
+    QVERIFY(streamed == whole);
+    QVERIFY(!(streamed != whole));
+    QVERIFY(streamed != ContentBuffer(QStringLiteral("Hello world")));
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <QObject>
+
+/**
+ * @brief Unit tests of the chunked message content buffer.
+ */
+class ContentBufferTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void appendAcrossChunks();
+    void suffixFromOffset();
+    void flattenWhileStreaming();
+    void setTextAndClear();
+    void equality();
+};
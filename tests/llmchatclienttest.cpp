@@ -0,0 +1,214 @@
+#include <chatmodel.h>
+#include <llmchatclient.h>
+#include <llmchatclienttest.h>
+#include <QJsonDocument>
+#include <QSet>
+#include <QTest>
+
+static const QJsonObject s_system{{"role", "system"}, {"content", "You are a helpful assistant."}};
+static const QJsonObject s_question{{"role", "user"}, {"content", "What is a prompt cache?"}};
+static const QJsonObject s_answer{{"role", "assistant"}, {"content", "The server keeps the state of a prompt it has seen."}};
+static const QJsonObject s_followUp{{"role", "user"}, {"content", "When is it lost?"}};
+
+// end of the messages array, sampling parameters follow
+static inline qsizetype historyEnd(const QByteArray &request)
+{
+    return request.indexOf("],\"max_tokens\"");
+}
+
+static inline ChatMessage *addMessage(ChatModel &history, ChatMessage::Role role, const QString &id, const QString &content)
+{
+    ChatMessage *message = new ChatMessage(&history);
+    message->setRole(role);
+    message->setId(id);
+    message->setContent(content);
+    return history.appendMessage(message);
+}
+
+static inline ToolCallEntry toolCall(const QString &id)
+{
+    ToolCallEntry call;
+    call.setToolType("function");
+    call.setToolCallId(id);
+    call.setFunctionName("read_file");
+    call.setArguments("{\"path\":\"main.cpp\"}");
+    return call;
+}
+
+// Question, tool call, tool result and answer per turn
+static inline void addToolTurns(ChatModel &history, int turns)
+{
+    for (int i = 0; i < turns; i++) {
+        const QString turn = QStringLiteral("turn-%1").arg(i);
+        addMessage(history, ChatMessage::UserRole, turn + "-question", QStringLiteral("Question %1: what does main do? ").arg(i) + QString("word ").repeated(40));
+        ChatMessage *caller = addMessage(history, ChatMessage::AssistantRole, turn, QString());
+        caller->setToolCalls({toolCall(turn + "-call")});
+        // results share the id of the message calling the tool
+        ChatMessage *result = addMessage(history, ChatMessage::ToolingRole, turn, QString());
+        result->setToolCalls({toolCall(turn + "-call")});
+        result->setToolContent(QByteArray("line ").repeated(300));
+        addMessage(history, ChatMessage::AssistantRole, turn + "-answer", QStringLiteral("Answer %1. ").arg(i) + QString("text ").repeated(60));
+    }
+}
+
+// Every result follows the message with its call, every call has its result
+static inline bool callsAnswered(const QList<LLMChatClient::SendParameters> &packed)
+{
+    QSet<QString> open;
+    foreach (const LLMChatClient::SendParameters &p, packed) {
+        foreach (const ToolCallEntry &call, p.toolCalls) {
+            open.insert(call.toolCallId());
+        }
+        if (!p.toolCallId.isEmpty() && !open.remove(p.toolCallId)) {
+            return false;
+        }
+    }
+    return open.isEmpty();
+}
+
+void LLMChatClientTest::consecutiveRequestsSharePrefix()
+{
+    LLMChatClient client(nullptr);
+
+    qsizetype stablePrefix = 0;
+    const QByteArray first = client.buildChatCompletionRequest( //
+        "mock-model",
+        {s_system, s_question},
+        {{"temperature", 0.7}, {"max_tokens", 1024}},
+        true,
+        &stablePrefix);
+    // next turn of the same chat, other sampling parameters
+    const QByteArray second = client.buildChatCompletionRequest( //
+        "mock-model",
+        {s_system, s_question, s_answer, s_followUp},
+        {{"max_tokens", 512}, {"temperature", 0.2}},
+        true);
+
+    QVERIFY(!QJsonDocument::fromJson(first).isNull());
+    QVERIFY(!QJsonDocument::fromJson(second).isNull());
+
+    // model, tools, system preamble and the whole former history are byte identical
+    const qsizetype end = historyEnd(first);
+    QVERIFY(end > 0);
+    QVERIFY(stablePrefix > 0 && stablePrefix < end);
+    QCOMPARE(second.left(end), first.left(end));
+}
+
+void LLMChatClientTest::systemMessagesLead()
+{
+    LLMChatClient client(nullptr);
+
+    // packing may put history in front of the system message
+    qsizetype stablePrefix = 0;
+    const QByteArray packed = client.buildChatCompletionRequest("mock-model", {s_question, s_system}, {{"max_tokens", 1024}}, false, &stablePrefix);
+    const QByteArray ordered = client.buildChatCompletionRequest("mock-model", {s_system, s_question}, {{"max_tokens", 1024}}, false);
+
+    QCOMPARE(packed, ordered);
+    QVERIFY(packed.left(stablePrefix).contains("\"role\":\"system\""));
+    QVERIFY(!packed.left(stablePrefix).contains("\"role\":\"user\""));
+}
+
+void LLMChatClientTest::contextBudgetKeepsPromptShare()
+{
+    LLMChatClient client(nullptr);
+
+    // the default response reserve exceeds a small window
+    client.setActiveModel({.id = "small", .contextLength = 2048});
+    const int budget = client.contextBudget(LLMChatClient::DefaultResponseTokens);
+    QVERIFY(budget > 0);
+    QVERIFY(budget <= 2048 / 4);
+
+    // below the cap every reserved token is taken from the budget
+    QCOMPARE(client.contextBudget(100) - client.contextBudget(200), 100);
+
+    // unknown window
+    client.setActiveModel({.id = "unknown", .contextLength = 0});
+    const int unknown = client.contextBudget(1024);
+    client.setActiveModel({.id = "default", .contextLength = LLMChatClient::DefaultContextLength});
+    QCOMPARE(unknown, client.contextBudget(1024));
+}
+
+void LLMChatClientTest::packContextKeepsPending()
+{
+    LLMChatClient client(nullptr);
+    client.setActiveModel({.id = "tiny", .contextLength = 512});
+
+    ChatModel history;
+    addToolTurns(history, 10);
+    const QList<LLMChatClient::SendParameters> pending = {
+        {.role = ChatMessage::SystemRole, .content = "You are terse."},
+        {.role = ChatMessage::UserRole, .content = "And now?"},
+    };
+
+    const QList<LLMChatClient::SendParameters> packed = client.packContext(&history, pending);
+
+    // older history is dropped, the messages of the request are last and untouched
+    QVERIFY(packed.size() >= pending.size());
+    QVERIFY(packed.size() < history.rowCount() + pending.size());
+    QCOMPARE(packed.at(packed.size() - 2).role, ChatMessage::SystemRole);
+    QCOMPARE(packed.at(packed.size() - 2).content, pending.at(0).content);
+    QCOMPARE(packed.last().role, ChatMessage::UserRole);
+    QCOMPARE(packed.last().content, pending.at(1).content);
+    QVERIFY(client.lastContextTokens() <= client.contextBudget(LLMChatClient::DefaultResponseTokens));
+}
+
+void LLMChatClientTest::packContextKeepsToolCallsWithResults_data()
+{
+    QTest::addColumn<int>("contextLength");
+    QTest::addColumn<bool>("complete");
+
+    QTest::newRow("256") << 256 << false;
+    QTest::newRow("512") << 512 << false;
+    QTest::newRow("1024") << 1024 << false;
+    QTest::newRow("2048") << 2048 << false;
+    QTest::newRow("8192") << 8192 << false;
+    QTest::newRow("32768") << 32768 << true;
+}
+
+void LLMChatClientTest::packContextKeepsToolCallsWithResults()
+{
+    QFETCH(int, contextLength);
+    QFETCH(bool, complete);
+
+    LLMChatClient client(nullptr);
+    client.setActiveModel({.id = "model", .contextLength = contextLength});
+
+    ChatModel history;
+    addToolTurns(history, 4);
+    const QList<LLMChatClient::SendParameters> pending = {{.role = ChatMessage::UserRole, .content = "Next question"}};
+
+    const QList<LLMChatClient::SendParameters> packed = client.packContext(&history, pending);
+
+    QVERIFY(callsAnswered(packed));
+    QVERIFY(client.lastContextTokens() <= client.contextBudget(LLMChatClient::DefaultResponseTokens));
+    if (complete) {
+        QCOMPARE(packed.size(), history.rowCount() + pending.size());
+    }
+}
+
+void LLMChatClientTest::packContextDropsUnpairedToolMessages()
+{
+    LLMChatClient client(nullptr);
+    client.setActiveModel({.id = "model", .contextLength = 32768});
+
+    ChatModel history;
+    // result of a call before the history
+    ChatMessage *orphan = addMessage(history, ChatMessage::ToolingRole, "earlier", QString());
+    orphan->setToolCalls({toolCall("earlier-call")});
+    orphan->setToolContent("stale result");
+    addMessage(history, ChatMessage::UserRole, "question", "What is in main.cpp?");
+    addMessage(history, ChatMessage::AssistantRole, "answer", "The entry point.");
+    // call whose result never arrived
+    ChatMessage *unanswered = addMessage(history, ChatMessage::AssistantRole, "pending-call", "Let me look.");
+    unanswered->setToolCalls({toolCall("lost-call")});
+
+    const QList<LLMChatClient::SendParameters> packed = client.packContext(&history, {{.role = ChatMessage::UserRole, .content = "Well?"}});
+
+    QCOMPARE(packed.size(), 4);
+    foreach (const LLMChatClient::SendParameters &p, packed) {
+        QVERIFY(p.toolCalls.isEmpty());
+        QVERIFY(p.toolCallId.isEmpty());
+    }
+    // the text of the unanswered message stays
+    QCOMPARE(packed.at(2).content, QStringLiteral("Let me look."));
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <QObject>
+
+/**
+ * @brief Unit tests of the request encoding and the context packing of
+ * LLMChatClient.
+ */
+class LLMChatClientTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void consecutiveRequestsSharePrefix();
+    void systemMessagesLead();
+    void contextBudgetKeepsPromptShare();
+    void packContextKeepsPending();
+    void packContextKeepsToolCallsWithResults_data();
+    void packContextKeepsToolCallsWithResults();
+    void packContextDropsUnpairedToolMessages();
+};
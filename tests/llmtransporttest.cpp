@@ -0,0 +1,191 @@
+#include <llmconnectionmodel.h>
+#include <llmtransport.h>
+#include <llmtransporttest.h>
+#include <QNetworkReply>
+#include <QSignalSpy>
+#include <QTest>
+
+// Short enough to wait for, long enough to see the circuit open
+static constexpr int s_threshold = 3;
+static constexpr qint64 s_openInterval = 200;
+
+static inline bool finish(QNetworkReply *reply)
+{
+    if (reply->isFinished()) {
+        return true;
+    }
+    QSignalSpy finished(reply, &QNetworkReply::finished);
+    return finished.wait(5000);
+}
+
+void LLMTransportTest::initTestCase()
+{
+    QVERIFY(m_server.listen(QHostAddress::LocalHost));
+    connect(&m_server, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                // requests without body, the header is complete at the blank line
+                const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                socket->setProperty("request", request);
+                if (!request.contains("\r\n\r\n")) {
+                    return;
+                }
+                if (m_status == 0) {
+                    m_held.append(socket);
+                } else {
+                    answer(socket, m_status);
+                }
+            });
+        }
+    });
+    LLMTransport::instance()->setCircuitPolicy(s_threshold, s_openInterval);
+}
+
+void LLMTransportTest::init()
+{
+    m_status = 503;
+}
+
+void LLMTransportTest::cleanup()
+{
+    release(200);
+}
+
+void LLMTransportTest::cleanupTestCase()
+{
+    LLMTransport::instance()->setCircuitPolicy(LLMTransport::FailureThreshold, LLMTransport::OpenInterval);
+}
+
+QString LLMTransportTest::apiUrl() const
+{
+    return QStringLiteral("http://127.0.0.1:%1/v1").arg(m_server.serverPort());
+}
+
+QNetworkReply *LLMTransportTest::send(const LLMConnection &connection)
+{
+    LLMTransport *transport = LLMTransport::instance();
+    QNetworkRequest request(QUrl(connection.apiUrl() + "/models"));
+    transport->prepare(request);
+    QNetworkReply *reply = transport->manager(&connection)->get(request);
+    transport->track(&connection, reply);
+    connect(reply, &QNetworkReply::finished, reply, &QObject::deleteLater);
+    return reply;
+}
+
+void LLMTransportTest::answer(QTcpSocket *socket, int status)
+{
+    socket->write(QStringLiteral("HTTP/1.1 %1 Status\r\nContent-Length: 0\r\nConnection: close\r\n\r\n").arg(status).toLatin1());
+    socket->disconnectFromHost();
+}
+
+void LLMTransportTest::release(int status)
+{
+    foreach (const QPointer<QTcpSocket> &socket, m_held) {
+        if (socket && socket->state() == QAbstractSocket::ConnectedState) {
+            answer(socket, status);
+        }
+    }
+    m_held.clear();
+}
+
+void LLMTransportTest::circuitOpensAfterFailures()
+{
+    LLMTransport *transport = LLMTransport::instance();
+    const LLMConnection connection("opens", "test", apiUrl(), "", false, true);
+
+    for (int i = 0; i < s_threshold - 1; i++) {
+        QVERIFY(finish(send(connection)));
+    }
+    QVERIFY(transport->isAvailable(&connection));
+
+    QVERIFY(finish(send(connection)));
+    QVERIFY(!transport->isAvailable(&connection));
+    QCOMPARE(transport->stats(&connection).failed, s_threshold);
+    QCOMPARE(transport->stats(&connection).active, 0);
+
+    // the circuit belongs to one server
+    const LLMConnection other("other", "test", apiUrl(), "", false, true);
+    QVERIFY(transport->isAvailable(&other));
+}
+
+void LLMTransportTest::successResetsFailures()
+{
+    LLMTransport *transport = LLMTransport::instance();
+    const LLMConnection connection("resets", "test", apiUrl(), "", false, true);
+
+    for (int i = 0; i < s_threshold - 1; i++) {
+        QVERIFY(finish(send(connection)));
+    }
+    m_status = 200;
+    QVERIFY(finish(send(connection)));
+
+    // failures count in a row only
+    m_status = 503;
+    for (int i = 0; i < s_threshold - 1; i++) {
+        QVERIFY(finish(send(connection)));
+    }
+    QVERIFY(transport->isAvailable(&connection));
+
+    // cancelled requests are not the server's fault
+    m_status = 0;
+    QNetworkReply *cancelled = send(connection);
+    QTRY_COMPARE(m_held.size(), 1);
+    cancelled->setProperty("cancelled", true);
+    cancelled->abort();
+    QVERIFY(transport->isAvailable(&connection));
+}
+
+void LLMTransportTest::probeIsClaimedBySentReply()
+{
+    LLMTransport *transport = LLMTransport::instance();
+    const LLMConnection connection("probe", "test", apiUrl(), "", false, true);
+
+    for (int i = 0; i < s_threshold; i++) {
+        QVERIFY(finish(send(connection)));
+    }
+    QVERIFY(!transport->isAvailable(&connection));
+
+    // sent while open, not a probe
+    m_status = 0;
+    QNetworkReply *early = send(connection);
+
+    // half open, asking does not claim the probe
+    QTest::qWait(s_openInterval + 50);
+    QVERIFY(transport->isAvailable(&connection));
+    QVERIFY(transport->isAvailable(&connection));
+
+    // the next reply tracked is the probe, no other request passes meanwhile
+    QNetworkReply *probe = send(connection);
+    QVERIFY(!transport->isAvailable(&connection));
+    QTRY_COMPARE(m_held.size(), 2);
+
+    // another reply ending does not end the probe
+    early->setProperty("cancelled", true);
+    early->abort();
+    QVERIFY(!transport->isAvailable(&connection));
+
+    // a successful probe closes the circuit
+    release(200);
+    QVERIFY(finish(probe));
+    QVERIFY(transport->isAvailable(&connection));
+}
+
+void LLMTransportTest::failedProbeOpensAgain()
+{
+    LLMTransport *transport = LLMTransport::instance();
+    const LLMConnection connection("reopens", "test", apiUrl(), "", false, true);
+
+    for (int i = 0; i < s_threshold; i++) {
+        QVERIFY(finish(send(connection)));
+    }
+    QTest::qWait(s_openInterval + 50);
+    QVERIFY(transport->isAvailable(&connection));
+
+    QVERIFY(finish(send(connection)));
+    QVERIFY(!transport->isAvailable(&connection));
+
+    // and half open after another interval
+    QTest::qWait(s_openInterval + 50);
+    QVERIFY(transport->isAvailable(&connection));
+}
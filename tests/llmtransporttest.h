@@ -0,0 +1,41 @@
+#pragma once
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+class QNetworkReply;
+class LLMConnection;
+
+/**
+ * @brief Unit tests of the circuit breaker of LLMTransport against a local
+ * server answering with a chosen status.
+ */
+class LLMTransportTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void cleanupTestCase();
+
+    void circuitOpensAfterFailures();
+    void successResetsFailures();
+    void probeIsClaimedBySentReply();
+    void failedProbeOpensAgain();
+
+private:
+    QTcpServer m_server;
+    // answer of the next requests, held back if zero
+    int m_status;
+    QList<QPointer<QTcpSocket>> m_held;
+
+private:
+    QString apiUrl() const;
+    QNetworkReply *send(const LLMConnection &connection);
+    void answer(QTcpSocket *socket, int status);
+    void release(int status);
+};
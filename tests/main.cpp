@@ -0,0 +1,55 @@
+#include <attachmentcachetest.h>
+#include <chathistorystoretest.h>
+#include <chatsearchindextest.h>
+#include <contentbuffertest.h>
+#include <llmchatclienttest.h>
+#include <llmtransporttest.h>
+#include <tokencountertest.h>
+#include <toolcallaccumulatortest.h>
+#include <QApplication>
+#include <QStandardPaths>
+#include <QTest>
+
+// Runs every test class, the exit code is non zero if one failed
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    app.setAttribute(Qt::AA_Use96Dpi, true);
+    // caches and indexes of the singletons stay out of the user's data
+    QStandardPaths::setTestModeEnabled(true);
+
+    int status = 0;
+    {
+        AttachmentCacheTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        ChatHistoryStoreTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        ChatSearchIndexTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        ContentBufferTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        LLMChatClientTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        LLMTransportTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TokenCounterTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        ToolCallAccumulatorTest test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    return status;
+}
@@ -0,0 +1,47 @@
+QT  += core
+QT  += gui
+QT  += widgets
+QT  += concurrent
+QT  += core5compat
+QT  += network
+QT  += testlib
+
+TARGET = tests
+CONFIG += c++17
+CONFIG += console
+CONFIG += testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+# application sources, without main.cpp
+include(../core/core.pri)
+include(../models/models.pri)
+include(../tokenizers/tokenizers.pri)
+include(../ui/ui.pri)
+
+INCLUDEPATH += $$PWD/
+
+HEADERS += \
+    $$PWD/attachmentcachetest.h \
+    $$PWD/chathistorystoretest.h \
+    $$PWD/chatsearchindextest.h \
+    $$PWD/contentbuffertest.h \
+    $$PWD/llmchatclienttest.h \
+    $$PWD/llmtransporttest.h \
+    $$PWD/tokencountertest.h \
+    $$PWD/toolcallaccumulatortest.h
+
+SOURCES += \
+    $$PWD/attachmentcachetest.cpp \
+    $$PWD/chathistorystoretest.cpp \
+    $$PWD/chatsearchindextest.cpp \
+    $$PWD/contentbuffertest.cpp \
+    $$PWD/llmchatclienttest.cpp \
+    $$PWD/llmtransporttest.cpp \
+    $$PWD/tokencountertest.cpp \
+    $$PWD/toolcallaccumulatortest.cpp \
+    $$PWD/main.cpp
+
+RESOURCES += \
+    ../eofaichat.qrc
@@ -0,0 +1,95 @@
+#include <tokencounter.h>
+#include <tokencountertest.h>
+#include <QFile>
+#include <QTest>
+
+// a, b, c, ab, cab, bc by rank
+static const QByteArray s_vocabulary = "YQ== 0\nYg== 1\nYw== 2\nYWI= 3\nY2Fi 4\nYmM= 5\n";
+
+void TokenCounterTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    QFile file(m_dir.filePath("test.tiktoken"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(s_vocabulary);
+}
+
+void TokenCounterTest::pieces_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<QList<QByteArray>>("pieces");
+
+    // as split by the cl100k pattern
+    QTest::newRow("sentence") << QByteArray("Hello world, it's 2024!\n\n  done") //
+                              << QList<QByteArray>{"Hello", " world", ",", " it", "'s", " ", "202", "4", "!\n\n", " ", " done"};
+    QTest::newRow("blank lines") << QByteArray("  \n\tfoo") << QList<QByteArray>{"  \n", "\tfoo"};
+    QTest::newRow("arithmetic") << QByteArray("2 + 2 = 4") << QList<QByteArray>{"2", " +", " ", "2", " =", " ", "4"};
+    // the 8 byte letter scan stops at bytes folding next to the letters
+    QTest::newRow("long word") << QByteArray("internationalization") << QList<QByteArray>{"internationalization"};
+    QTest::newRow("at sign") << QByteArray("abcd@efghijkl") << QList<QByteArray>{"abcd", "@efghijkl"};
+    QTest::newRow("bracket") << QByteArray("abcdefg[hijklmno") << QList<QByteArray>{"abcdefg", "[hijklmno"};
+    QTest::newRow("mixed case") << QByteArray("ABCxyzQRStuv") << QList<QByteArray>{"ABCxyzQRStuv"};
+    QTest::newRow("contractions") << QByteArray("we'll they've") << QList<QByteArray>{"we", "'ll", " they", "'ve"};
+}
+
+void TokenCounterTest::pieces()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(QList<QByteArray>, pieces);
+
+    QCOMPARE(TokenCounter::pieces(text), pieces);
+}
+
+void TokenCounterTest::mergeByRank_data()
+{
+    QTest::addColumn<QByteArray>("text");
+    QTest::addColumn<int>("tokens");
+
+    QTest::newRow("in vocabulary") << QByteArray("cab") << 1;
+    QTest::newRow("single byte") << QByteArray("z") << 1;
+    // ab merges before bc, abc is unknown
+    QTest::newRow("lowest rank first") << QByteArray("abc") << 2;
+    // ab, then cab
+    QTest::newRow("merged again") << QByteArray("cabc") << 2;
+    // leftmost ab first, then cab
+    QTest::newRow("leftmost") << QByteArray("abcab") << 2;
+    // pieces are merged on their own: abc and " abc"
+    QTest::newRow("two pieces") << QByteArray("abc abc") << 5;
+}
+
+void TokenCounterTest::mergeByRank()
+{
+    QFETCH(QByteArray, text);
+    QFETCH(int, tokens);
+
+    const TokenCounter counter(m_dir.filePath("test.tiktoken"));
+    QVERIFY(counter.isLoaded());
+    QCOMPARE(counter.encoding(), QStringLiteral("test"));
+    QCOMPARE(counter.count(text), tokens);
+}
+
+void TokenCounterTest::knownCounts_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<int>("tokens");
+
+    // counts of tiktoken with cl100k_base
+    QTest::newRow("greeting") << QStringLiteral("hello world") << 2;
+    QTest::newRow("punctuation") << QStringLiteral("Hello, world!") << 4;
+    QTest::newRow("subwords") << QStringLiteral("tiktoken is great!") << 6;
+    QTest::newRow("long word") << QStringLiteral("antidisestablishmentarianism") << 6;
+    QTest::newRow("arithmetic") << QStringLiteral("2 + 2 = 4") << 7;
+}
+
+void TokenCounterTest::knownCounts()
+{
+    QFETCH(QString, text);
+    QFETCH(int, tokens);
+
+    const QString fileName = TokenCounter::locate(QStringLiteral("cl100k_base"));
+    if (fileName.isEmpty()) {
+        QSKIP("cl100k_base.tiktoken not installed");
+    }
+    const TokenCounter counter(fileName);
+    QCOMPARE(counter.count(text), tokens);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <QObject>
+#include <QTemporaryDir>
+
+/**
+ * @brief Unit tests of the pre-tokenizer and the BPE merge of TokenCounter.
+ */
+class TokenCounterTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void pieces_data();
+    void pieces();
+    void mergeByRank_data();
+    void mergeByRank();
+    void knownCounts_data();
+    void knownCounts();
+
+private:
+    QTemporaryDir m_dir;
+};
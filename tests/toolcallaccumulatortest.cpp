@@ -0,0 +1,117 @@
+#include <chatmessage.h>
+#include <toolcallaccumulator.h>
+#include <toolcallaccumulatortest.h>
+#include <toolcallentry.h>
+#include <QTest>
+
+Q_DECLARE_METATYPE(JsonStreamValidator::State)
+
+static inline ToolCallEntry delta(int index, const QString &id, const QString &name, const QString &arguments)
+{
+    ToolCallEntry tool;
+    tool.setToolIndex(index);
+    tool.setToolType("function");
+    tool.setToolCallId(id);
+    tool.setFunctionName(name);
+    tool.setArguments(arguments);
+    return tool;
+}
+
+void ToolCallAccumulatorTest::deltasAreMergedByIndex()
+{
+    ToolCallAccumulator accumulator;
+    accumulator.merge(delta(0, "call_a", "read_file", "{\"pa"));
+    accumulator.merge(delta(1, "call_b", "list_dir", "{\"dir\":"));
+    accumulator.merge(delta(0, QString(), QString(), "th\":\"a.txt\"}"));
+    accumulator.merge(delta(1, QString(), QString(), "\".\"}"));
+
+    QCOMPARE(accumulator.count(), 2);
+    QCOMPARE(accumulator.calls()[0].functionName(), QStringLiteral("read_file"));
+    QCOMPARE(accumulator.calls()[0].arguments(), QStringLiteral("{\"path\":\"a.txt\"}"));
+    QCOMPARE(accumulator.calls()[1].toolCallId(), QStringLiteral("call_b"));
+    QCOMPARE(accumulator.calls()[1].arguments(), QStringLiteral("{\"dir\":\".\"}"));
+    QVERIFY(accumulator.isComplete(0));
+    QVERIFY(accumulator.isComplete(1));
+}
+
+void ToolCallAccumulatorTest::lateIdKeepsTheCall()
+{
+    ToolCallAccumulator accumulator;
+    accumulator.merge(delta(0, QString(), "read_file", "{\"path\":"));
+    qsizetype position = -1;
+    accumulator.merge(delta(0, "call_a", QString(), "\"a.txt\"}"), &position);
+
+    QCOMPARE(position, qsizetype(0));
+    QCOMPARE(accumulator.count(), 1);
+    QCOMPARE(accumulator.calls()[0].toolCallId(), QStringLiteral("call_a"));
+    QCOMPARE(accumulator.calls()[0].arguments(), QStringLiteral("{\"path\":\"a.txt\"}"));
+}
+
+void ToolCallAccumulatorTest::completionIsReportedOnce()
+{
+    ToolCallAccumulator accumulator;
+    QVERIFY(!accumulator.merge(delta(0, "call_a", "read_file", "{\"path\":")));
+    QVERIFY(accumulator.merge(delta(0, QString(), QString(), "\"a.txt\"}")));
+    // trailing whitespace of the stream
+    QVERIFY(!accumulator.merge(delta(0, QString(), QString(), " ")));
+    QVERIFY(accumulator.isComplete(0));
+}
+
+void ToolCallAccumulatorTest::setToolCallsReplaces()
+{
+    const ToolCallEntry call = delta(0, "call_a", "read_file", "{\"path\":\"a.txt\"}");
+
+    // a complete list, as loaded from history, twice
+    ChatMessage message(nullptr);
+    message.setToolCalls({call});
+    message.setToolCalls({call});
+    QCOMPARE(message.toolCalls().count(), 1);
+    QCOMPARE(message.toolCalls()[0].arguments(), call.arguments());
+
+    // the copy of a streamed message keeps its arguments
+    ChatMessage streamed(nullptr);
+    streamed.appendToolCallDelta(delta(0, "call_a", "read_file", "{\"path\":"));
+    streamed.appendToolCallDelta(delta(0, QString(), QString(), "\"a.txt\"}"));
+    ChatMessage copy(nullptr);
+    copy.setToolCalls(streamed.toolCalls());
+    QVERIFY(copy.toolCalls() == message.toolCalls());
+
+    // complete calls are appended, not merged
+    copy.addTools({delta(0, "call_b", "list_dir", "{}")});
+    QCOMPARE(copy.toolCalls().count(), 2);
+    QCOMPARE(copy.toolCalls()[0].arguments(), call.arguments());
+}
+
+void ToolCallAccumulatorTest::validatorStates_data()
+{
+    QTest::addColumn<QStringList>("fragments");
+    QTest::addColumn<JsonStreamValidator::State>("state");
+
+    QTest::newRow("empty") << QStringList{QString()} << JsonStreamValidator::Empty;
+    QTest::newRow("open") << QStringList{"{\"path\":\"a"} << JsonStreamValidator::Partial;
+    QTest::newRow("object") << QStringList{"{\"path\"", ":\"a.txt\",", "\"lines\":[1,2.5e3,-3]}"} << JsonStreamValidator::Complete;
+    QTest::newRow("empty object") << QStringList{" {", "} "} << JsonStreamValidator::Complete;
+    QTest::newRow("literals") << QStringList{"[tr", "ue,false,nu", "ll]"} << JsonStreamValidator::Complete;
+    QTest::newRow("escapes") << QStringList{"{\"a\":\"\\\"}\\u00", "e9\\n\"}"} << JsonStreamValidator::Complete;
+    QTest::newRow("nested") << QStringList{"{\"a\":{\"b\":[{}]}}"} << JsonStreamValidator::Complete;
+    QTest::newRow("no colon") << QStringList{"{\"a\" 1}"} << JsonStreamValidator::Invalid;
+    QTest::newRow("trailing comma") << QStringList{"{\"a\":1,}"} << JsonStreamValidator::Invalid;
+    QTest::newRow("key not string") << QStringList{"{a:1}"} << JsonStreamValidator::Invalid;
+    QTest::newRow("mismatch") << QStringList{"{\"a\":[1}"} << JsonStreamValidator::Invalid;
+    QTest::newRow("bad literal") << QStringList{"[tru", "e", "x]"} << JsonStreamValidator::Invalid;
+    QTest::newRow("bad escape") << QStringList{"{\"a\":\"\\x\"}"} << JsonStreamValidator::Invalid;
+    QTest::newRow("not container") << QStringList{"\"text\""} << JsonStreamValidator::Invalid;
+    QTest::newRow("after value") << QStringList{"{}", "{}"} << JsonStreamValidator::Invalid;
+}
+
+void ToolCallAccumulatorTest::validatorStates()
+{
+    QFETCH(QStringList, fragments);
+    QFETCH(JsonStreamValidator::State, state);
+
+    JsonStreamValidator validator;
+    foreach (const QString &fragment, fragments) {
+        validator.feed(fragment);
+    }
+    QCOMPARE(validator.state(), state);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <QObject>
+
+/**
+ * @brief Unit tests of the streamed tool call merge and its JSON check.
+ */
+class ToolCallAccumulatorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void deltasAreMergedByIndex();
+    void lateIdKeepsTheCall();
+    void completionIsReportedOnce();
+    void setToolCallsReplaces();
+    void validatorStates_data();
+    void validatorStates();
+};
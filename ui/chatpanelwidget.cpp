@@ -1,15 +1,20 @@
 #include <attachbutton.h>
+#include <attachmentcache.h>
 #include <chatpanelwidget.h>
 #include <chattextwidget.h>
+#include <comparedialog.h>
 #include <filelistmodel.h>
 #include <filelistwidget.h>
 #include <filenamelabel.h>
 #include <llmconnectionmodel.h>
+#include <llmmetrics.h>
 #include <mainwindow.h>
 #include <progresspopup.h>
 #include <settingsmanager.h>
+#include <tokencounter.h>
 #include <toolservice.h>
 #include <toolswidget.h>
+#include <tracebuffer.h>
 #include <QApplication>
 #include <QComboBox>
 #include <QCoreApplication>
@@ -19,11 +24,14 @@
 #include <QDockWidget>
 #include <QDragEnterEvent>
 #include <QDropEvent>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QGridLayout>
 #include <QHBoxLayout>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QKeyEvent>
@@ -31,6 +39,7 @@
 #include <QMainWindow>
 #include <QMessageBox>
 #include <QMimeData>
+#include <QPointer>
 #include <QScrollArea>
 #include <QScrollBar>
 #include <QSplitter>
@@ -41,6 +50,7 @@
 #include <QUrl>
 #include <QUuid>
 #include <QVBoxLayout>
+#include <QtConcurrent/QtConcurrent>
 
 ChatPanelWidget::ChatPanelWidget(LLMConnection *connection, SyntaxColorModel *scModel, ToolModel *tModel, QWidget *parent)
     : QWidget(parent)
@@ -49,8 +59,11 @@ ChatPanelWidget::ChatPanelWidget(LLMConnection *connection, SyntaxColorModel *sc
     , m_llmClient(new LLMChatClient(tModel, this))
     , m_syntaxModel(scModel)
     , m_toolModel(tModel)
+    , m_toolSpeculator(new ToolSpeculator(tModel, this))
     , m_fileListModel(new FileListModel(this))
     , m_isConversating(false)
+    , m_attachmentTokens(0)
+    , m_attachmentGeneration(0)
 {
     // fixed layout height
     setMinimumHeight(640);
@@ -103,6 +116,21 @@ ChatPanelWidget::ChatPanelWidget(LLMConnection *connection, SyntaxColorModel *sc
         settings->saveSplitterPosition("chat", splitter);
     });
 
+    // Failed requests are sent again, then moved to another server
+    m_llmClient->setRetryPolicy( //
+        settings->value("network/maxRetries", LLMChatClient::DefaultMaxRetries).toInt(),
+        settings->value("network/retryBaseDelay", LLMChatClient::RetryBaseDelay).toInt(),
+        settings->value("network/maxRetryDelay", LLMChatClient::MaxRetryDelay).toInt());
+    LLMConnectionModel *connections = MainWindow::window()->llmConnections();
+    const auto updateFailover = [this, connections]() { //
+        m_llmClient->setFailoverConnections(connections->getAllConnections());
+    };
+    connect(connections, &LLMConnectionModel::dataChanged, this, updateFailover);
+    connect(connections, &LLMConnectionModel::rowsInserted, this, updateFailover);
+    connect(connections, &LLMConnectionModel::rowsRemoved, this, updateFailover);
+    connect(connections, &LLMConnectionModel::modelReset, this, updateFailover);
+    QTimer::singleShot(10, this, updateFailover);
+
     // Connect LLM server
     if (m_activeConnection && m_activeConnection->isValid()) {
         QTimer::singleShot(10, this, [this]() {
@@ -182,9 +210,116 @@ inline QWidget *ChatPanelWidget::createFileListWidget(QWidget *parent)
     widget->setModel(m_fileListModel);
     widget->setVisible(false);
 
+    // attachments are counted once when the list changes
+    connect(m_fileListModel, &FileListModel::added, this, [this]() { //
+        countAttachments();
+    });
+    connect(m_fileListModel, &FileListModel::removed, this, [this]() { //
+        countAttachments();
+    });
+
     return widget;
 }
 
+inline void ChatPanelWidget::countAttachments()
+{
+    // cached files cost a stat, the others are read on a worker
+    AttachmentCache *cache = AttachmentCache::instance();
+    QStringList uncached;
+    m_attachmentTokens = 0;
+    for (int i = 0; i < m_fileListModel->rowCount(); i++) {
+        const AttachmentCache::Entry entry = cache->cached(m_fileListModel->filePath(i));
+        if (entry.tokens >= 0) {
+            m_attachmentTokens += entry.tokens;
+        } else if (!entry.fileName.isEmpty()) {
+            uncached.append(entry.fileName);
+        }
+    }
+    m_tokenTimer->start();
+
+    const quint64 generation = ++m_attachmentGeneration;
+    if (uncached.isEmpty()) {
+        return;
+    }
+
+    QFutureWatcher<QList<AttachmentCache::Entry>> *watcher = new QFutureWatcher<QList<AttachmentCache::Entry>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        const QList<AttachmentCache::Entry> entries = watcher->result();
+        foreach (const AttachmentCache::Entry &entry, entries) {
+            AttachmentCache::instance()->insert(entry);
+        }
+        // counts of an outdated list are cached for the next one
+        if (generation != m_attachmentGeneration) {
+            return;
+        }
+        foreach (const AttachmentCache::Entry &entry, entries) {
+            m_attachmentTokens += qMax(0, entry.tokens);
+        }
+        m_tokenTimer->start();
+    });
+    watcher->setFuture(QtConcurrent::run([uncached]() {
+        QList<AttachmentCache::Entry> entries;
+        foreach (const QString &fileName, uncached) {
+            entries.append(AttachmentCache::scan(fileName));
+        }
+        return entries;
+    }));
+}
+
+inline void ChatPanelWidget::cacheAttachments(const std::function<void()> &ready)
+{
+    // files of the question and of the history sent with it, uncached ones
+    // are read on a worker so sending does not wait on the GUI thread
+    AttachmentCache *cache = AttachmentCache::instance();
+    QStringList fileNames;
+    for (int i = 0; i < m_fileListModel->rowCount(); i++) {
+        fileNames.append(m_fileListModel->filePath(i));
+    }
+    for (int i = 0; i < m_chatModel->rowCount(); i++) {
+        foreach (const QJsonValue &value, m_chatModel->messageAt(i)->attachments()) {
+            fileNames.append(value.toObject().value("file").toString());
+        }
+    }
+    QStringList uncached;
+    foreach (const QString &fileName, fileNames) {
+        const AttachmentCache::Entry entry = cache->cached(fileName);
+        if (entry.tokens < 0 && !entry.fileName.isEmpty() && !uncached.contains(entry.fileName)) {
+            uncached.append(entry.fileName);
+        }
+    }
+    if (uncached.isEmpty()) {
+        ready();
+        return;
+    }
+
+    // the question stays as it is until the files are read
+    m_sendButton->setEnabled(false);
+    m_compareButton->setEnabled(false);
+    m_messageInput->setEnabled(false);
+    m_attachButton->setEnabled(false);
+
+    QFutureWatcher<QList<AttachmentCache::Entry>> *watcher = new QFutureWatcher<QList<AttachmentCache::Entry>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, ready]() {
+        watcher->deleteLater();
+        foreach (const AttachmentCache::Entry &entry, watcher->result()) {
+            AttachmentCache::instance()->insert(entry);
+        }
+        m_sendButton->setEnabled(true);
+        m_compareButton->setEnabled(true);
+        m_messageInput->setEnabled(true);
+        m_attachButton->setEnabled(true);
+        ready();
+    });
+    watcher->setFuture(QtConcurrent::run([uncached]() {
+        QList<AttachmentCache::Entry> entries;
+        foreach (const QString &fileName, uncached) {
+            entries.append(AttachmentCache::scan(fileName));
+        }
+        return entries;
+    }));
+}
+
 inline QWidget *ChatPanelWidget::createInputWidget(QWidget *parent)
 {
     m_messageInput = new QTextEdit(parent);
@@ -202,9 +337,19 @@ inline QWidget *ChatPanelWidget::createInputWidget(QWidget *parent)
         QSizePolicy::Policy::Expanding,
         QSizePolicy::Policy::MinimumExpanding);
 
+    // token count is updated once typing pauses
+    m_tokenTimer = new QTimer(this);
+    m_tokenTimer->setSingleShot(true);
+    m_tokenTimer->setInterval(250);
+    connect(m_tokenTimer, &QTimer::timeout, this, [this]() { //
+        updateTokenCount();
+    });
+
     connect(m_messageInput, &QTextEdit::textChanged, this, [this]() { //
         QTextDocument *doc = m_messageInput->document();
         m_sendButton->setEnabled(doc->isModified() && m_llmClient->hasLLModels());
+        m_compareButton->setEnabled(m_sendButton->isEnabled());
+        m_tokenTimer->start();
     });
 
     return m_messageInput;
@@ -233,46 +378,38 @@ inline QWidget *ChatPanelWidget::createLLMSelector(QWidget *parent)
         QSizePolicy::Expanding,
         QSizePolicy::Fixed);
 
+    // rows follow the diff of ModelListModel::loadFrom(), the current
+    // model keeps its row when lists are revalidated in the background
+    comboBox->setModel(m_llmClient->modelList());
+
     connect(comboBox, &QComboBox::currentIndexChanged, this, [this, comboBox](int index) {
         if (index < 0 || index >= comboBox->count())
             return;
-        QVariant data = comboBox->itemData(index);
+        QVariant data = comboBox->itemData(index, ModelListModel::ModelEntryRole);
         if (data.canConvert<ModelListModel::ModelEntry>()) {
             m_llmClient->setActiveModel(data.value<ModelListModel::ModelEntry>());
         }
     });
 
-    // Connect LLM list model - fill model selection
+    // Connect LLM list model - update model selection
     connect(m_llmClient->modelList(), &ModelListModel::modelsLoaded, this, [this, comboBox]() {
-        QTimer::singleShot(10, this, [this, comboBox]() {
-            if (ModelListModel *list = m_llmClient->modelList()) {
-                comboBox->clear();
-                // Fill Model selection QComboBox
-                for (int i = 0; i < list->rowCount(); i++) {
-                    QModelIndex index = list->index(i, 0);
-                    QVariant v = list->data(index, ModelListModel::ModelEntryRole);
-                    if (!v.isNull() && v.isValid()) {
-                        ModelListModel::ModelEntry entry = //
-                            v.value<ModelListModel::ModelEntry>();
-                        comboBox->addItem(entry.id, QVariant::fromValue(entry));
-                    }
-                }
-                // Select first model by default
-                if (comboBox->count() > 0) {
-                    comboBox->setCurrentIndex(0);
-                    // Save selected model entry
-                    QVariant data = comboBox->itemData(0);
-                    if (data.canConvert<ModelListModel::ModelEntry>()) {
-                        m_llmClient->setActiveModel(data.value<ModelListModel::ModelEntry>());
-                    }
-                }
+        // Select the former or the first model
+        if (comboBox->count() > 0) {
+            const int former = comboBox->findData(m_llmClient->activeModel().id, ModelListModel::IdRole);
+            const int selected = (former >= 0 ? former : qMax(0, comboBox->currentIndex()));
+            comboBox->setCurrentIndex(selected);
+            // Save selected model entry, its context length may have changed
+            QVariant data = comboBox->itemData(selected, ModelListModel::ModelEntryRole);
+            if (data.canConvert<ModelListModel::ModelEntry>()) {
+                m_llmClient->setActiveModel(data.value<ModelListModel::ModelEntry>());
             }
-            // unlock if model available
-            m_messageInput->setEnabled(comboBox->count() > 0);
-            m_sendButton->setEnabled(comboBox->count() > 0);
-            m_attachButton->setEnabled(comboBox->count() > 0);
-            comboBox->setEnabled(comboBox->count() > 0);
-        });
+        }
+        // unlock if model available
+        m_messageInput->setEnabled(comboBox->count() > 0);
+        m_sendButton->setEnabled(comboBox->count() > 0);
+        m_compareButton->setEnabled(comboBox->count() > 0);
+        m_attachButton->setEnabled(comboBox->count() > 0);
+        comboBox->setEnabled(comboBox->count() > 0);
     });
 
     modelLayout->addWidget(modelLabel);
@@ -292,10 +429,15 @@ inline QWidget *ChatPanelWidget::createButtonBox(QWidget *parent)
     buttonLayout->setSpacing(12);
     // Align layout to the right
     buttonLayout->setAlignment(Qt::AlignRight);
+    // Size of the message to send
+    m_tokenLabel = new QLabel(container);
+    m_tokenLabel->setObjectName("tokenLabel");
+    buttonLayout->addWidget(m_tokenLabel);
     // First add spacer to push buttons to the right
     buttonLayout->addStretch();
     buttonLayout->addWidget(createAttachButton(container));
     buttonLayout->addWidget(createToolsButton(container));
+    buttonLayout->addWidget(createCompareButton(container));
     buttonLayout->addWidget(createSendButton(container));
 
     container->setLayout(buttonLayout);
@@ -398,83 +540,150 @@ inline QPushButton *ChatPanelWidget::createSendButton(QWidget *parent)
         // check in conversation
         if (m_isConversating) {
             m_llmClient->cancelRequest();
+            m_toolSpeculator->clear();
             onHideProgressPopup();
             return;
         }
+        cacheAttachments([this]() { //
+            sendQuestion();
+        });
+    });
 
-        QList<LLMChatClient::SendParameters> messages;
-#if 0
-        // Chat history
-        for (int i = 0; i < m_chatModel->rowCount(); i++) {
-            ChatMessage *cm = m_chatModel->messageAt(i);
-            if (cm->isUser()) {
-                messages.append({
-                    .role = cm->role(),
-                    .content = cm->content(),
-                });
-            } else {
-                foreach (auto t, cm->toolCalls()) {
-                    messages.append({
-                        .role = cm->role(),
-                        .toolName = t.functionName(),
-                        .toolQuery = t.functionName(),
-                        .toolResult = cm->toolContent(),
-                    });
-                }
-            }
-        }
-#endif
-        // new user question
-        QStringList text;
+    return m_sendButton;
+}
 
-        QByteArray question = m_messageInput->toPlainText().trimmed().toUtf8();
-        if (question.isEmpty())
-            return;
-        text.append(question);
-
-        // load file attachments
-        if (m_fileListModel->rowCount() > 0) {
-            QByteArray content;
-            for (int i = 0; i < m_fileListModel->rowCount(); i++) {
-                if (FileItem *_item = dynamic_cast<FileItem *>(m_fileListModel->item(i))) {
-                    text.append(QStringLiteral("#File name: %1").arg(_item->fileInfo().absoluteFilePath()));
-                    text.append(m_fileListModel->readFileContent(i));
-                }
-            }
-        }
+inline void ChatPanelWidget::sendQuestion()
+{
+    QJsonArray attachmentRefs;
+    QList<LLMChatClient::SendParameters> messages = pendingMessages(attachmentRefs);
+    if (messages.isEmpty())
+        return;
+    const QString question = messages.last().content;
+
+    // earlier conversation, as much as fits the context window
+    messages = m_llmClient->packContext(m_chatModel, messages);
 
-        messages.append({
-            .role = ChatMessage::Role::UserRole,
-            .content = text.join("\n"),
+    // Add sender bubble
+    appendQuestion(question, attachmentRefs, m_llmClient->activeModel().id);
+
+    // Clear input
+    m_fileListModel->clear();
+    m_messageInput->clear();
+
+    // Show progress popup
+    // onShowProgressPopup();
+
+    m_sendButton->setText(tr("Stop"));
+    m_compareButton->setEnabled(false);
+    m_messageInput->setEnabled(false);
+    m_attachButton->setEnabled(false);
+    m_isConversating = true;
+
+    // Send JSON to LLM server
+    m_llmClient->sendChat(messages, true);
+}
+
+inline QPushButton *ChatPanelWidget::createCompareButton(QWidget *parent)
+{
+    m_compareButton = new QPushButton(tr("Compare"), parent);
+    m_compareButton->setEnabled(false);
+
+    connect(m_compareButton, &QPushButton::clicked, this, [this]() {
+        if (m_isConversating)
+            return;
+        cacheAttachments([this]() { //
+            compareQuestion();
         });
+    });
+
+    return m_compareButton;
+}
 
-        // Add sender bubble
-        ChatMessage cm(m_chatModel);
-        cm.setContent(question);
-        cm.setRole(ChatMessage::Role::ChatRole);
-        cm.setId(QStringLiteral("CPW-%1").arg(QUuid::createUuid().toString(QUuid::WithoutBraces)));
-        cm.setSystemFingerprint(cm.id());
-        cm.setCreated(QDateTime::currentDateTime().time().msecsSinceStartOfDay());
-        cm.setModel(m_llmClient->activeModel().id);
-        m_chatModel->appendMessage(cm);
-
-        // Clear input
+inline void ChatPanelWidget::compareQuestion()
+{
+    QJsonArray attachmentRefs;
+    QList<LLMChatClient::SendParameters> messages = pendingMessages(attachmentRefs);
+    if (messages.isEmpty())
+        return;
+    const QString question = messages.last().content;
+    messages = m_llmClient->packContext(m_chatModel, messages);
+
+    // same prompt to several models, the chosen answer continues the chat
+    CompareDialog *dialog = new CompareDialog(m_toolModel, MainWindow::window()->llmConnections(), messages, this);
+    connect(dialog, &CompareDialog::answerSelected, this, [this, question, attachmentRefs](const ChatMessage *message) {
+        appendQuestion(question, attachmentRefs, message->model());
+        m_chatModel->appendMessage(*message);
         m_fileListModel->clear();
         m_messageInput->clear();
+    });
+    dialog->show();
+}
 
-        // Show progress popup
-        // onShowProgressPopup();
-
-        m_sendButton->setText(tr("Stop"));
-        m_messageInput->setEnabled(false);
-        m_attachButton->setEnabled(false);
-        m_isConversating = true;
+inline QList<LLMChatClient::SendParameters> ChatPanelWidget::pendingMessages(QJsonArray &attachmentRefs)
+{
+    QList<LLMChatClient::SendParameters> messages;
+    // new user question
+    QStringList text;
+
+    QByteArray question = m_messageInput->toPlainText().trimmed().toUtf8();
+    if (question.isEmpty())
+        return messages;
+    text.append(question);
+
+    // file attachments are streamed from disk when the request is sent,
+    // the content hash lets later turns send unchanged files only once
+    QStringList attachments;
+    for (int i = 0; i < m_fileListModel->rowCount(); i++) {
+        if (FileItem *_item = dynamic_cast<FileItem *>(m_fileListModel->item(i))) {
+            const QString fileName = _item->fileInfo().absoluteFilePath();
+            const AttachmentCache::Entry entry = AttachmentCache::instance()->entry(fileName);
+            attachments.append(fileName);
+            attachmentRefs.append(QJsonObject{
+                {"file", fileName},
+                {"hash", QString::number(entry.hash, 16)},
+            });
+        }
+    }
 
-        // Send JSON to LLM server
-        m_llmClient->sendChat(messages, true);
+    messages.append({
+        .role = ChatMessage::Role::UserRole,
+        .content = text.join("\n"),
+        .attachments = attachments,
     });
+    return messages;
+}
 
-    return m_sendButton;
+inline void ChatPanelWidget::appendQuestion(const QString &question, const QJsonArray &attachmentRefs, const QString &model)
+{
+    ChatMessage cm(m_chatModel);
+    cm.setContent(question);
+    cm.setRole(ChatMessage::Role::ChatRole);
+    cm.setId(QStringLiteral("CPW-%1").arg(QUuid::createUuid().toString(QUuid::WithoutBraces)));
+    cm.setSystemFingerprint(cm.id());
+    cm.setCreated(QDateTime::currentDateTime().time().msecsSinceStartOfDay());
+    cm.setModel(model);
+    cm.setAttachments(attachmentRefs);
+    m_chatModel->appendMessage(cm);
+}
+
+inline void ChatPanelWidget::updateTokenCount()
+{
+    const TokenCounter *counter = TokenCounter::instance();
+    const int tokens = counter->count(m_messageInput->toPlainText()) + m_attachmentTokens;
+    if (tokens == 0) {
+        m_tokenLabel->clear();
+        return;
+    }
+
+    // estimated without a vocabulary
+    const QString count = (counter->isLoaded() ? QString::number(tokens) : QStringLiteral("~%1").arg(tokens));
+    const int contextLength = m_llmClient->activeModel().contextLength;
+    if (contextLength > 0) {
+        m_tokenLabel->setText(tr("%1 / %2 tokens").arg(count).arg(contextLength));
+    } else {
+        m_tokenLabel->setText(tr("%1 tokens").arg(count));
+    }
+    m_tokenLabel->setToolTip(counter->isLoaded() ? counter->encoding() : tr("Estimated, no tokenizer vocabulary installed"));
 }
 
 // ---------------- Key Press Event ----------------
@@ -528,33 +737,92 @@ void ChatPanelWidget::onConnectionChanged(LLMConnection *connection)
 
 // ---------------- Chat Message Events ----------------------------
 
+bool ChatPanelWidget::openHistory(const QString &fileName)
+{
+    if (!m_chatModel->openHistory(fileName)) {
+        return false;
+    }
+
+    // fill the view if the last page does not need a scroll bar yet
+    QTimer::singleShot(10, this, [this]() { //
+        if (m_chatView->verticalScrollBar()->maximum() == 0) {
+            onFetchOlderMessages();
+        }
+    });
+
+    return true;
+}
+
+void ChatPanelWidget::showMessage(int messageIndex)
+{
+    // older pages first, a search hit may be far up in the history
+    while (messageIndex < m_chatModel->baseIndex() && m_chatModel->canFetchMore(QModelIndex())) {
+        m_chatModel->fetchMore(QModelIndex());
+    }
+    ChatMessage *message = m_chatModel->messageAt(messageIndex - m_chatModel->baseIndex());
+    if (!message) {
+        return;
+    }
+
+    // once the view laid out the inserted pages
+    QPointer<ChatMessage> target(message);
+    QTimer::singleShot(0, this, [this, target]() {
+        if (target) {
+            m_chatView->scrollToMessage(target);
+        }
+    });
+}
+
+void ChatPanelWidget::onFetchOlderMessages()
+{
+    if (m_chatModel->canFetchMore(QModelIndex())) {
+        m_chatModel->fetchMore(QModelIndex());
+    }
+}
+
 void ChatPanelWidget::onUpdateChatText(int index, ChatMessage *message)
 {
     qDebug().noquote() << "[ChatPanelWidget] onUpdateChatText index:" << index //
-                       << "id:" << message->id() << "msg:" << message->content();
+                       << "id:" << message->id() << "length:" << message->contentLength();
     // ensure UI thread
     //QTimer::singleShot(10, this, [index, message, this]() {
+    QElapsedTimer timer;
+    timer.start();
+    TraceScope scope("appendMessage", "render");
     m_chatView->appendMessage(message);
+    LLMMetrics::instance()->addRenderTime(timer.nsecsElapsed());
     //});
 }
 
 inline void ChatPanelWidget::connectChatModel()
 {
     connect(m_chatModel, &ChatModel::messageAdded, this, [this](ChatMessage *message) { //
+        TraceBuffer::instance()->instant("messageAdded", "ChatModel");
         onUpdateChatText(-1, message);
     });
     connect(m_chatModel, &ChatModel::messageChanged, this, [this](ChatMessage *message, int index) { //
+        TraceBuffer::instance()->instant("messageChanged", "ChatModel");
         onUpdateChatText(index, message);
     });
     connect(m_chatModel, &ChatModel::messageRemoved, this, [](int) { //
-        //
+        TraceBuffer::instance()->instant("messageRemoved", "ChatModel");
+    });
+    // Older history pages loaded on scroll
+    connect(m_chatModel, &ChatModel::messagesPrepended, m_chatView, &ChatTextWidget::prependMessages);
+    connect(m_chatView->verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) { //
+        if (value == m_chatView->verticalScrollBar()->minimum()) {
+            onFetchOlderMessages();
+        }
     });
     // Get notified about message parser events
     connect(m_chatModel, &ChatModel::streamCompleted, this, &ChatPanelWidget::onHideProgressPopup, Qt::QueuedConnection);
     connect(m_chatModel, &ChatModel::toolRequest, this, &ChatPanelWidget::onToolRequest, Qt::QueuedConnection);
+    // Start read-only tools as soon as their arguments are complete
+    connect(m_chatModel, &ChatModel::toolCallCompleted, m_toolSpeculator, &ToolSpeculator::onToolCallCompleted, Qt::QueuedConnection);
+    connect(m_chatModel, &ChatModel::streamCompleted, m_toolSpeculator, &ToolSpeculator::clear, Qt::QueuedConnection);
 }
 
-inline void ChatPanelWidget::reportLLMError(QNetworkReply::NetworkError error, const QString &message)
+inline void ChatPanelWidget::reportLLMError(quint64 id, QNetworkReply::NetworkError error, const QString &message)
 {
     qCritical().noquote() << "[ChatPanelWidget]" << message << error;
 
@@ -567,7 +835,11 @@ inline void ChatPanelWidget::reportLLMError(QNetworkReply::NetworkError error, c
     cm.setContent(QStringLiteral("Error: %1\n%2").arg(error).arg(message));
 
     m_chatModel->appendMessage(cm);
-    m_llmClient->cancelRequest();
+    // other requests of this chat keep running
+    if (id != 0) {
+        m_llmClient->cancelRequest(id);
+        m_toolSpeculator->clear();
+    }
 
     QTimer::singleShot(10, this, [this]() { //
         onHideProgressPopup();
@@ -576,15 +848,15 @@ inline void ChatPanelWidget::reportLLMError(QNetworkReply::NetworkError error, c
 
 inline void ChatPanelWidget::connectLLMClient()
 {
-    connect(m_llmClient, &LLMChatClient::networkError, this, [this](QNetworkReply::NetworkError error, const QString &message) { //
-        reportLLMError(error, message);
+    // failed model list refreshes are only logged, they must not stop a chat
+    connect(m_llmClient, &LLMChatClient::requestFailed, this, [this](quint64 id, QNetworkReply::NetworkError error, const QString &message) { //
+        reportLLMError(id, error, message);
     });
     connect(m_llmClient, &LLMChatClient::errorOccurred, this, [this](const QString &message) { //
-        reportLLMError(QNetworkReply::NetworkError::OperationCanceledError, message);
+        reportLLMError(0, QNetworkReply::NetworkError::OperationCanceledError, message);
     });
-    // Link incomming data from LLM to chat model
-    connect(m_llmClient, &LLMChatClient::parseDataStream, m_chatModel, &ChatModel::onParseDataStream);
-    connect(m_llmClient, &LLMChatClient::parseDataObject, m_chatModel, &ChatModel::onParseMessageObject);
+    // Link incomming data from LLM to chat model, per request
+    m_llmClient->setChatModel(m_chatModel);
 }
 
 // ---------------- Progress Popup Methods ----------------------
@@ -617,6 +889,7 @@ void ChatPanelWidget::onHideProgressPopup()
     if (m_llmClient->hasLLModels()) {
         m_sendButton->setText(tr("Send"));
         m_sendButton->setEnabled(true);
+        m_compareButton->setEnabled(true);
         m_messageInput->setEnabled(true);
         m_attachButton->setEnabled(true);
     }
@@ -709,7 +982,10 @@ void ChatPanelWidget::onToolRequest(ChatMessage *message, const ToolCallEntry &t
 
     switch (toolCall.toolType()) {
         case ToolCallEntry::ToolType::Function: {
-            toolResult = toolService.execute(tool, toolCall.arguments());
+            // reuse result of a read-only tool started while streaming
+            if (!m_toolSpeculator->take(message->id(), toolCall, toolResult)) {
+                toolResult = toolService.execute(tool, toolCall.arguments());
+            }
             break;
         }
         case ToolCallEntry::ToolType::Resuource: {
@@ -789,6 +1065,8 @@ finish:
     cm.setCreated(QDateTime::currentDateTime().time().msecsSinceStartOfDay());
     cm.setModel(m_llmClient->activeModel().id);
     cm.setToolContent(buffer);
+    // the call answered, pairs the result with it when the history is packed
+    cm.setToolCalls({toolCall});
 
     if (errmsg.length() > 0) {
         cm.setContent(tr("Tool(%1:%2:%3) call failed.%4") //
@@ -811,6 +1089,8 @@ finish:
         .toolName = tool.name,
         .toolQuery = tool.title + "(" + tool.description + ")",
         .toolResult = buffer,
+        .toolCallId = toolCall.toolCallId(),
     };
-    m_llmClient->sendChat(params, true);
+    // conversation so far without the tool message just added
+    m_llmClient->sendChat(m_llmClient->packContext(m_chatModel, {params}, m_chatModel->rowCount() - 1), true);
 }
@@ -7,11 +7,15 @@
 #include <progresspopup.h>
 #include <syntaxcolormodel.h>
 #include <toolmodel.h>
+#include <toolspeculator.h>
 #include <QDragEnterEvent>
 #include <QDropEvent>
+#include <QJsonArray>
 #include <QKeyEvent>
+#include <QLabel>
 #include <QPushButton>
 #include <QTextEdit>
+#include <QTimer>
 #include <QWidget>
 
 class ChatPanelWidget : public QWidget
@@ -21,6 +25,10 @@ class ChatPanelWidget : public QWidget
 public:
     explicit ChatPanelWidget(LLMConnection *connection, SyntaxColorModel *scModel, ToolModel *tModel, QWidget *parent = nullptr);
     inline ChatModel *chatModel() { return m_chatModel; }
+    inline ChatTextWidget *chatView() { return m_chatView; }
+    bool openHistory(const QString &fileName);
+    // Loads the history up to an absolute message index and scrolls to it
+    void showMessage(int messageIndex);
 
 protected:
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -36,6 +44,7 @@ signals:
 private slots:
     void onUpdateChatText(int index, ChatMessage *message);
     void onToolRequest(ChatMessage *message, const ToolCallEntry &tool);
+    void onFetchOlderMessages();
     void onHideProgressPopup();
     void onShowProgressPopup();
 
@@ -44,6 +53,9 @@ private:
     ChatTextWidget *m_chatView;
     QTextEdit *m_messageInput;
     QPushButton *m_sendButton;
+    QPushButton *m_compareButton;
+    QLabel *m_tokenLabel;
+    QTimer *m_tokenTimer;
     AttachButton *m_attachButton;
     // Model to hold chat messages
     ChatModel *m_chatModel;
@@ -55,6 +67,8 @@ private:
     SyntaxColorModel *m_syntaxModel;
     // LLM Tooling
     ToolModel *m_toolModel;
+    // Early execution of read-only tools while streaming
+    ToolSpeculator *m_toolSpeculator;
     // File list model and widget
     FileListModel *m_fileListModel;
     // Progress popup widget
@@ -63,18 +77,30 @@ private:
     QString m_lastDirectory;
     // on action
     bool m_isConversating;
+    // token count of the attached files
+    int m_attachmentTokens;
+    // outdates the counts of a former attachment list
+    quint64 m_attachmentGeneration;
 
 private:
     inline QWidget *createChatArea(QWidget *);
     inline QWidget *createInputArea(QWidget *);
     inline QWidget *createFileListWidget(QWidget *);
+    inline void countAttachments();
+    inline void cacheAttachments(const std::function<void()> &ready);
     inline QWidget *createInputWidget(QWidget *);
     inline QWidget *createLLMSelector(QWidget *);
     inline QWidget *createButtonBox(QWidget *);
     inline AttachButton *createAttachButton(QWidget *);
     inline QPushButton *createToolsButton(QWidget *);
+    inline QPushButton *createCompareButton(QWidget *);
     inline QPushButton *createSendButton(QWidget *);
-    inline void reportLLMError(QNetworkReply::NetworkError error, const QString &message);
+    inline void sendQuestion();
+    inline void compareQuestion();
+    inline QList<LLMChatClient::SendParameters> pendingMessages(QJsonArray &attachmentRefs);
+    inline void appendQuestion(const QString &question, const QJsonArray &attachmentRefs, const QString &model);
+    inline void updateTokenCount();
+    inline void reportLLMError(quint64 id, QNetworkReply::NetworkError error, const QString &message);
     inline void connectLLMClient();
     inline void connectChatModel();
 };
@@ -1,5 +1,6 @@
 #include <chattexttokenizer.h>
 #include <chattextwidget.h>
+#include <QAbstractTextDocumentLayout>
 #include <QBrush>
 #include <QDebug>
 #include <QDir>
@@ -104,6 +105,19 @@ void ChatTextWidget::removeMessage(ChatMessage *message)
     Q_UNUSED(message)
 }
 
+void ChatTextWidget::scrollToMessage(ChatMessage *message)
+{
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next()) {
+        BlockData *data = static_cast<BlockData *>(block.userData());
+        if (data && data->message() == message) {
+            QTextCursor cursor(block);
+            setTextCursor(cursor);
+            verticalScrollBar()->setValue(qRound(document()->documentLayout()->blockBoundingRect(block).top()));
+            return;
+        }
+    }
+}
+
 #if 0
 void ChatTextWidget::updateMessage(ChatMessage *message)
 {
@@ -144,12 +158,12 @@ void ChatTextWidget::updateMessage(ChatMessage *message)
 
 void ChatTextWidget::appendMessage(ChatMessage *message)
 {
-    if (!message || message->content().isEmpty()) {
+    if (!message || !message->hasContent()) {
         return;
     }
 
     qDebug().noquote() << "[ChatTextWidget] adding:" //
-                       << message->id() << "msg:" << message->content();
+                       << message->id() << "length:" << message->contentLength();
 
     // user question and tool information
     if (message->role() == ChatMessage::ChatRole    //
@@ -167,6 +181,39 @@ void ChatTextWidget::appendMessage(ChatMessage *message)
     }
 }
 
+void ChatTextWidget::prependMessages(const QList<ChatMessage *> &messages)
+{
+    if (messages.isEmpty()) {
+        return;
+    }
+
+    // keep the visible part in place while content grows above it
+    QScrollBar *scrollBar = verticalScrollBar();
+    const int fromBottom = scrollBar->maximum() - scrollBar->value();
+
+    // empty block in front of the existing content receives the page
+    QTextCursor cursor(document());
+    cursor.setVisualNavigation(true);
+    cursor.movePosition(QTextCursor::Start);
+    cursor.insertBlock();
+    cursor.movePosition(QTextCursor::PreviousBlock);
+
+    foreach (ChatMessage *message, messages) {
+        if (!message || !message->hasContent()) {
+            continue;
+        }
+        // same selection as appendMessage for completed history
+        if (message->role() == ChatMessage::ChatRole    //
+            || message->role() == ChatMessage::UserRole //
+            || message->role() == ChatMessage::ToolingRole //
+            || message->finishReason() == "stop") {
+            insertMarkdown(&cursor, message);
+        }
+    }
+
+    scrollBar->setValue(scrollBar->maximum() - fromBottom);
+}
+
 QVector<Token> ChatTextWidget::tokenizeCode(const QString &code, const QString &language)
 {
     // Delegate to the new ChatTextTokenizer class
@@ -234,9 +281,7 @@ static QStringList fontFamilies = QStringList() << "Menlo" << "monospace";
 
 inline void ChatTextWidget::appendSeparator(QTextCursor *cursor)
 {
-    // Ensure text block appended at end of document
-    cursor->movePosition(QTextCursor::End);
-
+    // Insert at cursor, which is at document end unless prepending
     QTextBlockFormat blockFmt;
     blockFmt.setTopMargin(0);
     blockFmt.setBottomMargin(0);
@@ -273,8 +318,7 @@ inline void ChatTextWidget::appendNormalText(QTextCursor *cursor, ChatMessage *m
     charFmt.setFontPointSize(16);
     charFmt.setForeground(Qt::white);
 
-    // Ensure new text block appended at document end
-    cursor->movePosition(QTextCursor::End);
+    // New text block behind the cursor position
     cursor->insertBlock(blockFmt, charFmt);
 
     // Assign LLM message to text block
@@ -316,8 +360,7 @@ inline void ChatTextWidget::appendCodeBlock(QTextCursor *cursor, ChatMessage *me
     codeCharFmt.setFontPointSize(16);
     codeCharFmt.setForeground(Qt::white);
 
-    // Ensure text block appended at end of document
-    cursor->movePosition(QTextCursor::End);
+    // New text block behind the cursor position
     cursor->insertBlock(codeBlockFmt, codeCharFmt);
 
     // Assign LLM message to text block
@@ -337,16 +380,27 @@ inline void ChatTextWidget::appendCodeBlock(QTextCursor *cursor, ChatMessage *me
 }
 
 void ChatTextWidget::appendMarkdown(ChatMessage *message)
+{
+    QTextCursor cursor = textCursor();
+    cursor.setVisualNavigation(true);
+
+    // Ensure text block appended at the end of document
+    cursor.movePosition(QTextCursor::End);
+
+    insertMarkdown(&cursor, message);
+
+    // move to end
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+}
+
+void ChatTextWidget::insertMarkdown(QTextCursor *cursor, ChatMessage *message)
 {
     // Use raw regex string for better readability
     const QRegularExpression startRe(R"(^(```(\s*([A-Za-z0-9_+\-=#]*))\s*$))");
     QString normalBuffer;
 
-    QTextCursor cursor = textCursor();
-    cursor.setVisualNavigation(true);
-
     if (!document()->isEmpty() && message->role() == ChatMessage::ChatRole) {
-        appendSeparator(&cursor);
+        appendSeparator(cursor);
     }
 
     QString markdown = message->content();
@@ -363,9 +417,6 @@ void ChatTextWidget::appendMarkdown(ChatMessage *message)
         markdown = "```json\n" + markdown + "\n```";
     }
 
-    // Ensure text block appended at the end of document
-    cursor.movePosition(QTextCursor::End);
-
     QString codeLang;
     QString codeBuffer;
     QStringList lines = markdown.split('\n');
@@ -377,7 +428,7 @@ void ChatTextWidget::appendMarkdown(ChatMessage *message)
         if (!inCode) {
             QRegularExpressionMatch match = startRe.match(line.trimmed());
             if (match.hasMatch()) {
-                appendNormalText(&cursor, message, normalBuffer);
+                appendNormalText(cursor, message, normalBuffer);
                 normalBuffer.clear();
                 // --
                 inCode = true;
@@ -407,7 +458,7 @@ void ChatTextWidget::appendMarkdown(ChatMessage *message)
 
             // for better separation
             //codeBuffer += '\n';
-            appendCodeBlock(&cursor, message, codeLang, codeBuffer);
+            appendCodeBlock(cursor, message, codeLang, codeBuffer);
 
             codeBuffer.clear();
             codeLang.clear();
@@ -415,10 +466,7 @@ void ChatTextWidget::appendMarkdown(ChatMessage *message)
     }
 
     if (!normalBuffer.isEmpty()) {
-        appendNormalText(&cursor, message, normalBuffer);
+        appendNormalText(cursor, message, normalBuffer);
         normalBuffer.clear();
     }
-
-    // move to end
-    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
 }
@@ -15,7 +15,11 @@ public:
     void setSyntaxColorModel(SyntaxColorModel *model);
     // LLM messages
     void appendMessage(ChatMessage *message);
+    // Older history page, rendered above the current content
+    void prependMessages(const QList<ChatMessage *> &messages);
     void removeMessage(ChatMessage *message);
+    // Scrolls the first block of a rendered message to the top
+    void scrollToMessage(ChatMessage *message);
 
 signals:
     // Signal emitted when the text document has been updated
@@ -29,6 +33,8 @@ protected:
 private:
     // append given rendered document fragment or text, and attach highlighter for any code blocks
     void appendMarkdown(ChatMessage *message);
+    // render message at cursor position
+    void insertMarkdown(QTextCursor *cursor, ChatMessage *message);
     // Tokenize code for syntax highlighting
     QVector<Token> tokenizeCode(const QString &code, const QString &language);
     // Convert tokens to HTML with syntax highlighting
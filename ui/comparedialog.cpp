@@ -0,0 +1,304 @@
+#include <comparedialog.h>
+#include <QApplication>
+#include <QDebug>
+#include <QHBoxLayout>
+#include <QScrollBar>
+#include <QSet>
+#include <QTextCursor>
+#include <QVBoxLayout>
+
+CompareDialog::CompareDialog(ToolModel *toolModel,
+                             LLMConnectionModel *connections,
+                             const QList<LLMChatClient::SendParameters> &messages,
+                             QWidget *parent)
+    : QDialog(parent)
+    , m_client(new LLMChatClient(toolModel, this))
+    , m_messages(messages)
+    , m_connections()
+    , m_columns()
+    , m_fanOutId(0)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setupUI();
+    loadTargets(connections);
+
+    connect(m_client, &LLMChatClient::fanOutResult, this, &CompareDialog::onFanOutResult);
+    connect(m_client, &LLMChatClient::fanOutFinished, this, &CompareDialog::onFanOutFinished);
+}
+
+CompareDialog::~CompareDialog()
+{
+    // answers nobody will look at
+    if (m_fanOutId != 0) {
+        m_client->cancelFanOut(m_fanOutId);
+    }
+}
+
+inline void CompareDialog::setupUI()
+{
+    setWindowTitle(tr("%1 - Compare Models").arg(qApp->applicationDisplayName()));
+    resize(1000, 640);
+
+    setStyleSheet(qApp->styleSheet());
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(12, 12, 12, 12);
+
+    // connection / model pairs to compare
+    m_targetList = new QListWidget(this);
+    m_targetList->setMaximumHeight(140);
+    m_targetList->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+    // one column per target
+    m_columnSplitter = new QSplitter(Qt::Horizontal, this);
+    m_columnSplitter->setChildrenCollapsible(false);
+    m_columnSplitter->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+
+    QWidget *buttonContainer = new QWidget(this);
+    buttonContainer->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout(buttonContainer);
+    buttonLayout->setContentsMargins(0, 0, 0, 0);
+
+    m_autoPickCheck = new QCheckBox(tr("Pick fastest acceptable answer automatically"), buttonContainer);
+    m_runButton = new QPushButton(tr("Run"), buttonContainer);
+    m_runButton->setEnabled(false);
+    QPushButton *closeButton = new QPushButton(tr("Close"), buttonContainer);
+
+    buttonLayout->addWidget(m_autoPickCheck);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(m_runButton);
+    buttonLayout->addWidget(closeButton);
+
+    m_statusLabel = new QLabel(this);
+    m_statusLabel->setStyleSheet("QLabel { color: blue; max-height: 20px;}");
+
+    mainLayout->addWidget(new QLabel(tr("Models:"), this));
+    mainLayout->addWidget(m_targetList);
+    mainLayout->addWidget(m_columnSplitter, 1);
+    mainLayout->addWidget(m_statusLabel);
+    mainLayout->addWidget(buttonContainer);
+
+    connect(m_runButton, &QPushButton::clicked, this, &CompareDialog::onRunClicked);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::reject);
+    connect(m_targetList, &QListWidget::itemChanged, this, [this]() {
+        bool checked = false;
+        for (int i = 0; i < m_targetList->count() && !checked; i++) {
+            checked = m_targetList->item(i)->checkState() == Qt::Checked;
+        }
+        m_runButton->setEnabled(checked && m_fanOutId == 0);
+    });
+}
+
+inline void CompareDialog::loadTargets(LLMConnectionModel *connections)
+{
+    foreach (const LLMConnection &connection, connections->getAllConnections()) {
+        if (!connection.isEnabled() || !connection.isValid()) {
+            continue;
+        }
+
+        // model list of this connection; the lister is created first so it
+        // is destroyed before the connection it ends the list request of
+        LLMChatClient *lister = new LLMChatClient(nullptr, this);
+        LLMConnection *copy = new LLMConnection(connection);
+        copy->setParent(this);
+        m_connections.append(copy);
+
+        const int index = m_connections.size() - 1;
+        lister->setConnection(copy);
+        // a cached list is loaded at once, a revalidated one again later
+        connect(lister->modelList(), &ModelListModel::modelsLoaded, this, [this, lister, index]() { //
+            showModels(index, lister->modelList()->modelList());
+        });
+        connect(lister, &LLMChatClient::requestFinished, lister, &QObject::deleteLater);
+        lister->listModels();
+        // nothing to wait for
+        if (lister->lastRequestId() == 0) {
+            lister->deleteLater();
+        }
+    }
+
+    m_statusLabel->setText(m_connections.isEmpty() ? tr("No enabled connection") : QString());
+}
+
+inline void CompareDialog::showModels(int connection, const QList<ModelListModel::ModelEntry> &models)
+{
+    // replace the items of this connection, checked models stay checked
+    QSet<QString> checked;
+    for (int i = m_targetList->count() - 1; i >= 0; i--) {
+        QListWidgetItem *item = m_targetList->item(i);
+        if (item->data(Qt::UserRole).toInt() != connection) {
+            continue;
+        }
+        if (item->checkState() == Qt::Checked) {
+            checked.insert(item->data(Qt::UserRole + 1).toString());
+        }
+        delete item;
+    }
+
+    foreach (const ModelListModel::ModelEntry &entry, models) {
+        QListWidgetItem *item = new QListWidgetItem( //
+            QStringLiteral("%1 / %2").arg(m_connections[connection]->name(), entry.id),
+            m_targetList);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState(checked.contains(entry.id) ? Qt::Checked : Qt::Unchecked);
+        item->setData(Qt::UserRole, connection);
+        item->setData(Qt::UserRole + 1, entry.id);
+    }
+}
+
+inline void CompareDialog::clearColumns()
+{
+    foreach (const Column &column, m_columns) {
+        column.chatModel->deleteLater();
+    }
+    m_columns.clear();
+    while (m_columnSplitter->count() > 0) {
+        delete m_columnSplitter->widget(0);
+    }
+}
+
+inline CompareDialog::Column CompareDialog::createColumn(const QString &title)
+{
+    QWidget *container = new QWidget(m_columnSplitter);
+    QVBoxLayout *layout = new QVBoxLayout(container);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    Column column{
+        .chatModel = new ChatModel(this),
+        .titleLabel = new QLabel(title, container),
+        .transcript = new QTextBrowser(container),
+        .statsLabel = new QLabel(tr("Waiting..."), container),
+        .useButton = new QPushButton(tr("Use this answer"), container),
+        .shown = 0,
+    };
+    column.titleLabel->setWordWrap(true);
+    column.useButton->setEnabled(false);
+
+    layout->addWidget(column.titleLabel);
+    layout->addWidget(column.transcript, 1);
+    layout->addWidget(column.statsLabel);
+    layout->addWidget(column.useButton);
+
+    m_columnSplitter->addWidget(container);
+    return column;
+}
+
+void CompareDialog::onRunClicked()
+{
+    clearColumns();
+
+    QList<LLMChatClient::FanOutTarget> targets;
+    for (int i = 0; i < m_targetList->count(); i++) {
+        const QListWidgetItem *item = m_targetList->item(i);
+        if (item->checkState() != Qt::Checked) {
+            continue;
+        }
+
+        const int index = m_columns.size();
+        m_columns.append(createColumn(item->text()));
+        const Column &column = m_columns.last();
+        targets.append({
+            .connection = m_connections.value(item->data(Qt::UserRole).toInt()),
+            .model = item->data(Qt::UserRole + 1).toString(),
+            .chatModel = column.chatModel,
+        });
+
+        connect(column.chatModel, &ChatModel::messageAdded, this, [this, index](ChatMessage *message) { //
+            updateTranscript(index, message);
+        });
+        connect(column.chatModel, &ChatModel::messageChanged, this, [this, index](ChatMessage *message, int) { //
+            updateTranscript(index, message);
+        });
+        connect(column.useButton, &QPushButton::clicked, this, [this, index]() {
+            if (const ChatMessage *message = answer(index)) {
+                emit answerSelected(message);
+                accept();
+            }
+        });
+    }
+    if (targets.isEmpty()) {
+        return;
+    }
+
+    m_runButton->setEnabled(false);
+    m_statusLabel->setText(tr("Running %1 models...").arg(targets.size()));
+    m_fanOutId = m_client->sendFanOut(m_messages, targets);
+}
+
+inline void CompareDialog::updateTranscript(int column, ChatMessage *message)
+{
+    if (column < 0 || column >= m_columns.size() || !message || message->isUser()) {
+        return;
+    }
+
+    // streamed deltas are appended, not re-rendered
+    Column &c = m_columns[column];
+    if (message->contentLength() < c.shown) {
+        c.transcript->clear();
+        c.shown = 0;
+    }
+    QTextCursor cursor(c.transcript->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(message->contentSince(c.shown));
+    c.shown = message->contentLength();
+    c.transcript->verticalScrollBar()->setValue(c.transcript->verticalScrollBar()->maximum());
+}
+
+inline ChatMessage *CompareDialog::answer(int column) const
+{
+    if (column < 0 || column >= m_columns.size()) {
+        return nullptr;
+    }
+    const ChatModel *chatModel = m_columns[column].chatModel;
+    for (int i = chatModel->rowCount() - 1; i >= 0; i--) {
+        ChatMessage *message = chatModel->messageAt(i);
+        if (message && !message->isUser() && message->hasContent()) {
+            return message;
+        }
+    }
+    return nullptr;
+}
+
+void CompareDialog::onFanOutResult(quint64 fanOutId, const LLMChatClient::FanOutResult &result)
+{
+    if (fanOutId != m_fanOutId || result.index < 0 || result.index >= m_columns.size()) {
+        return;
+    }
+
+    const Column &column = m_columns[result.index];
+    if (!result.error.isEmpty()) {
+        column.statsLabel->setText(tr("Failed: %1").arg(result.error));
+    } else {
+        column.statsLabel->setText(tr("TTFT %1 ms · %2 tok/s · %3 s") //
+                                       .arg(result.firstTokenMs)
+                                       .arg(result.tokensPerSecond, 0, 'f', 1)
+                                       .arg(result.totalMs / 1000.0, 0, 'f', 1));
+    }
+    column.useButton->setEnabled(answer(result.index) != nullptr);
+}
+
+void CompareDialog::onFanOutFinished(quint64 fanOutId, int best)
+{
+    if (fanOutId != m_fanOutId) {
+        return;
+    }
+    m_fanOutId = 0;
+    m_runButton->setEnabled(true);
+
+    if (best < 0 || best >= m_columns.size()) {
+        m_statusLabel->setText(tr("No acceptable answer"));
+        return;
+    }
+
+    const Column &column = m_columns[best];
+    m_statusLabel->setText(tr("Fastest acceptable answer: %1").arg(column.titleLabel->text()));
+    column.titleLabel->setText(tr("%1 (fastest)").arg(column.titleLabel->text()));
+
+    if (m_autoPickCheck->isChecked()) {
+        if (const ChatMessage *message = answer(best)) {
+            emit answerSelected(message);
+            accept();
+        }
+    }
+}
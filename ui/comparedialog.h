@@ -0,0 +1,73 @@
+#pragma once
+#include <chatmodel.h>
+#include <llmchatclient.h>
+#include <llmconnectionmodel.h>
+#include <QCheckBox>
+#include <QDialog>
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QSplitter>
+#include <QTextBrowser>
+
+/**
+ * @brief Sends one prompt to several models side by side.
+ *
+ * The targets are the models of every enabled connection. All selected
+ * targets are requested at once, each answer streams into its own column
+ * with time to first token and throughput. The chosen answer, or the
+ * fastest acceptable one, is handed back to the chat. The dialog sends
+ * through a client of its own, so a failing target neither cancels the
+ * other targets nor reaches the chat transcript.
+ */
+class CompareDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit CompareDialog(ToolModel *toolModel,
+                           LLMConnectionModel *connections,
+                           const QList<LLMChatClient::SendParameters> &messages,
+                           QWidget *parent = nullptr);
+    ~CompareDialog();
+
+signals:
+    void answerSelected(const ChatMessage *message);
+
+private slots:
+    void onRunClicked();
+    void onFanOutResult(quint64 fanOutId, const LLMChatClient::FanOutResult &result);
+    void onFanOutFinished(quint64 fanOutId, int best);
+
+private:
+    struct Column
+    {
+        ChatModel *chatModel;
+        QLabel *titleLabel;
+        QTextBrowser *transcript;
+        QLabel *statsLabel;
+        QPushButton *useButton;
+        qsizetype shown; // content length already in the transcript
+    };
+
+    LLMChatClient *m_client;
+    QList<LLMChatClient::SendParameters> m_messages;
+    // copies of the enabled connections, owned by the dialog
+    QList<LLMConnection *> m_connections;
+    QListWidget *m_targetList;
+    QCheckBox *m_autoPickCheck;
+    QPushButton *m_runButton;
+    QSplitter *m_columnSplitter;
+    QLabel *m_statusLabel;
+    QList<Column> m_columns;
+    quint64 m_fanOutId;
+
+private:
+    inline void setupUI();
+    inline void loadTargets(LLMConnectionModel *connections);
+    inline void showModels(int connection, const QList<ModelListModel::ModelEntry> &models);
+    inline void clearColumns();
+    inline Column createColumn(const QString &title);
+    inline void updateTranscript(int column, ChatMessage *message);
+    inline ChatMessage *answer(int column) const;
+};
@@ -1,17 +1,23 @@
 #include <chatlistitemdelegate.h>
 #include <chatpanelwidget.h>
+#include <chatpersistenceservice.h>
+#include <chatsearchindex.h>
 #include <leftpanelwidget.h>
 #include <llmconnectionselection.h>
 #include <mainwindow.h>
 #include <QApplication>
+#include <QFileDialog>
+#include <QFutureWatcher>
 #include <QInputDialog>
 #include <QKeyEvent>
 #include <QLabel>
 #include <QMessageBox>
 #include <QMouseEvent>
 #include <QScrollBar>
+#include <QSet>
 #include <QStandardPaths>
 #include <QStyle>
+#include <QtConcurrent/QtConcurrent>
 
 LeftPanelWidget::LeftPanelWidget(QWidget *parent)
     : QWidget(parent)
@@ -30,6 +36,31 @@ LeftPanelWidget::LeftPanelWidget(QWidget *parent)
     connect(m_newChatButton, &QPushButton::clicked, this, &LeftPanelWidget::onNewChatClicked);
     layout->addWidget(m_newChatButton);
 
+    // ---------------- Search -------------------------------------
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setPlaceholderText(tr("Search chat histories"));
+    m_searchEdit->setClearButtonEnabled(true);
+    layout->addWidget(m_searchEdit);
+
+    m_searchResults = new QListWidget(this);
+    m_searchResults->setVisible(false);
+    m_searchResults->setWordWrap(true);
+    connect(m_searchResults, &QListWidget::itemActivated, this, &LeftPanelWidget::onSearchHitActivated);
+    connect(m_searchResults, &QListWidget::itemClicked, this, &LeftPanelWidget::onSearchHitActivated);
+    layout->addWidget(m_searchResults, 1);
+
+    // query once typing pauses
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(150);
+    connect(m_searchTimer, &QTimer::timeout, this, &LeftPanelWidget::onSearch);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &LeftPanelWidget::onSearchTextChanged);
+
+    // catch up with histories written while the index was not updated
+    ChatSearchIndex *searchIndex = ChatSearchIndex::instance();
+    connect(searchIndex, &ChatSearchIndex::indexingFinished, this, &LeftPanelWidget::onSearch);
+    searchIndex->indexDirectory(chatHistoryDirectory().absolutePath());
+
     // ---------------- Chat List ----------------------------------
 
     // connect new chat with connection changed and select as active chat
@@ -37,8 +68,12 @@ LeftPanelWidget::LeftPanelWidget(QWidget *parent)
         if (ChatPanelWidget *cpw = qobject_cast<ChatPanelWidget *>(w)) {
             // notify about LL model server connection changed
             connect(this, &LeftPanelWidget::connectionSelected, cpw, &ChatPanelWidget::onConnectionChanged);
-            // save chat messages with active chat name
-            connect(cpw, &ChatPanelWidget::chatTextUpdated, this, &LeftPanelWidget::onSaveChatHistory);
+            // chat messages are saved in the background, log named after the chat
+            if (m_chatListModel->rowCount() > 0) {
+                QModelIndex index = m_chatListModel->index(m_chatListModel->rowCount() - 1, 0);
+                cpw->chatModel()->setHistoryFile(newHistoryFile(index.data(Qt::DisplayRole).toString()));
+            }
+            MainWindow::window()->persistence()->watch(cpw->chatModel());
         }
         // Select the new chat
         if (m_chatListModel->rowCount() > 0) {
@@ -237,9 +272,14 @@ void LeftPanelWidget::onNewChatClicked()
         onSelectConnection();
     }
 
+    createChatPanel(name);
+}
+
+inline ChatPanelWidget *LeftPanelWidget::createChatPanel(const QString &name)
+{
     if (!m_connection.isValid()) {
         QMessageBox::information(this, qApp->applicationDisplayName(), "Invalid connection detected.");
-        return;
+        return nullptr;
     }
 
     if (MainWindow *mw = MainWindow::window()) {
@@ -250,6 +290,120 @@ void LeftPanelWidget::onNewChatClicked()
             mw->contentWidget());                         // placed in container widget
         // Create initial chat (raised chatWidgetAdded)
         m_chatListModel->addChat(name, newWidget);
+        return newWidget;
+    }
+
+    return nullptr;
+}
+
+void LeftPanelWidget::onOpenChatHistory()
+{
+    QString fileName = QFileDialog::getOpenFileName( //
+        this,
+        tr("Open Chat History"),
+        chatHistoryDirectory().absolutePath(),
+        tr("Chat History (*.chatlog *.json)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    openChatHistory(fileName);
+}
+
+inline ChatPanelWidget *LeftPanelWidget::openChatHistory(const QString &fileName)
+{
+    // find default connection
+    if (!m_connection.isValid()) {
+        foreach (auto connection, m_llmModel->getAllConnections()) {
+            if (connection.isDefault()) {
+                m_connection = connection;
+                break;
+            }
+        }
+    }
+
+    ChatPanelWidget *chatPanel = createChatPanel(QFileInfo(fileName).completeBaseName());
+    if (chatPanel && !chatPanel->openHistory(fileName)) {
+        QMessageBox::warning(this, qApp->applicationDisplayName(), tr("Unable to open chat history: %1").arg(fileName));
+        return nullptr;
+    }
+    return chatPanel;
+}
+
+void LeftPanelWidget::onSearchTextChanged()
+{
+    m_searchTimer->start();
+}
+
+void LeftPanelWidget::onSearch()
+{
+    const QString query = m_searchEdit->text().trimmed();
+    if (query.isEmpty()) {
+        m_searchResults->clear();
+        m_searchResults->setVisible(false);
+        return;
+    }
+
+    // the index may be merging on the writer thread, keep typing responsive
+    QFutureWatcher<QList<ChatSearchIndex::Hit>> *watcher = new QFutureWatcher<QList<ChatSearchIndex::Hit>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, query]() {
+        watcher->deleteLater();
+        // results of an outdated query
+        if (m_searchEdit->text().trimmed() != query) {
+            return;
+        }
+        showSearchHits(watcher->result());
+    });
+    watcher->setFuture(QtConcurrent::run([query]() { //
+        return ChatSearchIndex::instance()->search(query);
+    }));
+}
+
+inline void LeftPanelWidget::showSearchHits(const QList<ChatSearchIndex::Hit> &hits)
+{
+    m_searchResults->clear();
+    m_searchResults->setVisible(true);
+
+    foreach (const ChatSearchIndex::Hit &hit, hits) {
+        QListWidgetItem *item = new QListWidgetItem( //
+            QStringLiteral("%1\n%2").arg(QFileInfo(hit.historyFile).completeBaseName(), hit.preview),
+            m_searchResults);
+        item->setData(Qt::UserRole, hit.historyFile);
+        item->setData(Qt::UserRole + 1, hit.messageIndex);
+        item->setToolTip(hit.historyFile);
+    }
+
+    if (hits.isEmpty()) {
+        QListWidgetItem *item = new QListWidgetItem(tr("No matches"), m_searchResults);
+        item->setFlags(Qt::NoItemFlags);
+    }
+}
+
+void LeftPanelWidget::onSearchHitActivated(QListWidgetItem *item)
+{
+    const QString fileName = item->data(Qt::UserRole).toString();
+    if (fileName.isEmpty()) {
+        return;
+    }
+    const int messageIndex = item->data(Qt::UserRole + 1).toInt();
+
+    // chat is open already, a legacy .json hit by the log it was imported into
+    const QString logFile = ChatModel::historyLogFile(fileName);
+    for (int row = 0; row < m_chatListModel->chatCount(); row++) {
+        ChatModel *chatModel = m_chatListModel->chatModel(row);
+        if (chatModel && !chatModel->historyFile().isEmpty() && QFileInfo(chatModel->historyFile()).absoluteFilePath() == logFile) {
+            const QModelIndex index = m_chatListModel->index(row, 0);
+            m_chatListView->setCurrentIndex(index);
+            onChatItemClicked(index);
+            if (ChatListModel::ChatData *chatData = m_chatListModel->chatData(row)) {
+                chatData->widget->showMessage(messageIndex);
+            }
+            return;
+        }
+    }
+
+    if (ChatPanelWidget *chatPanel = openChatHistory(fileName)) {
+        chatPanel->showMessage(messageIndex);
     }
 }
 
@@ -266,6 +420,7 @@ void LeftPanelWidget::onContextMenu(const QPoint &point)
     contextMenu.addSeparator();
     // Add action to save chat history
     QAction *saveAction = contextMenu.addAction(tr("Save Chat History"));
+    QAction *openAction = contextMenu.addAction(tr("Open Chat History..."));
 
     // Enable/disable actions based on selection
     auto currentIndex = m_chatListView->currentIndex();
@@ -285,6 +440,8 @@ void LeftPanelWidget::onContextMenu(const QPoint &point)
     } else if (selectedAction == saveAction) {
         // Get the chat name and save history
         onSaveChatHistory();
+    } else if (selectedAction == openAction) {
+        onOpenChatHistory();
     }
 }
 
@@ -303,31 +460,53 @@ void LeftPanelWidget::keyPressEvent(QKeyEvent *event)
 void LeftPanelWidget::onSaveChatHistory()
 {
     auto currentIndex = m_chatListView->currentIndex();
-    QString chatName = currentIndex.data(Qt::DisplayRole).toString();
-
-    // Find the index of the chat with the given name
-    int row = -1;
-    for (int i = 0; i < m_chatListModel->chatCount(); ++i) {
-        QString name = m_chatListModel->data(m_chatListModel->index(i, 0), Qt::DisplayRole).toString();
-        if (name == chatName) {
-            row = i;
-            break;
-        }
-    }
-
-    // Chat not found, return
-    if (row == -1) {
+    if (!currentIndex.isValid()) {
         return;
     }
 
     // Get the ChatModel from the ChatPanelWidget
-    ChatModel *chatModel = m_chatListModel->chatModel(row);
+    ChatModel *chatModel = m_chatListModel->chatModel(currentIndex.row());
     if (!chatModel) {
         // ChatModel not found, return
         return;
     }
 
-    // Create a directory for chat histories if it doesn't exist
+    // Write pending changes now instead of after the debounce interval
+    if (MainWindow *mw = MainWindow::window()) {
+        mw->persistence()->markDirty(chatModel);
+        mw->persistence()->flush();
+    }
+}
+
+inline QString LeftPanelWidget::newHistoryFile(const QString &chatName) const
+{
+    // Sanitize the chat name to create a valid filename
+    QString sanitizedChatName = chatName;
+
+    // Replace invalid characters with underscores
+    sanitizedChatName.replace(QRegularExpression("[^a-zA-Z0-9_.-]"), "_");
+
+    // logs of open chats may not be written yet
+    QSet<QString> used;
+    for (int row = 0; row < m_chatListModel->rowCount(); row++) {
+        const ChatModel *chatModel = m_chatListModel->chatModel(row);
+        if (chatModel && !chatModel->historyFile().isEmpty()) {
+            used.insert(QFileInfo(chatModel->historyFile()).absoluteFilePath());
+        }
+    }
+
+    // Never continue the log of an older or another open chat with the same name
+    QDir chatDir = chatHistoryDirectory();
+    QString filePath = chatDir.absoluteFilePath(sanitizedChatName + ".chatlog");
+    for (int i = 2; QFileInfo::exists(filePath) || used.contains(filePath); i++) {
+        filePath = chatDir.absoluteFilePath(QStringLiteral("%1_%2.chatlog").arg(sanitizedChatName).arg(i));
+    }
+
+    return filePath;
+}
+
+inline QDir LeftPanelWidget::chatHistoryDirectory() const
+{
     QDir chatDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/chat_histories");
     if (!chatDir.exists()) {
         QFile::Permissions permissions;
@@ -339,19 +518,7 @@ void LeftPanelWidget::onSaveChatHistory()
         permissions.setFlag(QFile::Permission::ExeGroup, true);
         if (!chatDir.mkpath(chatDir.absolutePath(), permissions)) {
             qWarning("Unable to create directory: %s", qPrintable(chatDir.absolutePath()));
-            return;
         }
     }
-
-    // Sanitize the chat name to create a valid filename
-    QString sanitizedChatName = chatName;
-
-    // Replace invalid characters with underscores
-    sanitizedChatName.replace(QRegularExpression("[^a-zA-Z0-9_.-]"), "_");
-
-    // Create the file path
-    QString filePath = chatDir.absoluteFilePath(sanitizedChatName + ".json");
-
-    // Save the chat history to the file
-    chatModel->saveToFile(filePath);
+    return chatDir;
 }
@@ -1,10 +1,13 @@
 #pragma once
 #include <chatlistmodel.h>
 #include <chatpanelwidget.h>
+#include <chatsearchindex.h>
 #include <llmconnectionmodel.h>
 #include <QAbstractItemModel>
 #include <QContextMenuEvent>
+#include <QDir>
 #include <QHBoxLayout>
+#include <QLineEdit>
 #include <QListWidget>
 #include <QMenu>
 #include <QModelIndex>
@@ -34,6 +37,8 @@ public slots:
     void onNewChatClicked();
     // Add a slot for saving chat history
     void onSaveChatHistory();
+    // Open a saved chat history in a new chat
+    void onOpenChatHistory();
 
 private slots:
     void onChatItemClicked(const QModelIndex &index);
@@ -46,6 +51,9 @@ private slots:
     void onChatNameChanged(const QString &newName);
     void onDeleteChatRequested(int row);
     void onContextMenu(const QPoint &point);
+    void onSearchTextChanged();
+    void onSearch();
+    void onSearchHitActivated(QListWidgetItem *item);
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
@@ -54,6 +62,9 @@ private:
     ChatListModel *m_chatListModel;
     LLMConnectionModel *m_llmModel;
     QListView *m_chatListView; // Changed from QListWidget to QListView
+    QLineEdit *m_searchEdit;
+    QListWidget *m_searchResults;
+    QTimer *m_searchTimer;
     QPushButton *m_newChatButton;
     QPushButton *m_updatesButton;
     //QPushButton *m_downloadsButton;
@@ -65,4 +76,11 @@ private:
     int m_pendingDeleteIndex = -1;
     QMenu *m_contextMenu;
     LLMConnection m_connection;
+
+private:
+    inline ChatPanelWidget *createChatPanel(const QString &name);
+    inline void showSearchHits(const QList<ChatSearchIndex::Hit> &hits);
+    inline QDir chatHistoryDirectory() const;
+    inline QString newHistoryFile(const QString &chatName) const;
+    inline ChatPanelWidget *openChatHistory(const QString &fileName);
 };
@@ -1,13 +1,22 @@
+#include <attachmentcache.h>
 #include <chatpanelwidget.h>
+#include <chatpersistenceservice.h>
 #include <leftpanelwidget.h>
 #include <llmconnectionmodel.h>
 #include <llmconnectionsdialog.h>
+#include <llmmetrics.h>
+#include <llmtransport.h>
 #include <mainwindow.h>
+#include <modelcatalog.h>
+#include <performanceoverlay.h>
 #include <settingsmanager.h>
+#include <tokencounter.h>
+#include <tracebuffer.h>
 #include <QAction>
 #include <QApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFileDialog>
 #include <QHBoxLayout>
 #include <QMainWindow>
 #include <QMenu>
@@ -23,6 +32,8 @@ MainWindow::MainWindow(QWidget *parent)
     , m_connectionModel(new LLMConnectionModel(this))
     , m_syntaxModel(new SyntaxColorModel(this))
     , m_toolModel(new ToolModel(this))
+    , m_persistence(new ChatPersistenceService(this))
+    , m_overlay(nullptr)
 {
     setAttribute(Qt::WA_MacOpaqueSizeGrip, true);
     setWindowFlag(Qt::WindowType::Window, true);
@@ -70,6 +81,25 @@ MainWindow::MainWindow(QWidget *parent)
     // Load window size and position
     m_settingsManager->loadWindowSize(this);
 
+    // exact token counts with a tiktoken vocabulary, e.g. cl100k_base.tiktoken
+    const QString vocabulary = m_settingsManager->value("tokenizer/vocabulary", QString()).toString();
+    if (!vocabulary.isEmpty()) {
+        TokenCounter::instance()->load(vocabulary);
+    }
+    // token counts of attached files survive restarts unless disabled
+    AttachmentCache::instance()->setPersistent(m_settingsManager->value("attachments/persistCache", true).toBool());
+    // per completion timings as JSON lines, off unless a file is set
+    LLMMetrics::instance()->setTraceFile(m_settingsManager->value("metrics/traceFile", QString()).toString());
+    // model lists shared by all chats, shown at once after a restart and revalidated when older than the TTL
+    ModelCatalog::instance()->setTtl(m_settingsManager->value("models/catalogTtl", ModelCatalog::DefaultTtl / 1000).toLongLong() * 1000);
+    ModelCatalog::instance()->setPersistent(m_settingsManager->value("models/persistCatalog", true).toBool());
+    // servers failing this often in a row are skipped for the interval in msecs
+    LLMTransport::instance()->setCircuitPolicy( //
+        m_settingsManager->value("network/circuitFailures", LLMTransport::FailureThreshold).toInt(),
+        m_settingsManager->value("network/circuitOpenInterval", LLMTransport::OpenInterval).toLongLong());
+    // trace events for a dump from the start, otherwise recorded while the overlay is shown
+    TraceBuffer::instance()->setEnabled(m_settingsManager->value("metrics/traceEvents", false).toBool());
+
     QSplitter *splitter = new QSplitter(Qt::Horizontal, m_centralWidget);
     m_centralWidget->layout()->addWidget(splitter);
     splitter->insertWidget(0, leftPanel);
@@ -85,6 +115,12 @@ MainWindow::MainWindow(QWidget *parent)
     connect(qApp, &QApplication::aboutToQuit, this, [this] { //
         m_settingsManager->saveWindowSize(this);
         m_connectionModel->saveConnections();
+        // write pending chat changes before the chats go away
+        m_persistence->shutdown();
+        AttachmentCache::instance()->save();
+        ModelCatalog::instance()->save();
+        qDebug().noquote() << "[MainWindow] Connection pools:\n" << LLMTransport::instance()->report();
+        qDebug().noquote() << "[MainWindow] Completion timings:\n" << LLMMetrics::instance()->report();
     });
 
     // Setup menu bar
@@ -141,6 +177,29 @@ void MainWindow::setupMenuBar()
     connect(action, &QAction::triggered, this, []() { //
         loadStyleSheet(qApp, "eofaichat_purple");
     });
+
+    m_toolsMenu->addSeparator();
+
+    // Developer overlay and trace dump
+    action = m_toolsMenu->addAction(tr("Performance &overlay"));
+    action->setCheckable(true);
+    action->setShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_P));
+    connect(action, &QAction::toggled, this, [this](bool checked) {
+        if (!m_overlay) {
+            m_overlay = new PerformanceOverlay(this, m_centralWidget);
+        }
+        m_overlay->setActive(checked);
+    });
+    action = m_toolsMenu->addAction(tr("Save performance &trace..."));
+    connect(action, &QAction::triggered, this, [this]() {
+        const QString fileName = QFileDialog::getSaveFileName(this,
+                                                              tr("Save performance trace"),
+                                                              QDir::home().filePath("eofaichat-trace.json"),
+                                                              tr("Chrome trace (*.json)"));
+        if (!fileName.isEmpty() && TraceBuffer::instance()->writeChromeTrace(fileName)) {
+            statusBar()->showMessage(tr("Trace written to %1").arg(fileName), 5000);
+        }
+    });
 }
 
 void MainWindow::onManageConnections()
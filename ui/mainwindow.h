@@ -7,9 +7,11 @@
 #include <QSettings>
 #include <QWidget>
 
+class ChatPersistenceService;
 class SettingsManager;
 class LLMConnectionModel;
 class LLMConnectionsDialog;
+class PerformanceOverlay;
 class SyntaxColorModel;
 class ToolModel;
 
@@ -30,6 +32,7 @@ public:
     inline ToolModel *toolModel() const { return m_toolModel; }
     inline SettingsManager *settings() const { return m_settingsManager; }
     inline LLMConnectionModel *llmConnections() { return m_connectionModel; }
+    inline ChatPersistenceService *persistence() const { return m_persistence; }
 
 private slots:
     void onSwitchChatPanel(QWidget *chatWidget);
@@ -48,4 +51,6 @@ private:
     LLMConnectionModel *m_connectionModel;
     SyntaxColorModel *m_syntaxModel;
     ToolModel *m_toolModel;
+    ChatPersistenceService *m_persistence;
+    PerformanceOverlay *m_overlay;
 };
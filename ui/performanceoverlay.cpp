@@ -0,0 +1,172 @@
+#include <chatpanelwidget.h>
+#include <llmmetrics.h>
+#include <performanceoverlay.h>
+#include <tracebuffer.h>
+#include <QCoreApplication>
+#include <QEvent>
+#include <QFontDatabase>
+#include <QLocale>
+#include <QMap>
+#include <QStringList>
+#include <QTextDocument>
+
+PerformanceOverlay::PerformanceOverlay(QWidget *window, QWidget *parent)
+    : QLabel(parent)
+    , m_window(window)
+    , m_probeTimer(new QTimer(this))
+    , m_refreshTimer(new QTimer(this))
+    , m_probeClock()
+    , m_painting(false)
+    , m_wasTracing(false)
+{
+    setObjectName("performanceOverlay");
+    setAttribute(Qt::WA_TransparentForMouseEvents, true);
+    setTextFormat(Qt::PlainText);
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setStyleSheet("QLabel { background: rgba(0, 0, 0, 190); color: #9fef00; padding: 8px; border-radius: 6px; }");
+    hide();
+
+    parent->installEventFilter(this);
+
+    m_probeTimer->setInterval(ProbeInterval);
+    m_probeTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_probeTimer, &QTimer::timeout, this, &PerformanceOverlay::onProbe);
+    m_refreshTimer->setInterval(RefreshInterval);
+    connect(m_refreshTimer, &QTimer::timeout, this, &PerformanceOverlay::onRefresh);
+}
+
+void PerformanceOverlay::setActive(bool active)
+{
+    TraceBuffer *trace = TraceBuffer::instance();
+    if (active == m_refreshTimer->isActive()) {
+        return;
+    }
+
+    if (active) {
+        m_wasTracing = trace->isEnabled();
+        trace->setEnabled(true);
+        m_window->installEventFilter(this);
+        m_probeClock.start();
+        m_probeTimer->start();
+        m_refreshTimer->start();
+        onRefresh();
+        show();
+        raise();
+        return;
+    }
+
+    m_probeTimer->stop();
+    m_refreshTimer->stop();
+    m_window->removeEventFilter(this);
+    trace->setEnabled(m_wasTracing);
+    hide();
+}
+
+bool PerformanceOverlay::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == parent() && event->type() == QEvent::Resize) {
+        place();
+    }
+
+    // the window paints all dirty widgets on an update request, time it as one frame
+    if (watched == m_window && event->type() == QEvent::UpdateRequest && !m_painting) {
+        TraceScope scope("frame", "gui");
+        m_painting = true;
+        QCoreApplication::sendEvent(watched, event);
+        m_painting = false;
+        return true;
+    }
+    return QLabel::eventFilter(watched, event);
+}
+
+void PerformanceOverlay::onProbe()
+{
+    const qint64 elapsed = m_probeClock.restart();
+    TraceBuffer::instance()->counter("eventLoopLatency", "gui", qMax<qint64>(0, elapsed - ProbeInterval));
+}
+
+void PerformanceOverlay::onRefresh()
+{
+    TraceBuffer *trace = TraceBuffer::instance();
+    const QList<TraceBuffer::Event> events = trace->events(TraceBuffer::now() - 1000000000LL);
+
+    // last second
+    QList<double> frames, latencies;
+    QMap<QString, int> signalCounts;
+    double streamEvents = 0, renderMs = 0;
+    foreach (const TraceBuffer::Event &event, events) {
+        if (event.phase == 'X' && qstrcmp(event.name, "frame") == 0) {
+            frames.append(event.durationNs / 1e6);
+        } else if (event.phase == 'X' && qstrcmp(event.category, "render") == 0) {
+            renderMs += event.durationNs / 1e6;
+        } else if (event.phase == 'C' && qstrcmp(event.name, "eventLoopLatency") == 0) {
+            latencies.append(event.value);
+        } else if (event.phase == 'C' && qstrcmp(event.name, "streamEvents") == 0) {
+            streamEvents += event.value;
+        } else if (event.phase == 'i' && qstrcmp(event.category, "ChatModel") == 0) {
+            signalCounts[QString::fromUtf8(event.name)]++;
+        }
+    }
+
+    QStringList lines;
+    lines.append(QStringLiteral("frame    %1/s  p50 %2 ms  max %3 ms") //
+                     .arg(frames.size())
+                     .arg(qMax(0.0, LLMMetrics::percentile(frames, 50)), 0, 'f', 1)
+                     .arg(qMax(0.0, LLMMetrics::percentile(frames, 100)), 0, 'f', 1));
+    lines.append(QStringLiteral("latency  p95 %1 ms  max %2 ms") //
+                     .arg(qMax(0.0, LLMMetrics::percentile(latencies, 95)), 0, 'f', 0)
+                     .arg(qMax(0.0, LLMMetrics::percentile(latencies, 100)), 0, 'f', 0));
+    QStringList rates;
+    foreach (const QString &name, QStringList({"messageAdded", "messageChanged", "messageRemoved"})) {
+        rates.append(QStringLiteral("%1 %2/s").arg(name.mid(7).toLower()).arg(signalCounts.value(name)));
+    }
+    lines.append(QStringLiteral("signals  ") + rates.join(QStringLiteral("  ")));
+    // servers stream about one token per event
+    lines.append(QStringLiteral("stream   ~%1 tok/s  render %2 ms/s").arg(streamEvents, 0, 'f', 0).arg(renderMs, 0, 'f', 1));
+
+    // chat shown in the window
+    ChatPanelWidget *panel = nullptr;
+    foreach (ChatPanelWidget *widget, m_window->findChildren<ChatPanelWidget *>()) {
+        if (widget->isVisible()) {
+            panel = widget;
+            break;
+        }
+    }
+    if (panel) {
+        const ChatModel *model = panel->chatModel();
+        qint64 bytes = 0;
+        for (int i = 0; i < model->rowCount(); i++) {
+            const ChatMessage *message = model->messageAt(i);
+            bytes += qint64(sizeof(ChatMessage)) + message->contentLength() * qint64(sizeof(QChar)) + message->toolContent().size();
+        }
+        const QTextDocument *document = panel->chatView()->document();
+        lines.append(QStringLiteral("chat     %1 messages  ~%2") //
+                         .arg(model->rowCount())
+                         .arg(QLocale().formattedDataSize(bytes)));
+        lines.append(QStringLiteral("document %1 chars  %2 blocks  ~%3") //
+                         .arg(document->characterCount())
+                         .arg(document->blockCount())
+                         .arg(QLocale().formattedDataSize(qint64(document->characterCount()) * qint64(sizeof(QChar)))));
+    }
+
+    // last tool runs of the whole buffer
+    QStringList tools;
+    const QList<TraceBuffer::Event> all = trace->events();
+    for (qsizetype i = all.size() - 1; i >= 0 && tools.size() < 3; i--) {
+        if (all[i].phase == 'X' && qstrcmp(all[i].category, "tool") == 0) {
+            tools.append(QStringLiteral("%1 %2 ms").arg(QString::fromUtf8(all[i].name)).arg(all[i].durationNs / 1e6, 0, 'f', 1));
+        }
+    }
+    lines.append(QStringLiteral("tools    ") + (tools.isEmpty() ? QStringLiteral("-") : tools.join(QStringLiteral(", "))));
+
+    setText(lines.join('\n'));
+    adjustSize();
+    place();
+}
+
+inline void PerformanceOverlay::place()
+{
+    if (QWidget *area = parentWidget()) {
+        move(area->width() - width() - 12, 12);
+    }
+}
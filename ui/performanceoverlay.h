@@ -0,0 +1,47 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QTimer>
+#include <QWidget>
+
+/**
+ * @brief Developer overlay with live GUI and stream figures.
+ *
+ * Floats in the top right corner of its parent and shows, for the last
+ * second, the frame times of the window, the event-loop latency, the
+ * ChatModel signal rates and stream events, then the size of the current
+ * chat model and document and the last tool runs. The figures come from
+ * TraceBuffer, which records while the overlay is shown.
+ */
+class PerformanceOverlay : public QLabel
+{
+    Q_OBJECT
+
+public:
+    // lateness of this timer is the event-loop latency
+    static constexpr int ProbeInterval = 50;
+    static constexpr int RefreshInterval = 500;
+
+    explicit PerformanceOverlay(QWidget *window, QWidget *parent);
+
+    void setActive(bool active);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void onProbe();
+    void onRefresh();
+
+private:
+    QWidget *m_window;
+    QTimer *m_probeTimer;
+    QTimer *m_refreshTimer;
+    QElapsedTimer m_probeClock;
+    bool m_painting;
+    // trace recording was on before the overlay turned it on
+    bool m_wasTracing;
+
+private:
+    inline void place();
+};
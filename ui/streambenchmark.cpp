@@ -0,0 +1,231 @@
+#include <llmmetrics.h>
+#include <streambenchmark.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEvent>
+
+StreamBenchmark::StreamBenchmark(const MockLLMServer::Options &options, int answers, QObject *parent)
+    : QObject{parent}
+    , m_server(new MockLLMServer(this))
+    , m_connection(nullptr)
+    , m_toolModel(new ToolModel(this))
+    , m_chatModel(new ChatModel(this))
+    , m_colorModel(new SyntaxColorModel(this))
+    , m_chatView(nullptr)
+    , m_client(nullptr)
+    , m_frameTimer(new QTimer(this))
+    , m_clock()
+    , m_cpuStart(0)
+    , m_cpuEnd(0)
+    , m_wallMs(0)
+    , m_lastPaint(-1)
+    , m_lastTick(-1)
+    , m_painting(false)
+    , m_paintMs()
+    , m_paintIntervalMs()
+    , m_latencyMs()
+    , m_answers(qMax(1, answers))
+    , m_done(0)
+    , m_errors(0)
+    , m_toolCalls(0)
+    , m_requestId(0)
+{
+    m_server->setOptions(options);
+
+    // one tool the mock server can call
+    if (options.toolCalls) {
+        m_toolModel->addToolEntry(ToolModel::ToolModelEntry{
+            .tool =
+                QJsonObject{
+                    {"type", "function"},
+                    {"function",
+                     QJsonObject{
+                         {"name", "mock_search"},
+                         {"description", "Benchmark tool, never executed"},
+                         {"parameters", QJsonObject{{"type", "object"}, {"properties", QJsonObject{{"query", QJsonObject{{"type", "string"}}}}}}},
+                     }},
+                },
+            .name = QStringLiteral("mock_search"),
+            .title = QStringLiteral("Mock search"),
+            .description = QStringLiteral("Benchmark tool, never executed"),
+            .execHandler = QString(),
+            .execMethod = QString(),
+            .option = ToolModel::ToolEnabled,
+            .type = ToolModel::ToolFunction,
+            .readOnly = true,
+        });
+    }
+
+    m_chatView = new ChatTextWidget(nullptr, m_colorModel);
+    m_chatView->setWindowTitle(tr("Stream benchmark"));
+    m_chatView->resize(900, 700);
+    m_chatView->viewport()->installEventFilter(this);
+
+    connect(m_chatModel, &ChatModel::messageAdded, m_chatView, &ChatTextWidget::appendMessage);
+    connect(m_chatModel, &ChatModel::messageChanged, m_chatView, [this](ChatMessage *message) { //
+        m_chatView->appendMessage(message);
+    });
+    connect(m_chatModel, &ChatModel::toolRequest, this, [this]() { //
+        m_toolCalls++;
+    });
+
+    // late timeouts are the event-loop latency the user feels
+    m_frameTimer->setInterval(16);
+    m_frameTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_frameTimer, &QTimer::timeout, this, &StreamBenchmark::onFrameTick);
+}
+
+StreamBenchmark::~StreamBenchmark()
+{
+    delete m_client;
+    delete m_connection;
+    delete m_chatView;
+}
+
+bool StreamBenchmark::start()
+{
+    if (!m_server->listen(0)) {
+        return false;
+    }
+
+    m_connection = new LLMConnection(QStringLiteral("Mock"), QStringLiteral("OpenAI"), QStringLiteral("http://localhost:%1").arg(m_server->port()), QString(), true, true);
+    m_connection->setEndpointUri(LLMConnection::EndpointModels, "/v1/models");
+    m_connection->setEndpointUri(LLMConnection::EndpointCompletion, "/v1/chat/completions");
+
+    m_client = new LLMChatClient(m_toolModel);
+    m_client->setConnection(m_connection);
+    m_client->setChatModel(m_chatModel);
+    m_client->setActiveModel(ModelListModel::ModelEntry{
+        .id = m_server->options().models.first(),
+        .object = QStringLiteral("model"),
+        .ownedBy = QStringLiteral("mock"),
+    });
+    connect(m_client, &LLMChatClient::requestFinished, this, &StreamBenchmark::onRequestFinished);
+    connect(m_client, &LLMChatClient::errorOccurred, this, [this](const QString &error) {
+        qWarning().noquote() << "[StreamBenchmark] Error:" << error;
+        m_errors++;
+    });
+    // failed replies are reported as network errors, the request still finishes
+    connect(m_client, &LLMChatClient::networkError, this, [this](QNetworkReply::NetworkError error, const QString &message) {
+        qWarning().noquote() << "[StreamBenchmark] Network error:" << error << message;
+        m_errors++;
+    });
+
+    m_chatView->show();
+    m_clock.start();
+    m_cpuStart = std::clock();
+    m_frameTimer->start();
+    sendNext();
+    return true;
+}
+
+inline void StreamBenchmark::sendNext()
+{
+    const quint64 lastId = m_client->lastRequestId();
+    const int errors = m_errors;
+    m_client->sendChat(LLMChatClient::SendParameters{.content = QStringLiteral("Stream benchmark %1").arg(m_done + 1)}, true);
+    if (m_client->lastRequestId() != lastId) {
+        m_requestId = m_client->lastRequestId();
+        return;
+    }
+
+    // not sent, no request will finish: counted once, the run goes on
+    qWarning().noquote() << "[StreamBenchmark] Request" << m_done + 1 << "not sent";
+    if (m_errors == errors) {
+        m_errors++;
+    }
+    m_requestId = 0;
+    QTimer::singleShot(0, this, [this]() { //
+        onRequestFinished(0);
+    });
+}
+
+void StreamBenchmark::onRequestFinished(quint64 id)
+{
+    if (id != m_requestId) {
+        return;
+    }
+    if (++m_done < m_answers) {
+        sendNext();
+        return;
+    }
+
+    m_cpuEnd = std::clock();
+    m_wallMs = m_clock.elapsed();
+    m_frameTimer->stop();
+
+    const QJsonObject summary = result();
+    qDebug().noquote() << "[StreamBenchmark]" << m_server->tokensSent() << "tokens in" << m_wallMs << "ms," //
+                       << summary["cpuUsPerToken"].toDouble() << "us CPU per token";
+    emit finished(summary);
+}
+
+void StreamBenchmark::onFrameTick()
+{
+    const qint64 now = m_clock.elapsed();
+    if (m_lastTick >= 0) {
+        m_latencyMs.append(qMax<qint64>(0, now - m_lastTick - m_frameTimer->interval()));
+    }
+    m_lastTick = now;
+}
+
+bool StreamBenchmark::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() != QEvent::Paint || m_painting) {
+        return QObject::eventFilter(watched, event);
+    }
+
+    // paint now to time it, the nested delivery passes this filter
+    QElapsedTimer timer;
+    timer.start();
+    m_painting = true;
+    QCoreApplication::sendEvent(watched, event);
+    m_painting = false;
+    m_paintMs.append(timer.nsecsElapsed() / 1000000.0);
+
+    const qint64 now = m_clock.elapsed();
+    if (m_lastPaint >= 0) {
+        m_paintIntervalMs.append(now - m_lastPaint);
+    }
+    m_lastPaint = now;
+    return true;
+}
+
+inline QJsonObject StreamBenchmark::stats(const QList<double> &values)
+{
+    double max = 0;
+    foreach (double value, values) {
+        max = qMax(max, value);
+    }
+    return QJsonObject{
+        {"count", int(values.size())},
+        {"p50", LLMMetrics::percentile(values, 50)},
+        {"p95", LLMMetrics::percentile(values, 95)},
+        {"max", max},
+    };
+}
+
+QJsonObject StreamBenchmark::result() const
+{
+    const MockLLMServer::Options &options = m_server->options();
+    const qint64 tokens = m_server->tokensSent();
+    const double cpuMs = double(m_cpuEnd - m_cpuStart) * 1000.0 / CLOCKS_PER_SEC;
+
+    return QJsonObject{
+        {"answers", m_done},
+        {"errors", m_errors},
+        {"toolCalls", m_toolCalls},
+        {"rate", options.tokensPerSecond},
+        {"chunkTokens", options.chunkTokens},
+        {"malformed", m_server->malformedSent()},
+        {"tokens", tokens},
+        {"events", m_server->eventsSent()},
+        {"wallMs", m_wallMs},
+        {"tokensPerSecond", m_wallMs > 0 ? tokens * 1000.0 / m_wallMs : 0.0},
+        {"cpuMs", cpuMs},
+        {"cpuUsPerToken", tokens > 0 ? cpuMs * 1000.0 / tokens : 0.0},
+        {"paintMs", stats(m_paintMs)},
+        {"paintIntervalMs", stats(m_paintIntervalMs)},
+        {"eventLoopLatencyMs", stats(m_latencyMs)},
+    };
+}
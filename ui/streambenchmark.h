@@ -0,0 +1,74 @@
+#pragma once
+#include <chatmodel.h>
+#include <chattextwidget.h>
+#include <llmchatclient.h>
+#include <llmconnectionmodel.h>
+#include <mockllmserver.h>
+#include <syntaxcolormodel.h>
+#include <toolmodel.h>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QTimer>
+#include <ctime>
+
+/**
+ * @brief Streams mock answers through the whole chat pipeline.
+ *
+ * Starts a MockLLMServer on a free port and sends chat requests to it
+ * through LLMChatClient, ChatModel and a visible ChatTextWidget, one
+ * answer after the other. Reports the process CPU time per token, the
+ * duration of and interval between the paints of the chat view, and the
+ * event-loop latency seen by a 16 ms timer. The mock server runs in the
+ * same process, so its share is part of the CPU figure.
+ */
+class StreamBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamBenchmark(const MockLLMServer::Options &options, int answers = 5, QObject *parent = nullptr);
+    ~StreamBenchmark();
+
+    bool start();
+    QJsonObject result() const;
+
+signals:
+    void finished(const QJsonObject &result);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void onRequestFinished(quint64 id);
+    void onFrameTick();
+
+private:
+    MockLLMServer *m_server;
+    LLMConnection *m_connection;
+    ToolModel *m_toolModel;
+    ChatModel *m_chatModel;
+    SyntaxColorModel *m_colorModel;
+    ChatTextWidget *m_chatView;
+    LLMChatClient *m_client;
+    QTimer *m_frameTimer;
+    QElapsedTimer m_clock;
+    std::clock_t m_cpuStart;
+    std::clock_t m_cpuEnd;
+    qint64 m_wallMs;
+    qint64 m_lastPaint;
+    qint64 m_lastTick;
+    bool m_painting;
+    QList<double> m_paintMs;
+    QList<double> m_paintIntervalMs;
+    QList<double> m_latencyMs;
+    int m_answers;
+    int m_done;
+    int m_errors;
+    int m_toolCalls;
+    quint64 m_requestId;
+
+private:
+    inline void sendNext();
+    static inline QJsonObject stats(const QList<double> &values);
+};
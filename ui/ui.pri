@@ -8,13 +8,16 @@ HEADERS += \
     $$PWD/chatpanelwidget.h \
     $$PWD/chattextwidget.h \
     $$PWD/codehighlighter.h \
+    $$PWD/comparedialog.h \
     $$PWD/filelistwidget.h \
     $$PWD/filenamelabel.h \
     $$PWD/leftpanelwidget.h \
     $$PWD/llmconnectionsdialog.h \
     $$PWD/llmconnectionselection.h \
     $$PWD/mainwindow.h \
+    $$PWD/performanceoverlay.h \
     $$PWD/progresspopup.h \
+    $$PWD/streambenchmark.h \
     $$PWD/toolswidget.h
 
 SOURCES += \
@@ -24,11 +27,14 @@ SOURCES += \
     $$PWD/chatpanelwidget.cpp \
     $$PWD/chattextwidget.cpp \
     $$PWD/codehighlighter.cpp \
+    $$PWD/comparedialog.cpp \
     $$PWD/filelistwidget.cpp \
     $$PWD/filenamelabel.cpp \
     $$PWD/leftpanelwidget.cpp \
     $$PWD/llmconnectionsdialog.cpp \
     $$PWD/llmconnectionselection.cpp \
     $$PWD/mainwindow.cpp \
+    $$PWD/performanceoverlay.cpp \
     $$PWD/progresspopup.cpp \
+    $$PWD/streambenchmark.cpp \
     $$PWD/toolswidget.cpp
\ No newline at end of file